@@ -219,7 +219,9 @@ extern "C" {
    * Set a list node name function.
    * This callback function will be called whenever the name of a list
    * item needs to be determined.  This is used to find list items by
-   * name.
+   * name.  Lists with a name function are indexed by name, so the
+   * name of an item must not change while it is in the list (other
+   * than by replacing its data with stp_list_item_set_data).
    * @param list the list to use.
    * @param namefunc the function to set.
    */
@@ -238,7 +240,8 @@ extern "C" {
    * Set a list node long name function.
    * This callback function will be called whenever the long name of a list
    * item needs to be determined.  This is used to find list items by
-   * long name.
+   * long name.  As with stp_list_set_namefunc, the long name of an
+   * item must not change while it is in the list.
    * @param list the list to use.
    * @param long_namefunc the function to set.
    */
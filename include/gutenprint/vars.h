@@ -1394,6 +1394,418 @@ stp_get_parameter_active(const stp_vars_t *v, const char *parameter,
 
 
 
+/****************************************************************
+*                                                               *
+* PARAMETER KEYS                                                *
+*                                                               *
+****************************************************************/
+
+/**
+ * An interned parameter name.
+ * Code that gets or sets the same parameters repeatedly can intern
+ * their names once and use the _k accessors below, which index the
+ * parameter values directly rather than looking up the name.  Keys
+ * are global and remain valid for the life of the program.
+ *
+ * stp_parameter_intern() and stp_parameter_key_name() may be called
+ * from any thread at any time, and a key obtained in one thread may be
+ * used in any other.  The _k accessors are no more thread-safe than the
+ * accessors taking names: a vars object must not be used by one thread
+ * while another is modifying it.
+ */
+typedef int stp_parameter_key_t;
+
+/** The key of no parameter. */
+#define STP_PARAMETER_KEY_INVALID (-1)
+
+/**
+ * Intern a parameter name.
+ * @param name the name of the parameter.
+ * @returns the key for the name; the same name always yields the same
+ * key.  STP_PARAMETER_KEY_INVALID is returned if name is NULL.
+ */
+extern stp_parameter_key_t stp_parameter_intern(const char *name);
+
+/**
+ * Get the name of an interned parameter.
+ * @param key the key of the parameter.
+ * @returns the name, or NULL if the key is invalid.
+ */
+extern const char *stp_parameter_key_name(stp_parameter_key_t key);
+
+/**
+ * Set a string parameter by key.
+ * This is equivalent to stp_set_string_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param value the value to set.
+ */
+extern void stp_set_string_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+				       const char *value);
+
+/**
+ * Get a string parameter by key.
+ * This is equivalent to stp_get_string_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @returns the string, or NULL if no parameter was found.
+ */
+extern const char *stp_get_string_parameter_k(const stp_vars_t *v,
+					      stp_parameter_key_t key);
+
+/**
+ * Set a file parameter by key.
+ * This is equivalent to stp_set_file_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param value the value to set.
+ */
+extern void stp_set_file_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+				     const char *value);
+
+/**
+ * Get a file parameter by key.
+ * This is equivalent to stp_get_file_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @returns the filename, or NULL if no parameter was found.
+ */
+extern const char *stp_get_file_parameter_k(const stp_vars_t *v,
+					    stp_parameter_key_t key);
+
+/**
+ * Set a float parameter by key.
+ * This is equivalent to stp_set_float_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param value the value to set.
+ */
+extern void stp_set_float_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+				      double value);
+
+/**
+ * Get a float parameter by key.
+ * This is equivalent to stp_get_float_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @returns the float value.
+ */
+extern double stp_get_float_parameter_k(const stp_vars_t *v,
+					stp_parameter_key_t key);
+
+/**
+ * Set an integer parameter by key.
+ * This is equivalent to stp_set_int_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param value the value to set.
+ */
+extern void stp_set_int_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+				    int value);
+
+/**
+ * Get an integer parameter by key.
+ * This is equivalent to stp_get_int_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @returns the integer value.
+ */
+extern int stp_get_int_parameter_k(const stp_vars_t *v,
+				   stp_parameter_key_t key);
+
+/**
+ * Set a dimension parameter by key.
+ * This is equivalent to stp_set_dimension_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param value the value to set.
+ */
+extern void stp_set_dimension_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+					  stp_dimension_t value);
+
+/**
+ * Get a dimension parameter by key.
+ * This is equivalent to stp_get_dimension_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @returns the dimension value.
+ */
+extern stp_dimension_t stp_get_dimension_parameter_k(const stp_vars_t *v,
+						     stp_parameter_key_t key);
+
+/**
+ * Set a boolean parameter by key.
+ * This is equivalent to stp_set_boolean_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param value the value to set.
+ */
+extern void stp_set_boolean_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+					int value);
+
+/**
+ * Get a boolean parameter by key.
+ * This is equivalent to stp_get_boolean_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @returns the boolean value.
+ */
+extern int stp_get_boolean_parameter_k(const stp_vars_t *v,
+				       stp_parameter_key_t key);
+
+/**
+ * Set a curve parameter by key.
+ * This is equivalent to stp_set_curve_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param value the value to set.
+ */
+extern void stp_set_curve_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+				      const stp_curve_t *value);
+
+/**
+ * Get a curve parameter by key.
+ * This is equivalent to stp_get_curve_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @returns the curve, or NULL if no parameter was found.
+ */
+extern const stp_curve_t *stp_get_curve_parameter_k(const stp_vars_t *v,
+						    stp_parameter_key_t key);
+
+/**
+ * Set an array parameter by key.
+ * This is equivalent to stp_set_array_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param value the value to set.
+ */
+extern void stp_set_array_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+				      const stp_array_t *value);
+
+/**
+ * Get an array parameter by key.
+ * This is equivalent to stp_get_array_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @returns the array, or NULL if no parameter was found.
+ */
+extern const stp_array_t *stp_get_array_parameter_k(const stp_vars_t *v,
+						    stp_parameter_key_t key);
+
+/**
+ * Set a raw parameter by key.
+ * This is equivalent to stp_set_raw_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param value the value to set.
+ * @param bytes the length of value in bytes.
+ */
+extern void stp_set_raw_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+				    const void *value, size_t bytes);
+
+/**
+ * Get a raw parameter by key.
+ * This is equivalent to stp_get_raw_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @returns the raw data, or NULL if no parameter was found.
+ */
+extern const stp_raw_t *stp_get_raw_parameter_k(const stp_vars_t *v,
+						stp_parameter_key_t key);
+
+/**
+ * Check whether a parameter is defined, by key.
+ * This is equivalent to stp_check_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param active the minimum activity status.
+ * @param p_type the type of the parameter.
+ * @returns 1 if the parameter is defined, otherwise 0.
+ */
+extern int stp_check_parameter_k(const stp_vars_t *v, stp_parameter_key_t key,
+				 stp_parameter_activity_t active,
+				 stp_parameter_type_t p_type);
+
+/**
+ * Check if a string parameter is defined, by key.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param active the minimum activity status.
+ * @returns 1 if the parameter is defined, otherwise 0.
+ */
+extern int stp_check_string_parameter_k(const stp_vars_t *v,
+					stp_parameter_key_t key,
+					stp_parameter_activity_t active);
+
+/**
+ * Check if a file parameter is defined, by key.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param active the minimum activity status.
+ * @returns 1 if the parameter is defined, otherwise 0.
+ */
+extern int stp_check_file_parameter_k(const stp_vars_t *v,
+				      stp_parameter_key_t key,
+				      stp_parameter_activity_t active);
+
+/**
+ * Check if a float parameter is defined, by key.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param active the minimum activity status.
+ * @returns 1 if the parameter is defined, otherwise 0.
+ */
+extern int stp_check_float_parameter_k(const stp_vars_t *v,
+				       stp_parameter_key_t key,
+				       stp_parameter_activity_t active);
+
+/**
+ * Check if an integer parameter is defined, by key.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param active the minimum activity status.
+ * @returns 1 if the parameter is defined, otherwise 0.
+ */
+extern int stp_check_int_parameter_k(const stp_vars_t *v,
+				     stp_parameter_key_t key,
+				     stp_parameter_activity_t active);
+
+/**
+ * Check if a dimension parameter is defined, by key.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param active the minimum activity status.
+ * @returns 1 if the parameter is defined, otherwise 0.
+ */
+extern int stp_check_dimension_parameter_k(const stp_vars_t *v,
+					   stp_parameter_key_t key,
+					   stp_parameter_activity_t active);
+
+/**
+ * Check if a boolean parameter is defined, by key.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param active the minimum activity status.
+ * @returns 1 if the parameter is defined, otherwise 0.
+ */
+extern int stp_check_boolean_parameter_k(const stp_vars_t *v,
+					 stp_parameter_key_t key,
+					 stp_parameter_activity_t active);
+
+/**
+ * Check if a curve parameter is defined, by key.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param active the minimum activity status.
+ * @returns 1 if the parameter is defined, otherwise 0.
+ */
+extern int stp_check_curve_parameter_k(const stp_vars_t *v,
+				       stp_parameter_key_t key,
+				       stp_parameter_activity_t active);
+
+/**
+ * Check if an array parameter is defined, by key.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param active the minimum activity status.
+ * @returns 1 if the parameter is defined, otherwise 0.
+ */
+extern int stp_check_array_parameter_k(const stp_vars_t *v,
+				       stp_parameter_key_t key,
+				       stp_parameter_activity_t active);
+
+/**
+ * Check if a raw parameter is defined, by key.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ * @param active the minimum activity status.
+ * @returns 1 if the parameter is defined, otherwise 0.
+ */
+extern int stp_check_raw_parameter_k(const stp_vars_t *v,
+				     stp_parameter_key_t key,
+				     stp_parameter_activity_t active);
+
+/**
+ * Clear a string parameter by key.
+ * This is equivalent to stp_clear_string_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ */
+extern void stp_clear_string_parameter_k(stp_vars_t *v,
+					 stp_parameter_key_t key);
+
+/**
+ * Clear a file parameter by key.
+ * This is equivalent to stp_clear_file_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ */
+extern void stp_clear_file_parameter_k(stp_vars_t *v, stp_parameter_key_t key);
+
+/**
+ * Clear a float parameter by key.
+ * This is equivalent to stp_clear_float_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ */
+extern void stp_clear_float_parameter_k(stp_vars_t *v,
+					stp_parameter_key_t key);
+
+/**
+ * Clear a int parameter by key.
+ * This is equivalent to stp_clear_int_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ */
+extern void stp_clear_int_parameter_k(stp_vars_t *v, stp_parameter_key_t key);
+
+/**
+ * Clear a dimension parameter by key.
+ * This is equivalent to stp_clear_dimension_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ */
+extern void stp_clear_dimension_parameter_k(stp_vars_t *v,
+					    stp_parameter_key_t key);
+
+/**
+ * Clear a boolean parameter by key.
+ * This is equivalent to stp_clear_boolean_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ */
+extern void stp_clear_boolean_parameter_k(stp_vars_t *v,
+					  stp_parameter_key_t key);
+
+/**
+ * Clear a curve parameter by key.
+ * This is equivalent to stp_clear_curve_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ */
+extern void stp_clear_curve_parameter_k(stp_vars_t *v,
+					stp_parameter_key_t key);
+
+/**
+ * Clear a array parameter by key.
+ * This is equivalent to stp_clear_array_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ */
+extern void stp_clear_array_parameter_k(stp_vars_t *v,
+					stp_parameter_key_t key);
+
+/**
+ * Clear a raw parameter by key.
+ * This is equivalent to stp_clear_raw_parameter.
+ * @param v the vars to use.
+ * @param key the key of the parameter.
+ */
+extern void stp_clear_raw_parameter_k(stp_vars_t *v, stp_parameter_key_t key);
+
+
+
 /****************************************************************
 *                                                               *
 * INFORMATIONAL QUERIES                                         *
@@ -28,6 +28,10 @@
 #include <errno.h>
 #include <signal.h>
 #include <strings.h>  /* For strncasecmp */
+#include <sys/time.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 #define BACKEND_VERSION "0.132G"
 
@@ -41,6 +45,7 @@
 
 #define URB_XFER_SIZE  (64*1024)
 #define XFER_TIMEOUT    15000
+#define XFER_QUEUE_MAX     16
 
 #define USB_SUBCLASS_PRINTER 0x1
 #define USB_INTERFACE_PROTOCOL_BIDIR 0x2
@@ -63,6 +68,9 @@ FILE *logger;
 const char *corrtable_path = CORRTABLE_PATH;
 static int max_xfer_size = URB_XFER_SIZE;
 static int xfer_timeout = XFER_TIMEOUT;
+static int xfer_queue = 0;  /* Transfers kept in flight; 0 is synchronous */
+static int xfer_sink = -1;  /* Loopback sink standing in for the printer */
+static int input_mmap = 1;  /* Map regular input files instead of reading */
 
 #if defined(OLD_URI) && OLD_URI
 static int old_uri = 1;
@@ -276,6 +284,226 @@ done:
 	return ret;
 }
 
+static void dump_send_data(const uint8_t *buf, int len)
+{
+	int i = len;
+
+	DEBUG("-> ");
+	while(i > 0) {
+		if ((len-i) != 0 &&
+		    (len-i) % 16 == 0) {
+			DEBUG2("\n");
+			DEBUG("   ");
+		}
+		DEBUG2("%02x ", buf[len-i]);
+		i--;
+	}
+	DEBUG2("\n");
+}
+
+/* Loopback sink.
+
+   In test mode XFER_SINK names a file that takes the place of the
+   printer: send_data() writes to it instead of the USB device.  Queued
+   transfers are completed in submission order, one per call to
+   xfer_handle_events(), through the same callback libusb would use.
+*/
+static struct {
+	struct libusb_transfer *xfer;
+	int cancelled;
+} sink_pending[XFER_QUEUE_MAX];
+static int sink_head, sink_count;
+
+static int xfer_submit(struct libusb_transfer *xfer)
+{
+	if (xfer_sink < 0)
+		return libusb_submit_transfer(xfer);
+
+	int i = (sink_head + sink_count) % XFER_QUEUE_MAX;
+	sink_pending[i].xfer = xfer;
+	sink_pending[i].cancelled = 0;
+	sink_count++;
+
+	return LIBUSB_SUCCESS;
+}
+
+static void xfer_cancel(struct libusb_transfer *xfer)
+{
+	int i;
+
+	if (xfer_sink < 0) {
+		libusb_cancel_transfer(xfer);
+		return;
+	}
+
+	for (i = 0 ; i < sink_count ; i++) {
+		int j = (sink_head + i) % XFER_QUEUE_MAX;
+		if (sink_pending[j].xfer == xfer)
+			sink_pending[j].cancelled = 1;
+	}
+}
+
+static int xfer_handle_events(int *completed)
+{
+	struct libusb_transfer *xfer;
+	int len;
+
+	if (xfer_sink < 0) {
+		struct timeval tv = { 1, 0 };
+		return libusb_handle_events_timeout_completed(NULL, &tv, completed);
+	}
+
+	if (!sink_count)
+		return LIBUSB_ERROR_NOT_FOUND;
+
+	xfer = sink_pending[sink_head].xfer;
+	if (sink_pending[sink_head].cancelled) {
+		xfer->status = LIBUSB_TRANSFER_CANCELLED;
+		xfer->actual_length = 0;
+	} else {
+		len = write(xfer_sink, xfer->buffer, xfer->length);
+		xfer->status = (len < 0) ? LIBUSB_TRANSFER_ERROR : LIBUSB_TRANSFER_COMPLETED;
+		xfer->actual_length = (len < 0) ? 0 : len;
+	}
+	sink_head = (sink_head + 1) % XFER_QUEUE_MAX;
+	sink_count--;
+
+	xfer->callback(xfer);
+
+	return LIBUSB_SUCCESS;
+}
+
+static int xfer_status_to_error(enum libusb_transfer_status status)
+{
+	switch (status) {
+	case LIBUSB_TRANSFER_TIMED_OUT:
+		return LIBUSB_ERROR_TIMEOUT;
+	case LIBUSB_TRANSFER_STALL:
+		return LIBUSB_ERROR_PIPE;
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		return LIBUSB_ERROR_NO_DEVICE;
+	case LIBUSB_TRANSFER_OVERFLOW:
+		return LIBUSB_ERROR_OVERFLOW;
+	case LIBUSB_TRANSFER_CANCELLED:
+		return LIBUSB_ERROR_INTERRUPTED;
+	default:
+		return LIBUSB_ERROR_IO;
+	}
+}
+
+static void LIBUSB_CALL send_data_cb(struct libusb_transfer *xfer)
+{
+	*(int *)xfer->user_data = 1;
+}
+
+/* Keep up to xfer_queue transfers in flight, so the printer never waits
+   on us between chunks.  Chunks complete in order; the first failure,
+   or a SIGTERM, cancels everything still queued. */
+static int send_data_async(struct dyesub_connection *conn, const uint8_t *buf, int len)
+{
+	struct xfer_slot {
+		struct libusb_transfer *xfer;
+		int done;
+	} *slots;
+	int depth = (xfer_queue > XFER_QUEUE_MAX) ? XFER_QUEUE_MAX : xfer_queue;
+	int head = 0, count = 0;
+	int cancelled = 0;
+	int ret = 0;
+	int i;
+
+	slots = calloc(depth, sizeof(*slots));
+	if (!slots) {
+		ERROR("Memory allocation failure!\n");
+		return LIBUSB_ERROR_NO_MEM;
+	}
+	for (i = 0 ; i < depth ; i++) {
+		slots[i].xfer = libusb_alloc_transfer(0);
+		if (!slots[i].xfer) {
+			ERROR("Memory allocation failure!\n");
+			while (i--)
+				libusb_free_transfer(slots[i].xfer);
+			free(slots);
+			return LIBUSB_ERROR_NO_MEM;
+		}
+	}
+
+	while (count || (len && !cancelled)) {
+		/* Top up the queue */
+		while (len && !cancelled && count < depth) {
+			struct xfer_slot *slot = &slots[(head + count) % depth];
+			int len2 = (len > max_xfer_size) ? max_xfer_size: len;
+
+			if ((dyesub_debug > 1 && len2 < 4096) ||
+			    dyesub_debug > 2)
+				dump_send_data(buf, len2);
+
+			slot->done = 0;
+			libusb_fill_bulk_transfer(slot->xfer, conn->dev,
+						  conn->endp_down,
+						  (uint8_t*) buf, len2,
+						  send_data_cb, &slot->done,
+						  xfer_timeout);
+			ret = xfer_submit(slot->xfer);
+			if (ret < 0) {
+				ERROR("Failure to send data to printer (libusb error %d: (0/%d to 0x%02x))\n", ret, len2, conn->endp_down);
+				cancelled = 1;
+				break;
+			}
+			count++;
+			len -= len2;
+			buf += len2;
+		}
+
+		if (!count)
+			break;
+
+		/* Wait for the oldest one */
+		while (!slots[head].done) {
+			if (terminate && !cancelled) {
+				WARNING("Cancelling %d queued transfers\n", count);
+				ret = LIBUSB_ERROR_INTERRUPTED;
+				cancelled = 1;
+				for (i = 0 ; i < count ; i++)
+					xfer_cancel(slots[(head + i) % depth].xfer);
+			}
+			i = xfer_handle_events(&slots[head].done);
+			if (i < 0 && i != LIBUSB_ERROR_INTERRUPTED) {
+				ERROR("Failure waiting on printer transfer (libusb error %d)\n", i);
+				break;
+			}
+		}
+		if (!slots[head].done)
+			break;
+
+		struct libusb_transfer *xfer = slots[head].xfer;
+		if (!cancelled &&
+		    (xfer->status != LIBUSB_TRANSFER_COMPLETED ||
+		     xfer->actual_length != xfer->length)) {
+			ret = xfer_status_to_error(xfer->status);
+			ERROR("Failure to send data to printer (libusb error %d: (%d/%d to 0x%02x))\n", ret, xfer->actual_length, xfer->length, conn->endp_down);
+			cancelled = 1;
+			for (i = 1 ; i < count ; i++)
+				xfer_cancel(slots[(head + i) % depth].xfer);
+		}
+		head = (head + 1) % depth;
+		count--;
+	}
+
+	if (count) {
+		/* libusb gave up on us with transfers still in flight; they
+		   may yet complete, so they (and their slots) have to leak. */
+		if (!ret)
+			ret = LIBUSB_ERROR_OTHER;
+		return ret;
+	}
+
+	for (i = 0 ; i < depth ; i++)
+		libusb_free_transfer(slots[i].xfer);
+	free(slots);
+
+	return ret;
+}
+
 int send_data(struct dyesub_connection *conn, const uint8_t *buf, int len)
 {
 	int num = 0;
@@ -284,29 +512,26 @@ int send_data(struct dyesub_connection *conn, const uint8_t *buf, int len)
 		DEBUG("Sending %d bytes to printer\n", len);
 	}
 
+	/* Anything that fits in one transfer goes straight out */
+	if (xfer_queue > 1 && len > max_xfer_size)
+		return send_data_async(conn, buf, len);
+
 	while (len) {
 		int len2 = (len > max_xfer_size) ? max_xfer_size: len;
+		int ret;
 
 		if ((dyesub_debug > 1 && len2 < 4096) ||
-		    dyesub_debug > 2) {
-			int i = len2;
-
-			DEBUG("-> ");
-			while(i > 0) {
-				if ((len2-i) != 0 &&
-				    (len2-i) % 16 == 0) {
-					DEBUG2("\n");
-					DEBUG("   ");
-				}
-				DEBUG2("%02x ", buf[len2-i]);
-				i--;
-			}
-			DEBUG2("\n");
-		}
+		    dyesub_debug > 2)
+			dump_send_data(buf, len2);
 
-		int ret = libusb_bulk_transfer(conn->dev, conn->endp_down,
-					       (uint8_t*) buf, len2,
-					       &num, xfer_timeout);
+		if (xfer_sink >= 0) {
+			num = write(xfer_sink, buf, len2);
+			ret = (num < 0) ? LIBUSB_ERROR_IO : LIBUSB_SUCCESS;
+		} else {
+			ret = libusb_bulk_transfer(conn->dev, conn->endp_down,
+						   (uint8_t*) buf, len2,
+						   &num, xfer_timeout);
+		}
 
 		if (ret < 0) {
 			ERROR("Failure to send data to printer (libusb error %d: (%d/%d to 0x%02x))\n", ret, num, len2, conn->endp_down);
@@ -1051,6 +1276,7 @@ void print_help(const char *argv0, const struct dyesub_backend *backend)
 		int i;
 		DEBUG("Environment variables:\n");
 		DEBUG(" DYESUB_DEBUG EXTRA_PID EXTRA_VID EXTRA_TYPE BACKEND SERIAL OLD_URI_SCHEME BACKEND_QUIET\n");
+		DEBUG(" MAX_XFER_SIZE XFER_TIMEOUT XFER_QUEUE TEST_MODE XFER_SINK INPUT_MMAP\n");
 		DEBUG("CUPS Usage:\n");
 		DEBUG("\tDEVICE_URI=someuri %s job user title num-copies options [ filename ]\n", ptr);
 		DEBUG("\n");
@@ -1139,6 +1365,104 @@ static int parse_cmdstream(const struct dyesub_backend *backend, void *backend_c
 	return CUPS_BACKEND_OK;
 }
 
+/* Regular input files are mapped copy-on-write so read_parse can hand
+   out views into the spool data instead of reading it into fresh
+   buffers.  Backends that rewrite the stream still copy. */
+static uint8_t *input_map = NULL;
+static size_t input_map_len = 0;
+static int input_map_fd = -1;
+
+static void input_map_open(int data_fd)
+{
+#ifndef _WIN32
+	struct stat st;
+	void *map;
+
+	if (!input_mmap)
+		return;
+	if (fstat(data_fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+		return;
+	if ((uint64_t)st.st_size > SIZE_MAX)
+		return;
+
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, data_fd, 0);
+	if (map == MAP_FAILED) {
+		DEBUG("Unable to map input (%d), falling back to read()\n", errno);
+		return;
+	}
+	input_map = map;
+	input_map_len = st.st_size;
+	input_map_fd = data_fd;
+	DEBUG("Mapped %lu bytes of input\n", (unsigned long)input_map_len);
+#else
+	UNUSED(data_fd);
+#endif
+}
+
+static void input_map_close(void)
+{
+#ifndef _WIN32
+	if (input_map)
+		munmap(input_map, input_map_len);
+#endif
+	input_map = NULL;
+	input_map_len = 0;
+	input_map_fd = -1;
+}
+
+int dyesub_read_data(int data_fd, uint8_t **buf, uint32_t len)
+{
+	uint8_t *ptr;
+	uint32_t remain = len;
+	int i;
+
+	*buf = NULL;
+
+	if (input_map && data_fd == input_map_fd) {
+		off_t pos = lseek(data_fd, 0, SEEK_CUR);
+
+		if (pos >= 0 && (uint64_t)pos + len <= input_map_len) {
+			if (lseek(data_fd, len, SEEK_CUR) < 0) {
+				ERROR("Bad Seek! (%d)\n", errno);
+				return CUPS_BACKEND_FAILED;
+			}
+			*buf = input_map + pos;
+			return CUPS_BACKEND_OK;
+		}
+		/* Short file; let read() report it the usual way */
+	}
+
+	ptr = malloc(len ? len : 1);
+	if (!ptr) {
+		ERROR("Memory allocation failure!\n");
+		return CUPS_BACKEND_RETRY_CURRENT;
+	}
+
+	while (remain) {
+		i = read(data_fd, ptr + (len - remain), remain);
+		if (i <= 0) {
+			ERROR("Read failed (%d/%u/%u)\n", i, remain, len);
+			if (i < 0)
+				perror("ERROR: Read failed");
+			free(ptr);
+			return CUPS_BACKEND_CANCEL;
+		}
+		remain -= i;
+	}
+
+	*buf = ptr;
+	return CUPS_BACKEND_OK;
+}
+
+void dyesub_free_data(void *buf)
+{
+	uint8_t *ptr = buf;
+
+	if (input_map && ptr >= input_map && ptr < input_map + input_map_len)
+		return;
+	free(buf);
+}
+
 static int handle_input(struct dyesub_backend *backend, void *backend_ctx,
 			const char *fname, const char *uri, const char *type)
 {
@@ -1201,6 +1525,8 @@ static int handle_input(struct dyesub_backend *backend, void *backend_ctx,
 		goto done;
 	}
 
+	input_map_open(data_fd);
+
 	/* Time for the main processing loop */
 	INFO("Printing started (%d copies)\n", ncopies);
 
@@ -1273,7 +1599,67 @@ done_multiple:
 
 done:
 	if (jlist) dyesub_joblist_cleanup(jlist);
+	input_map_close();
+
+	return ret;
+}
+
+/* Push a file through send_data() into the loopback sink and report
+   how long it took. */
+static int xfer_loopback(struct dyesub_connection *conn, const char *fname)
+{
+	int data_fd = fileno(stdin);
+	uint8_t *buf = NULL;
+	int buflen = 0, len = 0;
+	struct timeval start, end;
+	int ret;
+
+	if (fname && strcmp("-", fname)) {
+		data_fd = open(fname, O_RDONLY);
+		if (data_fd < 0) {
+			perror("ERROR:Can't open input file");
+			return CUPS_BACKEND_FAILED;
+		}
+	}
+
+	do {
+		if (len == buflen) {
+			uint8_t *tmp = realloc(buf, buflen + URB_XFER_SIZE * 16);
+			if (!tmp) {
+				ERROR("Memory allocation failure!\n");
+				ret = CUPS_BACKEND_FAILED;
+				goto done;
+			}
+			buf = tmp;
+			buflen += URB_XFER_SIZE * 16;
+		}
+		ret = read(data_fd, buf + len, buflen - len);
+		if (ret < 0) {
+			perror("ERROR:Can't read input");
+			ret = CUPS_BACKEND_FAILED;
+			goto done;
+		}
+		len += ret;
+	} while (ret);
+
+#ifndef _WIN32
+	signal(SIGTERM, sigterm_handler);
+#endif
 
+	gettimeofday(&start, NULL);
+	ret = send_data(conn, buf, len);
+	gettimeofday(&end, NULL);
+
+	INFO("Loopback: %d bytes in %ld us (%d transfers queued)\n", len,
+	     (long)((end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec),
+	     xfer_queue < 2 ? 0 : xfer_queue > XFER_QUEUE_MAX ? XFER_QUEUE_MAX : xfer_queue);
+	if (ret)
+		ret = CUPS_BACKEND_FAILED;
+
+done:
+	if (data_fd != fileno(stdin))
+		close(data_fd);
+	free(buf);
 	return ret;
 }
 
@@ -1330,6 +1716,10 @@ int main (int argc, char **argv)
 		max_xfer_size = atoi(getenv("MAX_XFER_SIZE"));
 	if (getenv("XFER_TIMEOUT"))
 		xfer_timeout = atoi(getenv("XFER_TIMEOUT"));
+	if (getenv("XFER_QUEUE"))
+		xfer_queue = atoi(getenv("XFER_QUEUE"));
+	if (getenv("INPUT_MMAP"))
+		input_mmap = atoi(getenv("INPUT_MMAP"));
 	if (getenv("TEST_MODE"))
 		test_mode = atoi(getenv("TEST_MODE"));
 	if (getenv("OLD_URI_SCHEME"))
@@ -1342,6 +1732,18 @@ int main (int argc, char **argv)
 		exit(1);
 	}
 
+	if (getenv("XFER_SINK")) {
+		if (test_mode < TEST_MODE_NOATTACH) {
+			ERROR("XFER_SINK requires test mode > 1!\n");
+			exit(1);
+		}
+		xfer_sink = open(getenv("XFER_SINK"), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (xfer_sink < 0) {
+			ERROR("Can't open transfer sink '%s'\n", getenv("XFER_SINK"));
+			exit(1);
+		}
+	}
+
 	if (stats_only && !dyesub_debug)
 		quiet = 1;
 
@@ -1597,6 +1999,12 @@ bypass:
 		fname = argv[optind]; // XXX do this a smarter way?
 	}
 
+	/* With a loopback sink the input goes out untouched */
+	if (xfer_sink >= 0) {
+		ret = xfer_loopback(&conn, fname);
+		goto done_claimed;
+	}
+
 	/* Parse the file passed in */
 	ret = handle_input(backend, backend_ctx, fname, uri, type);
 
@@ -1623,6 +2031,9 @@ done:
 
 	libusb_exit(NULL);
 
+	if (xfer_sink >= 0)
+		close(xfer_sink);
+
 	return ret;
 }
 
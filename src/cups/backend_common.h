@@ -275,6 +275,11 @@ int dyesub_read_file2(const char *filename, void *databuf, int datalen,
 #define dyesub_read_file(__fname, __databuf, __datalen, __actual_len) \
 	dyesub_read_file2(__fname, __databuf, __datalen, __actual_len, 0)
 
+/* Read len bytes of job data.  If the input is mapped this returns a
+   view into it; either way release it with dyesub_free_data() */
+int dyesub_read_data(int data_fd, uint8_t **buf, uint32_t len);
+void dyesub_free_data(void *buf);
+
 uint16_t uint16_to_packed_bcd(uint16_t val);
 uint32_t packed_bcd_to_uint32(const char *in, int len);
 
@@ -27,6 +27,7 @@
 #define BACKEND hiti_backend
 
 #include "backend_common.h"
+#include "backend_hiti_interp.h"
 
 /* For Integration into gutenprint */
 #if defined(HAVE_CONFIG_H)
@@ -1459,7 +1460,7 @@ static void hiti_cleanup_job(const void *vjob) {
 	const struct hiti_printjob *job = vjob;
 
 	if (job->databuf)
-		free(job->databuf);
+		dyesub_free_data(job->databuf);
 
 	if (job->heattable_v2)
 		free(job->heattable_v2);
@@ -1749,187 +1750,6 @@ static int hiti_send_heat_data_v1(struct hiti_ctx *ctx, void *heatdata, int len,
 	return ret;
 }
 
-/* HiTi's funky interpolation table processing
-
-   Note this is a standard "CUBE" LUT (33x33x33) so there are options
-   for making this faster!
-*/
-struct rgb {
-	uint8_t r;
-	uint8_t g;
-	uint8_t b;
-};
-
-static uint32_t interp1089[33];
-static uint32_t interp33[33];
-static uint16_t interp256[256*9];
-
-static void hiti_interp_init(void)
-{
-	int i;
-	uint16_t *pre, *cur;
-
-	for (i = 0 ; i < 33 ; i++) {
-		interp1089[i] = i * 1089;
-		interp33[i] = i * 33;
-	}
-	memset(interp256, 0, sizeof(interp256));
-	pre = &interp256[0];
-	cur = &interp256[256];
-
-	for (i = 1 ; i < 9 ; i++) {
-		int j;
-		for (j = 0 ; j < 256 ; j++) {
-			cur[j] = pre[j] + j;
-		};
-		pre += 256;
-		cur += 256;
-	}
-}
-
-/* src and dst are RGB tuples */
-static void hiti_interp33_256(uint8_t *dst, const uint8_t *src, const uint8_t *pTable)
-{
-	struct rgb p1_pos, p2_pos, p3_pos, p4_pos;
-	struct rgb p1_val, p2_val, p3_val, p4_val;
-	uint8_t r_weight, g_weight, b_weight;
-	uint16_t w1, w2, w3, w4;
-	uint16_t *pw1, *pw2, *pw3, *pw4;
-	uint32_t pos;
-
-	/* Get Grid position */
-	p1_pos.r = src[0] >> 3;
-	p1_pos.g = src[1] >> 3;
-	p1_pos.b = src[2] >> 3;
-
-	p4_pos.r = p1_pos.r + 1;
-	p4_pos.g = p1_pos.g + 1;
-	p4_pos.b = p1_pos.b + 1;
-
-	/* Weights */
-	if (src[0] == 255)
-		r_weight = 8;
-	else
-		r_weight = src[0] & 0x7;
-
-	if (src[1] == 255)
-		g_weight = 8;
-	else
-		g_weight = src[1] & 0x7;
-
-	if (src[2] == 255)
-		b_weight = 8;
-	else
-		b_weight = src[2] & 0x7;
-
-	/* Work out relative weights and offsets */
-	if (r_weight >= g_weight) {
-		if (g_weight >= b_weight) { /* R > G > B */
-			w1 = 8 - r_weight;
-			w2 = r_weight - g_weight;
-			w3 = g_weight - b_weight;
-			w4 = b_weight;
-			p2_pos.r = p1_pos.r + 1;
-			p2_pos.g = p1_pos.g;
-			p2_pos.b = p1_pos.b;
-			p3_pos.r = p1_pos.r + 1;
-			p3_pos.g = p1_pos.g + 1;
-			p3_pos.b = p1_pos.b;
-		} else {
-			if (r_weight >= b_weight) { /* R > B > G */
-				w1 = 8 - r_weight;
-				w2 = r_weight - b_weight;
-				w3 = b_weight - g_weight;
-				w4 = g_weight;
-				p2_pos.r = p1_pos.r + 1;
-				p2_pos.g = p1_pos.g;
-				p2_pos.b = p1_pos.b;
-				p3_pos.r = p1_pos.r + 1;
-				p3_pos.g = p1_pos.g;
-				p3_pos.b = p1_pos.b + 1;
-			} else { /* B > R > G */
-				w1 = 8 - b_weight;
-				w2 = b_weight - r_weight;
-				w3 = r_weight - g_weight;
-				w4 = g_weight;
-				p2_pos.r = p1_pos.r;
-				p2_pos.g = p1_pos.g;
-				p2_pos.b = p1_pos.b + 1;
-				p3_pos.r = p1_pos.r + 1;
-				p3_pos.g = p1_pos.g;
-				p3_pos.b = p1_pos.b + 1;
-			}
-		}
-	} else {
-		if (r_weight >= b_weight) { /* G > R > B */
-			w1 = 8 - g_weight;
-			w2 = g_weight - r_weight;
-			w3 = r_weight - b_weight;
-			w4 = b_weight;
-			p2_pos.r = p1_pos.r;
-			p2_pos.g = p1_pos.g + 1;
-			p2_pos.b = p1_pos.b;
-			p3_pos.r = p1_pos.r + 1;
-			p3_pos.g = p1_pos.g + 1;
-			p3_pos.b = p1_pos.b;
-		} else {
-			if (g_weight >= b_weight) { /* G > B > R */
-				w1 = 8 - g_weight;
-				w2 = g_weight - b_weight;
-				w3 = b_weight - r_weight;
-				w4 = r_weight;
-				p2_pos.r = p1_pos.r;
-				p2_pos.g = p1_pos.g + 1;
-				p2_pos.b = p1_pos.b;
-				p3_pos.r = p1_pos.r;
-				p3_pos.g = p1_pos.g + 1;
-				p3_pos.b = p1_pos.b + 1;
-			} else { /* B > G > R */
-				w1 = 8 - b_weight;
-				w2 = b_weight - g_weight;
-				w3 = g_weight - r_weight;
-				w4 = r_weight;
-				p2_pos.r = p1_pos.r;
-				p2_pos.g = p1_pos.g;
-				p2_pos.b = p1_pos.b + 1;
-				p3_pos.r = p1_pos.r;
-				p3_pos.g = p1_pos.g + 1;
-				p3_pos.b = p1_pos.b + 1;
-			}
-		}
-	}
-
-	/* Work out values */
-	pos = (interp1089[p1_pos.b] + interp33[p1_pos.g] + p1_pos.r) * 3;
-	p1_val.r = pTable[pos];
-	p1_val.g = pTable[pos + 1];
-	p1_val.b = pTable[pos + 2];
-	pos = (interp1089[p2_pos.b] + interp33[p2_pos.g] + p2_pos.r) * 3;
-	p2_val.r = pTable[pos];
-	p2_val.g = pTable[pos + 1];
-	p2_val.b = pTable[pos + 2];
-	pos = (interp1089[p3_pos.b] + interp33[p3_pos.g] + p3_pos.r) * 3;
-	p3_val.r = pTable[pos];
-	p3_val.g = pTable[pos + 1];
-	p3_val.b = pTable[pos + 2];
-	pos = (interp1089[p4_pos.b] + interp33[p4_pos.g] + p4_pos.r) * 3;
-	p4_val.r = pTable[pos];
-	p4_val.g = pTable[pos + 1];
-	p4_val.b = pTable[pos + 2];
-
-	/* Final offsets into interpolation table */
-	pw1 = &interp256[w1 << 8];
-	pw2 = &interp256[w2 << 8];
-	pw3 = &interp256[w3 << 8];
-	pw4 = &interp256[w4 << 8];
-
-	/* And at long last.. final values */
-	dst[0] = (pw1[p1_val.r] + pw2[p2_val.r] + pw3[p3_val.r] + pw4[p4_val.r]) >> 3;
-	dst[1] = (pw1[p1_val.g] + pw2[p2_val.g] + pw3[p3_val.g] + pw4[p4_val.g]) >> 3;
-	dst[2] = (pw1[p1_val.b] + pw2[p2_val.b] + pw3[p3_val.b] + pw4[p4_val.b]) >> 3;
-
-}
-
 static int hiti_read_parse(void *vctx, const void **vjob, int data_fd, int copies)
 {
 	struct hiti_ctx *ctx = vctx;
@@ -2024,29 +1844,13 @@ static int hiti_read_parse(void *vctx, const void **vjob, int data_fd, int copie
 		break;
 	}
 
-	/* Allocate a buffer */
-	job->datalen = 0;
-	job->databuf = malloc(job->hdr.payload_len);
-	if (!job->databuf) {
-		ERROR("Memory allocation failure!\n");
-		hiti_cleanup_job(job);
-		return CUPS_BACKEND_RETRY_CURRENT;
-	}
-
 	/* Read in data */
-	uint32_t remain = job->hdr.payload_len;
-	while (remain) {
-		ret = read(data_fd, job->databuf + job->datalen, remain);
-		if (ret < 0) {
-			ERROR("Read failed (%d/%u/%u)\n",
-			      ret, remain, job->datalen);
-			perror("ERROR: Read failed");
-			hiti_cleanup_job(job);
-			return CUPS_BACKEND_CANCEL;
-		}
-		job->datalen += ret;
-		remain -= ret;
+	ret = dyesub_read_data(data_fd, &job->databuf, job->hdr.payload_len);
+	if (ret) {
+		hiti_cleanup_job(job);
+		return ret;
 	}
+	job->datalen = job->hdr.payload_len;
 
 	/* Sanity check against paper */
 	switch (ctx->paper.type) {
@@ -2149,12 +1953,22 @@ static int hiti_read_parse(void *vctx, const void **vjob, int data_fd, int copie
 	/* Convert input packed BGR data into YMC planar, if needed */
 	if (!(job->hdr.payload_flag & PAYLOAD_FLAG_YMCPLANAR)) {
 		/* Load up correction data, if requested */
-		uint8_t *corrdata = NULL;
 		if (!(job->hdr.payload_flag & PAYLOAD_FLAG_NOCORRECT)) {
-			corrdata = hiti_get_correction_data(ctx, job->hdr.quality, job->colormode, ribbonvendor);
+			uint8_t *corrdata = hiti_get_correction_data(ctx, job->hdr.quality, job->colormode, ribbonvendor);
 			if (corrdata) {
-				hiti_interp_init();
+				struct hiti_interp *interp = hiti_interp_create(corrdata);
+				free(corrdata);
+				if (!interp) {
+					hiti_cleanup_job(job);
+					ERROR("Memory Allocation Failure!\n");
+					return CUPS_BACKEND_FAILED;
+				}
 				INFO("Running input data through correction tables\n");
+				/* Input data is BGR */
+				hiti_interp33_256_rows(interp, job->databuf,
+						       job->hdr.cols, job->hdr.rows,
+						       job->hdr.cols * 3, 1, 0);
+				hiti_interp_destroy(interp);
 			}
 		}
 
@@ -2177,14 +1991,6 @@ static int hiti_read_parse(void *vctx, const void **vjob, int data_fd, int copie
 			uint8_t *rowM = ymcbuf + ctx->erdc_rs.cols * (job->hdr.rows + i);
 			uint8_t *rowC = ymcbuf + ctx->erdc_rs.cols * (job->hdr.rows * 2 + i);
 
-			/* Simple optimization */
-			uint8_t oldrgb[3] = { 255, 255, 255 };
-			uint8_t destrgb[3];
-
-			if (corrdata) {
-				hiti_interp33_256(destrgb, oldrgb, corrdata);
-			}
-
 			/* Leading Padding */
 			memset(rowY, 0, pad1);
 			rowY += pad1;
@@ -2194,36 +2000,12 @@ static int hiti_read_parse(void *vctx, const void **vjob, int data_fd, int copie
 			rowC += pad1;
 
 			for (j = 0 ; j < job->hdr.cols ; j++) {
-				uint8_t rgb[3];
 				uint32_t base = (job->hdr.cols * i + j) * 3;
 
-				/* Input data is BGR */
-				rgb[2] = job->databuf[base];
-				rgb[1] = job->databuf[base + 1];
-				rgb[0] = job->databuf[base + 2];
-
-				if (corrdata) {
-					if (rgb[0] == oldrgb[0] &&
-					    rgb[1] == oldrgb[1] &&
-					    rgb[2] == oldrgb[2]) {
-						rgb[0] = destrgb[0];
-						rgb[1] = destrgb[1];
-						rgb[2] = destrgb[2];
-					} else {
-						oldrgb[0] = rgb[0];
-						oldrgb[1] = rgb[1];
-						oldrgb[2] = rgb[2];
-						hiti_interp33_256(rgb, rgb, corrdata);
-						destrgb[0] = rgb[0];
-						destrgb[1] = rgb[1];
-						destrgb[2] = rgb[2];
-					}
-				}
-
-				/* Finally convert to YMC */
-				rowY[j] = 255 - rgb[2];
-				rowM[j] = 255 - rgb[1];
-				rowC[j] = 255 - rgb[0];
+				/* Input data is BGR; convert to YMC */
+				rowY[j] = 255 - job->databuf[base];
+				rowM[j] = 255 - job->databuf[base + 1];
+				rowC[j] = 255 - job->databuf[base + 2];
 			}
 
 			/* Trailing Padding */
@@ -2233,13 +2015,10 @@ static int hiti_read_parse(void *vctx, const void **vjob, int data_fd, int copie
 		}
 
 		/* Nuke the old BGR buffer and replace it with YMC buffer */
-		free(job->databuf);
+		dyesub_free_data(job->databuf);
 		job->databuf = ymcbuf;
 		job->datalen = ctx->erdc_rs.cols * 3 * job->hdr.cols;
 		job->hdr.cols = ctx->erdc_rs.cols;
-
-		if (corrdata)
-			free(corrdata);
 	}
 
 	/* Read in heat table for job */
@@ -0,0 +1,209 @@
+/*
+ *   HiTi 33x33x33 color correction LUT
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>.
+ *
+ *   SPDX-License-Identifier: GPL-2.0+
+ *
+ */
+
+/* For Integration into gutenprint */
+#if defined(HAVE_CONFIG_H)
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(HAVE_PTHREAD)
+#include <pthread.h>
+#endif
+
+#include "backend_hiti_interp.h"
+
+/* This is a standard tetrahedral "CUBE" interpolation with 8 steps
+   between grid points.  A component of 255 sits on the last grid point,
+   so it gets a weight of 8 instead of 7.
+
+   The tetrahedron and its weights are picked without branching: the
+   weights are the sorted fractions, and the two middle vertices come
+   from a table indexed by the three comparisons.  Each grid node is
+   stored as a 64-bit word with red, green and blue in separate 16-bit
+   lanes, so a vertex is one load and one multiply for all three
+   channels; the largest lane sum (255 * 8) fits comfortably.  Results
+   are truncated, exactly as the original per-pixel code did.
+*/
+
+#define GRID    HITI_INTERP_GRID
+#define STEP_R  1
+#define STEP_G  GRID
+#define STEP_B  (GRID * GRID)
+#define LANES   0x000000ff00ff00ffULL
+
+#define MAX_THREADS 8
+#define MIN_ROWS    64  /* Per thread */
+
+struct hiti_interp {
+	uint64_t node[GRID * GRID * GRID];
+};
+
+/* Offsets of the second and third tetrahedron vertices, indexed by
+   (r >= g) << 2 | (g >= b) << 1 | (r >= b).  Entries 1 and 6 cannot
+   occur. */
+static const uint16_t tetra_off[8][2] = {
+	{ STEP_B, STEP_B + STEP_G },  /* B > G > R */
+	{ STEP_R, STEP_R + STEP_G },
+	{ STEP_G, STEP_G + STEP_B },  /* G > B > R */
+	{ STEP_G, STEP_G + STEP_R },  /* G > R > B */
+	{ STEP_B, STEP_B + STEP_R },  /* B > R > G */
+	{ STEP_R, STEP_R + STEP_B },  /* R > B > G */
+	{ STEP_R, STEP_R + STEP_G },
+	{ STEP_R, STEP_R + STEP_G },  /* R > G > B */
+};
+
+struct hiti_interp *hiti_interp_create(const uint8_t *pTable)
+{
+	struct hiti_interp *interp = malloc(sizeof(*interp));
+	int i;
+
+	if (!interp)
+		return NULL;
+
+	for (i = 0 ; i < GRID * GRID * GRID ; i++) {
+		interp->node[i] = (uint64_t)pTable[0] |
+			((uint64_t)pTable[1] << 16) |
+			((uint64_t)pTable[2] << 32);
+		pTable += 3;
+	}
+
+	return interp;
+}
+
+void hiti_interp_destroy(struct hiti_interp *interp)
+{
+	free(interp);
+}
+
+static void hiti_interp_row(const struct hiti_interp *interp, uint8_t *data,
+			    uint32_t cols, int bgr)
+{
+	int ri = bgr ? 2 : 0;
+	int bi = bgr ? 0 : 2;
+	uint32_t k;
+
+	for (k = 0 ; k < cols ; k++) {
+		uint8_t *p = data + k * 3;
+		unsigned int r = p[ri], g = p[1], b = p[bi];
+		unsigned int rw = (r & 7) + (r == 255);
+		unsigned int gw = (g & 7) + (g == 255);
+		unsigned int bw = (b & 7) + (b == 255);
+		unsigned int hi = rw > gw ? rw : gw;
+		unsigned int lo = rw < gw ? rw : gw;
+		unsigned int mid, c;
+		const uint64_t *node;
+		uint64_t sum;
+
+		/* Classify */
+		hi = hi > bw ? hi : bw;
+		lo = lo < bw ? lo : bw;
+		mid = rw + gw + bw - hi - lo;
+		c = ((rw >= gw) << 2) | ((gw >= bw) << 1) | (rw >= bw);
+
+		/* Gather and blend */
+		node = interp->node + (b >> 3) * STEP_B + (g >> 3) * STEP_G + (r >> 3);
+		sum = node[0] * (8 - hi) +
+			node[tetra_off[c][0]] * (hi - mid) +
+			node[tetra_off[c][1]] * (mid - lo) +
+			node[STEP_R + STEP_G + STEP_B] * lo;
+		sum = (sum >> 3) & LANES;
+
+		p[ri] = sum;
+		p[1] = sum >> 16;
+		p[bi] = sum >> 32;
+	}
+}
+
+struct hiti_interp_band {
+	const struct hiti_interp *interp;
+	uint8_t *data;
+	uint32_t cols, rows, stride;
+	int bgr;
+};
+
+static void *hiti_interp_band(void *arg)
+{
+	struct hiti_interp_band *band = arg;
+	uint32_t i;
+
+	for (i = 0 ; i < band->rows ; i++)
+		hiti_interp_row(band->interp, band->data + i * band->stride,
+				band->cols, band->bgr);
+
+	return NULL;
+}
+
+void hiti_interp33_256_rows(const struct hiti_interp *interp, uint8_t *data,
+			    uint32_t cols, uint32_t rows, uint32_t stride,
+			    int bgr, int threads)
+{
+	struct hiti_interp_band bands[MAX_THREADS];
+	int nbands = 1;
+	int i;
+
+#if defined(HAVE_PTHREAD)
+	pthread_t tids[MAX_THREADS];
+	int started[MAX_THREADS];
+
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads > MAX_THREADS)
+		threads = MAX_THREADS;
+	if (threads > (int)(rows / MIN_ROWS))
+		threads = rows / MIN_ROWS;
+	if (threads > 1)
+		nbands = threads;
+#else
+	(void)threads;
+#endif
+
+	for (i = 0 ; i < nbands ; i++) {
+		uint32_t first = (uint64_t)rows * i / nbands;
+		uint32_t last = (uint64_t)rows * (i + 1) / nbands;
+
+		bands[i].interp = interp;
+		bands[i].data = data + first * stride;
+		bands[i].cols = cols;
+		bands[i].rows = last - first;
+		bands[i].stride = stride;
+		bands[i].bgr = bgr;
+	}
+
+#if defined(HAVE_PTHREAD)
+	/* Band 0 runs on this thread, as does any band whose thread
+	   couldn't be started. */
+	for (i = 1 ; i < nbands ; i++)
+		started[i] = !pthread_create(&tids[i], NULL,
+					     hiti_interp_band, &bands[i]);
+	hiti_interp_band(&bands[0]);
+	for (i = 1 ; i < nbands ; i++) {
+		if (started[i])
+			pthread_join(tids[i], NULL);
+		else
+			hiti_interp_band(&bands[i]);
+	}
+#else
+	hiti_interp_band(&bands[0]);
+#endif
+}
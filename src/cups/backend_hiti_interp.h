@@ -0,0 +1,41 @@
+/*
+ *   HiTi 33x33x33 color correction LUT
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>.
+ *
+ *   SPDX-License-Identifier: GPL-2.0+
+ *
+ */
+
+#ifndef __BACKEND_HITI_INTERP_H
+#define __BACKEND_HITI_INTERP_H
+
+#include <stdint.h>
+
+#define HITI_INTERP_GRID 33
+#define HITI_INTERP_LEN  (HITI_INTERP_GRID * HITI_INTERP_GRID * HITI_INTERP_GRID * 3)
+
+struct hiti_interp;
+
+/* pTable holds HITI_INTERP_LEN bytes of RGB triplets, red index fastest */
+struct hiti_interp *hiti_interp_create(const uint8_t *pTable);
+void hiti_interp_destroy(struct hiti_interp *interp);
+
+/* Runs packed RGB (or BGR) data through the table in place.  Rows are
+   split across up to 'threads' threads; 0 means one per CPU. */
+void hiti_interp33_256_rows(const struct hiti_interp *interp, uint8_t *data,
+			    uint32_t cols, uint32_t rows, uint32_t stride,
+			    int bgr, int threads);
+
+#endif /* __BACKEND_HITI_INTERP_H */
@@ -27,6 +27,10 @@
 #include "backend_common.h"
 #include "backend_mitsu.h"
 
+#if defined(HAVE_PTHREAD)
+#include <pthread.h>
+#endif
+
 int mitsu_loadlib(struct mitsu_lib *lib, int type)
 {
 	memset(lib, 0, sizeof(*lib));
@@ -133,6 +137,9 @@ int mitsu_loadlib(struct mitsu_lib *lib, int type)
 
 int mitsu_destroylib(struct mitsu_lib *lib)
 {
+	free(lib->native_lut);
+	lib->native_lut = NULL;
+
 #if defined(WITH_DYNAMIC)
 	if (lib->dl_handle) {
 		if (lib->cpcdata)
@@ -151,42 +158,347 @@ int mitsu_destroylib(struct mitsu_lib *lib)
 	return CUPS_BACKEND_OK;
 }
 
-int mitsu_apply3dlut_packed(struct mitsu_lib *lib, const char *lutfname, uint8_t *databuf,
-			    uint16_t cols, uint16_t rows, uint16_t stride,
-			    int rgb_bgr)
+/* Native 3D LUT engine.
+
+   The .lut files hold a 17x17x17 grid of BGR triplets with the red index
+   varying fastest.  Each grid node is kept as a 64-bit word with red,
+   green and blue in separate 16-bit lanes, so the four vertices of a
+   tetrahedron are blended with four multiplies instead of twelve; the
+   largest lane sum (255 * 16) still fits in 12 bits.  Like the
+   Mitsubishi library, the result is truncated rather than rounded.
+*/
+
+#define LUT_DIM    17
+#define LUT_STEP_R (LUT_DIM * LUT_DIM)
+#define LUT_STEP_G LUT_DIM
+#define LUT_STEP_B 1
+#define LUT_LANES  0x000000ff00ff00ffULL
+
+#define LUT_MAX_THREADS 8
+#define LUT_MIN_ROWS    64  /* Per thread */
+
+struct mitsu_3dlut {
+	uint64_t node[LUT_DIM * LUT_DIM * LUT_DIM];
+};
+
+/* Grid steps of the three edges walked from the base vertex, indexed by
+   (r >= g) << 2 | (g >= b) << 1 | (r >= b).  Fractions are taken in the
+   same axis order.  Entries 1 and 6 cannot occur. */
+static const struct {
+	uint8_t axis[3];
+	uint16_t off2, off3;
+} lut_tetra[8] = {
+	{ { 2, 1, 0 }, LUT_STEP_B, LUT_STEP_B + LUT_STEP_G },  /* b > g > r */
+	{ { 0, 1, 2 }, LUT_STEP_R, LUT_STEP_R + LUT_STEP_G },
+	{ { 1, 2, 0 }, LUT_STEP_G, LUT_STEP_G + LUT_STEP_B },  /* g >= b > r */
+	{ { 1, 0, 2 }, LUT_STEP_G, LUT_STEP_G + LUT_STEP_R },  /* g > r >= b */
+	{ { 2, 0, 1 }, LUT_STEP_B, LUT_STEP_B + LUT_STEP_R },  /* b > r >= g */
+	{ { 0, 2, 1 }, LUT_STEP_R, LUT_STEP_R + LUT_STEP_B },  /* r >= b > g */
+	{ { 0, 1, 2 }, LUT_STEP_R, LUT_STEP_R + LUT_STEP_G },
+	{ { 0, 1, 2 }, LUT_STEP_R, LUT_STEP_R + LUT_STEP_G },  /* r >= g >= b */
+};
+
+static struct mitsu_3dlut *mitsu_3dlut_load(const uint8_t *ptr)
+{
+	struct mitsu_3dlut *lut = malloc(sizeof(*lut));
+	int r, g, b;
+
+	if (!lut)
+		return NULL;
+
+	for (b = 0 ; b < LUT_DIM ; b++) {
+		for (g = 0 ; g < LUT_DIM ; g++) {
+			for (r = 0 ; r < LUT_DIM ; r++) {
+				lut->node[r * LUT_STEP_R + g * LUT_STEP_G + b] =
+					(uint64_t)ptr[2] |
+					((uint64_t)ptr[1] << 16) |
+					((uint64_t)ptr[0] << 32);
+				ptr += 3;
+			}
+		}
+	}
+
+	return lut;
+}
+
+static void mitsu_3dlut_row(const struct mitsu_3dlut *lut,
+			    uint8_t *red, uint8_t *grn, uint8_t *blu,
+			    uint32_t cols, int step)
 {
+	uint32_t i;
+
+	for (i = 0 ; i < cols ; i++) {
+		unsigned int frac[3];
+		const uint64_t *node;
+		uint64_t sum;
+		unsigned int fa, fb, fc, c;
+
+		frac[0] = *red & 0xf;
+		frac[1] = *grn & 0xf;
+		frac[2] = *blu & 0xf;
+		c = ((frac[0] >= frac[1]) << 2) |
+			((frac[1] >= frac[2]) << 1) |
+			(frac[0] >= frac[2]);
+		fa = frac[lut_tetra[c].axis[0]];
+		fb = frac[lut_tetra[c].axis[1]];
+		fc = frac[lut_tetra[c].axis[2]];
+
+		node = lut->node + (*red >> 4) * LUT_STEP_R +
+			(*grn >> 4) * LUT_STEP_G + (*blu >> 4);
+		sum = node[0] * (16 - fa) +
+			node[lut_tetra[c].off2] * (fa - fb) +
+			node[lut_tetra[c].off3] * (fb - fc) +
+			node[LUT_STEP_R + LUT_STEP_G + LUT_STEP_B] * fc;
+		sum = (sum >> 4) & LUT_LANES;
+
+		*red = sum;
+		*grn = sum >> 16;
+		*blu = sum >> 32;
+
+		red += step;
+		grn += step;
+		blu += step;
+	}
+}
+
+struct mitsu_3dlut_band {
+	const struct mitsu_3dlut *lut;
+	uint8_t *red, *grn, *blu;
+	uint32_t cols, rows, stride;
+	int step;
+};
+
+static void *mitsu_3dlut_band(void *arg)
+{
+	struct mitsu_3dlut_band *band = arg;
+	uint32_t i;
+
+	for (i = 0 ; i < band->rows ; i++) {
+		uint32_t offset = i * band->stride;
+		mitsu_3dlut_row(band->lut, band->red + offset,
+				band->grn + offset, band->blu + offset,
+				band->cols, band->step);
+	}
+
+	return NULL;
+}
+
+/* Split the image into horizontal bands, one per CPU */
+static void mitsu_3dlut_apply(const struct mitsu_3dlut *lut,
+			      uint8_t *red, uint8_t *grn, uint8_t *blu,
+			      uint32_t cols, uint32_t rows, uint32_t stride,
+			      int step)
+{
+	struct mitsu_3dlut_band bands[LUT_MAX_THREADS];
+	int nbands = 1;
+	int i;
+
+#if defined(HAVE_PTHREAD)
+	pthread_t threads[LUT_MAX_THREADS];
+	int started[LUT_MAX_THREADS];
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (ncpus > LUT_MAX_THREADS)
+		ncpus = LUT_MAX_THREADS;
+	if (ncpus > (long)(rows / LUT_MIN_ROWS))
+		ncpus = rows / LUT_MIN_ROWS;
+	if (ncpus > 1)
+		nbands = ncpus;
+#endif
+
+	for (i = 0 ; i < nbands ; i++) {
+		uint32_t first = (uint64_t)rows * i / nbands;
+		uint32_t last = (uint64_t)rows * (i + 1) / nbands;
+		uint32_t offset = first * stride;
+
+		bands[i].lut = lut;
+		bands[i].red = red + offset;
+		bands[i].grn = grn + offset;
+		bands[i].blu = blu + offset;
+		bands[i].cols = cols;
+		bands[i].rows = last - first;
+		bands[i].stride = stride;
+		bands[i].step = step;
+	}
+
+#if defined(HAVE_PTHREAD)
+	/* Band 0 runs on this thread; fall back to it for any band whose
+	   thread can't be started. */
+	for (i = 1 ; i < nbands ; i++)
+		started[i] = !pthread_create(&threads[i], NULL,
+					     mitsu_3dlut_band, &bands[i]);
+	mitsu_3dlut_band(&bands[0]);
+	for (i = 1 ; i < nbands ; i++) {
+		if (started[i])
+			pthread_join(threads[i], NULL);
+		else
+			mitsu_3dlut_band(&bands[i]);
+	}
+#else
+	mitsu_3dlut_band(&bands[0]);
+#endif
+}
+
+/* MITSU_LUT selects which engine runs the 3D LUT:
+     "native"  -- the built-in interpolator (default)
+     "lib"     -- the image processing library, if it is loaded
+     "verify"  -- both; the library's output is used and any
+                  difference from the built-in code is reported.
+
+   Only the 3D LUT is built in.  The rest of the processing for the
+   CP-D70/D80/K60 family, the CP-M1 and the CP98xx (CPC tables, YMC
+   conversion, sharpening) still needs the library, so those printers
+   can't print non-raw jobs without it whatever this is set to.
+*/
+enum {
+	LUT_ENGINE_NATIVE = 0,
+	LUT_ENGINE_LIB = 1,
+	LUT_ENGINE_VERIFY = 2,
+};
+
+static int mitsu_lut_engine(const struct mitsu_lib *lib)
+{
+	const char *sval = getenv("MITSU_LUT");
+	int engine = LUT_ENGINE_NATIVE;
+
+	if (sval && !strcmp(sval, "lib"))
+		engine = LUT_ENGINE_LIB;
+	else if (sval && !strcmp(sval, "verify"))
+		engine = LUT_ENGINE_VERIFY;
+
 #if defined(WITH_DYNAMIC)
+	if (lib->dl_handle)
+		return engine;
+#else
+	UNUSED(lib);
+#endif
+	if (engine != LUT_ENGINE_NATIVE)
+		WARNING("Image processing library not loaded, using built-in 3D LUT\n");
+	return LUT_ENGINE_NATIVE;
+}
+
+static int mitsu_load3dlut(struct mitsu_lib *lib, const char *lutfname,
+			   int engine)
+{
 	char full[2048];
-	int i;
+	uint8_t *buf;
+	int ret = CUPS_BACKEND_OK;
 
-	if (!lutfname)
+	if (lib->native_lut && (engine == LUT_ENGINE_NATIVE))
 		return CUPS_BACKEND_OK;
-	if (!lib->dl_handle)
+#if defined(WITH_DYNAMIC)
+	if (lib->native_lut && lib->lut)
 		return CUPS_BACKEND_OK;
+#endif
 
 	snprintf(full, sizeof(full), "%s/%s", corrtable_path, lutfname);
 
-	if (!lib->lut) {
-		uint8_t *buf = malloc(LUT_LEN);
-		if (!buf) {
+	buf = malloc(LUT_LEN);
+	if (!buf) {
+		ERROR("Memory allocation failure!\n");
+		return CUPS_BACKEND_RETRY_CURRENT;
+	}
+	if ((ret = dyesub_read_file(full, buf, LUT_LEN, NULL)))
+		goto done;
+
+	if (!lib->native_lut) {
+		lib->native_lut = mitsu_3dlut_load(buf);
+		if (!lib->native_lut) {
 			ERROR("Memory allocation failure!\n");
-			return CUPS_BACKEND_RETRY_CURRENT;
+			ret = CUPS_BACKEND_RETRY_CURRENT;
+			goto done;
 		}
-		if ((i = dyesub_read_file(full, buf, LUT_LEN, NULL)))
-			return i;
+	}
+#if defined(WITH_DYNAMIC)
+	if (engine != LUT_ENGINE_NATIVE && !lib->lut) {
 		lib->lut = lib->Load3DColorTable(buf);
-		free(buf);
 		if (!lib->lut) {
 			ERROR("Unable to parse LUT file '%s'!\n", full);
-			return CUPS_BACKEND_CANCEL;
+			ret = CUPS_BACKEND_CANCEL;
 		}
 	}
+#endif
+
+done:
+	free(buf);
+	return ret;
+}
+
+static void mitsu_3dlut_compare(const uint8_t *lib_out, const uint8_t *native_out,
+				uint32_t len, uint32_t rows, uint32_t stride)
+{
+	uint32_t i, j;
+	uint32_t mismatches = 0;
+
+	for (i = 0 ; i < rows ; i++) {
+		for (j = 0 ; j < len ; j++) {
+			uint32_t offset = i * stride + j;
+			if (lib_out[offset] == native_out[offset])
+				continue;
+			if (!mismatches)
+				ERROR("3D LUT mismatch at row %u byte %u (library %02x, built-in %02x)\n",
+				      i, j, lib_out[offset], native_out[offset]);
+			mismatches++;
+		}
+	}
+
+	if (mismatches)
+		ERROR("3D LUT verification failed: %u of %u bytes differ\n",
+		      mismatches, len * rows);
+	else
+		INFO("3D LUT verification passed (%u bytes)\n", len * rows);
+}
+
+int mitsu_apply3dlut_packed(struct mitsu_lib *lib, const char *lutfname, uint8_t *databuf,
+			    uint16_t cols, uint16_t rows, uint16_t stride,
+			    int rgb_bgr)
+{
+	int engine;
+	int ret;
+	uint8_t *red = databuf, *blu = databuf + 2;
+
+	if (!lutfname)
+		return CUPS_BACKEND_OK;
+
+	engine = mitsu_lut_engine(lib);
+	if ((ret = mitsu_load3dlut(lib, lutfname, engine)))
+		return ret;
 
-	if (lib->lut) {
-		DEBUG("Running print data through 3D LUT\n");
+	if (rgb_bgr == COLORCONV_BGR) {
+		red = databuf + 2;
+		blu = databuf;
+	}
+
+	DEBUG("Running print data through 3D LUT\n");
+
+#if defined(WITH_DYNAMIC)
+	if (engine == LUT_ENGINE_VERIFY) {
+		uint32_t len = (uint32_t)rows * stride;
+		uint8_t *copy = malloc(len);
+
+		if (copy) {
+			memcpy(copy, databuf, len);
+			mitsu_3dlut_apply(lib->native_lut, copy + (red - databuf),
+					  copy + 1, copy + (blu - databuf),
+					  cols, rows, stride, 3);
+		} else {
+			WARNING("Memory allocation failure, skipping 3D LUT verification\n");
+		}
 		lib->DoColorConv(lib->lut, databuf, cols, rows, stride, rgb_bgr);
+		if (copy)
+			mitsu_3dlut_compare(databuf, copy, cols * 3, rows, stride);
+		free(copy);
+		return CUPS_BACKEND_OK;
+	}
+	if (engine == LUT_ENGINE_LIB) {
+		lib->DoColorConv(lib->lut, databuf, cols, rows, stride, rgb_bgr);
+		return CUPS_BACKEND_OK;
 	}
 #endif
+
+	mitsu_3dlut_apply(lib->native_lut, red, databuf + 1, blu,
+			  cols, rows, stride, 3);
+
 	return CUPS_BACKEND_OK;
 }
 
@@ -194,38 +506,50 @@ int mitsu_apply3dlut_plane(struct mitsu_lib *lib, const char *lutfname,
 			   uint8_t *data_r, uint8_t *data_g, uint8_t *data_b,
 			   uint16_t cols, uint16_t rows)
 {
-#if defined(WITH_DYNAMIC)
-	char full[2048];
-	int i;
+	int engine;
+	int ret;
 
 	if (!lutfname)
 		return CUPS_BACKEND_OK;
-	if (!lib->dl_handle)
-		return CUPS_BACKEND_OK;
 
-	snprintf(full, sizeof(full), "%s/%s", corrtable_path, lutfname);
+	engine = mitsu_lut_engine(lib);
+	if ((ret = mitsu_load3dlut(lib, lutfname, engine)))
+		return ret;
 
-	if (!lib->lut) {
-		uint8_t *buf = malloc(LUT_LEN);
-		if (!buf) {
-			ERROR("Memory allocation failure!\n");
-			return CUPS_BACKEND_RETRY_CURRENT;
+	DEBUG("Running print data through 3D LUT\n");
+
+#if defined(WITH_DYNAMIC)
+	if (engine == LUT_ENGINE_VERIFY) {
+		uint32_t len = (uint32_t)rows * cols;
+		uint8_t *copy = malloc(len * 3);
+
+		if (copy) {
+			memcpy(copy, data_r, len);
+			memcpy(copy + len, data_g, len);
+			memcpy(copy + len * 2, data_b, len);
+			mitsu_3dlut_apply(lib->native_lut, copy, copy + len,
+					  copy + len * 2, cols, rows, cols, 1);
+		} else {
+			WARNING("Memory allocation failure, skipping 3D LUT verification\n");
 		}
-		if ((i = dyesub_read_file(full, buf, LUT_LEN, NULL)))
-			return i;
-		lib->lut = lib->Load3DColorTable(buf);
-		free(buf);
-		if (!lib->lut) {
-			ERROR("Unable to parse LUT file '%s'!\n", full);
-			return CUPS_BACKEND_CANCEL;
+		lib->DoColorConvPlane(lib->lut, data_r, data_g, data_b, cols * rows);
+		if (copy) {
+			mitsu_3dlut_compare(data_r, copy, len, 1, len);
+			mitsu_3dlut_compare(data_g, copy + len, len, 1, len);
+			mitsu_3dlut_compare(data_b, copy + len * 2, len, 1, len);
 		}
+		free(copy);
+		return CUPS_BACKEND_OK;
 	}
-
-	if (lib->lut) {
-		DEBUG("Running print data through 3D LUT\n");
+	if (engine == LUT_ENGINE_LIB) {
 		lib->DoColorConvPlane(lib->lut, data_r, data_g, data_b, cols * rows);
+		return CUPS_BACKEND_OK;
 	}
 #endif
+
+	mitsu_3dlut_apply(lib->native_lut, data_r, data_g, data_b,
+			  cols, rows, cols, 1);
+
 	return CUPS_BACKEND_OK;
 }
 
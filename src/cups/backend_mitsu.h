@@ -101,6 +101,9 @@ typedef int (*CPD30_DoConvertFN)(const struct mitsu_cpd30_data *table,
 /* Image processing library function prototypes */
 #define LIB_NAME_RE "libMitsuD70ImageReProcess" DLL_SUFFIX
 
+/* Built-in 3D LUT interpolator, see backend_mitsu.c */
+struct mitsu_3dlut;
+
 struct mitsu_lib {
 	void *dl_handle;
 	lib70x_getapiversionFN GetAPIVersion;
@@ -131,6 +134,7 @@ struct mitsu_lib {
 	CPD30_DestroyDataFN CPD30_DestroyData;
 	CPD30_DoConvertFN CPD30_DoConvert;
 	struct CColorConv3D *lut;
+	struct mitsu_3dlut *native_lut;
 	struct CPCData *cpcdata;
 	struct CPCData *ecpcdata;
 };
@@ -721,7 +721,7 @@ static void mitsu70x_cleanup_job(const void *vjob) {
 	if (job->databuf)
 		free(job->databuf);
 	if (job->spoolbuf)
-		free(job->spoolbuf);
+		dyesub_free_data(job->spoolbuf);
 
 	free((void*)job);
 }
@@ -1118,29 +1118,16 @@ repeat:
 	remain = job->rows * job->cols * 3;
 	DEBUG("Reading in %d bytes of 8bpp BGR data\n", remain);
 
-	job->spoolbuflen = 0;
-	job->spoolbuf = malloc(remain);
-	if (!job->spoolbuf) {
-		ERROR("Memory allocation failure!\n");
-		mitsu70x_cleanup_job(job);
-		return CUPS_BACKEND_RETRY_CURRENT;
-	}
-
 	/* Read in the BGR data */
-	while (remain) {
-		i = read(data_fd, job->spoolbuf + job->spoolbuflen, remain);
-		if (i == 0) {
-			mitsu70x_cleanup_job(job);
-			return CUPS_BACKEND_CANCEL;
-		}
-		if (i < 0) {
-			mitsu70x_cleanup_job(job);
-			return CUPS_BACKEND_CANCEL;
-		}
-		job->spoolbuflen += i;
-		remain -= i;
+	i = dyesub_read_data(data_fd, &job->spoolbuf, remain);
+	if (i) {
+		mitsu70x_cleanup_job(job);
+		return i;
 	}
+	job->spoolbuflen = remain;
 
+	/* The built-in 3D LUT doesn't help here; the conversion to YMC in
+	   the main loop needs the library regardless. */
 	if (!ctx->lib.dl_handle) {
 		ERROR("!!! Image Processing Library not found, aborting!\n");
 		mitsu70x_cleanup_job(job);
@@ -1866,7 +1853,7 @@ static int mitsu70x_main_loop(void *vctx, const void *vjob, int wait_for_return)
 	job->datalen += 3*job->planelen;
 
 	/* Clean up */
-	free(job->spoolbuf);
+	dyesub_free_data(job->spoolbuf);
 	job->spoolbuf = NULL;
 	job->spoolbuflen = 0;
 
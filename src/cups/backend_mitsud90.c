@@ -1003,7 +1003,8 @@ static void mitsud90_teardown(void *vctx) {
 	}
 
 	if (ctx->conn->type == P_MITSU_M1 ||
-	    ctx->conn->type == P_FUJI_ASK500) {
+	    ctx->conn->type == P_FUJI_ASK500 ||
+	    ctx->conn->type == P_MITSU_D90) {
 		mitsu_destroylib(&ctx->lib);
 	}
 
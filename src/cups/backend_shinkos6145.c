@@ -1384,7 +1384,7 @@ static int shinkos6145_read_parse(void *vctx, const void **vjob, int data_fd, in
 			databuf3[planelen + i] = 255 - g;
 			databuf3[planelen + planelen + i] = 255 - r;
 		}
-		free(job->databuf);
+		dyesub_free_data(job->databuf);
 		job->databuf = databuf3;
 	}
 
@@ -1687,7 +1687,7 @@ top:
 				free(newbuf);
 				return CUPS_BACKEND_FAILED;
 			}
-			free(job->databuf);
+			dyesub_free_data(job->databuf);
 			job->databuf = (uint8_t*)newbuf;
 			job->datalen = bufSize;
 		} else {
@@ -1716,7 +1716,7 @@ top:
 			}
 			ctx->ImageProcessing(job->databuf, databuf2, ctx->corrdata);
 
-			free(job->databuf);
+			dyesub_free_data(job->databuf);
 			job->databuf = (uint8_t*) databuf2;
 			job->datalen = newlen;
 		}
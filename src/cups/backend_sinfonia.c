@@ -71,37 +71,17 @@ int sinfonia_read_parse(int data_fd, uint32_t model,
 
 	/* Work out data length */
 	job->datalen = hdr[13] * hdr[14] * 3;
-	job->databuf = malloc(job->datalen);
-	if (!job->databuf) {
-		ERROR("Memory allocation failure!\n");
-		return CUPS_BACKEND_RETRY_CURRENT;
-	}
-
 	/* Read in payload data */
-	{
-		uint32_t remain = job->datalen;
-		uint8_t *ptr = job->databuf;
-		do {
-			ret = read(data_fd, ptr, remain);
-			if (ret < 0) {
-				ERROR("Read failed (%d/%u/%d)\n",
-				      ret, remain, job->datalen);
-				perror("ERROR: Read failed");
-				free(job->databuf);
-				job->databuf = NULL;
-				return ret;
-			}
-			ptr += ret;
-			remain -= ret;
-		} while (remain);
-	}
+	ret = dyesub_read_data(data_fd, &job->databuf, job->datalen);
+	if (ret)
+		return ret;
 
 	/* Make sure footer is sane too */
 	ret = read(data_fd, tmpbuf, 4);
 	if (ret != 4) {
 		ERROR("Read failed (%d/%d)\n", ret, 4);
 		perror("ERROR: Read failed");
-		free(job->databuf);
+		dyesub_free_data(job->databuf);
 		job->databuf = NULL;
 		return ret;
 	}
@@ -110,7 +90,7 @@ int sinfonia_read_parse(int data_fd, uint32_t model,
 	    tmpbuf[2] != 0x02 ||
 	    tmpbuf[3] != 0x01) {
 		ERROR("Unrecognized footer data format!\n");
-		free (job->databuf);
+		dyesub_free_data(job->databuf);
 		job->databuf = NULL;
 		return CUPS_BACKEND_CANCEL;
 	}
@@ -169,7 +149,7 @@ int sinfonia_raw10_read_parse(int data_fd, struct sinfonia_printjob *job)
 	job->jp.oc_mode = hdr.oc_mode;
 	job->jp.method = hdr.method;
 
-	/* Allocate buffer */
+	/* Work out data length */
 	job->datalen = job->jp.rows * job->jp.columns * 3;
 
 	/* Hack in backprinting */
@@ -179,27 +159,9 @@ int sinfonia_raw10_read_parse(int data_fd, struct sinfonia_printjob *job)
 		job->jp.ext_flags = EXT_FLAG_BACKPRINT;
 	}
 
-	job->databuf = malloc(job->datalen);
-	if (!job->databuf) {
-		ERROR("Memory allocation failure!\n");
-		return CUPS_BACKEND_RETRY_CURRENT;
-	}
-
-	{
-		int remain = job->datalen;
-		uint8_t *ptr = job->databuf;
-		do {
-			ret = read(data_fd, ptr, remain);
-			if (ret < 0) {
-				ERROR("Read failed (%d/%d/%d)\n",
-				      ret, remain, job->datalen);
-				perror("ERROR: Read failed");
-				return CUPS_BACKEND_CANCEL;
-			}
-			ptr += ret;
-			remain -= ret;
-		} while (remain);
-	}
+	ret = dyesub_read_data(data_fd, &job->databuf, job->datalen);
+	if (ret)
+		return ret;
 
 	return CUPS_BACKEND_OK;
 }
@@ -371,29 +333,11 @@ int sinfonia_raw18_read_parse(int data_fd, struct sinfonia_printjob *job)
 	job->jp.oc_mode = hdr.oc_mode;
 	job->jp.method = hdr.method;
 
-	/* Allocate buffer */
+	/* Work out data length */
 	job->datalen = job->jp.rows * job->jp.columns * 3;
-	job->databuf = malloc(job->datalen);
-	if (!job->databuf) {
-		ERROR("Memory allocation failure!\n");
-		return CUPS_BACKEND_RETRY_CURRENT;
-	}
-
-	{
-		int remain = job->datalen;
-		uint8_t *ptr = job->databuf;
-		do {
-			ret = read(data_fd, ptr, remain);
-			if (ret < 0) {
-				ERROR("Read failed (%d/%d/%d)\n",
-				      ret, remain, job->datalen);
-				perror("ERROR: Read failed");
-				return CUPS_BACKEND_CANCEL;
-			}
-			ptr += ret;
-			remain -= ret;
-		} while (remain);
-	}
+	ret = dyesub_read_data(data_fd, &job->databuf, job->datalen);
+	if (ret)
+		return ret;
 
 	return CUPS_BACKEND_OK;
 }
@@ -429,29 +373,11 @@ int sinfonia_raw28_read_parse(int data_fd, struct sinfonia_printjob *job)
 	job->jp.quality = hdr.options & SINFONIA_PRINT28_OPTIONS_HQ;
 	job->jp.method = hdr.method;
 
-	/* Allocate buffer */
+	/* Work out data length */
 	job->datalen = job->jp.rows * job->jp.columns * 3;
-	job->databuf = malloc(job->datalen);
-	if (!job->databuf) {
-		ERROR("Memory allocation failure!\n");
-		return CUPS_BACKEND_RETRY_CURRENT;
-	}
-
-	{
-		int remain = job->datalen;
-		uint8_t *ptr = job->databuf;
-		do {
-			ret = read(data_fd, ptr, remain);
-			if (ret < 0) {
-				ERROR("Read failed (%d/%d/%d)\n",
-				      ret, remain, job->datalen);
-				perror("ERROR: Read failed");
-				return CUPS_BACKEND_CANCEL;
-			}
-			ptr += ret;
-			remain -= ret;
-		} while (remain);
-	}
+	ret = dyesub_read_data(data_fd, &job->databuf, job->datalen);
+	if (ret)
+		return ret;
 
 	return CUPS_BACKEND_OK;
 }
@@ -461,7 +387,7 @@ void sinfonia_cleanup_job(const void *vjob)
 	const struct sinfonia_printjob *job = vjob;
 
 	if (job->databuf)
-		free(job->databuf);
+		dyesub_free_data(job->databuf);
 
 	free((void*)job);
 }
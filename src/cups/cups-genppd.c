@@ -21,6 +21,7 @@
  *   main()              - Process files on the command-line...
  *   cat_ppd()           - Copy the named PPD to stdout.
  *   generate_ppd()      - Generate a PPD file.
+ *   generate_ppds()     - Generate a list of PPD files, in parallel.
  *   getlangs()          - Get a list of available translations.
  *   help()              - Show detailed help.
  *   is_special_option() - Determine if an option should be grouped.
@@ -29,25 +30,58 @@
  *   print_group_open()  - Open a new UI group.
  *   printlangs()        - Print list of available translations.
  *   printmodels()       - Print a list of available models.
+ *   read_ppd_digest()   - Read the digest recorded in an existing PPD file.
  *   usage()             - Show program usage.
  *   write_ppd()         - Write a PPD file.
  */
 
 #include "genppd.h"
+#include <sys/time.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#define MAX_JOBS	256	/* Most worker processes for -j */
+
+/*
+ * One PPD file to generate.  With -j, the list of these is shared with
+ * the worker processes, each of which takes the next one not yet taken.
+ */
+typedef struct
+{
+  int		printer;	/* Index of printer */
+  ppd_type_t	ppd_type;	/* PPD type */
+  int		status;		/* Result (-1 if not generated) */
+  int		unchanged;	/* Existing file was up to date */
+  double	seconds;	/* Time taken */
+} ppd_work_item_t;
+
+typedef struct
+{
+  volatile int	next;		/* Next item to take */
+  volatile int	failed;		/* Set when any item fails */
+  int		count;		/* Number of items */
+  int		size;		/* Number of items allocated */
+  int		incremental;	/* Leave up to date files alone */
+  ppd_work_item_t items[1];
+} ppd_work_list_t;
 
 static int	generate_ppd(const char *prefix, int verbose,
 		             const stp_printer_t *p, const char *language,
-			     ppd_type_t ppd_type, int use_compression);
-static int	generate_model_ppds(const char *prefix, int verbose,
-				    const stp_printer_t *printer,
-				    const char *language, int which_ppds,
-				    int use_compression);
+			     ppd_type_t ppd_type, int use_compression,
+			     int incremental, int *unchanged);
+static int	generate_ppds(const char *prefix, int verbose,
+			      const char *language, ppd_work_list_t *work,
+			      unsigned jobs, int use_compression);
+static ppd_work_list_t *add_work(ppd_work_list_t *work, int printer,
+				 int which_ppds);
 static void	help(void);
 static void	printlangs(char** langs);
 static void	printmodels(int verbose);
 static void	usage(void);
 static gpFile	gpopen(const char *path, const char *mode, int use_compression);
 static int	gpclose(gpFile f, int use_compression);
+static int	read_ppd_digest(const char *filename, char *digest);
 
 /*
  * 'main()' - Process files on the command-line...
@@ -68,18 +102,19 @@ main(int  argc,			    /* I - Number of command-line arguments */
   int           opt_printmodels = 0;/* Print available models */
   int           which_ppds = 2;	    /* Simplified PPD's = 1, full = 2,
 				       no color opts = 4 */
-  unsigned      parallel = 1;	    /* Generate PPD files in parallel */
-  unsigned      rotor = 0;	    /* Rotor for generating PPD files in parallel */
+  unsigned      jobs = 1;	    /* Generate PPD files in parallel */
+  int		jobs_set = 0;	    /* -j given */
   unsigned      test_rotor = 0;	    /* Testing (serialized) rotor */
   unsigned      test_rotor_circumference = 1;    /* Testing (serialized) rotor size */
-  pid_t         *subprocesses = NULL;
-  int		parent = 1;
+  ppd_work_list_t *work = NULL;	    /* PPD files to generate */
+  int		status;
 #ifdef HAVE_LIBZ
   int		use_compression = 1;
 #else
   int		use_compression = 0;
 #endif
   int		skip_duplicate_ppds = 0;
+  int		incremental = 0;    /* Only rewrite changed PPD files */
 
 
  /*
@@ -90,7 +125,7 @@ main(int  argc,			    /* I - Number of command-line arguments */
 
   for (;;)
   {
-    if ((i = getopt(argc, argv, "23hvqc:p:l:LMVd:saNCbZzSr:R:")) == -1)
+    if ((i = getopt(argc, argv, "23hvqc:p:l:LMVd:saNCbZzSr:R:j:i")) == -1)
       break;
 
     switch (i)
@@ -183,6 +218,25 @@ main(int  argc,			    /* I - Number of command-line arguments */
     case 'R':
       test_rotor_circumference = atoi(optarg);
       break;
+    case 'j':
+      if (atoi(optarg) < 0)
+	{
+	  fprintf(stderr, "cups-genppd: Invalid number of jobs %s\n", optarg);
+	  exit(EXIT_FAILURE);
+	}
+      jobs = atoi(optarg);
+      if (jobs == 0)
+	{
+	  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	  jobs = cpus > 0 ? cpus : 1;
+	}
+      if (jobs > MAX_JOBS)
+	jobs = MAX_JOBS;
+      jobs_set = 1;
+      break;
+    case 'i':
+      incremental = 1;
+      break;
     default:
       usage();
       exit(EXIT_FAILURE);
@@ -236,35 +290,13 @@ main(int  argc,			    /* I - Number of command-line arguments */
     }
 
  /*
-  * Write PPD files...
+  * Work out which PPD files to write...
   */
 
-  if (getenv("STP_PARALLEL"))
-    {
-      parallel = atoi(getenv("STP_PARALLEL"));
-      if (parallel < 1 || parallel > 256)
-	parallel = 1;
-    }
-  if (parallel > 1)
-    {
-      subprocesses = stp_malloc(sizeof(pid_t) * parallel);
-      for (rotor = 0; rotor < parallel; rotor++)
-	{
-	  pid_t pid = fork();
-	  if (pid == 0)		/* Child */
-	    {
-	      parent = 0;
-	      break;
-	    }
-	  else if (pid > 0)
-	    subprocesses[rotor] = pid;
-	  else
-	    {
-	      fprintf(stderr, "Cannot fork: %s\n", strerror(errno));
-	      return 1;
-	    }
-	}
-    }
+  if (!jobs_set && getenv("STP_PARALLEL"))
+    jobs = atoi(getenv("STP_PARALLEL"));
+  if (jobs < 1 || jobs > MAX_JOBS)
+    jobs = 1;
   if (models)
     {
       int n;
@@ -273,21 +305,9 @@ main(int  argc,			    /* I - Number of command-line arguments */
 	  printer = stp_get_printer_by_driver(models[n]);
 	  if (!printer)
 	    printer = stp_get_printer_by_long_name(models[n]);
-
-	  if (n % parallel == rotor && printer)
-	    {
-	      if (printer)
-		{
-		  if (generate_model_ppds(prefix, verbose, printer, language,
-					  which_ppds, use_compression))
-		    return 1;
-		}
-	      else
-		{
-		  printf("Driver not found: %s\n", models[n]);
-		  return (1);
-		}
-	    }
+	  if (printer)
+	    work = add_work(work, stp_get_printer_index_by_driver
+			    (stp_printer_get_driver(printer)), which_ppds);
 	}
       stp_free(models);
     }
@@ -316,57 +336,238 @@ main(int  argc,			    /* I - Number of command-line arguments */
 	    }
 	  if (test_rotor_current % test_rotor_circumference != test_rotor)
 	    continue;
-	  if (i % parallel == rotor && printer)
-	    {
-	      if (! verbose && (i % 100) == 0)
-		fputc('.',stderr);
-	      if (generate_model_ppds(prefix, verbose, printer, language,
-				      which_ppds, use_compression))
-		return 1;
-	    }
+	  if (printer)
+	    work = add_work(work, i, which_ppds);
 	}
       if (seen_models)
 	stp_string_list_destroy(seen_models);
     }
-  if (subprocesses)
+
+ /*
+  * Write PPD files...
+  */
+
+  if (!work)
     {
-      pid_t pid;
-      do
-	{
-	  int status;
-	  pid = waitpid(-1, &status, 0);
-	  if (pid > 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
-	    {
-	      fprintf(stderr, "failed!\n");
-	      return 1;
-	    }
-	} while (pid > 0);
-      stp_free(subprocesses);
+      if (!verbose)
+	fprintf(stderr, " done.\n");
+      return (0);
     }
-  if (parent && !verbose)
+  work->incremental = incremental;
+  status = generate_ppds(prefix, verbose, language, work, jobs,
+			 use_compression);
+  if (status == 0 && !verbose)
     fprintf(stderr, " done.\n");
 
-  return (0);
+  return (status);
+}
+
+/*
+ * Allocate the work list so that it can be shared with worker processes.
+ */
+
+static ppd_work_list_t *
+alloc_work(int count)
+{
+  size_t size = sizeof(ppd_work_list_t) + count * sizeof(ppd_work_item_t);
+  ppd_work_list_t *work;
+#if defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS)
+  work = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (work == MAP_FAILED)
+    {
+      fprintf(stderr, "cups-genppd: Cannot allocate work list: %s\n",
+	      strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+#else
+  work = stp_malloc(size);
+#endif
+  memset(work, 0, size);
+  work->size = count;
+  return work;
+}
+
+static void
+free_work(ppd_work_list_t *work)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS)
+  munmap(work, sizeof(ppd_work_list_t) + work->size * sizeof(ppd_work_item_t));
+#else
+  stp_free(work);
+#endif
+}
+
+static ppd_work_list_t *
+add_work(ppd_work_list_t *work, int printer, int which_ppds)
+{
+  static const ppd_type_t types[] =
+    { PPD_SIMPLIFIED, PPD_STANDARD, PPD_NO_COLOR_OPTS };
+  int i;
+  for (i = 0; i < 3; i++)
+    if (which_ppds & (1 << i))
+      {
+	/* The list is only built before any work starts */
+	int count = work ? work->count : 0;
+	if (!work || count == work->size)
+	  {
+	    ppd_work_list_t *nwork = alloc_work(count ? count * 2 : 64);
+	    if (work)
+	      {
+		memcpy(nwork->items, work->items,
+		       count * sizeof(ppd_work_item_t));
+		free_work(work);
+	      }
+	    work = nwork;
+	  }
+	work->items[count].printer = printer;
+	work->items[count].ppd_type = types[i];
+	work->items[count].status = -1;
+	work->items[count].unchanged = 0;
+	work->count = count + 1;
+      }
+  return work;
+}
+
+static double
+get_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/*
+ * Take items off the work list until it's empty or something fails.
+ */
+
+static int
+do_work(const char *prefix, int verbose, const char *language,
+	ppd_work_list_t *work, int use_compression)
+{
+  for (;;)
+    {
+      int i = __sync_fetch_and_add(&work->next, 1);
+      ppd_work_item_t *item;
+      double start;
+      if (i >= work->count || work->failed)
+	return 0;
+      item = &(work->items[i]);
+      if (!verbose && (item->printer % 100) == 0 &&
+	  (i == 0 || work->items[i - 1].printer != item->printer))
+	fputc('.',stderr);
+      start = get_time();
+      item->status = generate_ppd(prefix, verbose,
+				  stp_get_printer_by_index(item->printer),
+				  language, item->ppd_type, use_compression,
+				  work->incremental, &(item->unchanged));
+      item->seconds = get_time() - start;
+      if (item->status)
+	{
+	  work->failed = 1;
+	  return 1;
+	}
+    }
 }
 
 static int
-generate_model_ppds(const char *prefix, int verbose,
-		    const stp_printer_t *printer, const char *language,
-		    int which_ppds, int use_compression)
+compare_item_times(const void *a, const void *b)
 {
-  if ((which_ppds & 1) &&
-      generate_ppd(prefix, verbose, printer, language, PPD_SIMPLIFIED,
-		   use_compression))
-    return (1);
-  if ((which_ppds & 2) &&
-      generate_ppd(prefix, verbose, printer, language, PPD_STANDARD,
-		   use_compression))
-    return (1);
-  if ((which_ppds & 4) &&
-      generate_ppd(prefix, verbose, printer, language, PPD_NO_COLOR_OPTS,
-		   use_compression))
-    return (1);
-  return 0;
+  const ppd_work_item_t *ia = *(const ppd_work_item_t * const *) a;
+  const ppd_work_item_t *ib = *(const ppd_work_item_t * const *) b;
+  return ia->seconds < ib->seconds ? 1 : ia->seconds > ib->seconds ? -1 : 0;
+}
+
+/*
+ * Print how long the PPD files took, and which took longest.
+ */
+
+static void
+print_summary(const ppd_work_list_t *work, unsigned jobs, double elapsed)
+{
+  static const char *const type_names[] = { "standard", "simplified", "nc" };
+  const ppd_work_item_t **sorted =
+    stp_malloc(work->count * sizeof(ppd_work_item_t *));
+  double total = 0;
+  int done = 0;
+  int unchanged = 0;
+  int i;
+
+  for (i = 0; i < work->count; i++)
+    if (work->items[i].status == 0)
+      {
+	sorted[done++] = &(work->items[i]);
+	total += work->items[i].seconds;
+	unchanged += work->items[i].unchanged;
+      }
+  qsort(sorted, done, sizeof(ppd_work_item_t *), compare_item_times);
+  fprintf(stderr, "\n%d of %d PPD files in %.2f s with %u job%s "
+	  "(%.2f s total, %.3f s mean per file)\n",
+	  done, work->count, elapsed, jobs, jobs == 1 ? "" : "s",
+	  total, done ? total / done : 0.0);
+  if (work->incremental)
+    fprintf(stderr, "%d of them were already up to date\n", unchanged);
+  for (i = 0; i < done && i < 5; i++)
+    fprintf(stderr, "  %8.3f s  %s (%s)\n", sorted[i]->seconds,
+	    stp_printer_get_driver(stp_get_printer_by_index(sorted[i]->printer)),
+	    type_names[sorted[i]->ppd_type]);
+  stp_free(sorted);
+}
+
+/*
+ * 'generate_ppds()' - Generate a list of PPD files, in parallel.
+ */
+
+static int
+generate_ppds(const char *prefix, int verbose, const char *language,
+	      ppd_work_list_t *work, unsigned jobs, int use_compression)
+{
+  double start = get_time();
+  int status = 0;
+  unsigned j;
+
+#if !defined(HAVE_SYS_MMAN_H) || !defined(MAP_ANONYMOUS)
+  jobs = 1;		/* Nothing to share the work list with */
+#endif
+  if (jobs > (unsigned) work->count)
+    jobs = work->count;
+  if (jobs <= 1)
+    status = do_work(prefix, verbose, language, work, use_compression);
+  else
+    {
+      fflush(stdout);
+      fflush(stderr);
+      for (j = 0; j < jobs; j++)
+	{
+	  pid_t pid = fork();
+	  if (pid == 0)		/* Child */
+	    exit(do_work(prefix, verbose, language, work, use_compression));
+	  else if (pid < 0)
+	    {
+	      fprintf(stderr, "Cannot fork: %s\n", strerror(errno));
+	      work->failed = 1;
+	      status = 1;
+	      break;
+	    }
+	}
+      for (;;)
+	{
+	  int wstatus;
+	  pid_t pid = waitpid(-1, &wstatus, 0);
+	  if (pid < 0)
+	    break;
+	  if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0)
+	    status = 1;
+	}
+      if (work->failed)
+	status = 1;
+      if (status)
+	fprintf(stderr, "failed!\n");
+    }
+  if (verbose || jobs > 1)
+    print_summary(work, jobs, get_time() - start);
+  free_work(work);
+  return (status);
 }
 
 /*
@@ -380,11 +581,15 @@ generate_ppd(
     const stp_printer_t *p,		/* I - Driver */
     const char          *language,	/* I - Primary language */
     ppd_type_t          ppd_type,	/* I - full, simplified, no color */
-    int			use_compression) /* I - compress output */
+    int			use_compression, /* I - compress output */
+    int			incremental,	/* I - leave up to date files alone */
+    int			*unchanged)	/* O - file was up to date */
 {
   int		status;			/* Exit status */
   gpFile	fp;			/* File to write to */
   char		filename[1024],		/* Filename */
+		new_filename[1030],	/* Filename while being written */
+		ppd_name[1024],		/* Filename without prefix */
 		ppd_location[1024];	/* Installed location */
   struct stat   dir;                    /* Prefix dir status */
   const char    *ppd_infix;
@@ -403,7 +608,8 @@ generate_ppd(
 
   if (stat(prefix, &dir) && !S_ISDIR(dir.st_mode))
   {
-    if (mkdir(prefix, 0777))
+    /* Another process may have got there first */
+    if (mkdir(prefix, 0777) && errno != EEXIST)
     {
       printf("cups-genppd: Cannot create directory %s: %s\n",
 	     prefix, strerror(errno));
@@ -438,34 +644,72 @@ generate_ppd(
 	   prefix, stp_printer_get_driver(p), GUTENPRINT_RELEASE_VERSION,
 	   ppd_infix, ppdext, gpext);
 
+  snprintf(ppd_location, sizeof(ppd_location), "%s%s%s/%s",
+	   cups_modeldir,
+	   cups_modeldir[strlen(cups_modeldir) - 1] == '/' ? "" : "/",
+	   language ? language : "C",
+	   basename(filename));
+
+  snprintf(ppd_name, sizeof(ppd_name) - 1, "stp-%s.%s%s%s",
+	   stp_printer_get_driver(p), GUTENPRINT_RELEASE_VERSION,
+	   ppd_infix, ppdext);
+
+ /*
+  * Leave the existing file alone if nothing that goes into it has
+  * changed...
+  */
+
+  *unchanged = 0;
+  if (incremental)
+  {
+    char	digest[PPD_DIGEST_SIZE],	/* Digest of new file */
+		old_digest[PPD_DIGEST_SIZE];	/* Digest of existing file */
+
+    ppd_digest(digest, p, language, ppd_location, ppd_type, ppd_name);
+    if (read_ppd_digest(filename, old_digest) &&
+	strcmp(digest, old_digest) == 0)
+    {
+      if (verbose)
+	fprintf(stderr, "Up to date %s\n", filename);
+      *unchanged = 1;
+      return (0);
+    }
+  }
+
  /*
-  * Open the PPD file...
+  * Open the PPD file.  It's written under a temporary name and renamed
+  * when complete, so that an interrupted run never leaves a partial file
+  * that looks up to date...
   */
 
-  if ((fp = gpopen(filename, "wb", use_compression)) == NULL)
+  snprintf(new_filename, sizeof(new_filename), "%s.new", filename);
+  if ((fp = gpopen(new_filename, "wb", use_compression)) == NULL)
   {
     fprintf(stderr, "cups-genppd: Unable to create file \"%s\" - %s.\n",
-            filename, strerror(errno));
+            new_filename, strerror(errno));
     return (2);
   }
 
   if (verbose)
     fprintf(stderr, "Writing %s...\n", filename);
 
-  snprintf(ppd_location, sizeof(ppd_location), "%s%s%s/%s",
-	   cups_modeldir,
-	   cups_modeldir[strlen(cups_modeldir) - 1] == '/' ? "" : "/",
-	   language ? language : "C",
-	   basename(filename));
-
-  snprintf(filename, sizeof(filename) - 1, "stp-%s.%s%s%s",
-	   stp_printer_get_driver(p), GUTENPRINT_RELEASE_VERSION,
-	   ppd_infix, ppdext);
-
   status = write_ppd(fp, p, language, ppd_location, ppd_type,
-		     basename(filename), use_compression);
+		     ppd_name, use_compression);
 
-  gpclose(fp, use_compression);
+  if (gpclose(fp, use_compression) != 0 && status == 0)
+  {
+    fprintf(stderr, "cups-genppd: Unable to write file \"%s\".\n",
+	    new_filename);
+    status = 2;
+  }
+  if (status == 0 && rename(new_filename, filename) != 0)
+  {
+    fprintf(stderr, "cups-genppd: Unable to rename \"%s\" - %s.\n",
+	    new_filename, strerror(errno));
+    status = 2;
+  }
+  if (status)
+    unlink(new_filename);
 
   return (status);
 }
@@ -497,7 +741,9 @@ help(void)
        "  -s            Generate simplified PPD files.\n"
        "  -a            Generate all (simplified and full) PPD files.\n"
        "  -q            Quiet mode.\n"
-       "  -v            Verbose mode.\n");
+       "  -v            Verbose mode.\n"
+       "  -j jobs       Generate PPD files in jobs processes (0 = one per CPU).\n"
+       "  -i            Only rewrite PPD files whose contents would change.\n");
   puts(
 #ifdef HAVE_LIBZ
        "  -z            Compress PPD files.\n"
@@ -519,7 +765,7 @@ void
 usage(void)
 {
   puts("Usage: cups-genppd "
-        "[-l locale] [-p prefix] [-s | -a] [-q] [-v] models...\n"
+        "[-l locale] [-p prefix] [-s | -a] [-q] [-v] [-j jobs] [-i] models...\n"
         "       cups-genppd -L\n"
 	"       cups-genppd -M [-v]\n"
 	"       cups-genppd -h\n"
@@ -624,3 +870,37 @@ gpclose(gpFile f, int use_compression)
 #endif
   return status;
 }
+
+/*
+ * 'read_ppd_digest()' - Read the digest recorded in an existing PPD file.
+ */
+
+static int				/* O - 1 if found, 0 otherwise */
+read_ppd_digest(const char *filename,	/* I - PPD file */
+		char       *digest)	/* O - Digest, PPD_DIGEST_SIZE bytes */
+{
+  char		line[1024];		/* Line from file */
+  int		found = 0;		/* Digest found? */
+#ifdef HAVE_LIBZ
+  gzFile	fp;			/* Reads uncompressed files too */
+
+  if ((fp = gzopen(filename, "rb")) == NULL)
+    return (0);
+  while (!found && gzgets(fp, line, sizeof(line)) &&
+	 strncmp(line, "*OpenUI", 7) != 0)
+#else
+  FILE		*fp;
+
+  if ((fp = fopen(filename, "rb")) == NULL)
+    return (0);
+  while (!found && fgets(line, sizeof(line), fp) &&
+	 strncmp(line, "*OpenUI", 7) != 0)
+#endif
+    found = sscanf(line, "*StpPPDDigest: \"%16[0-9a-f]\"", digest) == 1;
+#ifdef HAVE_LIBZ
+  gzclose(fp);
+#else
+  fclose(fp);
+#endif
+  return (found);
+}
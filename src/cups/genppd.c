@@ -25,6 +25,7 @@
  *   help()              - Show detailed help.
  *   is_special_option() - Determine if an option should be grouped.
  *   list_ppds()         - List the available drivers.
+ *   ppd_digest()        - Compute the digest of a PPD file.
  *   print_group_close() - Close a UI group.
  *   print_group_open()  - Open a new UI group.
  *   printlangs()        - Print list of available translations.
@@ -1183,6 +1184,343 @@ print_standard_fonts(gpFile fp)
   gpputs(fp, "*Font ZapfDingbats: Special \"(001.004S)\" Standard ROM\n");
 }
 
+/*
+ * PPD digests.
+ *
+ * The digest of a PPD file covers everything write_ppd() reads to
+ * produce it: the printer's defaults, the parameter descriptions, the
+ * paper sizes and resolutions, and the message catalogs, along with
+ * the options that change the output.  cups-genppd -i uses it to
+ * leave alone PPD files whose digest hasn't changed.
+ *
+ * Bump PPD_DIGEST_REVISION whenever write_ppd() changes what it writes
+ * for the same inputs within a release.
+ */
+
+#define PPD_DIGEST_REVISION "1"
+
+typedef unsigned long long ppd_digest_t;
+
+static void
+digest_bytes(ppd_digest_t *d, const void *data, size_t len)
+{
+  const unsigned char *s = data;
+  ppd_digest_t hash = *d;
+  while (len-- > 0)
+    {
+      hash ^= *s++;
+      hash *= 1099511628211ull;
+    }
+  *d = hash;
+}
+
+static void
+digest_int(ppd_digest_t *d, long long val)
+{
+  digest_bytes(d, &val, sizeof(val));
+}
+
+static void
+digest_double(ppd_digest_t *d, double val)
+{
+  digest_bytes(d, &val, sizeof(val));
+}
+
+static void
+digest_string(ppd_digest_t *d, const char *s)
+{
+  if (s)
+    digest_bytes(d, s, strlen(s) + 1);
+  else
+    digest_int(d, -1);
+}
+
+static void
+digest_string_list(ppd_digest_t *d, const stp_string_list_t *list)
+{
+  size_t count = list ? stp_string_list_count(list) : 0;
+  size_t i;
+  digest_int(d, count);
+  for (i = 0; i < count; i++)
+    {
+      const stp_param_string_t *opt = stp_string_list_param(list, i);
+      digest_string(d, opt->name);
+      digest_string(d, opt->text);
+    }
+}
+
+static void
+digest_parameter(ppd_digest_t *d, const stp_vars_t *v, const char *name)
+{
+  stp_parameter_t desc;
+
+  /* Drivers don't always fill in values that don't apply */
+  memset(&desc, 0, sizeof(desc));
+  stp_describe_parameter(v, name, &desc);
+  digest_string(d, name);
+  digest_string(d, desc.text);
+  digest_string(d, desc.category);
+  digest_string(d, desc.help);
+  digest_int(d, desc.p_type);
+  digest_int(d, desc.p_class);
+  digest_int(d, desc.p_level);
+  digest_int(d, desc.is_mandatory);
+  digest_int(d, desc.is_active);
+  digest_int(d, desc.channel);
+  digest_int(d, desc.read_only);
+  /* String lists are used even when inactive; other values aren't */
+  if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST)
+    {
+      digest_string_list(d, desc.bounds.str);
+      digest_string(d, desc.deflt.str);
+    }
+  else if (desc.is_active)
+    switch (desc.p_type)
+      {
+      case STP_PARAMETER_TYPE_INT:
+	digest_int(d, desc.bounds.integer.lower);
+	digest_int(d, desc.bounds.integer.upper);
+	digest_int(d, desc.deflt.integer);
+	break;
+      case STP_PARAMETER_TYPE_BOOLEAN:
+	digest_int(d, desc.deflt.boolean);
+	break;
+      case STP_PARAMETER_TYPE_DOUBLE:
+	digest_double(d, desc.bounds.dbl.lower);
+	digest_double(d, desc.bounds.dbl.upper);
+	digest_double(d, desc.deflt.dbl);
+	break;
+      case STP_PARAMETER_TYPE_DIMENSION:
+	digest_double(d, desc.bounds.dimension.lower);
+	digest_double(d, desc.bounds.dimension.upper);
+	digest_double(d, desc.deflt.dimension);
+	break;
+      default:
+	break;
+      }
+  stp_parameter_description_destroy(&desc);
+}
+
+/*
+ * The resolution that each choice of a Quality or Resolution
+ * parameter selects.
+ */
+
+static void
+digest_resolutions(ppd_digest_t *d, stp_vars_t *v, const char *name)
+{
+  stp_parameter_t desc;
+  stp_resolution_t xdpi, ydpi;
+  int i;
+
+  stp_describe_parameter(v, name, &desc);
+  if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST)
+    for (i = 0; i < stp_string_list_count(desc.bounds.str); i++)
+      {
+	xdpi = ydpi = 0;
+	stp_set_string_parameter(v, name,
+				 stp_string_list_param(desc.bounds.str, i)->name);
+	stp_describe_resolution(v, &xdpi, &ydpi);
+	digest_double(d, xdpi);
+	digest_double(d, ydpi);
+	stp_clear_string_parameter(v, name);
+      }
+  stp_parameter_description_destroy(&desc);
+}
+
+static void
+digest_page_sizes(ppd_digest_t *d, stp_vars_t *v)
+{
+  stp_parameter_t desc;
+  stp_dimension_t width, height, left, right, bottom, top;
+  int i;
+
+  stp_describe_parameter(v, "PageSize", &desc);
+  if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST)
+    for (i = 0; i < stp_string_list_count(desc.bounds.str); i++)
+      {
+	const char *name = stp_string_list_param(desc.bounds.str, i)->name;
+	const stp_papersize_t *papersize = stp_describe_papersize(v, name);
+	if (papersize)
+	  {
+	    digest_string(d, papersize->name);
+	    digest_string(d, papersize->text);
+	    digest_double(d, papersize->width);
+	    digest_double(d, papersize->height);
+	    digest_int(d, papersize->paper_unit);
+	  }
+	width = height = left = right = bottom = top = 0;
+	stp_set_string_parameter(v, "PageSize", name);
+	stp_get_media_size(v, &width, &height);
+	stp_get_maximum_imageable_area(v, &left, &right, &bottom, &top);
+	digest_double(d, width);
+	digest_double(d, height);
+	digest_double(d, left);
+	digest_double(d, right);
+	digest_double(d, bottom);
+	digest_double(d, top);
+	stp_clear_string_parameter(v, "PageSize");
+      }
+  stp_parameter_description_destroy(&desc);
+  width = height = left = right = 0;
+  stp_get_size_limit(v, &width, &height, &left, &right);
+  digest_double(d, width);
+  digest_double(d, height);
+  digest_double(d, left);
+  digest_double(d, right);
+}
+
+/*
+ * The message catalogs are the same for every PPD file, so only digest
+ * them once for each language.
+ */
+
+static ppd_digest_t
+catalog_digest(const char *language)
+{
+  static char *cached_language = NULL;
+  static int cached = 0;
+  static ppd_digest_t cached_digest;
+  char **all_langs = getlangs();
+  ppd_digest_t d = 14695981039346656037ull;
+  int i;
+
+  if (cached && (language == cached_language ||
+		 (language && cached_language &&
+		  strcmp(language, cached_language) == 0)))
+    return cached_digest;
+
+  digest_string(&d, language);
+  if (language)
+    digest_string_list(&d, stp_i18n_load(language));
+  else
+    for (i = 0; all_langs[i]; i++)
+      {
+	digest_string(&d, all_langs[i]);
+	digest_string_list(&d, stp_i18n_load(all_langs[i]));
+      }
+
+  if (cached_language)
+    stp_free(cached_language);
+  cached_language = language ? stp_strdup(language) : NULL;
+  cached_digest = d;
+  cached = 1;
+  return d;
+}
+
+/*
+ * The digest of everything the driver says about a printer.  This is
+ * the same for every type of PPD file, and cups-genppd generates those
+ * one after the other, so remember the last one.
+ */
+
+static ppd_digest_t
+model_digest(const stp_printer_t *p)
+{
+  static const stp_printer_t *cached_printer = NULL;
+  static ppd_digest_t cached_digest;
+  ppd_digest_t	d = 14695981039346656037ull;
+  const char	*driver = stp_printer_get_driver(p);
+  stp_vars_t	*v;
+  stp_parameter_list_t param_list;
+  stp_parameter_t desc;
+  size_t	i;
+
+  if (p == cached_printer)
+    return cached_digest;
+
+  digest_string(&d, driver);
+  digest_string(&d, stp_printer_get_family(p));
+  digest_string(&d, stp_printer_get_long_name(p));
+  digest_string(&d, stp_printer_get_manufacturer(p));
+  digest_string(&d, stp_printer_get_device_id(p));
+  digest_int(&d, stp_printer_get_model(p));
+  digest_int(&d, stp_get_printer_index_by_driver(driver));
+  digest_int(&d, stp_printer_model_count());
+
+ /*
+  * Describe the parameters in the same settings as write_ppd() does.
+  */
+
+  v = stp_vars_create_copy(stp_printer_get_defaults(p));
+  stp_set_string_parameter(v, "JobMode", "Job");
+  digest_parameter(&d, v, "PrintingMode");
+  digest_parameter(&d, v, "NativeCopies");
+  digest_parameter(&d, v, "CommandFilterName");
+  digest_parameter(&d, v, "CommandFilterCommands");
+
+  stp_describe_parameter(v, "PrintingMode", &desc);
+  if (desc.p_type == STP_PARAMETER_TYPE_STRING_LIST &&
+      stp_string_list_is_present(desc.bounds.str, "Color"))
+    stp_set_string_parameter(v, "PrintingMode", "Color");
+  else
+    stp_set_string_parameter(v, "PrintingMode", "BW");
+  stp_parameter_description_destroy(&desc);
+  stp_set_string_parameter(v, "ChannelBitDepth", "8");
+
+ /*
+  * Only the parameters that can appear in a PPD file; internal ones
+  * show up through the page sizes and resolutions.
+  */
+
+  param_list = stp_get_parameter_list(v);
+  for (i = 0; i < stp_parameter_list_count(param_list); i++)
+    {
+      const stp_parameter_t *lparam = stp_parameter_list_param(param_list, i);
+      if (lparam->p_class > STP_PARAMETER_CLASS_OUTPUT ||
+	  lparam->p_level > STP_PARAMETER_LEVEL_ADVANCED4 ||
+	  (lparam->p_type != STP_PARAMETER_TYPE_STRING_LIST &&
+	   lparam->p_type != STP_PARAMETER_TYPE_RAW &&
+	   lparam->p_type != STP_PARAMETER_TYPE_BOOLEAN &&
+	   lparam->p_type != STP_PARAMETER_TYPE_DIMENSION &&
+	   lparam->p_type != STP_PARAMETER_TYPE_INT &&
+	   lparam->p_type != STP_PARAMETER_TYPE_DOUBLE))
+	continue;
+      digest_parameter(&d, v, lparam->name);
+    }
+  stp_parameter_list_destroy(param_list);
+
+  digest_page_sizes(&d, v);
+  digest_resolutions(&d, v, "Quality");
+  digest_resolutions(&d, v, "Resolution");
+  stp_vars_destroy(v);
+
+  cached_printer = p;
+  cached_digest = d;
+  return d;
+}
+
+/*
+ * 'ppd_digest()' - Compute the digest of a PPD file.
+ */
+
+void
+ppd_digest(
+    char                *digest,	/* O - Digest, PPD_DIGEST_SIZE bytes */
+    const stp_printer_t *p,		/* I - Printer driver */
+    const char          *language,	/* I - Primary language */
+    const char		*ppd_location,	/* I - Location of PPD file */
+    ppd_type_t          ppd_type,	/* I - 1 = simplified options */
+    const char		*filename)	/* I - input filename */
+{
+  ppd_digest_t	d = 14695981039346656037ull;
+
+  digest_string(&d, PPD_DIGEST_REVISION);
+  digest_string(&d, use_base_version ? BASE_VERSION : VERSION);
+  digest_string(&d, GUTENPRINT_RELEASE_VERSION);
+  digest_string(&d, CUPS_PPD_NICKNAME_STRING);
+  digest_int(&d, cups_ppd_ps_level);
+  digest_int(&d, localize_numbers);
+  digest_int(&d, ppd_type);
+  digest_string(&d, language);
+  digest_string(&d, ppd_location);
+  digest_string(&d, filename);
+  digest_int(&d, catalog_digest(language));
+  digest_int(&d, model_digest(p));
+
+  snprintf(digest, PPD_DIGEST_SIZE, "%016llx", d);
+}
+
 /*
  * 'write_ppd()' - Write a PPD file.
  */
@@ -1221,6 +1559,7 @@ write_ppd(
   char		*default_resolution = NULL;  /* Default resolution mapped name */
   stp_string_list_t *resolutions = stp_string_list_create();
   char		**all_langs = getlangs();/* All languages */
+  char		digest[PPD_DIGEST_SIZE];	/* Digest of the inputs */
   const stp_string_list_t	*po = stp_i18n_load(language);
 					/* Message catalog */
 
@@ -1322,6 +1661,8 @@ write_ppd(
 
   gpputs(fp, "\n");
 
+  ppd_digest(digest, p, language, ppd_location, ppd_type, filename);
+  gpprintf(fp, "*StpPPDDigest: \"%s\"\n", digest);
   print_ppd_header_2(fp, ppd_type, model, driver, family, long_name,
 		     manufacturer, device_id, ppd_location, language, po,
 		     all_langs);
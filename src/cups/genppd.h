@@ -85,6 +85,11 @@ extern int cups_ppd_ps_level;
 extern int localize_numbers;
 extern int use_base_version;
 
+#define PPD_DIGEST_SIZE (17)	/* 16 hex digits */
+
+extern void	ppd_digest(char *digest, const stp_printer_t *p,
+			   const char *language, const char *ppd_location,
+			   ppd_type_t ppd_type, const char *filename);
 extern int	write_ppd(gpFile fp, const stp_printer_t *p,
 		          const char *language, const char *ppd_location,
 			  ppd_type_t ppd_type, const char *filename,
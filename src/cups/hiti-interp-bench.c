@@ -0,0 +1,496 @@
+/*
+ *   Benchmark for the HiTi color correction LUT
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>.
+ *
+ *   SPDX-License-Identifier: GPL-2.0+
+ *
+ */
+
+/*
+ * Feeds a synthetic BGR image through hiti_interp33_256_rows() and
+ * through the per-pixel code it replaced, which is kept below, and
+ * checks that both give the same output.  Every one of the 2^24 input
+ * colours is checked as well.
+ *
+ * Usage: hiti-interp-bench [cols rows [iterations [threads]]]
+ *
+ * With no arguments nothing is timed; a few small images of odd sizes
+ * are checked, with one thread and with several, and then every colour.
+ * This is what "make check" runs.  For timings, give a size; a 6x8
+ * print on a P52x/P72x is 1844 2492.
+ */
+
+#if defined(HAVE_CONFIG_H)
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "backend_hiti_interp.h"
+
+/*
+ * The code this replaced.
+ */
+
+struct rgb {
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+};
+
+static uint32_t interp1089[33];
+static uint32_t interp33[33];
+static uint16_t interp256[256*9];
+
+static void hiti_interp_init(void)
+{
+	int i;
+	uint16_t *pre, *cur;
+
+	for (i = 0 ; i < 33 ; i++) {
+		interp1089[i] = i * 1089;
+		interp33[i] = i * 33;
+	}
+	memset(interp256, 0, sizeof(interp256));
+	pre = &interp256[0];
+	cur = &interp256[256];
+
+	for (i = 1 ; i < 9 ; i++) {
+		int j;
+		for (j = 0 ; j < 256 ; j++) {
+			cur[j] = pre[j] + j;
+		};
+		pre += 256;
+		cur += 256;
+	}
+}
+
+/* src and dst are RGB tuples */
+static void hiti_interp33_256(uint8_t *dst, const uint8_t *src, const uint8_t *pTable)
+{
+	struct rgb p1_pos, p2_pos, p3_pos, p4_pos;
+	struct rgb p1_val, p2_val, p3_val, p4_val;
+	uint8_t r_weight, g_weight, b_weight;
+	uint16_t w1, w2, w3, w4;
+	uint16_t *pw1, *pw2, *pw3, *pw4;
+	uint32_t pos;
+
+	/* Get Grid position */
+	p1_pos.r = src[0] >> 3;
+	p1_pos.g = src[1] >> 3;
+	p1_pos.b = src[2] >> 3;
+
+	p4_pos.r = p1_pos.r + 1;
+	p4_pos.g = p1_pos.g + 1;
+	p4_pos.b = p1_pos.b + 1;
+
+	/* Weights */
+	if (src[0] == 255)
+		r_weight = 8;
+	else
+		r_weight = src[0] & 0x7;
+
+	if (src[1] == 255)
+		g_weight = 8;
+	else
+		g_weight = src[1] & 0x7;
+
+	if (src[2] == 255)
+		b_weight = 8;
+	else
+		b_weight = src[2] & 0x7;
+
+	/* Work out relative weights and offsets */
+	if (r_weight >= g_weight) {
+		if (g_weight >= b_weight) { /* R > G > B */
+			w1 = 8 - r_weight;
+			w2 = r_weight - g_weight;
+			w3 = g_weight - b_weight;
+			w4 = b_weight;
+			p2_pos.r = p1_pos.r + 1;
+			p2_pos.g = p1_pos.g;
+			p2_pos.b = p1_pos.b;
+			p3_pos.r = p1_pos.r + 1;
+			p3_pos.g = p1_pos.g + 1;
+			p3_pos.b = p1_pos.b;
+		} else {
+			if (r_weight >= b_weight) { /* R > B > G */
+				w1 = 8 - r_weight;
+				w2 = r_weight - b_weight;
+				w3 = b_weight - g_weight;
+				w4 = g_weight;
+				p2_pos.r = p1_pos.r + 1;
+				p2_pos.g = p1_pos.g;
+				p2_pos.b = p1_pos.b;
+				p3_pos.r = p1_pos.r + 1;
+				p3_pos.g = p1_pos.g;
+				p3_pos.b = p1_pos.b + 1;
+			} else { /* B > R > G */
+				w1 = 8 - b_weight;
+				w2 = b_weight - r_weight;
+				w3 = r_weight - g_weight;
+				w4 = g_weight;
+				p2_pos.r = p1_pos.r;
+				p2_pos.g = p1_pos.g;
+				p2_pos.b = p1_pos.b + 1;
+				p3_pos.r = p1_pos.r + 1;
+				p3_pos.g = p1_pos.g;
+				p3_pos.b = p1_pos.b + 1;
+			}
+		}
+	} else {
+		if (r_weight >= b_weight) { /* G > R > B */
+			w1 = 8 - g_weight;
+			w2 = g_weight - r_weight;
+			w3 = r_weight - b_weight;
+			w4 = b_weight;
+			p2_pos.r = p1_pos.r;
+			p2_pos.g = p1_pos.g + 1;
+			p2_pos.b = p1_pos.b;
+			p3_pos.r = p1_pos.r + 1;
+			p3_pos.g = p1_pos.g + 1;
+			p3_pos.b = p1_pos.b;
+		} else {
+			if (g_weight >= b_weight) { /* G > B > R */
+				w1 = 8 - g_weight;
+				w2 = g_weight - b_weight;
+				w3 = b_weight - r_weight;
+				w4 = r_weight;
+				p2_pos.r = p1_pos.r;
+				p2_pos.g = p1_pos.g + 1;
+				p2_pos.b = p1_pos.b;
+				p3_pos.r = p1_pos.r;
+				p3_pos.g = p1_pos.g + 1;
+				p3_pos.b = p1_pos.b + 1;
+			} else { /* B > G > R */
+				w1 = 8 - b_weight;
+				w2 = b_weight - g_weight;
+				w3 = g_weight - r_weight;
+				w4 = r_weight;
+				p2_pos.r = p1_pos.r;
+				p2_pos.g = p1_pos.g;
+				p2_pos.b = p1_pos.b + 1;
+				p3_pos.r = p1_pos.r;
+				p3_pos.g = p1_pos.g + 1;
+				p3_pos.b = p1_pos.b + 1;
+			}
+		}
+	}
+
+	/* Work out values */
+	pos = (interp1089[p1_pos.b] + interp33[p1_pos.g] + p1_pos.r) * 3;
+	p1_val.r = pTable[pos];
+	p1_val.g = pTable[pos + 1];
+	p1_val.b = pTable[pos + 2];
+	pos = (interp1089[p2_pos.b] + interp33[p2_pos.g] + p2_pos.r) * 3;
+	p2_val.r = pTable[pos];
+	p2_val.g = pTable[pos + 1];
+	p2_val.b = pTable[pos + 2];
+	pos = (interp1089[p3_pos.b] + interp33[p3_pos.g] + p3_pos.r) * 3;
+	p3_val.r = pTable[pos];
+	p3_val.g = pTable[pos + 1];
+	p3_val.b = pTable[pos + 2];
+	pos = (interp1089[p4_pos.b] + interp33[p4_pos.g] + p4_pos.r) * 3;
+	p4_val.r = pTable[pos];
+	p4_val.g = pTable[pos + 1];
+	p4_val.b = pTable[pos + 2];
+
+	/* Final offsets into interpolation table */
+	pw1 = &interp256[w1 << 8];
+	pw2 = &interp256[w2 << 8];
+	pw3 = &interp256[w3 << 8];
+	pw4 = &interp256[w4 << 8];
+
+	/* And at long last.. final values */
+	dst[0] = (pw1[p1_val.r] + pw2[p2_val.r] + pw3[p3_val.r] + pw4[p4_val.r]) >> 3;
+	dst[1] = (pw1[p1_val.g] + pw2[p2_val.g] + pw3[p3_val.g] + pw4[p4_val.g]) >> 3;
+	dst[2] = (pw1[p1_val.b] + pw2[p2_val.b] + pw3[p3_val.b] + pw4[p4_val.b]) >> 3;
+
+}
+
+
+static void ref_image(uint8_t *data, const uint8_t *pTable,
+		      uint32_t cols, uint32_t rows)
+{
+	uint32_t i, j;
+
+	for (i = 0 ; i < rows ; i++) {
+		/* Simple optimization */
+		uint8_t oldrgb[3] = { 255, 255, 255 };
+		uint8_t destrgb[3];
+
+		hiti_interp33_256(destrgb, oldrgb, pTable);
+
+		for (j = 0 ; j < cols ; j++) {
+			uint8_t *p = data + (cols * i + j) * 3;
+			uint8_t rgb[3];
+
+			/* Input data is BGR */
+			rgb[2] = p[0];
+			rgb[1] = p[1];
+			rgb[0] = p[2];
+
+			if (rgb[0] == oldrgb[0] &&
+			    rgb[1] == oldrgb[1] &&
+			    rgb[2] == oldrgb[2]) {
+				rgb[0] = destrgb[0];
+				rgb[1] = destrgb[1];
+				rgb[2] = destrgb[2];
+			} else {
+				oldrgb[0] = rgb[0];
+				oldrgb[1] = rgb[1];
+				oldrgb[2] = rgb[2];
+				hiti_interp33_256(rgb, rgb, pTable);
+				destrgb[0] = rgb[0];
+				destrgb[1] = rgb[1];
+				destrgb[2] = rgb[2];
+			}
+
+			p[0] = rgb[2];
+			p[1] = rgb[1];
+			p[2] = rgb[0];
+		}
+	}
+}
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* A smooth, slightly off-neutral curve with some noise, roughly what the
+   real correction tables look like. */
+static void make_table(uint8_t *table)
+{
+	int r, g, b;
+
+	for (b = 0 ; b < HITI_INTERP_GRID ; b++) {
+		for (g = 0 ; g < HITI_INTERP_GRID ; g++) {
+			for (r = 0 ; r < HITI_INTERP_GRID ; r++) {
+				int v[3] = { r * 8 - g / 2, g * 8 - b / 3, b * 8 - r / 4 };
+				int c;
+				for (c = 0 ; c < 3 ; c++) {
+					v[c] += rand() % 7 - 3;
+					if (v[c] < 0)
+						v[c] = 0;
+					if (v[c] > 255)
+						v[c] = 255;
+					*table++ = v[c];
+				}
+			}
+		}
+	}
+}
+
+/* Gradients, flat areas and noise */
+static void make_image(uint8_t *data, uint32_t cols, uint32_t rows)
+{
+	uint32_t i, j;
+
+	for (i = 0 ; i < rows ; i++) {
+		for (j = 0 ; j < cols ; j++) {
+			uint8_t *p = data + (cols * i + j) * 3;
+			if (i < rows / 4) {
+				p[0] = p[1] = p[2] = 255;
+			} else if (j < cols / 2) {
+				p[0] = j * 255 / cols;
+				p[1] = i * 255 / rows;
+				p[2] = (i + j) & 0xff;
+			} else {
+				p[0] = rand();
+				p[1] = rand();
+				p[2] = rand();
+			}
+		}
+	}
+}
+
+/* Runs one synthetic image through both, with the given thread count */
+static int check_image(const uint8_t *table, uint32_t cols, uint32_t rows,
+		       int threads)
+{
+	size_t len = (size_t)cols * rows * 3;
+	uint8_t *ref = malloc(len);
+	uint8_t *out = malloc(len);
+	struct hiti_interp *interp;
+	int ok;
+
+	if (!ref || !out) {
+		fprintf(stderr, "Memory allocation failure\n");
+		free(ref);
+		free(out);
+		return 0;
+	}
+	make_image(ref, cols, rows);
+	memcpy(out, ref, len);
+	ref_image(ref, table, cols, rows);
+	interp = hiti_interp_create(table);
+	hiti_interp33_256_rows(interp, out, cols, rows, cols * 3, 1, threads);
+	hiti_interp_destroy(interp);
+	ok = !memcmp(ref, out, len);
+	if (!ok)
+		fprintf(stderr, "Output mismatch in %ux%u image, %d threads\n",
+			cols, rows, threads);
+	free(ref);
+	free(out);
+	return ok;
+}
+
+/* Every colour, as a 4096x4096 image */
+static int check_all_colours(const uint8_t *table, int threads)
+{
+	size_t len = 4096 * 4096 * 3;
+	uint8_t *ref = malloc(len);
+	uint8_t *out = malloc(len);
+	struct hiti_interp *interp;
+	uint32_t i;
+	int ok;
+
+	if (!ref || !out) {
+		fprintf(stderr, "Memory allocation failure\n");
+		free(ref);
+		free(out);
+		return 0;
+	}
+	for (i = 0 ; i < 4096 * 4096 ; i++) {
+		ref[i * 3] = i;
+		ref[i * 3 + 1] = i >> 8;
+		ref[i * 3 + 2] = i >> 16;
+	}
+	memcpy(out, ref, len);
+	ref_image(ref, table, 4096, 4096);
+	interp = hiti_interp_create(table);
+	hiti_interp33_256_rows(interp, out, 4096, 4096, 4096 * 3, 1, threads);
+	hiti_interp_destroy(interp);
+	ok = !memcmp(ref, out, len);
+	if (!ok)
+		fprintf(stderr, "Output mismatch over all colours\n");
+	free(ref);
+	free(out);
+	return ok;
+}
+
+/* Odd sizes, so that rows split unevenly across threads */
+static const uint32_t check_sizes[][2] = {
+	{ 1, 1 }, { 3, 2 }, { 17, 5 }, { 97, 61 }, { 1844, 7 },
+};
+
+int main(int argc, char **argv)
+{
+	uint32_t cols = 1844, rows = 2492;
+	int iterations = 10, threads = 0;
+	uint8_t *table, *image, *ref, *out;
+	struct hiti_interp *interp;
+	size_t len;
+	double t, t_ref = 0, t_new = 0;
+	uint32_t i;
+	int iter, errors = 0;
+
+	if (argc > 1 && argc < 3) {
+		fprintf(stderr, "Usage: %s [cols rows [iterations [threads]]]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 2) {
+		cols = atoi(argv[1]);
+		rows = atoi(argv[2]);
+	}
+	if (argc > 3)
+		iterations = atoi(argv[3]);
+	if (argc > 4)
+		threads = atoi(argv[4]);
+	if (!cols || !rows || iterations < 1) {
+		fprintf(stderr, "Usage: %s [cols rows [iterations [threads]]]\n", argv[0]);
+		return 1;
+	}
+
+	srand(1);
+	table = malloc(HITI_INTERP_LEN);
+	if (!table) {
+		fprintf(stderr, "Memory allocation failure\n");
+		return 1;
+	}
+	make_table(table);
+	hiti_interp_init();
+
+	/* With no arguments, just check the output; this is what
+	   "make check" runs. */
+	if (argc == 1) {
+		for (i = 0 ; i < sizeof(check_sizes) / sizeof(check_sizes[0]) ; i++) {
+			if (!check_image(table, check_sizes[i][0], check_sizes[i][1], 1))
+				errors++;
+			if (!check_image(table, check_sizes[i][0], check_sizes[i][1], 3))
+				errors++;
+		}
+		if (!check_all_colours(table, 0))
+			errors++;
+		free(table);
+		if (errors)
+			return 1;
+		printf("All outputs match\n");
+		return 0;
+	}
+
+	len = (size_t)cols * rows * 3;
+	image = malloc(len);
+	ref = malloc(len);
+	out = malloc(len);
+	if (!image || !ref || !out) {
+		fprintf(stderr, "Memory allocation failure\n");
+		return 1;
+	}
+	make_image(image, cols, rows);
+
+	for (iter = 0 ; iter < iterations ; iter++) {
+		memcpy(ref, image, len);
+		t = now();
+		ref_image(ref, table, cols, rows);
+		t_ref += now() - t;
+
+		memcpy(out, image, len);
+		t = now();
+		interp = hiti_interp_create(table);
+		hiti_interp33_256_rows(interp, out, cols, rows, cols * 3, 1, threads);
+		hiti_interp_destroy(interp);
+		t_new += now() - t;
+
+		if (memcmp(ref, out, len)) {
+			fprintf(stderr, "Output mismatch in synthetic image\n");
+			errors++;
+			break;
+		}
+	}
+
+	printf("%ux%u, %d iterations\n", cols, rows, iterations);
+	printf("  per pixel: %8.2f ms/image\n", t_ref * 1000 / iterations);
+	printf("  rows:      %8.2f ms/image (%.2fx)\n", t_new * 1000 / iterations,
+	       t_new > 0 ? t_ref / t_new : 0);
+
+	free(image);
+	free(ref);
+	free(out);
+	if (!check_all_colours(table, threads))
+		errors++;
+	free(table);
+
+	if (errors)
+		return 1;
+	printf("All outputs match\n");
+	return 0;
+}
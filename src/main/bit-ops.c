@@ -34,47 +34,242 @@
 #include <limits.h>
 #endif
 
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
 #ifdef __GNUC__
 #define inline __inline__
 #define NOINLINE __attribute__ ((noinline))
 #else
-$define NOINLINE
+#define NOINLINE
 #endif
 
+/*
+ * BIT_TABLE_8(0, b0, ... b7) expands to the 256 entries of a table
+ * indexed by a byte, each entry being the sum of b<i> for every bit i
+ * set in its index.  That lets the tables below be built by the
+ * compiler rather than at run time.
+ */
+#define BIT_TABLE_1(n, b0) (n), (n) + (b0)
+#define BIT_TABLE_2(n, b0, b1)						\
+  BIT_TABLE_1(n, b0), BIT_TABLE_1((n) + (b1), b0)
+#define BIT_TABLE_3(n, b0, b1, b2)					\
+  BIT_TABLE_2(n, b0, b1), BIT_TABLE_2((n) + (b2), b0, b1)
+#define BIT_TABLE_4(n, b0, b1, b2, b3)					\
+  BIT_TABLE_3(n, b0, b1, b2), BIT_TABLE_3((n) + (b3), b0, b1, b2)
+#define BIT_TABLE_5(n, b0, b1, b2, b3, b4)				\
+  BIT_TABLE_4(n, b0, b1, b2, b3), BIT_TABLE_4((n) + (b4), b0, b1, b2, b3)
+#define BIT_TABLE_6(n, b0, b1, b2, b3, b4, b5)				\
+  BIT_TABLE_5(n, b0, b1, b2, b3, b4),					\
+  BIT_TABLE_5((n) + (b5), b0, b1, b2, b3, b4)
+#define BIT_TABLE_7(n, b0, b1, b2, b3, b4, b5, b6)			\
+  BIT_TABLE_6(n, b0, b1, b2, b3, b4, b5),				\
+  BIT_TABLE_6((n) + (b6), b0, b1, b2, b3, b4, b5)
+#define BIT_TABLE_8(n, b0, b1, b2, b3, b4, b5, b6, b7)			\
+  BIT_TABLE_7(n, b0, b1, b2, b3, b4, b5, b6),				\
+  BIT_TABLE_7((n) + (b7), b0, b1, b2, b3, b4, b5, b6)
+
+#define SPREAD(k) BIT_TABLE_8(0, 1ull << (0 * (k)), 1ull << (1 * (k)),	\
+			      1ull << (2 * (k)), 1ull << (3 * (k)),	\
+			      1ull << (4 * (k)), 1ull << (5 * (k)),	\
+			      1ull << (6 * (k)), 1ull << (7 * (k)))
+
+/*
+ * spread_<k>[x] has bit i of x moved to bit i * k.  Folding k planes
+ * is then one lookup per plane, shifted by the plane number and ORed
+ * together.  spread_8 is also an 8x8 bit transpose, which is what the
+ * 1-bit unpackers use.
+ */
+static const unsigned short spread_2[256] = { SPREAD(2) };
+static const unsigned spread_3[256] = { SPREAD(3) };
+static const unsigned spread_4[256] = { SPREAD(4) };
+static const unsigned long long spread_8[256] = { SPREAD(8) };
+
+/*
+ * The four 2-bit fields of x, each moved to the bottom of its own byte.
+ */
+static const unsigned spread_2x4[256] =
+  { BIT_TABLE_8(0, 0x1, 0x2, 0x100, 0x200,
+		0x10000, 0x20000, 0x1000000, 0x2000000) };
+
+/*
+ * Bits 7, 5, 3 and 1 of x in the high nibble, and bits 6, 4, 2 and 0
+ * in the low nibble.
+ */
+static const unsigned char unshuffle_2[256] =
+  { BIT_TABLE_8(0, 0x01, 0x10, 0x02, 0x20, 0x04, 0x40, 0x08, 0x80) };
+
+/*
+ * Vector folds.  PSHUFB (or TBL) spreads the bits of each nibble of
+ * sixteen bytes at a time; the rest is shifts and interleaves.  Each
+ * returns how many columns it did, leaving the rest to the table code.
+ */
+
+#ifdef HAVE_X86_SIMD
+
+#define SSE41 __attribute__((target("sse4.1")))
+
+/*
+ * Spread the bits of the high and low nibbles of each byte of v by
+ * looking them up in table.
+ */
+static inline SSE41 void
+sse41_spread_nibbles(__m128i v, __m128i table, __m128i *hi, __m128i *lo)
+{
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  *hi = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+  *lo = _mm_shuffle_epi8(table, _mm_and_si128(v, nibble));
+}
+
+/*
+ * Interleave the bits of a and b, as stp_fold does: the high nibbles
+ * go to *hi and the low nibbles to *lo, with the bits of b above those
+ * of a.
+ */
+static inline SSE41 void
+sse41_fold_2(__m128i a, __m128i b, __m128i *hi, __m128i *lo)
+{
+  const __m128i spread =
+    _mm_setr_epi8(0x00, 0x01, 0x04, 0x05, 0x10, 0x11, 0x14, 0x15,
+		  0x40, 0x41, 0x44, 0x45, 0x50, 0x51, 0x54, 0x55);
+  __m128i ahi, alo, bhi, blo;
+  sse41_spread_nibbles(a, spread, &ahi, &alo);
+  sse41_spread_nibbles(b, spread, &bhi, &blo);
+  *hi = _mm_or_si128(ahi, _mm_add_epi8(bhi, bhi));
+  *lo = _mm_or_si128(alo, _mm_add_epi8(blo, blo));
+}
+
+static SSE41 int
+sse41_fold(const unsigned char *line, int single_length,
+	   unsigned char *outbuf)
+{
+  int i;
+  for (i = 0; i + 16 <= single_length; i += 16)
+    {
+      __m128i hi, lo;
+      sse41_fold_2(_mm_loadu_si128((const __m128i *) (line + i)),
+		   _mm_loadu_si128((const __m128i *)
+				   (line + single_length + i)),
+		   &hi, &lo);
+      _mm_storeu_si128((__m128i *) (outbuf + 2 * i),
+		       _mm_unpacklo_epi8(hi, lo));
+      _mm_storeu_si128((__m128i *) (outbuf + 2 * i + 16),
+		       _mm_unpackhi_epi8(hi, lo));
+    }
+  return i;
+}
+
+/*
+ * Fold A with B and C with D, then interleave those 2 bits at a time:
+ * B7 A7 B6 A6 and D7 C7 D6 C6 make D7 C7 B7 A7 D6 C6 B6 A6.
+ */
+static SSE41 int
+sse41_fold_4bit(const unsigned char *line, int single_length,
+		unsigned char *outbuf)
+{
+  const __m128i spread =
+    _mm_setr_epi8(0x00, 0x01, 0x02, 0x03, 0x10, 0x11, 0x12, 0x13,
+		  0x20, 0x21, 0x22, 0x23, 0x30, 0x31, 0x32, 0x33);
+  int i;
+  for (i = 0; i + 16 <= single_length; i += 16)
+    {
+      __m128i abhi, ablo, cdhi, cdlo, ab, cd, o0, o1, o2, o3, t0, t1;
+      sse41_fold_2(_mm_loadu_si128((const __m128i *) (line + i)),
+		   _mm_loadu_si128((const __m128i *)
+				   (line + single_length + i)),
+		   &abhi, &ablo);
+      sse41_fold_2(_mm_loadu_si128((const __m128i *)
+				   (line + single_length * 2 + i)),
+		   _mm_loadu_si128((const __m128i *)
+				   (line + single_length * 3 + i)),
+		   &cdhi, &cdlo);
+      sse41_spread_nibbles(abhi, spread, &o0, &o1);
+      sse41_spread_nibbles(cdhi, spread, &cd, &t0);
+      o0 = _mm_or_si128(o0, _mm_slli_epi16(cd, 2));
+      o1 = _mm_or_si128(o1, _mm_slli_epi16(t0, 2));
+      sse41_spread_nibbles(ablo, spread, &o2, &o3);
+      sse41_spread_nibbles(cdlo, spread, &cd, &t0);
+      o2 = _mm_or_si128(o2, _mm_slli_epi16(cd, 2));
+      o3 = _mm_or_si128(o3, _mm_slli_epi16(t0, 2));
+
+      ab = _mm_unpacklo_epi8(o0, o1);
+      cd = _mm_unpacklo_epi8(o2, o3);
+      t0 = _mm_unpackhi_epi8(o0, o1);
+      t1 = _mm_unpackhi_epi8(o2, o3);
+      _mm_storeu_si128((__m128i *) (outbuf + 4 * i),
+		       _mm_unpacklo_epi16(ab, cd));
+      _mm_storeu_si128((__m128i *) (outbuf + 4 * i + 16),
+		       _mm_unpackhi_epi16(ab, cd));
+      _mm_storeu_si128((__m128i *) (outbuf + 4 * i + 32),
+		       _mm_unpacklo_epi16(t0, t1));
+      _mm_storeu_si128((__m128i *) (outbuf + 4 * i + 48),
+		       _mm_unpackhi_epi16(t0, t1));
+    }
+  return i;
+}
+
+#endif /* HAVE_X86_SIMD */
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+
+static inline void
+neon_fold_2(uint8x16_t a, uint8x16_t b, uint8x16_t *hi, uint8x16_t *lo)
+{
+  static const unsigned char spread_nibble[16] =
+    { 0x00, 0x01, 0x04, 0x05, 0x10, 0x11, 0x14, 0x15,
+      0x40, 0x41, 0x44, 0x45, 0x50, 0x51, 0x54, 0x55 };
+  const uint8x16_t spread = vld1q_u8(spread_nibble);
+  const uint8x16_t nibble = vdupq_n_u8(0x0f);
+  *hi = vorrq_u8(vqtbl1q_u8(spread, vshrq_n_u8(a, 4)),
+		 vshlq_n_u8(vqtbl1q_u8(spread, vshrq_n_u8(b, 4)), 1));
+  *lo = vorrq_u8(vqtbl1q_u8(spread, vandq_u8(a, nibble)),
+		 vshlq_n_u8(vqtbl1q_u8(spread, vandq_u8(b, nibble)), 1));
+}
+
+static int
+neon_fold(const unsigned char *line, int single_length,
+	  unsigned char *outbuf)
+{
+  int i;
+  for (i = 0; i + 16 <= single_length; i += 16)
+    {
+      uint8x16x2_t out;
+      neon_fold_2(vld1q_u8(line + i), vld1q_u8(line + single_length + i),
+		  &out.val[0], &out.val[1]);
+      vst2q_u8(outbuf + 2 * i, out);
+    }
+  return i;
+}
+
+#endif /* __ARM_NEON && __aarch64__ */
+
 void
 stp_fold(const unsigned char *line,
 	 int single_length,
 	 unsigned char *outbuf)
 {
-  int i;
-  memset(outbuf, 0, single_length * 2);
-  for (i = 0; i < single_length; i++)
+  int i = 0;
+#ifdef HAVE_X86_SIMD
+  if (stpi_cpu_features() & STPI_CPU_SSE41)
+    i = sse41_fold(line, single_length, outbuf);
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+  if (stpi_cpu_features() & STPI_CPU_NEON)
+    i = neon_fold(line, single_length, outbuf);
+#endif
+  for (; i < single_length; i++)
     {
-      unsigned char l0 = line[0];
-      unsigned char l1 = line[single_length];
-      if (l0 || l1)
-	{
-	  outbuf[0] =		/* B7 A7 B6 A6 B5 A5 B4 A4 */
-	    ((l0 & (1 << 7)) >> 1) +
-	    ((l0 & (1 << 6)) >> 2) +
-	    ((l0 & (1 << 5)) >> 3) +
-	    ((l0 & (1 << 4)) >> 4) +
-	    ((l1 & (1 << 7)) >> 0) +
-	    ((l1 & (1 << 6)) >> 1) +
-	    ((l1 & (1 << 5)) >> 2) +
-	    ((l1 & (1 << 4)) >> 3);
-	  outbuf[1] =		/* B3 A3 B2 A2 B1 A1 B0 A0 */
-	    ((l0 & (1 << 3)) << 3) +
-	    ((l0 & (1 << 2)) << 2) +
-	    ((l0 & (1 << 1)) << 1) +
-	    ((l0 & (1 << 0)) << 0) +
-	    ((l1 & (1 << 3)) << 4) +
-	    ((l1 & (1 << 2)) << 3) +
-	    ((l1 & (1 << 1)) << 2) +
-	    ((l1 & (1 << 0)) << 1);
-	}
-      line++;
-      outbuf += 2;
+      /* B7 A7 B6 A6 B5 A5 B4 A4 B3 A3 B2 A2 B1 A1 B0 A0 */
+      unsigned v =
+	spread_2[line[i]] | (spread_2[line[single_length + i]] << 1);
+      outbuf[2 * i] = v >> 8;
+      outbuf[2 * i + 1] = v & 0xff;
     }
 }
 
@@ -84,45 +279,17 @@ stp_fold_3bit(const unsigned char *line,
                 unsigned char *outbuf)
 {
   int i;
-  memset(outbuf, 0, single_length * 3);
   for (i = 0; i < single_length; i++)
     {
-      unsigned char l0 = line[0];
-      unsigned char l1 = line[single_length];
-      unsigned char l2 = line[single_length * 2];
-      if (l0 || l1 || l2)
-	{
-	  outbuf[0] =		/* C7 B7 A7 C6 B6 A6 C5 B5  */
-	    ((l0 & (1 << 7)) >> 2) |
-	    ((l0 & (1 << 6)) >> 4) |
-	    ((l1 & (1 << 7)) >> 1) |
-	    ((l1 & (1 << 6)) >> 3) |
-	    ((l1 & (1 << 5)) >> 5) |
-	    ((l2 & (1 << 7)) << 0) |
-	    ((l2 & (1 << 6)) >> 2) |
-	    ((l2 & (1 << 5)) >> 4);
-	  outbuf[1] =		/* A5 C4 B4 A4 C3 B3 A3 C2 */
-	    ((l0 & (1 << 5)) << 2) |
-	    ((l0 & (1 << 4)) << 0) |
-	    ((l0 & (1 << 3)) >> 2) |
-	    ((l1 & (1 << 4)) << 1) |
-	    ((l1 & (1 << 3)) >> 1) |
-	    ((l2 & (1 << 4)) << 2) |
-	    ((l2 & (1 << 3)) << 0) |
-	    ((l2 & (1 << 2)) >> 2);
-	  outbuf[2] =		/* B2 A2 C1 B1 A1 C0 B0 A0 */
-	    ((l0 & (1 << 2)) << 4) |
-	    ((l0 & (1 << 1)) << 2) |
-	    ((l0 & (1 << 0)) << 0) |
-	    ((l1 & (1 << 2)) << 5) |
-	    ((l1 & (1 << 1)) << 3) |
-	    ((l1 & (1 << 0)) << 1) |
-	    ((l2 & (1 << 1)) << 4) |
-	    ((l2 & (1 << 0)) << 2);
-	}
-    line++;
-    outbuf += 3;
-  }
+      /* C7 B7 A7 C6 B6 A6 C5 B5 ... B2 A2 C1 B1 A1 C0 B0 A0 */
+      unsigned v = spread_3[line[i]] |
+	(spread_3[line[single_length + i]] << 1) |
+	(spread_3[line[single_length * 2 + i]] << 2);
+      outbuf[0] = v >> 16;
+      outbuf[1] = (v >> 8) & 0xff;
+      outbuf[2] = v & 0xff;
+      outbuf += 3;
+    }
 }
 
 void
@@ -229,58 +396,22 @@ stp_fold_4bit(const unsigned char *line,
                 int single_length,
                 unsigned char *outbuf)
 {
-  int i;
-  memset(outbuf, 0, single_length * 4);
-  for (i = 0; i < single_length; i++)
+  int i = 0;
+#ifdef HAVE_X86_SIMD
+  if (stpi_cpu_features() & STPI_CPU_SSE41)
+    i = sse41_fold_4bit(line, single_length, outbuf);
+#endif
+  for (; i < single_length; i++)
     {
-      unsigned char l0 = line[0];
-      unsigned char l1 = line[single_length];
-      unsigned char l2 = line[single_length*2];
-      unsigned char l3 = line[single_length*3];
-      if (l0 || l1 || l2 || l3)
-	{
-	  outbuf[0] =		/* D7 C7 B7 A7 D6 C6 B6 A6 */
-            ((l3 & (1 << 7)) >> 0)|
-            ((l2 & (1 << 7)) >> 1)|
-            ((l1 & (1 << 7)) >> 2)|
-            ((l0 & (1 << 7)) >> 3)|
-            ((l3 & (1 << 6)) >> 3)|
-            ((l2 & (1 << 6)) >> 4)|
-            ((l1 & (1 << 6)) >> 5)|
-            ((l0 & (1 << 6)) >> 6);
-
-	  outbuf[1] =		/* D5 C5 B5 A5 D4 C4 B4 A4 */
-            ((l3 & (1 << 5)) << 2)|
-            ((l2 & (1 << 5)) << 1)|
-            ((l1 & (1 << 5)) << 0)|
-            ((l0 & (1 << 5)) >> 1)|
-            ((l3 & (1 << 4)) >> 1)|
-            ((l2 & (1 << 4)) >> 2)|
-            ((l1 & (1 << 4)) >> 3)|
-            ((l0 & (1 << 4)) >> 4);
-
-	  outbuf[2] =		/* D3 C3 B3 A3 D2 C2 B2 A2 */
-            ((l3 & (1 << 3)) << 4)|
-            ((l2 & (1 << 3)) << 3)|
-            ((l1 & (1 << 3)) << 2)|
-            ((l0 & (1 << 3)) << 1)|
-            ((l3 & (1 << 2)) << 1)|
-            ((l2 & (1 << 2)) << 0)|
-            ((l1 & (1 << 2)) >> 1)|
-            ((l0 & (1 << 2)) >> 2);
-
-	  outbuf[3] =		/* D1 C1 B1 A1 D0 C0 B0 A0 */
-            ((l3 & (1 << 1)) << 6)|
-            ((l2 & (1 << 1)) << 5)|
-            ((l1 & (1 << 1)) << 4)|
-            ((l0 & (1 << 1)) << 3)|
-            ((l3 & (1 << 0)) << 3)|
-            ((l2 & (1 << 0)) << 2)|
-            ((l1 & (1 << 0)) << 1)|
-            ((l0 & (1 << 0)) << 0);
-	}
-      line++;
-      outbuf += 4;
+      /* D7 C7 B7 A7 D6 C6 B6 A6 ... D1 C1 B1 A1 D0 C0 B0 A0 */
+      unsigned v = spread_4[line[i]] |
+	(spread_4[line[single_length + i]] << 1) |
+	(spread_4[line[single_length * 2 + i]] << 2) |
+	(spread_4[line[single_length * 3 + i]] << 3);
+      outbuf[4 * i] = v >> 24;
+      outbuf[4 * i + 1] = (v >> 16) & 0xff;
+      outbuf[4 * i + 2] = (v >> 8) & 0xff;
+      outbuf[4 * i + 3] = v & 0xff;
     }
 }
 
@@ -289,101 +420,64 @@ stp_fold_8bit(const unsigned char *line,
                 int single_length,
                 unsigned char *outbuf)
 {
-  int i;
-  memset(outbuf, 0, single_length * 8);
+  const unsigned char *l0 = line;
+  const unsigned char *l1 = l0 + single_length;
+  const unsigned char *l2 = l1 + single_length;
+  const unsigned char *l3 = l2 + single_length;
+  const unsigned char *l4 = l3 + single_length;
+  const unsigned char *l5 = l4 + single_length;
+  const unsigned char *l6 = l5 + single_length;
+  const unsigned char *l7 = l6 + single_length;
+  int i, j;
   for (i = 0; i < single_length; i++)
     {
-      unsigned char l0 = line[0];
-      unsigned char l1 = line[single_length];
-      unsigned char l2 = line[single_length*2];
-      unsigned char l3 = line[single_length*3];
-      unsigned char l4 = line[single_length*4];
-      unsigned char l5 = line[single_length*5];
-      unsigned char l6 = line[single_length*6];
-      unsigned char l7 = line[single_length*7];
-      if (l0 || l1 || l2 || l3 || l4 || l5 || l6 || l7)
+      /* H7 G7 F7 E7 D7 C7 B7 A7 ... H0 G0 F0 E0 D0 C0 B0 A0 */
+      unsigned long long v =
+	spread_8[l0[i]] | (spread_8[l1[i]] << 1) |
+	(spread_8[l2[i]] << 2) | (spread_8[l3[i]] << 3) |
+	(spread_8[l4[i]] << 4) | (spread_8[l5[i]] << 5) |
+	(spread_8[l6[i]] << 6) | (spread_8[l7[i]] << 7);
+      for (j = 0; j < 8; j++)
+	outbuf[j] = (v >> (8 * (7 - j))) & 0xff;
+      outbuf += 8;
+    }
+}
+
+/*
+ * Nonzero groups of bits go to each row in turn.  With two rows, the
+ * groups that stay on the current row are those with an odd number of
+ * nonzero groups at or below them, which a prefix XOR gives directly.
+ */
+static void
+split_two_rows(int limit, int bits, const unsigned char *in,
+	       unsigned char *row0, unsigned char *row1)
+{
+  int i;
+  for (i = 0; i < limit; i++)
+    {
+      unsigned inbyte = in[i];
+      unsigned set, parity, first;
+      if (inbyte == 0)
 	{
-	  outbuf[0] =		/* H7 G7 F7 E7 D7 C7 B7 A7 */
-            ((l7 & (1 << 7)) >> 0)|
-            ((l6 & (1 << 7)) >> 1)|
-            ((l5 & (1 << 7)) >> 2)|
-            ((l4 & (1 << 7)) >> 3)|
-            ((l3 & (1 << 7)) >> 4)|
-            ((l2 & (1 << 7)) >> 5)|
-            ((l1 & (1 << 7)) >> 6)|
-            ((l0 & (1 << 7)) >> 7);
-
-	  outbuf[1] =		/* H6 G6 F6 E6 D6 C6 B6 A6 */
-            ((l7 & (1 << 6)) << 1)|
-            ((l6 & (1 << 6)) >> 0)|
-            ((l5 & (1 << 6)) >> 1)|
-            ((l4 & (1 << 6)) >> 2)|
-            ((l3 & (1 << 6)) >> 3)|
-            ((l2 & (1 << 6)) >> 4)|
-            ((l1 & (1 << 6)) >> 5)|
-            ((l0 & (1 << 6)) >> 6);
-
-	  outbuf[2] =		/* H5 G5 F5 E5 D5 C5 B5 A5 */
-            ((l7 & (1 << 5)) << 2)|
-            ((l6 & (1 << 5)) << 1)|
-            ((l5 & (1 << 5)) >> 0)|
-            ((l4 & (1 << 5)) >> 1)|
-            ((l3 & (1 << 5)) >> 2)|
-            ((l2 & (1 << 5)) >> 3)|
-            ((l1 & (1 << 5)) >> 4)|
-            ((l0 & (1 << 5)) >> 5);
-
-	  outbuf[3] =		/* H4 G4 F4 E4 D4 C4 B4 A4 */
-            ((l7 & (1 << 4)) << 3)|
-            ((l6 & (1 << 4)) << 2)|
-            ((l5 & (1 << 4)) << 1)|
-            ((l4 & (1 << 4)) >> 0)|
-            ((l3 & (1 << 4)) >> 1)|
-            ((l2 & (1 << 4)) >> 2)|
-            ((l1 & (1 << 4)) >> 3)|
-            ((l0 & (1 << 4)) >> 4);
-	  outbuf[4] =		/* H3 G3 F3 E3 D3 C3 B3 A3 */
-            ((l7 & (1 << 3)) << 4)|
-            ((l6 & (1 << 3)) << 3)|
-            ((l5 & (1 << 3)) << 2)|
-            ((l4 & (1 << 3)) << 1)|
-            ((l3 & (1 << 3)) >> 0)|
-            ((l2 & (1 << 3)) >> 1)|
-            ((l1 & (1 << 3)) >> 2)|
-            ((l0 & (1 << 3)) >> 3);
-
-	  outbuf[5] =		/* H2 G2 F2 E2 D2 C2 B2 A2 */
-            ((l7 & (1 << 2)) << 5)|
-            ((l6 & (1 << 2)) << 4)|
-            ((l5 & (1 << 2)) << 3)|
-            ((l4 & (1 << 2)) << 2)|
-            ((l3 & (1 << 2)) << 1)|
-            ((l2 & (1 << 2)) >> 0)|
-            ((l1 & (1 << 2)) >> 1)|
-            ((l0 & (1 << 2)) >> 2);
-
-	  outbuf[6] =		/* H1 G1 F1 E1 D1 C1 B1 A1 */
-            ((l7 & (1 << 1)) << 6)|
-            ((l6 & (1 << 1)) << 5)|
-            ((l5 & (1 << 1)) << 4)|
-            ((l4 & (1 << 1)) << 3)|
-            ((l3 & (1 << 1)) << 2)|
-            ((l2 & (1 << 1)) << 1)|
-            ((l1 & (1 << 1)) >> 0)|
-            ((l0 & (1 << 1)) >> 1);
-
-	  outbuf[7] =		/* H0 G0 F0 E0 D0 C0 B0 A0 */
-            ((l7 & (1 << 0)) << 7)|
-            ((l6 & (1 << 0)) << 6)|
-            ((l5 & (1 << 0)) << 5)|
-            ((l4 & (1 << 0)) << 4)|
-            ((l3 & (1 << 0)) << 3)|
-            ((l2 & (1 << 0)) << 2)|
-            ((l1 & (1 << 0)) << 1)|
-            ((l0 & (1 << 0)) >> 0);
+	  row0[i] = 0;
+	  row1[i] = 0;
+	  continue;
+	}
+      set = bits == 1 ? inbyte : (inbyte | (inbyte >> 1)) & 0x55;
+      parity = set ^ (set << 1);
+      parity ^= parity << 2;
+      parity ^= parity << 4;
+      first = set & parity;
+      if (bits != 1)
+	first = (first * 3) & inbyte;
+      row0[i] = first;
+      row1[i] = inbyte ^ first;
+      if (parity & 0x80)
+	{
+	  unsigned char *tmp = row0;
+	  row0 = row1;
+	  row1 = tmp;
 	}
-      line++;
-      outbuf += 8;
     }
 }
 
@@ -413,6 +507,11 @@ stp_split(int length,
   int limit = length * bits;
   int rlimit = n * increment;
   int i;
+  if (n == 2)
+    {
+      split_two_rows(limit, bits, in, outs[0], outs[increment]);
+      return;
+    }
   for (i = 1; i < n; i++)
     memset(outs[i * increment], 0, limit);
 
@@ -483,58 +582,70 @@ stp_split_4(int length,
 }
 
 
+/*
+ * Transpose up to eight bytes taken stride bytes apart: byte i of the
+ * result holds bit i of each of them, the first in the top bit.
+ */
+static inline unsigned long long
+transpose_8(const unsigned char *in, int count, int stride)
+{
+  unsigned long long v = 0;
+  int j;
+  for (j = 0; j < count; j++)
+    v |= spread_8[in[j * stride]] << (7 - j);
+  return v;
+}
+
+/*
+ * Likewise for the 2-bit fields of up to four bytes: byte i of the
+ * result holds field i of each of them, the first in the top two bits.
+ */
+static inline unsigned
+transpose_2x4(const unsigned char *in, int count, int stride)
+{
+  unsigned v = 0;
+  int j;
+  for (j = 0; j < count; j++)
+    v |= spread_2x4[in[j * stride]] << (6 - 2 * j);
+  return v;
+}
+
+/*
+ * Write the bytes of a transpose to the planes, the top byte first.
+ */
+static inline void
+put_planes_8(unsigned char **outs, unsigned long long v)
+{
+  int j;
+  for (j = 0; j < 8; j++)
+    *outs[j]++ = (v >> (8 * (7 - j))) & 0xff;
+}
+
+static inline void
+put_planes_4(unsigned char **outs, unsigned v)
+{
+  int j;
+  for (j = 0; j < 4; j++)
+    *outs[j]++ = (v >> (8 * (3 - j))) & 0xff;
+}
+
 static void NOINLINE
 stpi_unpack_2_1(int length,
 		const unsigned char *in,
 		unsigned char **outs)
 {
-  unsigned char	tempin, bit, temp0, temp1;
-
-  if (length <= 0)
-    return;
-  for (bit = 128, temp0 = 0, temp1 = 0;
-       length > 0;
-       length --)
+  for (; length > 1; length -= 2, in += 2)
     {
-      tempin = *in++;
-
-      if (tempin & 128)
-        temp0 |= bit;
-      if (tempin & 64)
-        temp1 |= bit;
-      bit >>= 1;
-      if (tempin & 32)
-        temp0 |= bit;
-      if (tempin & 16)
-        temp1 |= bit;
-      bit >>= 1;
-      if (tempin & 8)
-        temp0 |= bit;
-      if (tempin & 4)
-        temp1 |= bit;
-      bit >>= 1;
-      if (tempin & 2)
-        temp0 |= bit;
-      if (tempin & 1)
-        temp1 |= bit;
-
-      if (bit > 1)
-        bit >>= 1;
-      else
-      {
-        bit     = 128;
-	*outs[0]++ = temp0;
-	*outs[1]++ = temp1;
-
-	temp0   = 0;
-	temp1   = 0;
-      }
+      unsigned char t0 = unshuffle_2[in[0]];
+      unsigned char t1 = unshuffle_2[in[1]];
+      *outs[0]++ = (t0 & 0xf0) | (t1 >> 4);
+      *outs[1]++ = (t0 << 4) | (t1 & 0x0f);
     }
-
-  if (bit < 128)
+  if (length > 0)
     {
-      *outs[0]++ = temp0;
-      *outs[1]++ = temp1;
+      unsigned char t0 = unshuffle_2[in[0]];
+      *outs[0]++ = t0 & 0xf0;
+      *outs[1]++ = t0 << 4;
     }
 }
 
@@ -564,63 +675,32 @@ stpi_unpack_2_2(int length,
     }
 }
 
+/*
+ * Each byte holds two bits for each of the four planes, so in the
+ * transpose of four bytes the high nibbles land on the odd bits of
+ * bytes 7-4 and the low nibbles on the odd bits of bytes 3-0.
+ */
+static inline void
+unpack_4_1_group(const unsigned char *in, int count, unsigned char **outs)
+{
+  unsigned long long v = 0;
+  int j;
+  for (j = 0; j < count; j++)
+    v |= spread_8[in[j]] << (7 - 2 * j);
+  for (j = 0; j < 4; j++)
+    *outs[j]++ = ((v >> (8 * (7 - j))) & 0xaa) |
+      (((v >> (8 * (3 - j))) & 0xaa) >> 1);
+}
+
 static void NOINLINE
 stpi_unpack_4_1(int length,
 		 const unsigned char *in,
 		 unsigned char **outs)
 {
-  unsigned char	tempin, bit, temp0, temp1, temp2, temp3;
-
-  if (length <= 0)
-    return;
-  for (bit = 128, temp0 = 0, temp1 = 0, temp2 = 0, temp3 = 0;
-       length > 0;
-       length --)
-    {
-      tempin = *in++;
-
-      if (tempin & 128)
-        temp0 |= bit;
-      if (tempin & 64)
-        temp1 |= bit;
-      if (tempin & 32)
-        temp2 |= bit;
-      if (tempin & 16)
-        temp3 |= bit;
-      bit >>= 1;
-      if (tempin & 8)
-        temp0 |= bit;
-      if (tempin & 4)
-        temp1 |= bit;
-      if (tempin & 2)
-        temp2 |= bit;
-      if (tempin & 1)
-        temp3 |= bit;
-
-      if (bit > 1)
-        bit >>= 1;
-      else
-      {
-        bit     = 128;
-	*outs[0]++ = temp0;
-	*outs[1]++ = temp1;
-	*outs[2]++ = temp2;
-	*outs[3]++ = temp3;
-
-	temp0   = 0;
-	temp1   = 0;
-	temp2   = 0;
-	temp3   = 0;
-      }
-    }
-
-  if (bit < 128)
-    {
-      *outs[0]++ = temp0;
-      *outs[1]++ = temp1;
-      *outs[2]++ = temp2;
-      *outs[3]++ = temp3;
-    }
+  for (; length >= 4; length -= 4, in += 4)
+    unpack_4_1_group(in, 4, outs);
+  if (length > 0)
+    unpack_4_1_group(in, length, outs);
 }
 
 static void NOINLINE
@@ -628,59 +708,10 @@ stpi_unpack_4_2(int length,
 		 const unsigned char *in,
 		 unsigned char **outs)
 {
-  unsigned char	tempin,
-		shift,
-		temp0,
-		temp1,
-		temp2,
-		temp3;
-
-  length *= 2;
-
-  for (shift = 0, temp0 = 0, temp1 = 0, temp2 = 0, temp3 = 0;
-       length > 0;
-       length --)
-    {
-     /*
-      * Note - we can't use (tempin & N) >> (shift - M) since negative
-      * right-shifts are not always implemented.
-      */
-
-      tempin = *in++;
-
-      if (tempin & 192)
-        temp0 |= (tempin & 192) >> shift;
-      if (tempin & 48)
-        temp1 |= ((tempin & 48) << 2) >> shift;
-      if (tempin & 12)
-        temp2 |= ((tempin & 12) << 4) >> shift;
-      if (tempin & 3)
-        temp3 |= ((tempin & 3) << 6) >> shift;
-
-      if (shift < 6)
-        shift += 2;
-      else
-      {
-        shift   = 0;
-	*outs[0]++ = temp0;
-	*outs[1]++ = temp1;
-	*outs[2]++ = temp2;
-	*outs[3]++ = temp3;
-
-	temp0   = 0;
-	temp1   = 0;
-	temp2   = 0;
-	temp3   = 0;
-      }
-    }
-
-  if (shift)
-    {
-      *outs[0]++ = temp0;
-      *outs[1]++ = temp1;
-      *outs[2]++ = temp2;
-      *outs[3]++ = temp3;
-    }
+  for (length *= 2; length >= 4; length -= 4, in += 4)
+    put_planes_4(outs, transpose_2x4(in, 4, 1));
+  if (length > 0)
+    put_planes_4(outs, transpose_2x4(in, length, 1));
 }
 
 static void NOINLINE
@@ -688,72 +719,10 @@ stpi_unpack_8_1(int length,
 		const unsigned char *in,
 		unsigned char **outs)
 {
-  unsigned char	tempin, bit, temp0, temp1, temp2, temp3, temp4, temp5, temp6,
-    temp7;
-
-  if (length <= 0)
-    return;
-
-  for (bit = 128, temp0 = 0, temp1 = 0, temp2 = 0,
-       temp3 = 0, temp4 = 0, temp5 = 0, temp6 = 0, temp7 = 0;
-       length > 0;
-       length --)
-    {
-      tempin = *in++;
-
-      if (tempin & 128)
-        temp0 |= bit;
-      if (tempin & 64)
-        temp1 |= bit;
-      if (tempin & 32)
-        temp2 |= bit;
-      if (tempin & 16)
-        temp3 |= bit;
-      if (tempin & 8)
-        temp4 |= bit;
-      if (tempin & 4)
-        temp5 |= bit;
-      if (tempin & 2)
-        temp6 |= bit;
-      if (tempin & 1)
-        temp7 |= bit;
-
-      if (bit > 1)
-        bit >>= 1;
-      else
-      {
-        bit     = 128;
-	*outs[0]++ = temp0;
-	*outs[1]++ = temp1;
-	*outs[2]++ = temp2;
-	*outs[3]++ = temp3;
-	*outs[4]++ = temp4;
-	*outs[5]++ = temp5;
-	*outs[6]++ = temp6;
-	*outs[7]++ = temp7;
-
-	temp0   = 0;
-	temp1   = 0;
-	temp2   = 0;
-	temp3   = 0;
-	temp4   = 0;
-	temp5   = 0;
-	temp6   = 0;
-	temp7   = 0;
-      }
-    }
-
-  if (bit < 128)
-    {
-      *outs[0]++ = temp0;
-      *outs[1]++ = temp1;
-      *outs[2]++ = temp2;
-      *outs[3]++ = temp3;
-      *outs[4]++ = temp4;
-      *outs[5]++ = temp5;
-      *outs[6]++ = temp6;
-      *outs[7]++ = temp7;
-    }
+  for (; length >= 8; length -= 8, in += 8)
+    put_planes_8(outs, transpose_8(in, 8, 1));
+  if (length > 0)
+    put_planes_8(outs, transpose_8(in, length, 1));
 }
 
 static void NOINLINE
@@ -761,85 +730,15 @@ stpi_unpack_8_2(int length,
 		const unsigned char *in,
 		unsigned char **outs)
 {
-  unsigned char	tempin,
-		shift,
-		temp0,
-		temp1,
-		temp2,
-		temp3,
-		temp4,
-		temp5,
-		temp6,
-		temp7;
-
-
-  for (shift = 0, temp0 = 0, temp1 = 0,
-       temp2 = 0, temp3 = 0, temp4 = 0, temp5 = 0, temp6 = 0, temp7 = 0;
-       length > 0;
-       length --)
+  for (; length >= 4; length -= 4, in += 8)
     {
-     /*
-      * Note - we can't use (tempin & N) >> (shift - M) since negative
-      * right-shifts are not always implemented.
-      */
-
-      tempin = *in++;
-
-      if (tempin & 192)
-        temp0 |= (tempin & 192) >> shift;
-      if (tempin & 48)
-        temp1 |= ((tempin & 48) << 2) >> shift;
-      if (tempin & 12)
-        temp2 |= ((tempin & 12) << 4) >> shift;
-      if (tempin & 3)
-        temp3 |= ((tempin & 3) << 6) >> shift;
-
-      tempin = *in++;
-
-      if (tempin & 192)
-        temp4 |= (tempin & 192) >> shift;
-      if (tempin & 48)
-        temp5 |= ((tempin & 48) << 2) >> shift;
-      if (tempin & 12)
-        temp6 |= ((tempin & 12) << 4) >> shift;
-      if (tempin & 3)
-        temp7 |= ((tempin & 3) << 6) >> shift;
-
-      if (shift < 6)
-        shift += 2;
-      else
-      {
-        shift   = 0;
-	*outs[0]++ = temp0;
-	*outs[1]++ = temp1;
-	*outs[2]++ = temp2;
-	*outs[3]++ = temp3;
-	*outs[4]++ = temp4;
-	*outs[5]++ = temp5;
-	*outs[6]++ = temp6;
-	*outs[7]++ = temp7;
-
-	temp0   = 0;
-	temp1   = 0;
-	temp2   = 0;
-	temp3   = 0;
-	temp4   = 0;
-	temp5   = 0;
-	temp6   = 0;
-	temp7   = 0;
-      }
+      put_planes_4(outs, transpose_2x4(in, 4, 2));
+      put_planes_4(outs + 4, transpose_2x4(in + 1, 4, 2));
     }
-
-  if (shift)
+  if (length > 0)
     {
-      *outs[0]++ = temp0;
-      *outs[1]++ = temp1;
-      *outs[2]++ = temp2;
-      *outs[3]++ = temp3;
-      *outs[4]++ = temp4;
-      *outs[5]++ = temp5;
-      *outs[6]++ = temp6;
-      *outs[7]++ = temp7;
+      put_planes_4(outs, transpose_2x4(in, length, 2));
+      put_planes_4(outs + 4, transpose_2x4(in + 1, length, 2));
     }
 }
 
@@ -848,155 +747,35 @@ stpi_unpack_16_1(int length,
 		 const unsigned char *in,
 		 unsigned char **outs)
 {
-  unsigned char	tempin, bit;
-  unsigned char temp[16];
-  int j;
-
-  if (length <= 0)
-    return;
-
-  memset(temp, 0, 16);
-
-  for (bit = 128; length > 0; length--)
+  for (; length >= 8; length -= 8, in += 16)
     {
-      tempin = *in++;
-
-      if (tempin & 128)
-        temp[0] |= bit;
-      if (tempin & 64)
-        temp[1] |= bit;
-      if (tempin & 32)
-        temp[2] |= bit;
-      if (tempin & 16)
-        temp[3] |= bit;
-      if (tempin & 8)
-        temp[4] |= bit;
-      if (tempin & 4)
-        temp[5] |= bit;
-      if (tempin & 2)
-        temp[6] |= bit;
-      if (tempin & 1)
-        temp[7] |= bit;
-
-      tempin = *in++;
-
-      if (tempin & 128)
-	temp[8] |= bit;
-      if (tempin & 64)
-	temp[9] |= bit;
-      if (tempin & 32)
-	temp[10] |= bit;
-      if (tempin & 16)
-	temp[11] |= bit;
-      if (tempin & 8)
-	temp[12] |= bit;
-      if (tempin & 4)
-	temp[13] |= bit;
-      if (tempin & 2)
-	temp[14] |= bit;
-      if (tempin & 1)
-	temp[15] |= bit;
-
-      if (bit > 1)
-        bit >>= 1;
-      else
-	{
-	  bit     = 128;
-	  for (j = 0; j < 16; j++)
-	    *outs[j]++ = temp[j];
-
-	  memset(temp, 0, 16);
-	}
+      put_planes_8(outs, transpose_8(in, 8, 2));
+      put_planes_8(outs + 8, transpose_8(in + 1, 8, 2));
+    }
+  if (length > 0)
+    {
+      put_planes_8(outs, transpose_8(in, length, 2));
+      put_planes_8(outs + 8, transpose_8(in + 1, length, 2));
     }
-
-  if (bit < 128)
-    for (j = 0; j < 16; j++)
-      *outs[j]++ = temp[j];
 }
 
+/*
+ * Each step takes four input bytes, two per unit of length, so an odd
+ * length still reads a whole step at the end.
+ */
 static void NOINLINE
 stpi_unpack_16_2(int length,
 		 const unsigned char *in,
 		 unsigned char **outs)
 {
-  unsigned char	tempin, shift;
-  unsigned char temp[16];
-  int j;
-
-  if (length <= 0)
-    return;
-
-  memset(temp, 0, 16);
-
-  for (shift = 0; length > 0; length--)
-    {
-      /*
-       * Note - we can't use (tempin & N) >> (shift - M) since negative
-       * right-shifts are not always implemented.
-       */
-
-      tempin = *in++;
-
-      if (tempin & 192)
-        temp[0] |= (tempin & 192) >> shift;
-      if (tempin & 48)
-        temp[1] |= ((tempin & 48) << 2) >> shift;
-      if (tempin & 12)
-        temp[2] |= ((tempin & 12) << 4) >> shift;
-      if (tempin & 3)
-        temp[3] |= ((tempin & 3) << 6) >> shift;
-
-      tempin = *in++;
-
-      if (tempin & 192)
-        temp[4] |= (tempin & 192) >> shift;
-      if (tempin & 48)
-        temp[5] |= ((tempin & 48) << 2) >> shift;
-      if (tempin & 12)
-        temp[6] |= ((tempin & 12) << 4) >> shift;
-      if (tempin & 3)
-        temp[7] |= ((tempin & 3) << 6) >> shift;
-
-      if (length-- > 0)
-	{
-	  tempin = *in++;
-
-	  if (tempin & 192)
-	    temp[8] |= (tempin & 192) >> shift;
-	  if (tempin & 48)
-	    temp[9] |= ((tempin & 48) << 2) >> shift;
-	  if (tempin & 12)
-	    temp[10] |= ((tempin & 12) << 4) >> shift;
-	  if (tempin & 3)
-	    temp[11] |= ((tempin & 3) << 6) >> shift;
-
-	  tempin = *in++;
-
-	  if (tempin & 192)
-	    temp[12] |= (tempin & 192) >> shift;
-	  if (tempin & 48)
-	    temp[13] |= ((tempin & 48) << 2) >> shift;
-	  if (tempin & 12)
-	    temp[14] |= ((tempin & 12) << 4) >> shift;
-	  if (tempin & 3)
-	    temp[15] |= ((tempin & 3) << 6) >> shift;
-	}
-
-      if (shift < 6)
-        shift += 2;
-      else
-	{
-	  shift   = 0;
-	  for (j = 0; j < 16; j++)
-	    *outs[j]++ = temp[j];
-
-	  memset(temp, 0, 16);
-	}
-    }
-
-  if (shift)
-    for (j = 0; j < 16; j++)
-      *outs[j]++ = temp[j];
+  int steps = (length + 1) / 2;
+  int k;
+  for (; steps >= 4; steps -= 4, in += 16)
+    for (k = 0; k < 4; k++)
+      put_planes_4(outs + 4 * k, transpose_2x4(in + k, 4, 4));
+  if (steps > 0)
+    for (k = 0; k < 4; k++)
+      put_planes_4(outs + 4 * k, transpose_2x4(in + k, steps, 4));
 }
 
 void
@@ -1006,11 +785,10 @@ stp_unpack(int length,
 	   const unsigned char *in,
 	   unsigned char **outs)
 {
-  unsigned char **touts;
+  unsigned char *touts[16];
   int i;
-  if (n < 2)
+  if (n < 2 || n > 16)
     return;
-  touts = stp_malloc(sizeof(unsigned char *) * n);
   for (i = 0; i < n; i++)
     touts[i] = outs[i];
   if (bits == 1)
@@ -1045,7 +823,6 @@ stp_unpack(int length,
 	stpi_unpack_16_2(length, in, touts);
 	break;
       }
-  stp_free(touts);
 }
 
 void
@@ -1144,32 +921,133 @@ stp_unpack_16(int length,
   stp_unpack(length, bits, 16, in, outs);
 }
 
-static void NOINLINE
-find_first_and_last(const unsigned char *line, int length,
-		    int *first, int *last)
+/*
+ * Byte scanning for the packers.  SSE2 and NEON are baseline wherever
+ * they are available, so these compare sixteen bytes at a time without
+ * any run-time dispatch.  Each mask has bit i set if byte i matches.
+ */
+#if defined(__GNUC__) && defined(__SSE2__)
+#define BYTE_SCAN_VECTOR
+
+static inline unsigned
+match_value_16(const unsigned char *p, unsigned char value)
+{
+  return _mm_movemask_epi8
+    (_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p),
+		    _mm_set1_epi8((char) value)));
+}
+
+static inline unsigned
+match_bytes_16(const unsigned char *p, const unsigned char *q)
+{
+  return _mm_movemask_epi8
+    (_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p),
+		    _mm_loadu_si128((const __m128i *) q)));
+}
+
+#elif defined(__GNUC__) && defined(__ARM_NEON) && defined(__aarch64__)
+#define BYTE_SCAN_VECTOR
+
+static inline unsigned
+neon_movemask(uint8x16_t matches)
+{
+  static const unsigned char weights[16] =
+    { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+  uint8x16_t bits = vandq_u8(matches, vld1q_u8(weights));
+  return vaddv_u8(vget_low_u8(bits)) | (vaddv_u8(vget_high_u8(bits)) << 8);
+}
+
+static inline unsigned
+match_value_16(const unsigned char *p, unsigned char value)
 {
-  int found_first = 0;
-  int f = 0;
-  int l = 0;
-  for (f = 0; f < length; f++)
+  return neon_movemask(vceqq_u8(vld1q_u8(p), vdupq_n_u8(value)));
+}
+
+static inline unsigned
+match_bytes_16(const unsigned char *p, const unsigned char *q)
+{
+  return neon_movemask(vceqq_u8(vld1q_u8(p), vld1q_u8(q)));
+}
+
+#endif
+
+/*
+ * Number of bytes at the start of p that are equal to value.
+ */
+static inline int
+run_length(const unsigned char *p, int length, unsigned char value)
+{
+  int i = 0;
+#ifdef BYTE_SCAN_VECTOR
+  for (; i + 16 <= length; i += 16)
     {
-      if (line[f])
-	{
-	  found_first = 1;
-	  break;
-	}
+      unsigned mismatch = match_value_16(p + i, value) ^ 0xffff;
+      if (mismatch)
+	return i + __builtin_ctz(mismatch);
     }
-  *first = f;
-  if (!found_first)
+#endif
+  while (i < length && p[i] == value)
+    i++;
+  return i;
+}
+
+/*
+ * Number of bytes just before end that are equal to value.
+ */
+static inline int
+run_length_back(const unsigned char *end, int length, unsigned char value)
+{
+  int i = 0;
+#ifdef BYTE_SCAN_VECTOR
+  for (; i + 16 <= length; i += 16)
     {
-      *last = 0;
-      return;
+      unsigned mismatch = match_value_16(end - i - 16, value) ^ 0xffff;
+      if (mismatch)
+	return i + __builtin_clz(mismatch) - 16;
+    }
+#endif
+  while (i < length && end[-1 - i] == value)
+    i++;
+  return i;
+}
+
+/*
+ * Offset of the first three equal bytes in a row, or -1 if there are
+ * none.
+ */
+static inline int
+find_triple(const unsigned char *p, int length)
+{
+  int i = 0;
+#ifdef BYTE_SCAN_VECTOR
+  for (; i + 18 <= length; i += 16)
+    {
+      unsigned triples =
+	match_bytes_16(p + i, p + i + 1) & match_bytes_16(p + i + 1, p + i + 2);
+      if (triples)
+	return i + __builtin_ctz(triples);
     }
-  for (l = length - 1; l >= f; l--)
-    if (line[l])
-      break;
-  ;
-  *last = l;
+#endif
+  for (; i + 2 < length; i++)
+    if (p[i] == p[i + 1] && p[i + 1] == p[i + 2])
+      return i;
+  return -1;
+}
+
+/*
+ * This only reads the blank margins of the line, so it costs next to
+ * nothing unless they are wide, and then it is quick.
+ */
+static void
+find_first_and_last(const unsigned char *line, int length,
+		    int *first, int *last)
+{
+  int f = run_length(line, length, 0);
+  *first = f;
+  if (f >= length)
+    *last = 0;
+  else
+    *last = length - 1 - run_length_back(line + length, length - f, 0);
 }
 
 int
@@ -1212,27 +1090,26 @@ stp_pack_tiff(stp_vars_t *v,
       const unsigned char *start = line;	/* Start of compressed data */
       unsigned char repeat;		/* Repeating char */
       int count;			/* Count of compressed bytes */
+      int triple;
+
       /*
-       * Get a run of at least 3 non-repeated chars...
+       * Get a run of non-repeated chars, up to the next three repeated
+       * ones.  If there aren't any, stop two short of the end; those
+       * are sent as repeats of one or two.
        */
 
-      line   += 2;
-      length -= 2;
-
-      while (length > 0 && (line[-2] != line[-1] || line[-1] != line[0]))
-	{
-	  line ++;
-	  length --;
-	}
-
-      line   -= 2;
-      length += 2;
+      triple = find_triple(line, length);
+      if (triple >= 0)
+	count = triple;
+      else
+	count = length > 2 ? length - 2 : 0;
+      line   += count;
+      length -= count;
 
       /*
        * Output the non-repeated sequences (max 128 at a time).
        */
 
-      count = line - start;
       while (count > 0)
 	{
 	  int tcount = count > 128 ? 128 : count;
@@ -1252,23 +1129,15 @@ stp_pack_tiff(stp_vars_t *v,
        * Find the repeated sequences...
        */
 
-      start  = line;
       repeat = line[0];
-
-      line ++;
-      length --;
-
-      while (length > 0 && *line == repeat)
-	{
-	  line++;
-	  length--;
-	}
+      count  = 1 + run_length(line + 1, length - 1, repeat);
+      line   += count;
+      length -= count;
 
       /*
        * Output the repeated sequences (max 128 at a time).
        */
 
-      count = line - start;
       while (count > 0)
 	{
 	  int tcount = count > 128 ? 128 : count;
@@ -64,7 +64,12 @@ typedef struct
   stp_curve_t *curve;
 } stpi_channel_t;
 
-typedef struct
+struct stpi_channel_group;
+
+typedef void (*stpi_channel_kernel_t)(struct stpi_channel_group *cg,
+				      unsigned *zero_mask);
+
+typedef struct stpi_channel_group
 {
   stpi_channel_t *c;
   stp_curve_t *gcr_curve;
@@ -95,6 +100,12 @@ typedef struct
   int gloss_physical_channel;
   int initialized;
   int valid_8bit;
+  stpi_channel_kernel_t kernel;
+  int kernel_copy;
+  const unsigned short *gcr_lookup;
+  unsigned scale_density[STP_CHANNEL_LIMIT];
+  unsigned zero_always;
+  unsigned zero_if_empty;
 } stpi_channel_group_t;
 
 
@@ -147,6 +158,7 @@ stpi_channel_clear(void *vc)
   cg->input_channels = 0;
   cg->initialized = 0;
   cg->valid_8bit = 0;
+  cg->kernel = NULL;
 }
 
 void
@@ -261,7 +273,10 @@ stp_channel_set_density_adjustment(stp_vars_t *v, int color, int subchannel,
 		  "channel_density channel %d subchannel %d adjustment %f\n",
 		  color, subchannel, adjustment);
       if (sch && adjustment >= 0 && adjustment <= 1)
-	sch->s_density = adjustment * 65535;
+	{
+	  sch->s_density = adjustment * 65535;
+	  get_channel_group(v)->kernel = NULL;
+	}
     }
 }
 
@@ -281,7 +296,10 @@ stp_channel_set_ink_limit(stp_vars_t *v, double limit)
   stpi_channel_group_t *cg = get_channel_group(v);
   stp_dprintf(STP_DBG_INK, v, "ink_limit %f\n", limit);
   if (cg && limit > 0)
-    cg->ink_limit = 65535 * limit;
+    {
+      cg->ink_limit = 65535 * limit;
+      cg->kernel = NULL;
+    }
 }
 
 double
@@ -337,7 +355,10 @@ stp_channel_set_gloss_limit(stp_vars_t *v, double limit)
   stpi_channel_group_t *cg = get_channel_group(v);
   stp_dprintf(STP_DBG_INK, v, "gloss_limit %f\n", limit);
   if (cg && limit > 0)
-    cg->gloss_limit = 65535 * limit;
+    {
+      cg->gloss_limit = 65535 * limit;
+      cg->kernel = NULL;
+    }
 }
 
 double
@@ -383,6 +404,7 @@ stp_channel_set_gcr_curve(stp_vars_t *v, const stp_curve_t *curve)
     cg->gcr_curve = stp_curve_create_copy(curve);
   else
     cg->gcr_curve = NULL;
+  cg->kernel = NULL;
 }
 
 const stp_curve_t *
@@ -663,98 +685,6 @@ stp_channel_initialize(stp_vars_t *v, stp_image_t *image,
     stp_dump_channels(v);
 }
 
-static void NOINLINE
-clear_channel(unsigned short *data, unsigned width, unsigned depth)
-{
-  int i;
-  width *= depth;
-  for (i = 0; i < width; i += depth)
-    data[i] = 0;
-}
-
-static int NOINLINE
-scale_channel(unsigned short *data, unsigned width, unsigned depth,
-	      unsigned short density)
-{
-  int i;
-  int retval = 0;
-  unsigned short previous_data = 0;
-  unsigned short previous_value = 0;
-  width *= depth;
-  for (i = 0; i < width; i += depth)
-    {
-      if (data[i] == previous_data)
-	data[i] = previous_value;
-      else if (data[i] == (unsigned short) 65535)
-	{
-	  data[i] = density;
-	  retval = 1;
-	}
-      else if (data[i] > 0)
-	{
-	  unsigned short tval = (32767u + data[i] * density) / 65535u;
-	  previous_data = data[i];
-	  if (tval)
-	    retval = 1;
-	  previous_value = (unsigned short) tval;
-	  data[i] = (unsigned short) tval;
-	}
-    }
-  return retval;
-}
-
-static int NOINLINE
-scan_channel(unsigned short *data, unsigned width, unsigned depth)
-{
-  int i;
-  width *= depth;
-  for (i = 0; i < width; i += depth)
-    {
-      if (data[i])
-	return 1;
-    }
-  return 0;
-}
-
-static inline unsigned
-ink_sum(const unsigned short *data, int total_channels)
-{
-  int j;
-  unsigned total_ink = 0;
-  for (j = 0; j < total_channels; j++)
-    total_ink += data[j];
-  return total_ink;
-}
-
-static int NOINLINE
-limit_ink(stpi_channel_group_t *cg)
-{
-  int i;
-  int retval = 0;
-  unsigned short *ptr;
-  if (!cg || cg->ink_limit == 0 || cg->ink_limit >= cg->max_density)
-    return 0;
-  cg->valid_8bit = 0;
-  ptr = cg->output_data;
-  for (i = 0; i < cg->width; i++)
-    {
-      int total_ink = ink_sum(ptr, cg->total_channels);
-      if (total_ink > cg->ink_limit) /* Need to limit ink? */
-	{
-	  int j;
-	  /*
-	   * FIXME we probably should first try to convert light ink to dark
-	   */
-	  double ratio = (double) cg->ink_limit / (double) total_ink;
-	  for (j = 0; j < cg->total_channels; j++)
-	    ptr[j] *= ratio;
-	  retval = 1;
-	}
-      ptr += cg->total_channels;
-   }
-  return retval;
-}
-
 static inline int
 short_eq(const unsigned short *i1, const unsigned short *i2, size_t count)
 {
@@ -781,33 +711,6 @@ short_copy(unsigned short *out, const unsigned short *in, size_t count)
 #endif
 }
 
-static void NOINLINE
-copy_channels(stpi_channel_group_t *cg)
-{
-  int i, j, k;
-  const unsigned short *input;
-  unsigned short *output;
-  if (!cg)
-    return;
-  input = cg->input_data;
-  output = cg->output_data;
-  for (i = 0; i < cg->width; i++)
-    {
-      for (j = 0; j < cg->channel_count; j++)
-	{
-	  stpi_channel_t *ch = &(cg->c[j]);
-	  for (k = 0; k < ch->subchannel_count; k++)
-	    {
-	      if (cg->gloss_channel != j)
-		{
-		  *output = *input++;
-		}
-	      output++;
-	    }
-	}
-    }
-}
-
 static inline double
 compute_hue(int c, int m, int y, int max)
 {
@@ -837,339 +740,416 @@ interpolate_value(const double *vec, double val)
   return lval;
 }
 
-static void NOINLINE
-generate_special_channels(stpi_channel_group_t *cg)
+/*
+ * Post-processing of a row (special inks, GCR, splitting into light
+ * and dark inks or density scaling, ink limiting and gloss) is done
+ * one pixel at a time, running every stage on a pixel before moving
+ * on to the next.  Each stage below handles one pixel; which of them
+ * run is decided once by plan_kernel() from the channel group setup.
+ */
+
+static inline unsigned
+ink_sum(const unsigned short *data, int total_channels)
 {
-  int i, j;
-  const unsigned short *input_cache = NULL;
-  const unsigned short *output_cache = NULL;
-  const unsigned short *input;
-  unsigned short *output;
-  int offset;
-  int outbytes;
-  if (!cg)
-    return;
-  cg->valid_8bit = 0;
-  input = cg->input_data;
-  output = cg->multi_tmp;
-  offset = (cg->black_channel >= 0 ? 0 : -1);
-  outbytes = cg->aux_output_channels * sizeof(unsigned short);
-  for (i = 0; i < cg->width;
-       input += cg->input_channels, output += cg->aux_output_channels, i++)
+  int j;
+  unsigned total_ink = 0;
+  for (j = 0; j < total_channels; j++)
+    total_ink += data[j];
+  return total_ink;
+}
+
+static inline void
+special_pixel(const stpi_channel_group_t *cg, const unsigned short *input,
+	      unsigned short *output)
+{
+  int j;
+  int offset = (cg->black_channel >= 0 ? 0 : -1);
+  int c = input[STP_ECOLOR_C + offset];
+  int m = input[STP_ECOLOR_M + offset];
+  int y = input[STP_ECOLOR_Y + offset];
+  int min = FMIN(c, FMIN(m, y));
+  int max = FMAX(c, FMAX(m, y));
+  if (max > min)	/* Otherwise it's gray, and we don't care */
     {
-      if (input_cache && short_eq(input_cache, input, cg->input_channels))
-	{
-	  memcpy(output, output_cache, outbytes);
-	}
-      else
+      double hue;
+      /*
+       * We're only interested in converting color components
+       * to special inks.  We want to compute the hue and
+       * luminosity to determine what we want to convert.
+       * Since we're eliminating all grayscale component, the
+       * computations become simpler.
+       */
+      c -= min;
+      m -= min;
+      y -= min;
+      max -= min;
+      if (offset == 0)
+	output[STP_ECOLOR_K] = input[STP_ECOLOR_K];
+      hue = compute_hue(c, m, y, max);
+      for (j = 1; j < cg->aux_output_channels - offset; j++)
 	{
-	  int c = input[STP_ECOLOR_C + offset];
-	  int m = input[STP_ECOLOR_M + offset];
-	  int y = input[STP_ECOLOR_Y + offset];
-	  int min = FMIN(c, FMIN(m, y));
-	  int max = FMAX(c, FMAX(m, y));
-	  if (max > min)	/* Otherwise it's gray, and we don't care */
-	    {
-	      double hue;
-	      /*
-	       * We're only interested in converting color components
-	       * to special inks.  We want to compute the hue and
-	       * luminosity to determine what we want to convert.
-	       * Since we're eliminating all grayscale component, the
-	       * computations become simpler.
-	       */
-	      c -= min;
-	      m -= min;
-	      y -= min;
-	      max -= min;
-	      if (offset == 0)
-		output[STP_ECOLOR_K] = input[STP_ECOLOR_K];
-	      hue = compute_hue(c, m, y, max);
-	      for (j = 1; j < cg->aux_output_channels - offset; j++)
-		{
-		  stpi_channel_t *ch = &(cg->c[j]);
-		  if (ch->hue_map)
-		    output[j + offset] =
-		      max * interpolate_value(ch->hue_map,
-					      hue * ch->h_count / 6.0);
-		  else
-		    output[j + offset] = 0;
-		}
-	      output[STP_ECOLOR_C + offset] += min;
-	      output[STP_ECOLOR_M + offset] += min;
-	      output[STP_ECOLOR_Y + offset] += min;
-	    }
+	  stpi_channel_t *ch = &(cg->c[j]);
+	  if (ch->hue_map)
+	    output[j + offset] =
+	      max * interpolate_value(ch->hue_map, hue * ch->h_count / 6.0);
 	  else
-	    {
-	      for (j = 0; j < 4 + offset; j++)
-		output[j] = input[j];
-	      for (j = 4 + offset; j < cg->aux_output_channels; j++)
-		output[j] = 0;
-	    }
+	    output[j + offset] = 0;
 	}
-      input_cache = input;
-      output_cache = output;
+      output[STP_ECOLOR_C + offset] += min;
+      output[STP_ECOLOR_M + offset] += min;
+      output[STP_ECOLOR_Y + offset] += min;
+    }
+  else
+    {
+      for (j = 0; j < 4 + offset; j++)
+	output[j] = input[j];
+      for (j = 4 + offset; j < cg->aux_output_channels; j++)
+	output[j] = 0;
     }
 }
 
-static void NOINLINE
-split_channels(stpi_channel_group_t *cg, unsigned *zero_mask)
+/*
+ * The gloss channel is filled in last; start it out empty so that the
+ * ink limit doesn't count whatever the previous row left there.
+ */
+static inline void
+copy_pixel(const stpi_channel_group_t *cg, const unsigned short *input,
+	   unsigned short *output)
 {
-  int i, j, k;
-  int nz[STP_CHANNEL_LIMIT];
-  int outbytes;
-  const unsigned short *input_cache = NULL;
-  const unsigned short *output_cache = NULL;
-  const unsigned short *input;
-  unsigned short *output;
-  if (!cg)
-    return;
-  cg->valid_8bit = 0;
-  outbytes = cg->total_channels * sizeof(unsigned short);
-  input = cg->split_input;
-  output = cg->output_data;
-  for (i = 0; i < cg->total_channels; i++)
-    nz[i] = 0;
-  for (i = 0; i < cg->width; i++)
+  int j, k;
+  for (j = 0; j < cg->channel_count; j++)
     {
-      int zero_ptr = 0;
-      if (input_cache && short_eq(input_cache, input, cg->aux_output_channels))
+      stpi_channel_t *ch = &(cg->c[j]);
+      for (k = 0; k < ch->subchannel_count; k++)
 	{
-	  memcpy(output, output_cache, outbytes);
-	  input += cg->aux_output_channels;
-	  output += cg->total_channels;
+	  if (cg->gloss_channel != j)
+	    *output = *input++;
+	  else
+	    *output = 0;
+	  output++;
 	}
-      else
+    }
+}
+
+static inline void
+gcr_pixel(const stpi_channel_group_t *cg, unsigned short *data)
+{
+  unsigned k = data[0];
+  if (k > 0)
+    {
+      int kk = cg->gcr_lookup[k];
+      int ck;
+      if (kk > k)
+	kk = k;
+      ck = k - kk;
+      data[0] = kk;
+      data[1] += ck * cg->cyan_balance;
+      data[2] += ck * cg->magenta_balance;
+      data[3] += ck * cg->yellow_balance;
+    }
+}
+
+static inline void
+split_pixel(const stpi_channel_group_t *cg, const unsigned short *input,
+	    unsigned short *output, unsigned *nz)
+{
+  int j, k;
+  unsigned black_value = 0;
+  unsigned virtual_black = 65535;
+  if (cg->black_channel >= 0)
+    black_value = input[cg->black_channel];
+  for (j = 0; j < cg->aux_output_channels; j++)
+    {
+      if (input[j] < virtual_black && j != cg->black_channel)
+	virtual_black = input[j];
+    }
+  black_value += virtual_black / 4;
+  for (j = 0; j < cg->channel_count; j++)
+    {
+      stpi_channel_t *c = &(cg->c[j]);
+      int s_count = c->subchannel_count;
+      if (s_count >= 1)
 	{
-	  unsigned black_value = 0;
-	  unsigned virtual_black = 65535;
-	  input_cache = input;
-	  output_cache = output;
-	  if (cg->black_channel >= 0)
-	    black_value = input[cg->black_channel];
-	  for (j = 0; j < cg->aux_output_channels; j++)
+	  unsigned i_val = *input++;
+	  if (i_val == 0)
+	    {
+	      for (k = 0; k < s_count; k++)
+		*(output++) = 0;
+	      nz += s_count;
+	    }
+	  else if (s_count == 1)
 	    {
-	      if (input[j] < virtual_black && j != cg->black_channel)
-		virtual_black = input[j];
+	      if (c->sc[0].s_density < 65535)
+		i_val = i_val * c->sc[0].s_density / 65535;
+	      *nz++ |= *(output++) = i_val;
 	    }
-	  black_value += virtual_black / 4;
-	  for (j = 0; j < cg->channel_count; j++)
+	  else
 	    {
-	      stpi_channel_t *c = &(cg->c[j]);
-	      int s_count = c->subchannel_count;
-	      if (s_count >= 1)
+	      unsigned l_val = i_val;
+	      unsigned offset;
+	      if (i_val > 0 && black_value && j != cg->black_channel)
 		{
-		  unsigned i_val = *input++;
-		  if (i_val == 0)
-		    {
-		      for (k = 0; k < s_count; k++)
-			*(output++) = 0;
-		    }
-		  else if (s_count == 1)
+		  l_val += black_value;
+		  if (l_val > 65535)
+		    l_val = 65535;
+		}
+	      offset = l_val * s_count;
+	      for (k = 0; k < s_count; k++)
+		{
+		  unsigned o_val;
+		  if (c->sc[k].s_density > 0)
 		    {
-		      if (c->sc[0].s_density < 65535)
-			i_val = i_val * c->sc[0].s_density / 65535;
-		      nz[zero_ptr++] |= *(output++) = i_val;
+		      o_val = c->lut[offset + k];
+		      if (i_val != l_val)
+			o_val = o_val * i_val / l_val;
+		      if (c->sc[k].s_density < 65535)
+			o_val = o_val * c->sc[k].s_density / 65535;
 		    }
 		  else
-		    {
-		      unsigned l_val = i_val;
-		      unsigned offset;
-		      if (i_val > 0 && black_value && j != cg->black_channel)
-			{
-			  l_val += black_value;
-			  if (l_val > 65535)
-			    l_val = 65535;
-			}
-		      offset = l_val * s_count;
-		      for (k = 0; k < s_count; k++)
-			{
-			  unsigned o_val;
-			  if (c->sc[k].s_density > 0)
-			    {
-			      o_val = c->lut[offset + k];
-			      if (i_val != l_val)
-				o_val = o_val * i_val / l_val;
-			      if (c->sc[k].s_density < 65535)
-				o_val = o_val * c->sc[k].s_density / 65535;
-			    }
-			  else
-			    o_val = 0;
-			  *output++ = o_val;
-			  nz[zero_ptr++] |= o_val;
-			}
-		    }
+		    o_val = 0;
+		  *output++ = o_val;
+		  *nz++ |= o_val;
 		}
 	    }
 	}
     }
-  if (zero_mask)
+}
+
+static inline void
+scale_pixel(const stpi_channel_group_t *cg, unsigned short *data,
+	    unsigned *nz)
+{
+  int i;
+  for (i = 0; i < cg->total_channels; i++)
     {
-      *zero_mask = 0;
-      for (i = 0; i < cg->total_channels; i++)
-	if (!nz[i])
-	  *zero_mask |= 1 << i;
+      unsigned density = cg->scale_density[i];
+      if (density < 65535)
+	data[i] = (32767u + data[i] * density) / 65535u;
+      nz[i] |= data[i];
     }
 }
 
-static void NOINLINE
-scale_channels(stpi_channel_group_t *cg, unsigned *zero_mask,
-	       int zero_mask_valid)
+static inline int
+limit_pixel(const stpi_channel_group_t *cg, unsigned short *data)
 {
-  int i, j;
-  int physical_channel = 0;
-  if (!cg)
-    return;
-  cg->valid_8bit = 0;
-  if (zero_mask)
-    *zero_mask = 0;
-  for (i = 0; i < cg->channel_count; i++)
+  int j;
+  unsigned total_ink = ink_sum(data, cg->total_channels);
+  if (total_ink > cg->ink_limit) /* Need to limit ink? */
     {
-      stpi_channel_t *ch = &(cg->c[i]);
-      if (ch->subchannel_count > 0)
-	for (j = 0; j < ch->subchannel_count; j++)
-	  {
-	    if (cg->gloss_channel != i)
-	      {
-		stpi_subchannel_t *sch = &(ch->sc[j]);
-		unsigned density = sch->s_density;
-		unsigned short *output = cg->output_data + physical_channel;
-		if (density == 0)
-		  {
-		    clear_channel(output, cg->width, cg->total_channels);
-		    if (zero_mask)
-		      *zero_mask |= 1 << physical_channel;
-		  }
-		else if (density != 65535)
-		  {
-		    if (scale_channel(output, cg->width, cg->total_channels,
-				      density) == 0)
-		      if (zero_mask)
-			*zero_mask |= 1 << physical_channel;
-		  }
-		else if (zero_mask && ! zero_mask_valid)
-		  {
-		    if (scan_channel(output, cg->width, cg->total_channels)==0)
-		      *zero_mask |= 1 << physical_channel;
-		  }
-	      }
-	    physical_channel++;
-	  }
+      /*
+       * FIXME we probably should first try to convert light ink to dark
+       */
+      double ratio = (double) cg->ink_limit / (double) total_ink;
+      for (j = 0; j < cg->total_channels; j++)
+	data[j] *= ratio;
+      return 1;
     }
+  return 0;
 }
 
-static void NOINLINE
-generate_gloss(stpi_channel_group_t *cg, unsigned *zero_mask)
+static inline int
+gloss_pixel(const stpi_channel_group_t *cg, unsigned short *data)
 {
-  unsigned short *output;
-  unsigned gloss_mask;
-  int i, j, k;
-  if (!cg || cg->gloss_channel == -1 || cg->gloss_limit <= 0)
-    return;
-  cg->valid_8bit = 0;
-  output = cg->output_data;
-  gloss_mask = ~(1 << cg->gloss_physical_channel);
-  for (i = 0; i < cg->width; i++)
+  int i;
+  unsigned channel_sum = 0;
+  data[cg->gloss_physical_channel] = 0;
+  for (i = 0; i < cg->total_channels; i++)
+    channel_sum += data[i];
+  if (channel_sum < cg->gloss_limit)
     {
-      int physical_channel = 0;
-      unsigned channel_sum = 0;
-      output[cg->gloss_physical_channel] = 0;
-      for (j = 0; j < cg->channel_count; j++)
-	{
-	  stpi_channel_t *ch = &(cg->c[j]);
-	  for (k = 0; k < ch->subchannel_count; k++)
-	    {
-	      if (cg->gloss_channel != j)
-		{
-		  channel_sum += (unsigned) output[physical_channel];
-		  if (channel_sum >= cg->gloss_limit)
-		    goto next;
-		}
-	      physical_channel++;
-	    }
-	}
-      if (channel_sum < cg->gloss_limit)
-	{
-	  unsigned gloss_required = cg->gloss_limit - channel_sum;
-	  if (gloss_required > 65535)
-	    gloss_required = 65535;
-	  output[cg->gloss_physical_channel] = gloss_required;
-	  if (zero_mask)
-	    *zero_mask &= gloss_mask;
-	}
-    next:
-      output += cg->total_channels;
+      unsigned gloss_required = cg->gloss_limit - channel_sum;
+      if (gloss_required > 65535)
+	gloss_required = 65535;
+      data[cg->gloss_physical_channel] = gloss_required;
+      return 1;
     }
+  return 0;
 }
 
-static void NOINLINE
-do_gcr(stpi_channel_group_t *cg, unsigned *zero_mask)
+#define KERNEL_GCR	1
+#define KERNEL_SPLIT	2
+#define KERNEL_LIMIT	4
+#define KERNEL_GLOSS	8
+
+/*
+ * No stage looks at neighboring pixels, so a pixel identical to the
+ * one before it gets the same output.  'flags' is a constant in each
+ * instantiation, so the disabled stages compile away.  The per-pixel
+ * scratch arrays belong to the caller, so that inlining this into
+ * each instantiation doesn't grow its stack frame.
+ */
+static inline void
+convert_row(stpi_channel_group_t *cg, unsigned *zero_mask, unsigned flags,
+	    unsigned *nz, unsigned short *last)
 {
-  const unsigned short *gcr_lookup;
-  unsigned short *output;
-  size_t count;
+  const unsigned short *src;
+  unsigned short *output = cg->output_data;
+  unsigned short *split_input = cg->split_input;
+  unsigned short *gcr_data = cg->gcr_data;
+  unsigned short *multi_tmp = cg->multi_tmp;
+  const unsigned short *input = cg->input_data;
+  size_t src_step;
+  int has_special = input_has_special_channels(cg);
+  int has_copy = cg->kernel_copy;
+  int gloss_used = 0;
   int i;
-  union {
-    unsigned short nz[4];
-    unsigned long long nzl;
-  } nzx;
 
-  nzx.nzl = 0ull;
-  if (!cg)
-    return;
-  cg->valid_8bit = 0;
+  if (has_special || has_copy)
+    {
+      src = input;
+      src_step = cg->input_channels;
+    }
+  else if (flags & KERNEL_SPLIT)
+    {
+      src = split_input;
+      src_step = cg->aux_output_channels;
+    }
+  else
+    {
+      src = output;
+      src_step = cg->total_channels;
+    }
+  memset(nz, 0, sizeof(unsigned) * cg->total_channels);
 
-  output = cg->gcr_data;
-  stp_curve_resample(cg->gcr_curve, 65536);
-  gcr_lookup = stp_curve_get_ushort_data(cg->gcr_curve, &count);
   for (i = 0; i < cg->width; i++)
     {
-      unsigned k = output[0];
-      if (k > 0)
+      if (i > 0 && short_eq(last, src, src_step))
+	short_copy(output, output - cg->total_channels, cg->total_channels);
+      else
 	{
-	  int kk = gcr_lookup[k];
-	  int ck;
-	  if (kk > k)
-	    kk = k;
-	  ck = k - kk;
-	  output[0] = kk;
-	  output[1] += ck * cg->cyan_balance;
-	  output[2] += ck * cg->magenta_balance;
-	  output[3] += ck * cg->yellow_balance;
-	  nzx.nzl |= *(unsigned long long *) output;
+	  short_copy(last, src, src_step);
+	  if (has_special)
+	    special_pixel(cg, input, multi_tmp);
+	  else if (has_copy)
+	    copy_pixel(cg, input, output);
+	  if (flags & KERNEL_GCR)
+	    gcr_pixel(cg, gcr_data);
+	  if (flags & KERNEL_SPLIT)
+	    split_pixel(cg, split_input, output, nz);
+	  else
+	    scale_pixel(cg, output, nz);
+	  if (flags & KERNEL_LIMIT)
+	    (void) limit_pixel(cg, output);
+	  if (flags & KERNEL_GLOSS)
+	    gloss_used |= gloss_pixel(cg, output);
 	}
-      output += cg->gcr_channels;
+      src += src_step;
+      input += cg->input_channels;
+      output += cg->total_channels;
+      split_input += cg->aux_output_channels;
+      gcr_data += cg->gcr_channels;
+      multi_tmp += cg->aux_output_channels;
+    }
+
+  if (zero_mask)
+    {
+      *zero_mask = cg->zero_always;
+      for (i = 0; i < cg->total_channels && i < sizeof(unsigned) * 8; i++)
+	if (!nz[i] && (cg->zero_if_empty & (1u << i)))
+	  *zero_mask |= 1u << i;
+      if (gloss_used)
+	*zero_mask &= ~(1u << cg->gloss_physical_channel);
     }
-  *zero_mask = 0;
-  for (i = 0; i < 4; i++)
-    if (nzx.nz[i] == 0)
-      *zero_mask |= (1 << i);
 }
 
-void
-stp_channel_convert(const stp_vars_t *v, unsigned *zero_mask)
+#define KERNEL(flags)							\
+static void NOINLINE							\
+convert_row_##flags(stpi_channel_group_t *cg, unsigned *zero_mask)	\
+{									\
+  unsigned nz[STP_CHANNEL_LIMIT];					\
+  unsigned short last[STP_CHANNEL_LIMIT];				\
+  convert_row(cg, zero_mask, flags, nz, last);				\
+}
+
+KERNEL(0)  KERNEL(1)  KERNEL(2)  KERNEL(3)
+KERNEL(4)  KERNEL(5)  KERNEL(6)  KERNEL(7)
+KERNEL(8)  KERNEL(9)  KERNEL(10) KERNEL(11)
+KERNEL(12) KERNEL(13) KERNEL(14) KERNEL(15)
+
+static stpi_channel_kernel_t const channel_kernels[16] =
 {
+  convert_row_0,  convert_row_1,  convert_row_2,  convert_row_3,
+  convert_row_4,  convert_row_5,  convert_row_6,  convert_row_7,
+  convert_row_8,  convert_row_9,  convert_row_10, convert_row_11,
+  convert_row_12, convert_row_13, convert_row_14, convert_row_15,
+};
+
+static void
+plan_kernel(stpi_channel_group_t *cg)
+{
+  unsigned flags = 0;
   int zero_mask_valid = 1;
-  stpi_channel_group_t *cg =
-    ((stpi_channel_group_t *) stp_get_component_data(v, "Channel"));
+  int i, j;
+  int physical_channel = 0;
+
+  cg->kernel_copy = 0;
   if (input_has_special_channels(cg))
-    {
-      generate_special_channels(cg);
-      zero_mask_valid = 0;
-    }
+    zero_mask_valid = 0;
   else if (output_has_gloss(cg) && !input_needs_splitting(cg))
     {
-      copy_channels(cg);
+      cg->kernel_copy = 1;
       zero_mask_valid = 0;
     }
   if (output_needs_gcr(cg))
-    do_gcr(cg, zero_mask);
+    {
+      size_t count;
+      stp_curve_resample(cg->gcr_curve, 65536);
+      cg->gcr_lookup = stp_curve_get_ushort_data(cg->gcr_curve, &count);
+      flags |= KERNEL_GCR;
+    }
+
+  /*
+   * Which channels to report as empty.  Splitting reports any channel
+   * that came out empty; scaling reports channels scaled to nothing,
+   * and full density channels only if they weren't checked upstream.
+   */
+  cg->zero_always = 0;
+  cg->zero_if_empty = 0;
   if (input_needs_splitting(cg))
-    split_channels(cg, zero_mask);
-  else
-    scale_channels(cg, zero_mask, zero_mask_valid);
-  (void) limit_ink(cg);
-  (void) generate_gloss(cg, zero_mask);
+    {
+      flags |= KERNEL_SPLIT;
+      cg->zero_if_empty = ~0u;
+    }
+  for (i = 0; i < cg->channel_count; i++)
+    {
+      stpi_channel_t *ch = &(cg->c[i]);
+      for (j = 0; j < ch->subchannel_count; j++)
+	{
+	  unsigned bit = physical_channel < sizeof(unsigned) * 8 ?
+	    1u << physical_channel : 0;
+	  unsigned density = ch->sc[j].s_density;
+	  if (cg->gloss_channel == i)
+	    cg->scale_density[physical_channel] = 65535;
+	  else
+	    {
+	      cg->scale_density[physical_channel] = density;
+	      if (flags & KERNEL_SPLIT)
+		;
+	      else if (density == 0)
+		cg->zero_always |= bit;
+	      else if (density != 65535 || !zero_mask_valid)
+		cg->zero_if_empty |= bit;
+	    }
+	  physical_channel++;
+	}
+    }
+
+  if (cg->ink_limit != 0 && cg->ink_limit < cg->max_density)
+    flags |= KERNEL_LIMIT;
+  if (cg->gloss_channel != -1 && cg->gloss_limit > 0)
+    flags |= KERNEL_GLOSS;
+  cg->kernel = channel_kernels[flags];
+}
+
+void
+stp_channel_convert(const stp_vars_t *v, unsigned *zero_mask)
+{
+  stpi_channel_group_t *cg =
+    ((stpi_channel_group_t *) stp_get_component_data(v, "Channel"));
+  if (!cg->kernel)
+    plan_kernel(cg);
+  cg->valid_8bit = 0;
+  (cg->kernel)(cg, zero_mask);
 }
 
 unsigned short *
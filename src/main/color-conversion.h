@@ -95,6 +95,9 @@ typedef unsigned (*stp_convert_t)(const stp_vars_t *vars,
 				  const unsigned char *in,
 				  unsigned short *out);
 
+/* Choose and plan the color conversion function for a job */
+typedef stp_convert_t (*stp_convert_select_t)(const stp_vars_t *vars);
+
 #define CMASK_NONE   (0)
 #define CMASK_RGB    (CMASK_R | CMASK_G | CMASK_B)
 #define CMASK_CMY    (CMASK_C | CMASK_M | CMASK_Y)
@@ -123,7 +126,7 @@ typedef struct
   unsigned channels;
   int channel_count;
   color_correction_enum_t default_correction;
-  stp_convert_t conversion_function;
+  stp_convert_select_t select_conversion;
 } color_description_t;
 
 typedef struct
@@ -155,7 +158,6 @@ typedef struct
   double contrast;
   double brightness;
   int linear_contrast_adjustment;
-  int printed_colorfunc;
   int simple_gamma_correction;
   stp_cached_curve_t hue_map;
   stp_cached_curve_t lum_map;
@@ -163,20 +165,28 @@ typedef struct
   unsigned short *gray_tmp;	/* Color -> Gray */
   unsigned short *cmy_tmp;	/* CMY -> CMYK */
   unsigned char *in_data;
+  /* Conversion plan, fixed for the job; see color-conversions.c */
+  stp_convert_t convert;
+  double saturation;
+  double user_brightness;
+  const unsigned short *channel_data[STP_CHANNEL_LIMIT];
+  const unsigned short *brightness_data;
+  const unsigned short *contrast_data;
+  const unsigned short *user_data;
+  unsigned *simd_tables;	/* Composite curves for vector kernels */
 } lut_t;
 
-extern unsigned stpi_color_convert_to_gray(const stp_vars_t *v,
-					   const unsigned char *,
-					   unsigned short *);
-extern unsigned stpi_color_convert_to_color(const stp_vars_t *v,
-					    const unsigned char *,
-					    unsigned short *);
-extern unsigned stpi_color_convert_to_kcmy(const stp_vars_t *v,
-					   const unsigned char *,
-					   unsigned short *);
-extern unsigned stpi_color_convert_raw(const stp_vars_t *v,
-				       const unsigned char *,
-				       unsigned short *);
+extern stp_convert_t stpi_color_convert_to_gray(const stp_vars_t *v);
+extern stp_convert_t stpi_color_convert_to_color(const stp_vars_t *v);
+extern stp_convert_t stpi_color_convert_to_kcmy(const stp_vars_t *v);
+extern stp_convert_t stpi_color_convert_raw(const stp_vars_t *v);
+
+/* color-simd.c */
+extern stp_convert_t stpi_color_simd_color_to_color_raw(lut_t *lut);
+extern stp_convert_t stpi_color_simd_color_to_kcmy_raw(lut_t *lut);
+extern stp_convert_t stpi_color_simd_color_to_kcmy_threshold(lut_t *lut);
+extern stp_convert_t stpi_color_simd_color_to_color_fast(lut_t *lut);
+extern stp_convert_t stpi_color_simd_color_to_kcmy_fast(lut_t *lut);
 
 #ifdef __cplusplus
   }
@@ -326,28 +326,164 @@ adjust_hsl(unsigned short *rgbout, lut_t *lut, double ssat, double isat,
   rgbout[2] ^= 65535;
 }
 
-#define GENERIC_COLOR_FUNC(fromname, toname)				\
-CFUNC									\
-fromname##_to_##toname(const stp_vars_t *vars, const unsigned char *in,	\
-		       unsigned short *out)				\
+/*
+ * Conversion plans.  Everything a kernel needs that is fixed for the
+ * duration of the job (curves resampled to the kernel's input depth,
+ * cached curve data, and the user's saturation and brightness) is looked
+ * up once here, when the kernel is selected, rather than on every row.
+ * The kernels only read the results from the lut.
+ */
+
+static void
+plan_nothing(const stp_vars_t *vars, lut_t *lut, int bits)
+{
+}
+
+static void
+plan_color_curves(const stp_vars_t *vars, lut_t *lut, int bits)
+{
+  int i;
+  lut->saturation = stp_get_float_parameter(vars, "Saturation");
+  lut->user_brightness = stp_get_float_parameter(vars, "Brightness");
+  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)
+    stp_curve_resample(stp_curve_cache_get_curve(&(lut->channel_curves[i])),
+		       1 << bits);
+  stp_curve_resample
+    (stp_curve_cache_get_curve(&(lut->brightness_correction)), 65536);
+  stp_curve_resample
+    (stp_curve_cache_get_curve(&(lut->contrast_correction)), 1 << bits);
+  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)
+    lut->channel_data[i] =
+      stp_curve_cache_get_ushort_data(&(lut->channel_curves[i]));
+  lut->brightness_data =
+    stp_curve_cache_get_ushort_data(&(lut->brightness_correction));
+  lut->contrast_data =
+    stp_curve_cache_get_ushort_data(&(lut->contrast_correction));
+  (void) stp_curve_cache_get_double_data(&(lut->hue_map));
+  (void) stp_curve_cache_get_double_data(&(lut->lum_map));
+  (void) stp_curve_cache_get_double_data(&(lut->sat_map));
+}
+
+static void
+plan_fast_color_curves(const stp_vars_t *vars, lut_t *lut, int bits)
+{
+  int i;
+  lut->saturation = stp_get_float_parameter(vars, "Saturation");
+  lut->user_brightness = stp_get_float_parameter(vars, "Brightness");
+  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)
+    stp_curve_resample(lut->channel_curves[i].curve, 65536);
+  stp_curve_resample
+    (stp_curve_cache_get_curve(&(lut->brightness_correction)), 65536);
+  stp_curve_resample
+    (stp_curve_cache_get_curve(&(lut->contrast_correction)), 1 << bits);
+  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)
+    lut->channel_data[i] =
+      stp_curve_cache_get_ushort_data(&(lut->channel_curves[i]));
+  lut->brightness_data =
+    stp_curve_cache_get_ushort_data(&(lut->brightness_correction));
+  lut->contrast_data =
+    stp_curve_cache_get_ushort_data(&(lut->contrast_correction));
+}
+
+static void
+plan_gray_to_color_curves(const stp_vars_t *vars, lut_t *lut, int bits)
+{
+  int i;
+  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)
+    stp_curve_resample(lut->channel_curves[i].curve, 65536);
+  stp_curve_resample
+    (stp_curve_cache_get_curve(&(lut->user_color_correction)), 1 << bits);
+  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)
+    lut->channel_data[i] =
+      stp_curve_cache_get_ushort_data(&(lut->channel_curves[i]));
+  lut->user_data =
+    stp_curve_cache_get_ushort_data(&(lut->user_color_correction));
+}
+
+static void
+plan_gray_curves(const stp_vars_t *vars, lut_t *lut, int bits)
+{
+  stp_curve_resample
+    (stp_curve_cache_get_curve(&(lut->channel_curves[CHANNEL_K])), 65536);
+  lut->channel_data[CHANNEL_K] =
+    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_K]));
+  stp_curve_resample(lut->user_color_correction.curve, 1 << bits);
+  lut->user_data =
+    stp_curve_cache_get_ushort_data(&(lut->user_color_correction));
+}
+
+static void
+plan_channel_curves(lut_t *lut, int channels, int bits)
+{
+  int i;
+  for (i = 0; i < channels; i++)
+    {
+      stp_curve_resample(lut->channel_curves[i].curve, 65536);
+      lut->channel_data[i] =
+	stp_curve_cache_get_ushort_data(&(lut->channel_curves[i]));
+    }
+  stp_curve_resample(lut->user_color_correction.curve, 1 << bits);
+  lut->user_data =
+    stp_curve_cache_get_ushort_data(&(lut->user_color_correction));
+}
+
+static void
+plan_kcmy_curves(const stp_vars_t *vars, lut_t *lut, int bits)
+{
+  plan_channel_curves(lut, 4, bits);
+}
+
+static void
+plan_raw_curves(const stp_vars_t *vars, lut_t *lut, int bits)
+{
+  plan_channel_curves(lut, lut->out_channels, bits);
+}
+
+static stp_convert_t
+no_simd(lut_t *lut)
+{
+  return NULL;
+}
+
+/*
+ * Select the 8 or 16 bit kernel and plan it.  Chained kernels convert
+ * their input to a 16 bit intermediate and hand it to another kernel,
+ * so that is the depth their curves must be planned for.  Kernels
+ * with vector versions in color-simd.c use those if the CPU can.
+ */
+#define SELECT_COLOR_FUNC(fromname, toname, plan, plan_bits, simd)	\
+static stp_convert_t							\
+fromname##_to_##toname(const stp_vars_t *vars)				\
 {									\
   lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
-  if (!lut->printed_colorfunc)						\
-    {									\
-      lut->printed_colorfunc = 1;					\
-      stp_dprintf(STP_DBG_COLORFUNC, vars,				\
-		   "Colorfunc is %s_%d_to_%s, %s, %s, %d, %d\n",	\
-		   #fromname, lut->channel_depth, #toname,		\
-		   lut->input_color_description->name,			\
-		   lut->output_color_description->name,			\
-		   lut->steps, lut->invert_output);			\
-    }									\
-  if (lut->channel_depth == 8)						\
-    return fromname##_8_to_##toname(vars, in, out);			\
+  stp_convert_t convert;						\
+  plan(vars, lut, plan_bits);						\
+  convert = simd(lut);							\
+  stp_dprintf(STP_DBG_COLORFUNC, vars,					\
+	      "Colorfunc is %s_%d_to_%s%s, %s, %s, %d, %d\n",		\
+	      #fromname, lut->channel_depth, #toname,			\
+	      convert ? " (vector)" : "",				\
+	      lut->input_color_description->name,			\
+	      lut->output_color_description->name,			\
+	      lut->steps, lut->invert_output);				\
+  if (convert)								\
+    return convert;							\
+  else if (lut->channel_depth == 8)					\
+    return fromname##_8_to_##toname;					\
   else									\
-    return fromname##_16_to_##toname(vars, in, out);			\
+    return fromname##_16_to_##toname;					\
 }
 
+#define GENERIC_COLOR_FUNC(fromname, toname, plan)			\
+  SELECT_COLOR_FUNC(fromname, toname, plan, lut->channel_depth, no_simd)
+
+#define CHAINED_COLOR_FUNC(fromname, toname, plan)			\
+  SELECT_COLOR_FUNC(fromname, toname, plan, 16, no_simd)
+
+#define VECTOR_COLOR_FUNC(fromname, toname, plan)			\
+  SELECT_COLOR_FUNC(fromname, toname, plan, lut->channel_depth,	\
+		    stpi_color_simd_##fromname##_to_##toname)
+
 #define BD(bits) (65535u / (unsigned) MAXB(bits))
 
 #define COLOR_TO_COLOR_FUNC(T, bits)					\
@@ -357,8 +493,9 @@ color_##bits##_to_color(const stp_vars_t *vars, const unsigned char *in, \
 {									\
   int i;								\
   double isat = 1.0;							\
-  double ssat = stp_get_float_parameter(vars, "Saturation");		\
-  double sbright = stp_get_float_parameter(vars, "Brightness");		\
+  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
+  double ssat = lut->saturation;					\
+  double sbright = lut->user_brightness;				\
   int i0 = -1;								\
   int i1 = -1;								\
   int i2 = -1;								\
@@ -374,7 +511,6 @@ color_##bits##_to_color(const stp_vars_t *vars, const unsigned char *in, \
   const unsigned short *brightness;					\
   const unsigned short *contrast;					\
   const T *s_in = (const T *) in;					\
-  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
   int compute_saturation = ssat <= .99999 || ssat >= 1.00001;		\
   int split_saturation = ssat > 1.4;					\
   int bright_color_adjustment = 0;					\
@@ -388,26 +524,11 @@ color_##bits##_to_color(const stp_vars_t *vars, const unsigned char *in, \
     do_user_adjustment = 1;						\
   compute_saturation |= do_user_adjustment;				\
 									\
-  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)				\
-    stp_curve_resample(stp_curve_cache_get_curve(&(lut->channel_curves[i])), \
-		       1 << bits);					\
-  stp_curve_resample							\
-    (stp_curve_cache_get_curve(&(lut->brightness_correction)), 65536);	\
-  stp_curve_resample							\
-    (stp_curve_cache_get_curve(&(lut->contrast_correction)), 1 << bits); \
-  red =									\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_C]));	\
-  green =								\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_M]));	\
-  blue =								\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_Y]));	\
-  brightness=								\
-    stp_curve_cache_get_ushort_data(&(lut->brightness_correction));	\
-  contrast =								\
-    stp_curve_cache_get_ushort_data(&(lut->contrast_correction));	\
-  (void) stp_curve_cache_get_double_data(&(lut->hue_map));		\
-  (void) stp_curve_cache_get_double_data(&(lut->lum_map));		\
-  (void) stp_curve_cache_get_double_data(&(lut->sat_map));		\
+  red = lut->channel_data[CHANNEL_C];					\
+  green = lut->channel_data[CHANNEL_M];					\
+  blue = lut->channel_data[CHANNEL_Y];					\
+  brightness = lut->brightness_data;					\
+  contrast = lut->contrast_data;					\
   const double *hue_map = CURVE_CACHE_FAST_DOUBLE(&(lut->hue_map));	\
   const double *lum_map = CURVE_CACHE_FAST_DOUBLE(&(lut->lum_map));	\
   const double *sat_map = CURVE_CACHE_FAST_DOUBLE(&(lut->sat_map));	\
@@ -457,7 +578,7 @@ color_##bits##_to_color(const stp_vars_t *vars, const unsigned char *in, \
 
 COLOR_TO_COLOR_FUNC(unsigned char, 8) // color_8_to_color
 COLOR_TO_COLOR_FUNC(unsigned short, 16) // color_16_to_color
-GENERIC_COLOR_FUNC(color, color)
+GENERIC_COLOR_FUNC(color, color, plan_color_curves)
 
 #define COLOR_TO_KCMY_FUNC(T, bits)					\
 CFUNC									\
@@ -466,8 +587,9 @@ color_##bits##_to_kcmy(const stp_vars_t *vars, const unsigned char *in,	\
 {									\
   int i;								\
   double isat = 1.0;							\
-  double ssat = stp_get_float_parameter(vars, "Saturation");		\
-  double sbright = stp_get_float_parameter(vars, "Brightness");		\
+  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
+  double ssat = lut->saturation;					\
+  double sbright = lut->user_brightness;				\
   union {								\
     unsigned short nz[4];						\
     unsigned long long nzl;						\
@@ -479,7 +601,6 @@ color_##bits##_to_kcmy(const stp_vars_t *vars, const unsigned char *in,	\
   const unsigned short *brightness;					\
   const unsigned short *contrast;					\
   const T *s_in = (const T *) in;					\
-  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
   int compute_saturation = ssat <= .99999 || ssat >= 1.00001;		\
   int split_saturation = ssat > 1.4;					\
   int bright_color_adjustment = 0;					\
@@ -494,26 +615,11 @@ color_##bits##_to_kcmy(const stp_vars_t *vars, const unsigned char *in,	\
   compute_saturation |= do_user_adjustment;				\
   nzx.nzl = 0ull;							\
 									\
-  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)				\
-    stp_curve_resample(stp_curve_cache_get_curve(&(lut->channel_curves[i])), \
-		       1 << bits);					\
-  stp_curve_resample							\
-    (stp_curve_cache_get_curve(&(lut->brightness_correction)), 65536);	\
-  stp_curve_resample							\
-    (stp_curve_cache_get_curve(&(lut->contrast_correction)), 1 << bits); \
-  red =									\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_C]));	\
-  green =								\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_M]));	\
-  blue =								\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_Y]));	\
-  brightness=								\
-    stp_curve_cache_get_ushort_data(&(lut->brightness_correction));	\
-  contrast =								\
-    stp_curve_cache_get_ushort_data(&(lut->contrast_correction));	\
-  (void) stp_curve_cache_get_double_data(&(lut->hue_map));		\
-  (void) stp_curve_cache_get_double_data(&(lut->lum_map));		\
-  (void) stp_curve_cache_get_double_data(&(lut->sat_map));		\
+  red = lut->channel_data[CHANNEL_C];					\
+  green = lut->channel_data[CHANNEL_M];					\
+  blue = lut->channel_data[CHANNEL_Y];					\
+  brightness = lut->brightness_data;					\
+  contrast = lut->contrast_data;					\
   const double *hue_map = CURVE_CACHE_FAST_DOUBLE(&(lut->hue_map));	\
   const double *lum_map = CURVE_CACHE_FAST_DOUBLE(&(lut->lum_map));	\
   const double *sat_map = CURVE_CACHE_FAST_DOUBLE(&(lut->sat_map));	\
@@ -551,7 +657,7 @@ color_##bits##_to_kcmy(const stp_vars_t *vars, const unsigned char *in,	\
 
 COLOR_TO_KCMY_FUNC(unsigned char, 8) // color_8_to_kcmy
 COLOR_TO_KCMY_FUNC(unsigned short, 16) // color_16_to_kcmy
-GENERIC_COLOR_FUNC(color, kcmy)
+GENERIC_COLOR_FUNC(color, kcmy, plan_color_curves)
 
 /*
  * 'rgb_to_rgb()' - Convert rgb image data to RGB.
@@ -580,30 +686,19 @@ color_##bits##_to_color_fast(const stp_vars_t *vars, const unsigned char *in, \
   const unsigned short *brightness;					\
   const unsigned short *contrast;					\
   double isat = 1.0;							\
-  double saturation = stp_get_float_parameter(vars, "Saturation");	\
-  double sbright = stp_get_float_parameter(vars, "Brightness");		\
+  double saturation = lut->saturation;					\
+  double sbright = lut->user_brightness;				\
   int compute_saturation = saturation <= .99999 || saturation >= 1.00001; \
   int do_user_adjustment = 0;						\
   if (sbright != 1)							\
     do_user_adjustment = 1;						\
   compute_saturation |= do_user_adjustment;				\
 									\
-  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)				\
-    stp_curve_resample(lut->channel_curves[i].curve, 65536);		\
-  stp_curve_resample							\
-    (stp_curve_cache_get_curve(&(lut->brightness_correction)), 65536);	\
-  stp_curve_resample							\
-    (stp_curve_cache_get_curve(&(lut->contrast_correction)), 1 << bits); \
-  red =									\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_C]));	\
-  green =								\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_M]));	\
-  blue =								\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_Y]));	\
-  brightness=								\
-    stp_curve_cache_get_ushort_data(&(lut->brightness_correction));	\
-  contrast =								\
-    stp_curve_cache_get_ushort_data(&(lut->contrast_correction));	\
+  red = lut->channel_data[CHANNEL_C];					\
+  green = lut->channel_data[CHANNEL_M];					\
+  blue = lut->channel_data[CHANNEL_Y];					\
+  brightness = lut->brightness_data;					\
+  contrast = lut->contrast_data;					\
 									\
   if (saturation > 1)							\
     isat = 1.0 / saturation;						\
@@ -643,7 +738,7 @@ color_##bits##_to_color_fast(const stp_vars_t *vars, const unsigned char *in, \
 
 FAST_COLOR_TO_COLOR_FUNC(unsigned char, 8) // color_8_to_color_fast
 FAST_COLOR_TO_COLOR_FUNC(unsigned short, 16) // color_16_to_color_fast
-GENERIC_COLOR_FUNC(color, color_fast)
+VECTOR_COLOR_FUNC(color, color_fast, plan_fast_color_curves)
 
 #define FAST_COLOR_TO_KCMY_FUNC(T, bits)				\
 CFUNC									\
@@ -665,8 +760,8 @@ color_##bits##_to_kcmy_fast(const stp_vars_t *vars, const unsigned char *in, \
   const unsigned short *brightness;					\
   const unsigned short *contrast;					\
   double isat = 1.0;							\
-  double saturation = stp_get_float_parameter(vars, "Saturation");	\
-  double sbright = stp_get_float_parameter(vars, "Brightness");		\
+  double saturation = lut->saturation;					\
+  double sbright = lut->user_brightness;				\
   int compute_saturation = saturation <= .99999 || saturation >= 1.00001; \
   int do_user_adjustment = 0;						\
   if (sbright != 1)							\
@@ -674,22 +769,11 @@ color_##bits##_to_kcmy_fast(const stp_vars_t *vars, const unsigned char *in, \
   compute_saturation |= do_user_adjustment;				\
   nzx.nzl = 0ull;							\
 									\
-  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)				\
-    stp_curve_resample(lut->channel_curves[i].curve, 65536);		\
-  stp_curve_resample							\
-    (stp_curve_cache_get_curve(&(lut->brightness_correction)), 65536);	\
-  stp_curve_resample							\
-    (stp_curve_cache_get_curve(&(lut->contrast_correction)), 1 << bits); \
-  red =									\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_C]));	\
-  green =								\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_M]));	\
-  blue =								\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_Y]));	\
-  brightness=								\
-    stp_curve_cache_get_ushort_data(&(lut->brightness_correction));	\
-  contrast =								\
-    stp_curve_cache_get_ushort_data(&(lut->contrast_correction));	\
+  red = lut->channel_data[CHANNEL_C];					\
+  green = lut->channel_data[CHANNEL_M];					\
+  blue = lut->channel_data[CHANNEL_Y];					\
+  brightness = lut->brightness_data;					\
+  contrast = lut->contrast_data;					\
 									\
   if (saturation > 1)							\
     isat = 1.0 / saturation;						\
@@ -728,7 +812,7 @@ color_##bits##_to_kcmy_fast(const stp_vars_t *vars, const unsigned char *in, \
 
 FAST_COLOR_TO_KCMY_FUNC(unsigned char, 8) // color_8_to_kcmy_fast
 FAST_COLOR_TO_KCMY_FUNC(unsigned short, 16) // color_16_to_color_fast
-GENERIC_COLOR_FUNC(color, kcmy_fast)
+VECTOR_COLOR_FUNC(color, kcmy_fast, plan_fast_color_curves)
 
 #define RAW_COLOR_TO_COLOR_FUNC(T, bits)				    \
 CFUNC									    \
@@ -761,7 +845,7 @@ color_##bits##_to_color_raw(const stp_vars_t *vars, const unsigned char *in,\
 
 RAW_COLOR_TO_COLOR_FUNC(unsigned char, 8) // color_8_to_color_raw
 RAW_COLOR_TO_COLOR_FUNC(unsigned short, 16) // color_16_to_color_raw
-GENERIC_COLOR_FUNC(color, color_raw)
+VECTOR_COLOR_FUNC(color, color_raw, plan_nothing)
 
 #define RAW_COLOR_TO_KCMY_FUNC(T, bits)					\
 CFUNC									\
@@ -801,7 +885,7 @@ color_##bits##_to_kcmy_raw(const stp_vars_t *vars, const unsigned char *in, \
 
 RAW_COLOR_TO_KCMY_FUNC(unsigned char, 8) // color_8_to_kcmy_raw
 RAW_COLOR_TO_KCMY_FUNC(unsigned short, 16) // color_16_to_kcmy_raw
-GENERIC_COLOR_FUNC(color, kcmy_raw)
+VECTOR_COLOR_FUNC(color, kcmy_raw, plan_nothing)
 
 /*
  * 'gray_to_rgb()' - Convert gray image data to RGB.
@@ -827,18 +911,10 @@ gray_##bits##_to_color(const stp_vars_t *vars, const unsigned char *in,	    \
   const unsigned short *blue;						    \
   const unsigned short *user;						    \
 									    \
-  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)				    \
-    stp_curve_resample(lut->channel_curves[i].curve, 65536);		    \
-  stp_curve_resample							    \
-    (stp_curve_cache_get_curve(&(lut->user_color_correction)), 1 << bits);  \
-  red =									    \
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_C]));	    \
-  green =								    \
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_M]));	    \
-  blue =								    \
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_Y]));	    \
-  user =								    \
-    stp_curve_cache_get_ushort_data(&(lut->user_color_correction));	    \
+  red = lut->channel_data[CHANNEL_C];					    \
+  green = lut->channel_data[CHANNEL_M];					    \
+  blue = lut->channel_data[CHANNEL_Y];					    \
+  user = lut->user_data;						    \
 									    \
   for (i = 0; i < lut->image_width; i++)				    \
     {									    \
@@ -869,7 +945,7 @@ gray_##bits##_to_color(const stp_vars_t *vars, const unsigned char *in,	    \
 
 GRAY_TO_COLOR_FUNC(unsigned char, 8) // gray_8_to_color
 GRAY_TO_COLOR_FUNC(unsigned short, 16) // gray_16_to_color
-GENERIC_COLOR_FUNC(gray, color)
+GENERIC_COLOR_FUNC(gray, color, plan_gray_to_color_curves)
 
 #define GRAY_TO_KCMY_FUNC(T, bits)					\
 CFUNC									\
@@ -889,18 +965,10 @@ gray_##bits##_to_kcmy(const stp_vars_t *vars, const unsigned char *in,	\
   const unsigned short *blue;						\
   const unsigned short *user;						\
 									\
-  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)				\
-    stp_curve_resample(lut->channel_curves[i].curve, 65536);		\
-  stp_curve_resample							\
-    (stp_curve_cache_get_curve(&(lut->user_color_correction)), 1 << bits); \
-  red =									\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_C]));	\
-  green =								\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_M]));	\
-  blue =								\
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_Y]));	\
-  user =								\
-    stp_curve_cache_get_ushort_data(&(lut->user_color_correction));	\
+  red = lut->channel_data[CHANNEL_C];					\
+  green = lut->channel_data[CHANNEL_M];					\
+  blue = lut->channel_data[CHANNEL_Y];					\
+  user = lut->user_data;						\
 									\
   for (i = 0; i < lut->image_width; i++, out += 4, s_in++)		\
     {									\
@@ -921,7 +989,7 @@ gray_##bits##_to_kcmy(const stp_vars_t *vars, const unsigned char *in,	\
 
 GRAY_TO_KCMY_FUNC(unsigned char, 8) // gray_8_to_kcmy
 GRAY_TO_KCMY_FUNC(unsigned short, 16) // gray_16_to_kcmy
-GENERIC_COLOR_FUNC(gray, kcmy)
+GENERIC_COLOR_FUNC(gray, kcmy, plan_gray_to_color_curves)
 
 #define GRAY_TO_COLOR_RAW_FUNC(T, bits)					   \
 CFUNC									   \
@@ -952,7 +1020,7 @@ gray_##bits##_to_color_raw(const stp_vars_t *vars, const unsigned char *in,\
 
 GRAY_TO_COLOR_RAW_FUNC(unsigned char, 8) // gray_8_to_color_raw
 GRAY_TO_COLOR_RAW_FUNC(unsigned short, 16) // gray_16_to_color_raw
-GENERIC_COLOR_FUNC(gray, color_raw)
+GENERIC_COLOR_FUNC(gray, color_raw, plan_nothing)
 
 #define GRAY_TO_KCMY_RAW_FUNC(T, bits)					\
 CFUNC									\
@@ -982,7 +1050,7 @@ gray_##bits##_to_kcmy_raw(const stp_vars_t *vars, const unsigned char *in, \
 
 GRAY_TO_KCMY_RAW_FUNC(unsigned char, 8) // gray_8_to_kcmy_raw
 GRAY_TO_KCMY_RAW_FUNC(unsigned short, 16) // gray_16_to_kcmy_raw
-GENERIC_COLOR_FUNC(gray, kcmy_raw)
+GENERIC_COLOR_FUNC(gray, kcmy_raw, plan_nothing)
 
 #define COLOR_TO_KCMY_THRESHOLD_FUNC(T, name)				\
 CFUNC									\
@@ -1039,7 +1107,7 @@ name##_to_kcmy_threshold(const stp_vars_t *vars,			\
 
 COLOR_TO_KCMY_THRESHOLD_FUNC(unsigned char, color_8) // color_8_to_kcmy_threshold
 COLOR_TO_KCMY_THRESHOLD_FUNC(unsigned short, color_16) // color_16_to_kcmy_threshold
-GENERIC_COLOR_FUNC(color, kcmy_threshold)
+VECTOR_COLOR_FUNC(color, kcmy_threshold, plan_nothing)
 
 #define CMYK_TO_KCMY_THRESHOLD_FUNC(T, name)				\
 CFUNC									\
@@ -1086,7 +1154,7 @@ name##_to_kcmy_threshold(const stp_vars_t *vars,			\
 
 CMYK_TO_KCMY_THRESHOLD_FUNC(unsigned char, cmyk_8) // cmyk_8_to_kcmy_threshold
 CMYK_TO_KCMY_THRESHOLD_FUNC(unsigned short, cmyk_16) // cmyk_16_to_kcmy_threshodl
-GENERIC_COLOR_FUNC(cmyk, kcmy_threshold)
+GENERIC_COLOR_FUNC(cmyk, kcmy_threshold, plan_nothing)
 
 #define KCMY_TO_KCMY_THRESHOLD_FUNC(T, name)				\
 CFUNC									\
@@ -1126,7 +1194,7 @@ name##_to_kcmy_threshold(const stp_vars_t *vars,			\
 
 KCMY_TO_KCMY_THRESHOLD_FUNC(unsigned char, kcmy_8) // kcmy_8_to_kcmy_threshold
 KCMY_TO_KCMY_THRESHOLD_FUNC(unsigned short, kcmy_16) // kcmy_8_to_kcmy_threshold
-GENERIC_COLOR_FUNC(kcmy, kcmy_threshold)
+GENERIC_COLOR_FUNC(kcmy, kcmy_threshold, plan_nothing)
 
 #define GRAY_TO_COLOR_THRESHOLD_FUNC(T, name, bits, channels)		\
 CFUNC									\
@@ -1161,11 +1229,11 @@ gray_##bits##_to_##name##_threshold(const stp_vars_t *vars,		\
 
 GRAY_TO_COLOR_THRESHOLD_FUNC(unsigned char, color, 8, 3) // gray_8_to_color_threshold
 GRAY_TO_COLOR_THRESHOLD_FUNC(unsigned short, color, 16, 3) // gray_16_to_color_threshold
-GENERIC_COLOR_FUNC(gray, color_threshold)
+GENERIC_COLOR_FUNC(gray, color_threshold, plan_nothing)
 
 GRAY_TO_COLOR_THRESHOLD_FUNC(unsigned char, kcmy, 8, 4) // gray_8_to_kcmy_threshold
 GRAY_TO_COLOR_THRESHOLD_FUNC(unsigned short, kcmy, 16, 4) // gray_16_to_kcmy_threshold
-GENERIC_COLOR_FUNC(gray, kcmy_threshold)
+GENERIC_COLOR_FUNC(gray, kcmy_threshold, plan_nothing)
 
 #define COLOR_TO_COLOR_THRESHOLD_FUNC(T, name)				\
 CFUNC									\
@@ -1207,7 +1275,7 @@ name##_to_color_threshold(const stp_vars_t *vars,			\
 
 COLOR_TO_COLOR_THRESHOLD_FUNC(unsigned char, color_8) // color_8_to_color_threshold
 COLOR_TO_COLOR_THRESHOLD_FUNC(unsigned short, color_16) // color_8_to_color_threshold
-GENERIC_COLOR_FUNC(color, color_threshold)
+GENERIC_COLOR_FUNC(color, color_threshold, plan_nothing)
 
 #define COLOR_TO_GRAY_THRESHOLD_FUNC(T, name, channels, max_channels)	\
 CFUNC									\
@@ -1245,19 +1313,19 @@ name##_to_gray_threshold(const stp_vars_t *vars,			\
 
 COLOR_TO_GRAY_THRESHOLD_FUNC(unsigned char, cmyk_8, 4, 4) // cmyk_8_to_gray_threshold
 COLOR_TO_GRAY_THRESHOLD_FUNC(unsigned short, cmyk_16, 4, 4) // cmyk_16_to_gray_threshold
-GENERIC_COLOR_FUNC(cmyk, gray_threshold)
+GENERIC_COLOR_FUNC(cmyk, gray_threshold, plan_nothing)
 
 COLOR_TO_GRAY_THRESHOLD_FUNC(unsigned char, kcmy_8, 4, 4) // kcmy_8_to_gray_threshold
 COLOR_TO_GRAY_THRESHOLD_FUNC(unsigned short, kcmy_16, 4, 4) // kcmy_16_to_gray_threshold
-GENERIC_COLOR_FUNC(kcmy, gray_threshold)
+GENERIC_COLOR_FUNC(kcmy, gray_threshold, plan_nothing)
 
 COLOR_TO_GRAY_THRESHOLD_FUNC(unsigned char, color_8, 3, 3) // color_8_to_gray_threshold
 COLOR_TO_GRAY_THRESHOLD_FUNC(unsigned short, color_16, 3, 3) // color_16_to_gray_threshold
-GENERIC_COLOR_FUNC(color, gray_threshold)
+GENERIC_COLOR_FUNC(color, gray_threshold, plan_nothing)
 
 COLOR_TO_GRAY_THRESHOLD_FUNC(unsigned char, gray_8, 1, 1) // gray_8_to_gray_threshold
 COLOR_TO_GRAY_THRESHOLD_FUNC(unsigned short, gray_16, 1, 1) // gray_16_to_gray_threshold
-GENERIC_COLOR_FUNC(gray, gray_threshold)
+GENERIC_COLOR_FUNC(gray, gray_threshold, plan_nothing)
 
 #define CMYK_TO_COLOR_FUNC(namein, name2, T, bits, offset)		\
 static unsigned								\
@@ -1304,28 +1372,28 @@ namein##_##bits##_to_##name2(const stp_vars_t *vars, const unsigned char *in, \
 
 CMYK_TO_COLOR_FUNC(cmyk, color, unsigned char, 8, 0) // cmyk_8_to_color
 CMYK_TO_COLOR_FUNC(cmyk, color, unsigned short, 16, 0) // cmyk_16_to_color
-GENERIC_COLOR_FUNC(cmyk, color)
+CHAINED_COLOR_FUNC(cmyk, color, plan_color_curves)
 CMYK_TO_COLOR_FUNC(kcmy, color, unsigned char, 8, 1) // kcmy_8_to_color
 CMYK_TO_COLOR_FUNC(kcmy, color, unsigned short, 16, 1) // kcmy_16_to_color
-GENERIC_COLOR_FUNC(kcmy, color)
+CHAINED_COLOR_FUNC(kcmy, color, plan_color_curves)
 CMYK_TO_COLOR_FUNC(cmyk, color_threshold, unsigned char, 8, 0) // cmyk_8_to_color_threshold
 CMYK_TO_COLOR_FUNC(cmyk, color_threshold, unsigned short, 16, 0) // cmyk_16_to_color_threshold
-GENERIC_COLOR_FUNC(cmyk, color_threshold)
+GENERIC_COLOR_FUNC(cmyk, color_threshold, plan_nothing)
 CMYK_TO_COLOR_FUNC(kcmy, color_threshold, unsigned char, 8, 1) // kcmy_8_to_color_threshold
 CMYK_TO_COLOR_FUNC(kcmy, color_threshold, unsigned short, 16, 1) // kcmy_16_to_color_threshold
-GENERIC_COLOR_FUNC(kcmy, color_threshold)
+GENERIC_COLOR_FUNC(kcmy, color_threshold, plan_nothing)
 CMYK_TO_COLOR_FUNC(cmyk, color_fast, unsigned char, 8, 0) // cmyk_8_to_color_fast
 CMYK_TO_COLOR_FUNC(cmyk, color_fast, unsigned short, 16, 0) // cmyk_16_to_color_fast
-GENERIC_COLOR_FUNC(cmyk, color_fast)
+CHAINED_COLOR_FUNC(cmyk, color_fast, plan_fast_color_curves)
 CMYK_TO_COLOR_FUNC(kcmy, color_fast, unsigned char, 8, 1) // kcmy_8_to_color_fast
 CMYK_TO_COLOR_FUNC(kcmy, color_fast, unsigned short, 16, 1) // kcmy_16_to_color_fast
-GENERIC_COLOR_FUNC(kcmy, color_fast)
+CHAINED_COLOR_FUNC(kcmy, color_fast, plan_fast_color_curves)
 CMYK_TO_COLOR_FUNC(cmyk, color_raw, unsigned char, 8, 0) // cmyk_8_to_color_raw
 CMYK_TO_COLOR_FUNC(cmyk, color_raw, unsigned short, 16, 0) // cmyk_16_to_color_raw
-GENERIC_COLOR_FUNC(cmyk, color_raw)
+GENERIC_COLOR_FUNC(cmyk, color_raw, plan_nothing)
 CMYK_TO_COLOR_FUNC(kcmy, color_raw, unsigned char, 8, 1) // kcmy_8_to_color_raw
 CMYK_TO_COLOR_FUNC(kcmy, color_raw, unsigned short, 16, 1) // kcmy_16_to_color_raw
-GENERIC_COLOR_FUNC(kcmy, color_raw)
+GENERIC_COLOR_FUNC(kcmy, color_raw, plan_nothing)
 
 #define CMYK_TO_KCMY_FUNC(T, size)					    \
 CFUNC									    \
@@ -1343,12 +1411,8 @@ cmyk_##size##_to_kcmy(const stp_vars_t *vars,				    \
   const unsigned short *maps[4];					    \
 									    \
   for (i = 0; i < 4; i++)						    \
-    {									    \
-      stp_curve_resample(lut->channel_curves[i].curve, 65536);		    \
-      maps[i] = stp_curve_cache_get_ushort_data(&(lut->channel_curves[i])); \
-    }									    \
-  stp_curve_resample(lut->user_color_correction.curve, 1 << size);	    \
-  user = stp_curve_cache_get_ushort_data(&(lut->user_color_correction));    \
+    maps[i] = lut->channel_data[i];					    \
+  user = lut->user_data;						    \
 									    \
   memset(nz, 0, sizeof(nz));						    \
 									    \
@@ -1370,7 +1434,7 @@ cmyk_##size##_to_kcmy(const stp_vars_t *vars,				    \
 
 CMYK_TO_KCMY_FUNC(unsigned char, 8) // cmyk_8_to_kcmy
 CMYK_TO_KCMY_FUNC(unsigned short, 16) // cmyk_16_to_kcmy
-GENERIC_COLOR_FUNC(cmyk, kcmy)
+GENERIC_COLOR_FUNC(cmyk, kcmy, plan_kcmy_curves)
 
 #define KCMY_TO_KCMY_FUNC(T, size)					    \
 CFUNC									    \
@@ -1388,12 +1452,8 @@ kcmy_##size##_to_kcmy(const stp_vars_t *vars,				    \
   const unsigned short *maps[4];					    \
 									    \
   for (i = 0; i < 4; i++)						    \
-    {									    \
-      stp_curve_resample(lut->channel_curves[i].curve, 65536);		    \
-      maps[i] = stp_curve_cache_get_ushort_data(&(lut->channel_curves[i])); \
-    }									    \
-  stp_curve_resample(lut->user_color_correction.curve, 1 << size);	    \
-  user = stp_curve_cache_get_ushort_data(&(lut->user_color_correction));    \
+    maps[i] = lut->channel_data[i];					    \
+  user = lut->user_data;						    \
 									    \
   memset(nz, 0, sizeof(nz));						    \
 									    \
@@ -1414,7 +1474,7 @@ kcmy_##size##_to_kcmy(const stp_vars_t *vars,				    \
 
 KCMY_TO_KCMY_FUNC(unsigned char, 8) // kcmy_8_to_kcmy
 KCMY_TO_KCMY_FUNC(unsigned short, 16) // kcmy_16_to_kcmy
-GENERIC_COLOR_FUNC(kcmy, kcmy)
+GENERIC_COLOR_FUNC(kcmy, kcmy, plan_kcmy_curves)
 
 
 #define GRAY_TO_GRAY_FUNC(T, bits)					   \
@@ -1433,12 +1493,8 @@ gray_##bits##_to_gray(const stp_vars_t *vars,				   \
   const unsigned short *composite;					   \
   const unsigned short *user;						   \
 									   \
-  stp_curve_resample							   \
-    (stp_curve_cache_get_curve(&(lut->channel_curves[CHANNEL_K])), 65536); \
-  composite =								   \
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_K]));	   \
-  stp_curve_resample(lut->user_color_correction.curve, 1 << bits);	   \
-  user = stp_curve_cache_get_ushort_data(&(lut->user_color_correction));   \
+  composite = lut->channel_data[CHANNEL_K];				   \
+  user = lut->user_data;						   \
 									   \
   memset(out, 0, width * sizeof(unsigned short));			   \
 									   \
@@ -1459,7 +1515,7 @@ gray_##bits##_to_gray(const stp_vars_t *vars,				   \
 
 GRAY_TO_GRAY_FUNC(unsigned char, 8) // gray_8_to_gray
 GRAY_TO_GRAY_FUNC(unsigned short, 16) // gray_16_to_gray
-GENERIC_COLOR_FUNC(gray, gray)
+GENERIC_COLOR_FUNC(gray, gray, plan_gray_curves)
 
 #define COLOR_TO_GRAY_FUNC(T, bits)					      \
 CFUNC									      \
@@ -1481,12 +1537,8 @@ color_##bits##_to_gray(const stp_vars_t *vars,				      \
   const unsigned short *composite;					      \
   const unsigned short *user;						      \
 									      \
-  stp_curve_resample							      \
-    (stp_curve_cache_get_curve(&(lut->channel_curves[CHANNEL_K])), 65536);    \
-  composite =								      \
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_K]));	      \
-  stp_curve_resample(lut->user_color_correction.curve, 1 << bits);	      \
-  user = stp_curve_cache_get_ushort_data(&(lut->user_color_correction));      \
+  composite = lut->channel_data[CHANNEL_K];				      \
+  user = lut->user_data;						      \
 									      \
   if (lut->input_color_description->color_model == COLOR_BLACK)		      \
     {									      \
@@ -1515,7 +1567,7 @@ color_##bits##_to_gray(const stp_vars_t *vars,				      \
 
 COLOR_TO_GRAY_FUNC(unsigned char, 8) // color_8_to_gray
 COLOR_TO_GRAY_FUNC(unsigned short, 16) // color_16_to_gray
-GENERIC_COLOR_FUNC(color, gray)
+GENERIC_COLOR_FUNC(color, gray, plan_gray_curves)
 
 
 #define CMYK_TO_GRAY_FUNC(T, bits)					    \
@@ -1540,12 +1592,8 @@ cmyk_##bits##_to_gray(const stp_vars_t *vars,				    \
   const unsigned short *composite;					    \
   const unsigned short *user;						    \
 									    \
-  stp_curve_resample							    \
-    (stp_curve_cache_get_curve(&(lut->channel_curves[CHANNEL_K])), 65536);  \
-  composite =								    \
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_K]));	    \
-  stp_curve_resample(lut->user_color_correction.curve, 1 << bits);	    \
-  user = stp_curve_cache_get_ushort_data(&(lut->user_color_correction));    \
+  composite = lut->channel_data[CHANNEL_K];				    \
+  user = lut->user_data;						    \
 									    \
   if (lut->input_color_description->color_model == COLOR_BLACK)		    \
     {									    \
@@ -1576,7 +1624,7 @@ cmyk_##bits##_to_gray(const stp_vars_t *vars,				    \
 
 CMYK_TO_GRAY_FUNC(unsigned char, 8) // cmyk_8_to_gray
 CMYK_TO_GRAY_FUNC(unsigned short, 16) // cmyk_16_to_gray
-GENERIC_COLOR_FUNC(cmyk, gray)
+GENERIC_COLOR_FUNC(cmyk, gray, plan_gray_curves)
 
 #define KCMY_TO_GRAY_FUNC(T, bits)					    \
 CFUNC									    \
@@ -1600,12 +1648,8 @@ kcmy_##bits##_to_gray(const stp_vars_t *vars,				    \
   const unsigned short *composite;					    \
   const unsigned short *user;						    \
 									    \
-  stp_curve_resample							    \
-    (stp_curve_cache_get_curve(&(lut->channel_curves[CHANNEL_K])), 65536);  \
-  composite =								    \
-    stp_curve_cache_get_ushort_data(&(lut->channel_curves[CHANNEL_K]));	    \
-  stp_curve_resample(lut->user_color_correction.curve, 1 << bits);	    \
-  user = stp_curve_cache_get_ushort_data(&(lut->user_color_correction));    \
+  composite = lut->channel_data[CHANNEL_K];				    \
+  user = lut->user_data;						    \
 									    \
   if (lut->input_color_description->color_model == COLOR_BLACK)		    \
     {									    \
@@ -1636,7 +1680,7 @@ kcmy_##bits##_to_gray(const stp_vars_t *vars,				    \
 
 KCMY_TO_GRAY_FUNC(unsigned char, 8) // kcmy_8_to_gray
 KCMY_TO_GRAY_FUNC(unsigned short, 16) // kcmy_16_to_gray
-GENERIC_COLOR_FUNC(kcmy, gray)
+GENERIC_COLOR_FUNC(kcmy, gray, plan_gray_curves)
 
 #define GRAY_TO_GRAY_RAW_FUNC(T, bits)					\
 CFUNC									\
@@ -1667,7 +1711,7 @@ gray_##bits##_to_gray_raw(const stp_vars_t *vars,			\
 
 GRAY_TO_GRAY_RAW_FUNC(unsigned char, 8) // gray_8_to_gray_raw
 GRAY_TO_GRAY_RAW_FUNC(unsigned short, 16) // gray_16_to_gray_raw
-GENERIC_COLOR_FUNC(gray, gray_raw)
+GENERIC_COLOR_FUNC(gray, gray_raw, plan_nothing)
 
 #define COLOR_TO_GRAY_RAW_FUNC(T, bits, invertable, name2)		\
 CFUNC									\
@@ -1719,7 +1763,7 @@ color_##bits##_to_gray_##name2(const stp_vars_t *vars,			\
 
 COLOR_TO_GRAY_RAW_FUNC(unsigned char, 8, 1, raw) // color_8_to_gray_raw
 COLOR_TO_GRAY_RAW_FUNC(unsigned short, 16, 1, raw) // color_16_to_gray_raw
-GENERIC_COLOR_FUNC(color, gray_raw)
+GENERIC_COLOR_FUNC(color, gray_raw, plan_nothing)
 COLOR_TO_GRAY_RAW_FUNC(unsigned char, 8, 0, noninvert) // color_8_to_gray_noninvert
 COLOR_TO_GRAY_RAW_FUNC(unsigned short, 16, 0, noninvert) // color_16_to_gray_noninvert
 // GENERIC_COLOR_FUNC(color, gray_noninvert)
@@ -1780,7 +1824,7 @@ cmyk_##bits##_to_gray_##name2(const stp_vars_t *vars,			    \
 
 CMYK_TO_GRAY_RAW_FUNC(unsigned char, 8, 1, raw) // cmyk_8_to_gray_raw
 CMYK_TO_GRAY_RAW_FUNC(unsigned short, 16, 1, raw) // cmyk_16_to_gray_raw
-GENERIC_COLOR_FUNC(cmyk, gray_raw)
+GENERIC_COLOR_FUNC(cmyk, gray_raw, plan_nothing)
 CMYK_TO_GRAY_RAW_FUNC(unsigned char, 8, 0, noninvert) // cmyk_8_to_gray_noninvert
 CMYK_TO_GRAY_RAW_FUNC(unsigned short, 16, 0, noninvert) // cmyk_16_to_gray_noninvert
 // GENERIC_COLOR_FUNC(cmyk, gray_noninvert)
@@ -1840,7 +1884,7 @@ kcmy_##bits##_to_gray_##name2(const stp_vars_t *vars,			    \
 
 KCMY_TO_GRAY_RAW_FUNC(unsigned char, 8, 1, raw) // kcmy_8_to_gray_raw
 KCMY_TO_GRAY_RAW_FUNC(unsigned short, 16, 1, raw) // kcmy_16_to_gray_raw
-GENERIC_COLOR_FUNC(kcmy, gray_raw)
+GENERIC_COLOR_FUNC(kcmy, gray_raw, plan_nothing)
 KCMY_TO_GRAY_RAW_FUNC(unsigned char, 8, 0, noninvert) // kcmy_8_to_gray_noninvert
 KCMY_TO_GRAY_RAW_FUNC(unsigned short, 16, 0, noninvert) // kcmy_16_to_gray_noninvert
 // GENERIC_COLOR_FUNC(kcmy, gray_noninvert)
@@ -1878,7 +1922,7 @@ cmyk_##bits##_to_kcmy_raw(const stp_vars_t *vars,			\
 
 CMYK_TO_KCMY_RAW_FUNC(unsigned char, 8) // cmyk_8_to_kcmy_raw
 CMYK_TO_KCMY_RAW_FUNC(unsigned short, 16) // cmyk_16_to_kcmy_raw
-GENERIC_COLOR_FUNC(cmyk, kcmy_raw)
+GENERIC_COLOR_FUNC(cmyk, kcmy_raw, plan_nothing)
 
 #define KCMY_TO_KCMY_RAW_FUNC(T, bits)					\
 CFUNC									\
@@ -1912,7 +1956,7 @@ kcmy_##bits##_to_kcmy_raw(const stp_vars_t *vars,			\
 
 KCMY_TO_KCMY_RAW_FUNC(unsigned char, 8) // kcmy_8_to_kcmy_raw
 KCMY_TO_KCMY_RAW_FUNC(unsigned short, 16) // kcmy_16_to_kcmy_raw
-GENERIC_COLOR_FUNC(kcmy, kcmy_raw)
+GENERIC_COLOR_FUNC(kcmy, kcmy_raw, plan_nothing)
 
 #define DESATURATED_FUNC(name, name2, bits)				   \
 CFUNC									   \
@@ -1934,40 +1978,39 @@ name##_##bits##_to_##name2##_desaturated(const stp_vars_t *vars,	   \
 
 DESATURATED_FUNC(color, color, 8) // color_8_to_color_desaturated
 DESATURATED_FUNC(color, color, 16) // color_16_to_color_desaturated
-GENERIC_COLOR_FUNC(color, color_desaturated)
+CHAINED_COLOR_FUNC(color, color_desaturated, plan_gray_to_color_curves)
 DESATURATED_FUNC(color, kcmy, 8) // color_8_to_kcmy_desaturated
 DESATURATED_FUNC(color, kcmy, 16) // color_8_to_kcmy_desaturated
-GENERIC_COLOR_FUNC(color, kcmy_desaturated)
+CHAINED_COLOR_FUNC(color, kcmy_desaturated, plan_gray_to_color_curves)
 
 DESATURATED_FUNC(cmyk, color, 8) // cmyk_8_to_color_desaturated
 DESATURATED_FUNC(cmyk, color, 16) // cmyk_16_to_color_desaturated
-GENERIC_COLOR_FUNC(cmyk, color_desaturated)
+CHAINED_COLOR_FUNC(cmyk, color_desaturated, plan_gray_to_color_curves)
 DESATURATED_FUNC(cmyk, kcmy, 8) // cmyk_8_to_kcmy_desaturated
 DESATURATED_FUNC(cmyk, kcmy, 16) // cmyk_16_to_kcmy_desaturated
-GENERIC_COLOR_FUNC(cmyk, kcmy_desaturated)
+CHAINED_COLOR_FUNC(cmyk, kcmy_desaturated, plan_gray_to_color_curves)
 
 DESATURATED_FUNC(kcmy, color, 8) // kcmy_8_to_color_desaturated
 DESATURATED_FUNC(kcmy, color, 16) // kcmy_16_to_kcmy_desaturated
-GENERIC_COLOR_FUNC(kcmy, color_desaturated)
+CHAINED_COLOR_FUNC(kcmy, color_desaturated, plan_gray_to_color_curves)
 DESATURATED_FUNC(kcmy, kcmy, 8) // kcmy_8_to_color_desaturated
 DESATURATED_FUNC(kcmy, kcmy, 16) // kcmy_16_to_kcmy_desaturated
-GENERIC_COLOR_FUNC(kcmy, kcmy_desaturated)
+CHAINED_COLOR_FUNC(kcmy, kcmy_desaturated, plan_gray_to_color_curves)
 
 #define CMYK_DISPATCH(name)						\
-CFUNC									\
-CMYK_to_##name(const stp_vars_t *vars, const unsigned char *in,		\
-	       unsigned short *out)					\
+static stp_convert_t							\
+CMYK_to_##name(const stp_vars_t *vars)					\
 {									\
   lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
   if (lut->input_color_description->color_id == COLOR_ID_CMYK)		\
-    return cmyk_to_##name(vars, in, out);				\
+    return cmyk_to_##name(vars);					\
   else if (lut->input_color_description->color_id == COLOR_ID_KCMY)	\
-    return kcmy_to_##name(vars, in, out);				\
+    return kcmy_to_##name(vars);					\
   else									\
     {									\
       stp_eprintf(vars, "Bad dispatch to CMYK_to_%s: %d\n", #name,	\
 		  lut->input_color_description->color_id);		\
-      return 0;								\
+      return NULL;							\
     }									\
 }
 
@@ -2022,7 +2065,7 @@ name##_to_raw_threshold(const stp_vars_t *vars,				\
 
 RAW_TO_RAW_THRESHOLD_FUNC(unsigned char, raw_8) // raw_8_to_raw_threshold
 RAW_TO_RAW_THRESHOLD_FUNC(unsigned short, raw_16) // raw_16_to_raw_threshold
-GENERIC_COLOR_FUNC(raw, raw_threshold)
+GENERIC_COLOR_FUNC(raw, raw_threshold, plan_nothing)
 
 #define RAW_TO_RAW_FUNC(T, size)					    \
 CFUNC									    \
@@ -2040,12 +2083,8 @@ raw_##size##_to_raw(const stp_vars_t *vars,				    \
   const unsigned short *user;						    \
 									    \
   for (i = 0; i < lut->out_channels; i++)				    \
-    {									    \
-      stp_curve_resample(lut->channel_curves[i].curve, 65536);		    \
-      maps[i] = stp_curve_cache_get_ushort_data(&(lut->channel_curves[i])); \
-    }									    \
-  stp_curve_resample(lut->user_color_correction.curve, 1 << size);	    \
-  user = stp_curve_cache_get_ushort_data(&(lut->user_color_correction));    \
+    maps[i] = lut->channel_data[i];					    \
+  user = lut->user_data;						    \
 									    \
   memset(nz, 0, sizeof(nz));						    \
 									    \
@@ -2066,7 +2105,7 @@ raw_##size##_to_raw(const stp_vars_t *vars,				    \
 
 RAW_TO_RAW_FUNC(unsigned char, 8) // raw_8_to_raw
 RAW_TO_RAW_FUNC(unsigned short, 16) // raw_8_to_raw
-GENERIC_COLOR_FUNC(raw, raw)
+GENERIC_COLOR_FUNC(raw, raw, plan_raw_curves)
 
 
 #define RAW_TO_RAW_RAW_FUNC(T, bits)					\
@@ -2102,14 +2141,12 @@ raw_##bits##_to_raw_raw(const stp_vars_t *vars,				\
 
 RAW_TO_RAW_RAW_FUNC(unsigned char, 8) // raw_8_to_raw_raw
 RAW_TO_RAW_RAW_FUNC(unsigned short, 16) // raw_16_to_raw_raw
-GENERIC_COLOR_FUNC(raw, raw_raw)
+GENERIC_COLOR_FUNC(raw, raw_raw, plan_nothing)
 
 
 #define CONVERSION_FUNCTION_WITH_FAST(from, to, from2)			\
-CFUNC									\
-generic_##from##_to_##to(const stp_vars_t *v,				\
-			 const unsigned char *in,			\
-			 unsigned short *out)				\
+static stp_convert_t							\
+generic_##from##_to_##to(const stp_vars_t *v)				\
 {									\
   lut_t *lut = (lut_t *)(stp_get_component_data(v, "Color"));		\
   switch (lut->color_correction->correction)				\
@@ -2117,37 +2154,35 @@ generic_##from##_to_##to(const stp_vars_t *v,				\
     case COLOR_CORRECTION_UNCORRECTED:					\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s_fast\n", #from2, #to);		\
-      return from2##_to_##to##_fast(v, in, out);			\
+      return from2##_to_##to##_fast(v);					\
     case COLOR_CORRECTION_ACCURATE:					\
     case COLOR_CORRECTION_BRIGHT:					\
     case COLOR_CORRECTION_HUE:						\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s\n", #from2, #to);		\
-      return from2##_to_##to(v, in, out);				\
+      return from2##_to_##to(v);					\
     case COLOR_CORRECTION_DESATURATED:					\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s_desaturated\n", #from2, #to);	\
-      return from2##_to_##to##_desaturated(v, in, out);			\
+      return from2##_to_##to##_desaturated(v);				\
     case COLOR_CORRECTION_THRESHOLD:					\
     case COLOR_CORRECTION_PREDITHERED:					\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s_threshold\n", #from2, #to);	\
-      return from2##_to_##to##_threshold(v, in, out);			\
+      return from2##_to_##to##_threshold(v);				\
     case COLOR_CORRECTION_DENSITY:					\
     case COLOR_CORRECTION_RAW:						\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s_raw\n", #from2, #to);		\
-      return from2##_to_##to##_raw(v, in, out);				\
+      return from2##_to_##to##_raw(v);					\
     default:								\
-      return (unsigned) -1;						\
+      return NULL;							\
     }									\
 }
 
 #define CONVERSION_FUNCTION_WITHOUT_FAST(from, to, from2)		\
-CFUNC									\
-generic_##from##_to_##to(const stp_vars_t *v,				\
-			 const unsigned char *in,			\
-			 unsigned short *out)				\
+static stp_convert_t							\
+generic_##from##_to_##to(const stp_vars_t *v)				\
 {									\
   lut_t *lut = (lut_t *)(stp_get_component_data(v, "Color"));		\
   switch (lut->color_correction->correction)				\
@@ -2158,31 +2193,29 @@ generic_##from##_to_##to(const stp_vars_t *v,				\
     case COLOR_CORRECTION_HUE:						\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s\n", #from2, #to);		\
-      return from2##_to_##to(v, in, out);				\
+      return from2##_to_##to(v);					\
     case COLOR_CORRECTION_DESATURATED:					\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s_desaturated\n", #from2, #to);	\
-      return from2##_to_##to##_desaturated(v, in, out);			\
+      return from2##_to_##to##_desaturated(v);				\
     case COLOR_CORRECTION_THRESHOLD:					\
     case COLOR_CORRECTION_PREDITHERED:					\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s_threshold\n", #from2, #to);	\
-      return from2##_to_##to##_threshold(v, in, out);			\
+      return from2##_to_##to##_threshold(v);				\
     case COLOR_CORRECTION_DENSITY:					\
     case COLOR_CORRECTION_RAW:						\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s_raw\n", #from2, #to);		\
-      return from2##_to_##to##_raw(v, in, out);				\
+      return from2##_to_##to##_raw(v);					\
     default:								\
-      return (unsigned) -1;						\
+      return NULL;							\
     }									\
 }
 
 #define CONVERSION_FUNCTION_WITHOUT_DESATURATED(from, to, from2)	\
-CFUNC									\
-generic_##from##_to_##to(const stp_vars_t *v,				\
-			 const unsigned char *in,			\
-			 unsigned short *out)				\
+static stp_convert_t							\
+generic_##from##_to_##to(const stp_vars_t *v)				\
 {									\
   lut_t *lut = (lut_t *)(stp_get_component_data(v, "Color"));		\
   switch (lut->color_correction->correction)				\
@@ -2194,19 +2227,19 @@ generic_##from##_to_##to(const stp_vars_t *v,				\
     case COLOR_CORRECTION_DESATURATED:					\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s\n", #from2, #to);		\
-      return from2##_to_##to(v, in, out);				\
+      return from2##_to_##to(v);					\
     case COLOR_CORRECTION_THRESHOLD:					\
     case COLOR_CORRECTION_PREDITHERED:					\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s_threshold\n", #from2, #to);	\
-      return from2##_to_##to##_threshold(v, in, out);			\
+      return from2##_to_##to##_threshold(v);				\
     case COLOR_CORRECTION_DENSITY:					\
     case COLOR_CORRECTION_RAW:						\
       stp_dprintf(STP_DBG_COLORFUNC, v,					\
 		  "Colorfunc: %s_to_%s_raw\n", #from2, #to);		\
-      return from2##_to_##to##_raw(v, in, out);				\
+      return from2##_to_##to##_raw(v);					\
     default:								\
-      return (unsigned) -1;						\
+      return NULL;							\
     }									\
 }
 
@@ -2220,76 +2253,68 @@ CONVERSION_FUNCTION_WITHOUT_DESATURATED(gray, gray, gray) // generic_gray_to_gra
 CONVERSION_FUNCTION_WITHOUT_DESATURATED(gray, color, gray) // generic_gray_to_color
 CONVERSION_FUNCTION_WITHOUT_DESATURATED(gray, kcmy, gray) // generic_gray_to_kcmy
 
-unsigned
-stpi_color_convert_to_gray(const stp_vars_t *v,
-			   const unsigned char *in,
-			   unsigned short *out)
+stp_convert_t
+stpi_color_convert_to_gray(const stp_vars_t *v)
 {
   lut_t *lut = (lut_t *)(stp_get_component_data(v, "Color"));
   switch (lut->input_color_description->color_id)
     {
     case COLOR_ID_GRAY:
     case COLOR_ID_WHITE:
-      return generic_gray_to_gray(v, in, out);
+      return generic_gray_to_gray(v);
     case COLOR_ID_RGB:
     case COLOR_ID_CMY:
-      return generic_color_to_gray(v, in, out);
+      return generic_color_to_gray(v);
     case COLOR_ID_CMYK:
     case COLOR_ID_KCMY:
-      return generic_cmyk_to_gray(v, in, out);
+      return generic_cmyk_to_gray(v);
     default:
-      return (unsigned) -1;
+      return NULL;
     }
 }
 
-unsigned
-stpi_color_convert_to_color(const stp_vars_t *v,
-			    const unsigned char *in,
-			    unsigned short *out)
+stp_convert_t
+stpi_color_convert_to_color(const stp_vars_t *v)
 {
   lut_t *lut = (lut_t *)(stp_get_component_data(v, "Color"));
   switch (lut->input_color_description->color_id)
     {
     case COLOR_ID_GRAY:
     case COLOR_ID_WHITE:
-      return generic_gray_to_color(v, in, out);
+      return generic_gray_to_color(v);
     case COLOR_ID_RGB:
     case COLOR_ID_CMY:
-      return generic_color_to_color(v, in, out);
+      return generic_color_to_color(v);
     case COLOR_ID_CMYK:
     case COLOR_ID_KCMY:
-      return generic_cmyk_to_color(v, in, out);
+      return generic_cmyk_to_color(v);
     default:
-      return (unsigned) -1;
+      return NULL;
     }
 }
 
-unsigned
-stpi_color_convert_to_kcmy(const stp_vars_t *v,
-			   const unsigned char *in,
-			   unsigned short *out)
+stp_convert_t
+stpi_color_convert_to_kcmy(const stp_vars_t *v)
 {
   lut_t *lut = (lut_t *)(stp_get_component_data(v, "Color"));
   switch (lut->input_color_description->color_id)
     {
     case COLOR_ID_GRAY:
     case COLOR_ID_WHITE:
-      return generic_gray_to_kcmy(v, in, out);
+      return generic_gray_to_kcmy(v);
     case COLOR_ID_RGB:
     case COLOR_ID_CMY:
-      return generic_color_to_kcmy(v, in, out);
+      return generic_color_to_kcmy(v);
     case COLOR_ID_CMYK:
     case COLOR_ID_KCMY:
-      return generic_cmyk_to_kcmy(v, in, out);
+      return generic_cmyk_to_kcmy(v);
     default:
-      return (unsigned) -1;
+      return NULL;
     }
 }
 
-unsigned
-stpi_color_convert_raw(const stp_vars_t *v,
-		       const unsigned char *in,
-		       unsigned short *out)
+stp_convert_t
+stpi_color_convert_raw(const stp_vars_t *v)
 {
   lut_t *lut = (lut_t *)(stp_get_component_data(v, "Color"));
   switch (lut->color_correction->correction)
@@ -2297,20 +2322,20 @@ stpi_color_convert_raw(const stp_vars_t *v,
     case COLOR_CORRECTION_THRESHOLD:
     case COLOR_CORRECTION_PREDITHERED:
       stp_dprintf(STP_DBG_COLORFUNC, v, "Colorfunc: raw_to_raw_threshold\n");
-      return raw_to_raw_threshold(v, in, out);
+      return raw_to_raw_threshold(v);
     case COLOR_CORRECTION_UNCORRECTED:
     case COLOR_CORRECTION_BRIGHT:
     case COLOR_CORRECTION_HUE:
     case COLOR_CORRECTION_ACCURATE:
     case COLOR_CORRECTION_DESATURATED:
       stp_dprintf(STP_DBG_COLORFUNC, v, "Colorfunc: raw_to_raw_desaturated\n");
-      return raw_to_raw(v, in, out);
+      return raw_to_raw(v);
     case COLOR_CORRECTION_RAW:
     case COLOR_CORRECTION_DEFAULT:
     case COLOR_CORRECTION_DENSITY:
       stp_dprintf(STP_DBG_COLORFUNC, v, "Colorfunc: raw_to_raw_raw\n");
-      return raw_to_raw_raw(v, in, out);
+      return raw_to_raw_raw(v);
     default:
-      return (unsigned) -1;
+      return NULL;
     }
 }
@@ -0,0 +1,853 @@
+/*
+ *
+ *   Gutenprint color management module - vectorized conversions.
+ *
+ *   Copyright 2026 the Gutenprint project
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Vector versions of the RGB conversion kernels in color-conversions.c
+ * that don't need per-pixel floating point.  Each kernel produces
+ * exactly the same output and return value as its scalar counterpart,
+ * eight pixels at a time, and finishes the row with scalar code.
+ *
+ * The stpi_color_simd_* functions are called when the conversion is
+ * planned; they return the best kernel that the CPU supports, or NULL
+ * if the scalar kernel should be used.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <gutenprint/gutenprint.h>
+#include "gutenprint-internal.h"
+#include <gutenprint/gutenprint-intl-internal.h>
+#include <string.h>
+#include "color-conversion.h"
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#define MAXB(bits) ((1 << (bits)) - 1)
+#define BD(bits) (65535u / (unsigned) MAXB(bits))
+
+#if defined(HAVE_X86_SIMD) || defined(__ARM_NEON)
+
+/*
+ * Scalar code for the pixels left over at the end of a row.  These
+ * must match the kernels in color-conversions.c.
+ */
+
+#define SCALAR_COLOR_TO_KCMY_RAW(T, bits)				\
+static void								\
+scalar_##bits##_to_kcmy_raw(const T *s_in, unsigned short *out, int count, \
+			    unsigned scale, unsigned mask, unsigned *nz) \
+{									\
+  int i;								\
+  for (i = 0; i < count; i++, out += 4, s_in += 3)			\
+    {									\
+      unsigned c = (s_in[0] * scale) ^ mask;				\
+      unsigned m = (s_in[1] * scale) ^ mask;				\
+      unsigned y = (s_in[2] * scale) ^ mask;				\
+      unsigned k = c < m ? (c < y ? c : y) : (m < y ? m : y);		\
+      out[0] = k;							\
+      out[1] = c - k;							\
+      out[2] = m - k;							\
+      out[3] = y - k;							\
+      nz[0] |= out[0];							\
+      nz[1] |= out[1];							\
+      nz[2] |= out[2];							\
+      nz[3] |= out[3];							\
+    }									\
+}
+
+#define SCALAR_COLOR_TO_COLOR_RAW(T, bits)				\
+static unsigned								\
+scalar_##bits##_to_color_raw(const T *s_in, unsigned short *out,	\
+			     int count, unsigned scale, unsigned mask)	\
+{									\
+  int i;								\
+  unsigned nz = 0;							\
+  for (i = 0; i < count * 3; i++)					\
+    {									\
+      out[i] = (s_in[i] * scale) ^ mask;				\
+      if (out[i])							\
+	nz |= 1 << (i % 3);						\
+    }									\
+  return nz;								\
+}
+
+#define SCALAR_COLOR_TO_KCMY_THRESHOLD(T, bits)			\
+static unsigned								\
+scalar_##bits##_to_kcmy_threshold(const T *s_in, unsigned short *out,	\
+				  int count, unsigned mask)		\
+{									\
+  int i;								\
+  unsigned z = 15;							\
+  unsigned high_bit = ((1 << ((sizeof(T) * 8) - 1)));			\
+  for (i = 0; i < count; i++, out += 4, s_in += 3)			\
+    {									\
+      unsigned c = s_in[0] ^ mask;					\
+      unsigned m = s_in[1] ^ mask;					\
+      unsigned y = s_in[2] ^ mask;					\
+      unsigned k = (c < m ? (c < y ? c : y) : (m < y ? m : y));		\
+      if (k >= high_bit)						\
+	{								\
+	  c -= k;							\
+	  m -= k;							\
+	  y -= k;							\
+	  z &= 0xe;							\
+	  out[0] = 65535;						\
+	}								\
+      if (c >= high_bit)						\
+	{								\
+	  z &= 0xd;							\
+	  out[1] = 65535;						\
+	}								\
+      if (m >= high_bit)						\
+	{								\
+	  z &= 0xb;							\
+	  out[2] = 65535;						\
+	}								\
+      if (y >= high_bit)						\
+	{								\
+	  z &= 0x7;							\
+	  out[3] = 65535;						\
+	}								\
+    }									\
+  return z;								\
+}
+
+SCALAR_COLOR_TO_KCMY_RAW(unsigned char, 8)
+SCALAR_COLOR_TO_KCMY_RAW(unsigned short, 16)
+SCALAR_COLOR_TO_COLOR_RAW(unsigned char, 8)
+SCALAR_COLOR_TO_COLOR_RAW(unsigned short, 16)
+SCALAR_COLOR_TO_KCMY_THRESHOLD(unsigned char, 8)
+SCALAR_COLOR_TO_KCMY_THRESHOLD(unsigned short, 16)
+
+static unsigned
+zero_mask(const unsigned *nz, int channels)
+{
+  int i;
+  unsigned retval = 0;
+  for (i = 0; i < channels; i++)
+    if (nz[i] == 0)
+      retval |= (1 << i);
+  return retval;
+}
+
+#endif
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * The fast (uncorrected) conversions look each channel up in its
+ * contrast curve and then in its output curve.  Without a saturation
+ * or brightness adjustment in between, the two lookups collapse into
+ * one table per channel, which is what the vector kernels gather from.
+ */
+static int
+plan_composite_tables(lut_t *lut)
+{
+  int i, j;
+  int steps = 1 << lut->channel_depth;
+  int compute_saturation =
+    lut->saturation <= .99999 || lut->saturation >= 1.00001;
+  if (lut->user_brightness != 1)
+    compute_saturation = 1;
+  if (compute_saturation || !lut->contrast_data)
+    return 0;
+  for (i = CHANNEL_C; i <= CHANNEL_Y; i++)
+    if (!lut->channel_data[i])
+      return 0;
+  if (!lut->simd_tables)
+    lut->simd_tables = stp_malloc(3 * steps * sizeof(unsigned));
+  for (i = 0; i < 3; i++)
+    {
+      const unsigned short *curve = lut->channel_data[CHANNEL_C + i];
+      unsigned *table = lut->simd_tables + i * steps;
+      for (j = 0; j < steps; j++)
+	table[j] = curve[lut->contrast_data[j]];
+    }
+  return 1;
+}
+
+#define SSE41 __attribute__((target("sse4.1")))
+#define AVX2 __attribute__((target("avx2")))
+
+/*
+ * Split eight interleaved RGB pixels into one vector per channel.
+ */
+static inline SSE41 void
+sse41_load_rgb_8(const unsigned char *s_in, __m128i *c, __m128i *m, __m128i *y)
+{
+  __m128i a = _mm_loadu_si128((const __m128i *) s_in);
+  __m128i b = _mm_loadl_epi64((const __m128i *) (s_in + 16));
+  *c = _mm_or_si128
+    (_mm_shuffle_epi8(a, _mm_setr_epi8(0, -1, 3, -1, 6, -1, 9, -1,
+				       12, -1, 15, -1, -1, -1, -1, -1)),
+     _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+				       -1, -1, -1, -1, 2, -1, 5, -1)));
+  *m = _mm_or_si128
+    (_mm_shuffle_epi8(a, _mm_setr_epi8(1, -1, 4, -1, 7, -1, 10, -1,
+				       13, -1, -1, -1, -1, -1, -1, -1)),
+     _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+				       -1, -1, 0, -1, 3, -1, 6, -1)));
+  *y = _mm_or_si128
+    (_mm_shuffle_epi8(a, _mm_setr_epi8(2, -1, 5, -1, 8, -1, 11, -1,
+				       14, -1, -1, -1, -1, -1, -1, -1)),
+     _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+				       -1, -1, 1, -1, 4, -1, 7, -1)));
+}
+
+static inline SSE41 void
+sse41_load_rgb_16(const unsigned short *s_in,
+		  __m128i *c, __m128i *m, __m128i *y)
+{
+  __m128i a = _mm_loadu_si128((const __m128i *) s_in);
+  __m128i b = _mm_loadu_si128((const __m128i *) (s_in + 8));
+  __m128i d = _mm_loadu_si128((const __m128i *) (s_in + 16));
+  *c = _mm_or_si128
+    (_mm_or_si128
+     (_mm_shuffle_epi8(a, _mm_setr_epi8(0, 1, 6, 7, 12, 13, -1, -1,
+					-1, -1, -1, -1, -1, -1, -1, -1)),
+      _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 3,
+					8, 9, 14, 15, -1, -1, -1, -1))),
+     _mm_shuffle_epi8(d, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+				       -1, -1, -1, -1, 4, 5, 10, 11)));
+  *m = _mm_or_si128
+    (_mm_or_si128
+     (_mm_shuffle_epi8(a, _mm_setr_epi8(2, 3, 8, 9, 14, 15, -1, -1,
+					-1, -1, -1, -1, -1, -1, -1, -1)),
+      _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 4, 5,
+					10, 11, -1, -1, -1, -1, -1, -1))),
+     _mm_shuffle_epi8(d, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+				       -1, -1, 0, 1, 6, 7, 12, 13)));
+  *y = _mm_or_si128
+    (_mm_or_si128
+     (_mm_shuffle_epi8(a, _mm_setr_epi8(4, 5, 10, 11, -1, -1, -1, -1,
+					-1, -1, -1, -1, -1, -1, -1, -1)),
+      _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, 0, 1, 6, 7,
+					12, 13, -1, -1, -1, -1, -1, -1))),
+     _mm_shuffle_epi8(d, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+				       -1, -1, 2, 3, 8, 9, 14, 15)));
+}
+
+/*
+ * Widen the next 24 samples (eight pixels) to 16 bits, in order.
+ */
+static inline SSE41 void
+sse41_load_samples_8(const unsigned char *s_in, __m128i *v)
+{
+  __m128i a = _mm_loadu_si128((const __m128i *) s_in);
+  v[0] = _mm_cvtepu8_epi16(a);
+  v[1] = _mm_cvtepu8_epi16(_mm_srli_si128(a, 8));
+  v[2] = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (s_in + 16)));
+}
+
+static inline SSE41 void
+sse41_load_samples_16(const unsigned short *s_in, __m128i *v)
+{
+  v[0] = _mm_loadu_si128((const __m128i *) s_in);
+  v[1] = _mm_loadu_si128((const __m128i *) (s_in + 8));
+  v[2] = _mm_loadu_si128((const __m128i *) (s_in + 16));
+}
+
+static inline SSE41 void
+sse41_store_kcmy(unsigned short *out, __m128i k, __m128i c, __m128i m,
+		 __m128i y)
+{
+  __m128i kc_lo = _mm_unpacklo_epi16(k, c);
+  __m128i kc_hi = _mm_unpackhi_epi16(k, c);
+  __m128i my_lo = _mm_unpacklo_epi16(m, y);
+  __m128i my_hi = _mm_unpackhi_epi16(m, y);
+  _mm_storeu_si128((__m128i *) out, _mm_unpacklo_epi32(kc_lo, my_lo));
+  _mm_storeu_si128((__m128i *) (out + 8), _mm_unpackhi_epi32(kc_lo, my_lo));
+  _mm_storeu_si128((__m128i *) (out + 16), _mm_unpacklo_epi32(kc_hi, my_hi));
+  _mm_storeu_si128((__m128i *) (out + 24), _mm_unpackhi_epi32(kc_hi, my_hi));
+}
+
+static inline SSE41 void
+sse41_store_rgb(unsigned short *out, __m128i c, __m128i m, __m128i y)
+{
+  _mm_storeu_si128
+    ((__m128i *) out,
+     _mm_or_si128
+     (_mm_or_si128
+      (_mm_shuffle_epi8(c, _mm_setr_epi8(0, 1, -1, -1, -1, -1, 2, 3,
+					 -1, -1, -1, -1, 4, 5, -1, -1)),
+       _mm_shuffle_epi8(m, _mm_setr_epi8(-1, -1, 0, 1, -1, -1, -1, -1,
+					 2, 3, -1, -1, -1, -1, 4, 5))),
+      _mm_shuffle_epi8(y, _mm_setr_epi8(-1, -1, -1, -1, 0, 1, -1, -1,
+					-1, -1, 2, 3, -1, -1, -1, -1))));
+  _mm_storeu_si128
+    ((__m128i *) (out + 8),
+     _mm_or_si128
+     (_mm_or_si128
+      (_mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, 6, 7, -1, -1, -1, -1,
+					 8, 9, -1, -1, -1, -1, 10, 11)),
+       _mm_shuffle_epi8(m, _mm_setr_epi8(-1, -1, -1, -1, 6, 7, -1, -1,
+					 -1, -1, 8, 9, -1, -1, -1, -1))),
+      _mm_shuffle_epi8(y, _mm_setr_epi8(4, 5, -1, -1, -1, -1, 6, 7,
+					-1, -1, -1, -1, 8, 9, -1, -1))));
+  _mm_storeu_si128
+    ((__m128i *) (out + 16),
+     _mm_or_si128
+     (_mm_or_si128
+      (_mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, 12, 13, -1, -1,
+					 -1, -1, 14, 15, -1, -1, -1, -1)),
+       _mm_shuffle_epi8(m, _mm_setr_epi8(10, 11, -1, -1, -1, -1, 12, 13,
+					 -1, -1, -1, -1, 14, 15, -1, -1))),
+      _mm_shuffle_epi8(y, _mm_setr_epi8(-1, -1, 10, 11, -1, -1, -1, -1,
+					12, 13, -1, -1, -1, -1, 14, 15))));
+}
+
+static inline SSE41 unsigned
+sse41_nonzero(__m128i v)
+{
+  return !_mm_testz_si128(v, v);
+}
+
+#define SSE41_COLOR_TO_KCMY_RAW_FUNC(T, bits)				\
+static SSE41 unsigned							\
+sse41_color_##bits##_to_kcmy_raw(const stp_vars_t *vars,		\
+				 const unsigned char *in,		\
+				 unsigned short *out)			\
+{									\
+  int i;								\
+  const T *s_in = (const T *) in;					\
+  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
+  int width = lut->image_width;						\
+  unsigned mask = lut->invert_output ? 0xffff : 0;			\
+  unsigned nz[4] = { 0, 0, 0, 0 };					\
+  __m128i vmask = _mm_set1_epi16(mask);					\
+  __m128i vscale = _mm_set1_epi16(BD(bits));				\
+  __m128i nzk = _mm_setzero_si128();					\
+  __m128i nzc = nzk, nzm = nzk, nzy = nzk;				\
+									\
+  for (i = 0; i + 8 <= width; i += 8, s_in += 24, out += 32)		\
+    {									\
+      __m128i c, m, y, k;						\
+      sse41_load_rgb_##bits(s_in, &c, &m, &y);				\
+      c = _mm_xor_si128(_mm_mullo_epi16(c, vscale), vmask);		\
+      m = _mm_xor_si128(_mm_mullo_epi16(m, vscale), vmask);		\
+      y = _mm_xor_si128(_mm_mullo_epi16(y, vscale), vmask);		\
+      k = _mm_min_epu16(c, _mm_min_epu16(m, y));			\
+      c = _mm_sub_epi16(c, k);						\
+      m = _mm_sub_epi16(m, k);						\
+      y = _mm_sub_epi16(y, k);						\
+      sse41_store_kcmy(out, k, c, m, y);				\
+      nzk = _mm_or_si128(nzk, k);					\
+      nzc = _mm_or_si128(nzc, c);					\
+      nzm = _mm_or_si128(nzm, m);					\
+      nzy = _mm_or_si128(nzy, y);					\
+    }									\
+  scalar_##bits##_to_kcmy_raw(s_in, out, width - i, BD(bits), mask, nz);	\
+  nz[0] |= sse41_nonzero(nzk);						\
+  nz[1] |= sse41_nonzero(nzc);						\
+  nz[2] |= sse41_nonzero(nzm);						\
+  nz[3] |= sse41_nonzero(nzy);						\
+  return zero_mask(nz, 4);						\
+}
+
+SSE41_COLOR_TO_KCMY_RAW_FUNC(unsigned char, 8)
+SSE41_COLOR_TO_KCMY_RAW_FUNC(unsigned short, 16)
+
+#define SSE41_COLOR_TO_COLOR_RAW_FUNC(T, bits)				\
+static SSE41 unsigned							\
+sse41_color_##bits##_to_color_raw(const stp_vars_t *vars,		\
+				  const unsigned char *in,		\
+				  unsigned short *out)			\
+{									\
+  int i, j;								\
+  const T *s_in = (const T *) in;					\
+  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
+  int width = lut->image_width;						\
+  unsigned mask = lut->invert_output ? 0xffff : 0;			\
+  unsigned nz;								\
+  unsigned short lanes[24];						\
+  __m128i vmask = _mm_set1_epi16(mask);					\
+  __m128i vscale = _mm_set1_epi16(BD(bits));				\
+  __m128i acc[3];							\
+  acc[0] = acc[1] = acc[2] = _mm_setzero_si128();			\
+									\
+  for (i = 0; i + 8 <= width; i += 8, s_in += 24, out += 24)		\
+    {									\
+      __m128i v[3];							\
+      sse41_load_samples_##bits(s_in, v);				\
+      for (j = 0; j < 3; j++)						\
+	{								\
+	  v[j] = _mm_xor_si128(_mm_mullo_epi16(v[j], vscale), vmask);	\
+	  _mm_storeu_si128((__m128i *) (out + 8 * j), v[j]);		\
+	  acc[j] = _mm_or_si128(acc[j], v[j]);				\
+	}								\
+    }									\
+  nz = scalar_##bits##_to_color_raw(s_in, out, width - i, BD(bits), mask);	\
+  for (j = 0; j < 3; j++)						\
+    _mm_storeu_si128((__m128i *) (lanes + 8 * j), acc[j]);		\
+  for (j = 0; j < 24; j++)						\
+    if (lanes[j])							\
+      nz |= 1 << (j % 3);						\
+  return nz;								\
+}
+
+SSE41_COLOR_TO_COLOR_RAW_FUNC(unsigned char, 8)
+SSE41_COLOR_TO_COLOR_RAW_FUNC(unsigned short, 16)
+
+#define SSE41_COLOR_TO_KCMY_THRESHOLD_FUNC(T, bits)			\
+static SSE41 unsigned							\
+sse41_color_##bits##_to_kcmy_threshold(const stp_vars_t *vars,		\
+				       const unsigned char *in,		\
+				       unsigned short *out)		\
+{									\
+  int i;								\
+  unsigned z;								\
+  const T *s_in = (const T *) in;					\
+  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
+  int width = lut->image_width;						\
+  unsigned mask = lut->invert_output ? MAXB(bits) : 0;			\
+  __m128i vmask = _mm_set1_epi16(mask);					\
+  __m128i high_bit = _mm_set1_epi16(1 << (bits - 1));			\
+  __m128i nzk = _mm_setzero_si128();					\
+  __m128i nzc = nzk, nzm = nzk, nzy = nzk;				\
+  memset(out, 0, width * 4 * sizeof(unsigned short));			\
+									\
+  for (i = 0; i + 8 <= width; i += 8, s_in += 24, out += 32)		\
+    {									\
+      __m128i c, m, y, k, kk;						\
+      sse41_load_rgb_##bits(s_in, &c, &m, &y);				\
+      c = _mm_xor_si128(c, vmask);					\
+      m = _mm_xor_si128(m, vmask);					\
+      y = _mm_xor_si128(y, vmask);					\
+      kk = _mm_min_epu16(c, _mm_min_epu16(m, y));			\
+      k = _mm_cmpeq_epi16(_mm_and_si128(kk, high_bit), high_bit);	\
+      kk = _mm_and_si128(kk, k);					\
+      c = _mm_sub_epi16(c, kk);						\
+      m = _mm_sub_epi16(m, kk);						\
+      y = _mm_sub_epi16(y, kk);						\
+      c = _mm_cmpeq_epi16(_mm_and_si128(c, high_bit), high_bit);	\
+      m = _mm_cmpeq_epi16(_mm_and_si128(m, high_bit), high_bit);	\
+      y = _mm_cmpeq_epi16(_mm_and_si128(y, high_bit), high_bit);	\
+      sse41_store_kcmy(out, k, c, m, y);				\
+      nzk = _mm_or_si128(nzk, k);					\
+      nzc = _mm_or_si128(nzc, c);					\
+      nzm = _mm_or_si128(nzm, m);					\
+      nzy = _mm_or_si128(nzy, y);					\
+    }									\
+  z = scalar_##bits##_to_kcmy_threshold(s_in, out, width - i, mask);	\
+  if (sse41_nonzero(nzk))						\
+    z &= 0xe;								\
+  if (sse41_nonzero(nzc))						\
+    z &= 0xd;								\
+  if (sse41_nonzero(nzm))						\
+    z &= 0xb;								\
+  if (sse41_nonzero(nzy))						\
+    z &= 0x7;								\
+  return z;								\
+}
+
+SSE41_COLOR_TO_KCMY_THRESHOLD_FUNC(unsigned char, 8)
+SSE41_COLOR_TO_KCMY_THRESHOLD_FUNC(unsigned short, 16)
+
+/*
+ * Look up eight 16 bit indices in a table of 32 bit entries.
+ */
+static inline AVX2 __m128i
+avx2_lookup(const unsigned *table, __m128i index)
+{
+  __m256i v = _mm256_i32gather_epi32((const int *) table,
+				     _mm256_cvtepu16_epi32(index), 4);
+  return _mm_packus_epi32(_mm256_castsi256_si128(v),
+			  _mm256_extracti128_si256(v, 1));
+}
+
+#define AVX2_COLOR_TO_KCMY_FAST_FUNC(T, bits)				\
+static AVX2 unsigned							\
+avx2_color_##bits##_to_kcmy_fast(const stp_vars_t *vars,		\
+				 const unsigned char *in,		\
+				 unsigned short *out)			\
+{									\
+  int i;								\
+  const T *s_in = (const T *) in;					\
+  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
+  int width = lut->image_width;						\
+  const unsigned *red = lut->simd_tables;				\
+  const unsigned *green = red + (1 << bits);				\
+  const unsigned *blue = green + (1 << bits);				\
+  unsigned nz[4] = { 0, 0, 0, 0 };					\
+  __m128i nzk = _mm_setzero_si128();					\
+  __m128i nzc = nzk, nzm = nzk, nzy = nzk;				\
+									\
+  for (i = 0; i + 8 <= width; i += 8, s_in += 24, out += 32)		\
+    {									\
+      __m128i c, m, y, k;						\
+      sse41_load_rgb_##bits(s_in, &c, &m, &y);				\
+      c = avx2_lookup(red, c);						\
+      m = avx2_lookup(green, m);					\
+      y = avx2_lookup(blue, y);						\
+      k = _mm_min_epu16(c, _mm_min_epu16(m, y));			\
+      c = _mm_sub_epi16(c, k);						\
+      m = _mm_sub_epi16(m, k);						\
+      y = _mm_sub_epi16(y, k);						\
+      sse41_store_kcmy(out, k, c, m, y);				\
+      nzk = _mm_or_si128(nzk, k);					\
+      nzc = _mm_or_si128(nzc, c);					\
+      nzm = _mm_or_si128(nzm, m);					\
+      nzy = _mm_or_si128(nzy, y);					\
+    }									\
+  for (; i < width; i++, out += 4, s_in += 3)				\
+    {									\
+      unsigned c = red[s_in[0]];					\
+      unsigned m = green[s_in[1]];					\
+      unsigned y = blue[s_in[2]];					\
+      unsigned k = c < m ? (c < y ? c : y) : (m < y ? m : y);		\
+      out[0] = k;							\
+      out[1] = c - k;							\
+      out[2] = m - k;							\
+      out[3] = y - k;							\
+      nz[0] |= out[0];							\
+      nz[1] |= out[1];							\
+      nz[2] |= out[2];							\
+      nz[3] |= out[3];							\
+    }									\
+  nz[0] |= sse41_nonzero(nzk);						\
+  nz[1] |= sse41_nonzero(nzc);						\
+  nz[2] |= sse41_nonzero(nzm);						\
+  nz[3] |= sse41_nonzero(nzy);						\
+  return zero_mask(nz, 4);						\
+}
+
+AVX2_COLOR_TO_KCMY_FAST_FUNC(unsigned char, 8)
+AVX2_COLOR_TO_KCMY_FAST_FUNC(unsigned short, 16)
+
+#define AVX2_COLOR_TO_COLOR_FAST_FUNC(T, bits)				\
+static AVX2 unsigned							\
+avx2_color_##bits##_to_color_fast(const stp_vars_t *vars,		\
+				  const unsigned char *in,		\
+				  unsigned short *out)			\
+{									\
+  int i;								\
+  const T *s_in = (const T *) in;					\
+  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
+  int width = lut->image_width;						\
+  const unsigned *red = lut->simd_tables;				\
+  const unsigned *green = red + (1 << bits);				\
+  const unsigned *blue = green + (1 << bits);				\
+  unsigned nz[3] = { 0, 0, 0 };						\
+  __m128i nzc = _mm_setzero_si128();					\
+  __m128i nzm = nzc, nzy = nzc;						\
+									\
+  for (i = 0; i + 8 <= width; i += 8, s_in += 24, out += 24)		\
+    {									\
+      __m128i c, m, y;							\
+      sse41_load_rgb_##bits(s_in, &c, &m, &y);				\
+      c = avx2_lookup(red, c);						\
+      m = avx2_lookup(green, m);					\
+      y = avx2_lookup(blue, y);						\
+      sse41_store_rgb(out, c, m, y);					\
+      nzc = _mm_or_si128(nzc, c);					\
+      nzm = _mm_or_si128(nzm, m);					\
+      nzy = _mm_or_si128(nzy, y);					\
+    }									\
+  for (; i < width; i++, out += 3, s_in += 3)				\
+    {									\
+      out[0] = red[s_in[0]];						\
+      out[1] = green[s_in[1]];						\
+      out[2] = blue[s_in[2]];						\
+      nz[0] |= out[0];							\
+      nz[1] |= out[1];							\
+      nz[2] |= out[2];							\
+    }									\
+  nz[0] |= sse41_nonzero(nzc);						\
+  nz[1] |= sse41_nonzero(nzm);						\
+  nz[2] |= sse41_nonzero(nzy);						\
+  return zero_mask(nz, 3);						\
+}
+
+AVX2_COLOR_TO_COLOR_FAST_FUNC(unsigned char, 8)
+AVX2_COLOR_TO_COLOR_FAST_FUNC(unsigned short, 16)
+
+#endif /* HAVE_X86_SIMD */
+
+#ifdef __ARM_NEON
+
+static inline void
+neon_load_rgb_8(const unsigned char *s_in,
+		uint16x8_t *c, uint16x8_t *m, uint16x8_t *y)
+{
+  uint8x8x3_t v = vld3_u8(s_in);
+  *c = vmovl_u8(v.val[0]);
+  *m = vmovl_u8(v.val[1]);
+  *y = vmovl_u8(v.val[2]);
+}
+
+static inline void
+neon_load_rgb_16(const unsigned short *s_in,
+		 uint16x8_t *c, uint16x8_t *m, uint16x8_t *y)
+{
+  uint16x8x3_t v = vld3q_u16(s_in);
+  *c = v.val[0];
+  *m = v.val[1];
+  *y = v.val[2];
+}
+
+static inline void
+neon_load_samples_8(const unsigned char *s_in, uint16x8_t *v)
+{
+  v[0] = vmovl_u8(vld1_u8(s_in));
+  v[1] = vmovl_u8(vld1_u8(s_in + 8));
+  v[2] = vmovl_u8(vld1_u8(s_in + 16));
+}
+
+static inline void
+neon_load_samples_16(const unsigned short *s_in, uint16x8_t *v)
+{
+  v[0] = vld1q_u16(s_in);
+  v[1] = vld1q_u16(s_in + 8);
+  v[2] = vld1q_u16(s_in + 16);
+}
+
+static inline void
+neon_store_kcmy(unsigned short *out, uint16x8_t k, uint16x8_t c,
+		uint16x8_t m, uint16x8_t y)
+{
+  uint16x8x4_t v;
+  v.val[0] = k;
+  v.val[1] = c;
+  v.val[2] = m;
+  v.val[3] = y;
+  vst4q_u16(out, v);
+}
+
+static inline unsigned
+neon_nonzero(uint16x8_t v)
+{
+  uint16x4_t x = vorr_u16(vget_low_u16(v), vget_high_u16(v));
+  return (vget_lane_u16(x, 0) | vget_lane_u16(x, 1) |
+	  vget_lane_u16(x, 2) | vget_lane_u16(x, 3)) != 0;
+}
+
+#define NEON_COLOR_TO_KCMY_RAW_FUNC(T, bits)				\
+static unsigned								\
+neon_color_##bits##_to_kcmy_raw(const stp_vars_t *vars,			\
+				const unsigned char *in,		\
+				unsigned short *out)			\
+{									\
+  int i;								\
+  const T *s_in = (const T *) in;					\
+  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
+  int width = lut->image_width;						\
+  unsigned mask = lut->invert_output ? 0xffff : 0;			\
+  unsigned nz[4] = { 0, 0, 0, 0 };					\
+  uint16x8_t vmask = vdupq_n_u16(mask);					\
+  uint16x8_t nzk = vdupq_n_u16(0);					\
+  uint16x8_t nzc = nzk, nzm = nzk, nzy = nzk;				\
+									\
+  for (i = 0; i + 8 <= width; i += 8, s_in += 24, out += 32)		\
+    {									\
+      uint16x8_t c, m, y, k;						\
+      neon_load_rgb_##bits(s_in, &c, &m, &y);				\
+      c = veorq_u16(vmulq_n_u16(c, BD(bits)), vmask);			\
+      m = veorq_u16(vmulq_n_u16(m, BD(bits)), vmask);			\
+      y = veorq_u16(vmulq_n_u16(y, BD(bits)), vmask);			\
+      k = vminq_u16(c, vminq_u16(m, y));				\
+      c = vsubq_u16(c, k);						\
+      m = vsubq_u16(m, k);						\
+      y = vsubq_u16(y, k);						\
+      neon_store_kcmy(out, k, c, m, y);					\
+      nzk = vorrq_u16(nzk, k);						\
+      nzc = vorrq_u16(nzc, c);						\
+      nzm = vorrq_u16(nzm, m);						\
+      nzy = vorrq_u16(nzy, y);						\
+    }									\
+  scalar_##bits##_to_kcmy_raw(s_in, out, width - i, BD(bits), mask, nz);	\
+  nz[0] |= neon_nonzero(nzk);						\
+  nz[1] |= neon_nonzero(nzc);						\
+  nz[2] |= neon_nonzero(nzm);						\
+  nz[3] |= neon_nonzero(nzy);						\
+  return zero_mask(nz, 4);						\
+}
+
+NEON_COLOR_TO_KCMY_RAW_FUNC(unsigned char, 8)
+NEON_COLOR_TO_KCMY_RAW_FUNC(unsigned short, 16)
+
+#define NEON_COLOR_TO_COLOR_RAW_FUNC(T, bits)				\
+static unsigned								\
+neon_color_##bits##_to_color_raw(const stp_vars_t *vars,		\
+				 const unsigned char *in,		\
+				 unsigned short *out)			\
+{									\
+  int i, j;								\
+  const T *s_in = (const T *) in;					\
+  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
+  int width = lut->image_width;						\
+  unsigned mask = lut->invert_output ? 0xffff : 0;			\
+  unsigned nz;								\
+  unsigned short lanes[24];						\
+  uint16x8_t vmask = vdupq_n_u16(mask);					\
+  uint16x8_t acc[3];							\
+  acc[0] = acc[1] = acc[2] = vdupq_n_u16(0);				\
+									\
+  for (i = 0; i + 8 <= width; i += 8, s_in += 24, out += 24)		\
+    {									\
+      uint16x8_t v[3];							\
+      neon_load_samples_##bits(s_in, v);				\
+      for (j = 0; j < 3; j++)						\
+	{								\
+	  v[j] = veorq_u16(vmulq_n_u16(v[j], BD(bits)), vmask);		\
+	  vst1q_u16(out + 8 * j, v[j]);					\
+	  acc[j] = vorrq_u16(acc[j], v[j]);				\
+	}								\
+    }									\
+  nz = scalar_##bits##_to_color_raw(s_in, out, width - i, BD(bits), mask);	\
+  for (j = 0; j < 3; j++)						\
+    vst1q_u16(lanes + 8 * j, acc[j]);					\
+  for (j = 0; j < 24; j++)						\
+    if (lanes[j])							\
+      nz |= 1 << (j % 3);						\
+  return nz;								\
+}
+
+NEON_COLOR_TO_COLOR_RAW_FUNC(unsigned char, 8)
+NEON_COLOR_TO_COLOR_RAW_FUNC(unsigned short, 16)
+
+#define NEON_COLOR_TO_KCMY_THRESHOLD_FUNC(T, bits)			\
+static unsigned								\
+neon_color_##bits##_to_kcmy_threshold(const stp_vars_t *vars,		\
+				      const unsigned char *in,		\
+				      unsigned short *out)		\
+{									\
+  int i;								\
+  unsigned z;								\
+  const T *s_in = (const T *) in;					\
+  lut_t *lut = (lut_t *)(stp_get_component_data(vars, "Color"));	\
+  int width = lut->image_width;						\
+  unsigned mask = lut->invert_output ? MAXB(bits) : 0;			\
+  uint16x8_t vmask = vdupq_n_u16(mask);					\
+  uint16x8_t high_bit = vdupq_n_u16(1 << (bits - 1));			\
+  uint16x8_t nzk = vdupq_n_u16(0);					\
+  uint16x8_t nzc = nzk, nzm = nzk, nzy = nzk;				\
+  memset(out, 0, width * 4 * sizeof(unsigned short));			\
+									\
+  for (i = 0; i + 8 <= width; i += 8, s_in += 24, out += 32)		\
+    {									\
+      uint16x8_t c, m, y, k, kk;					\
+      neon_load_rgb_##bits(s_in, &c, &m, &y);				\
+      c = veorq_u16(c, vmask);						\
+      m = veorq_u16(m, vmask);						\
+      y = veorq_u16(y, vmask);						\
+      kk = vminq_u16(c, vminq_u16(m, y));				\
+      k = vtstq_u16(kk, high_bit);					\
+      kk = vandq_u16(kk, k);						\
+      c = vtstq_u16(vsubq_u16(c, kk), high_bit);			\
+      m = vtstq_u16(vsubq_u16(m, kk), high_bit);			\
+      y = vtstq_u16(vsubq_u16(y, kk), high_bit);			\
+      neon_store_kcmy(out, k, c, m, y);					\
+      nzk = vorrq_u16(nzk, k);						\
+      nzc = vorrq_u16(nzc, c);						\
+      nzm = vorrq_u16(nzm, m);						\
+      nzy = vorrq_u16(nzy, y);						\
+    }									\
+  z = scalar_##bits##_to_kcmy_threshold(s_in, out, width - i, mask);	\
+  if (neon_nonzero(nzk))						\
+    z &= 0xe;								\
+  if (neon_nonzero(nzc))						\
+    z &= 0xd;								\
+  if (neon_nonzero(nzm))						\
+    z &= 0xb;								\
+  if (neon_nonzero(nzy))						\
+    z &= 0x7;								\
+  return z;								\
+}
+
+NEON_COLOR_TO_KCMY_THRESHOLD_FUNC(unsigned char, 8)
+NEON_COLOR_TO_KCMY_THRESHOLD_FUNC(unsigned short, 16)
+
+#endif /* __ARM_NEON */
+
+#define SIMD_CHOOSE(lut, prefix, name)					\
+  ((lut)->channel_depth == 8 ? prefix##_color_8_to_##name :		\
+   prefix##_color_16_to_##name)
+
+stp_convert_t
+stpi_color_simd_color_to_kcmy_raw(lut_t *lut)
+{
+#ifdef HAVE_X86_SIMD
+  if (stpi_cpu_features() & STPI_CPU_SSE41)
+    return SIMD_CHOOSE(lut, sse41, kcmy_raw);
+#endif
+#ifdef __ARM_NEON
+  if (stpi_cpu_features() & STPI_CPU_NEON)
+    return SIMD_CHOOSE(lut, neon, kcmy_raw);
+#endif
+  return NULL;
+}
+
+stp_convert_t
+stpi_color_simd_color_to_color_raw(lut_t *lut)
+{
+#ifdef HAVE_X86_SIMD
+  if (stpi_cpu_features() & STPI_CPU_SSE41)
+    return SIMD_CHOOSE(lut, sse41, color_raw);
+#endif
+#ifdef __ARM_NEON
+  if (stpi_cpu_features() & STPI_CPU_NEON)
+    return SIMD_CHOOSE(lut, neon, color_raw);
+#endif
+  return NULL;
+}
+
+stp_convert_t
+stpi_color_simd_color_to_kcmy_threshold(lut_t *lut)
+{
+#ifdef HAVE_X86_SIMD
+  if (stpi_cpu_features() & STPI_CPU_SSE41)
+    return SIMD_CHOOSE(lut, sse41, kcmy_threshold);
+#endif
+#ifdef __ARM_NEON
+  if (stpi_cpu_features() & STPI_CPU_NEON)
+    return SIMD_CHOOSE(lut, neon, kcmy_threshold);
+#endif
+  return NULL;
+}
+
+/*
+ * NEON has no gather, so the table lookups in the fast conversions
+ * are left to the scalar kernels there.
+ */
+
+stp_convert_t
+stpi_color_simd_color_to_kcmy_fast(lut_t *lut)
+{
+#ifdef HAVE_X86_SIMD
+  if ((stpi_cpu_features() & STPI_CPU_AVX2) && plan_composite_tables(lut))
+    return SIMD_CHOOSE(lut, avx2, kcmy_fast);
+#endif
+  return NULL;
+}
+
+stp_convert_t
+stpi_color_simd_color_to_color_fast(lut_t *lut)
+{
+#ifdef HAVE_X86_SIMD
+  if ((stpi_cpu_features() & STPI_CPU_AVX2) && plan_composite_tables(lut))
+    return SIMD_CHOOSE(lut, avx2, color_fast);
+#endif
+  return NULL;
+}
@@ -0,0 +1,63 @@
+/*
+ *   CPU feature detection for Gutenprint
+ *
+ *   Copyright 2026 the Gutenprint project
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file must include only standard C header files.  The core code must
+ * compile on generic platforms that don't support glib, gimp, etc.
+ *
+ * Vectorized code is used whenever the CPU supports it; it must produce
+ * exactly the same output as the scalar code it replaces.  Setting
+ * STP_SIMD=0 in the environment disables it, which is useful for
+ * comparing the two.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <gutenprint/gutenprint.h>
+#include "gutenprint-internal.h"
+#include <stdlib.h>
+
+static int stpi_cpu_features_initialized = 0;
+static unsigned stpi_cpu_feature_mask = 0;
+
+unsigned
+stpi_cpu_features(void)
+{
+  if (!stpi_cpu_features_initialized)
+    {
+      unsigned features = 0;
+      const char *sval = getenv("STP_SIMD");
+#ifdef HAVE_X86_SIMD
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("sse4.1"))
+	features |= STPI_CPU_SSE41;
+      if (__builtin_cpu_supports("avx2"))
+	features |= STPI_CPU_AVX2;
+#endif
+#ifdef __ARM_NEON
+      features |= STPI_CPU_NEON;
+#endif
+      if (sval && atoi(sval) == 0)
+	features = 0;
+      stpi_cpu_feature_mask = features;
+      stpi_cpu_features_initialized = 1;
+    }
+  return stpi_cpu_feature_mask;
+}
@@ -154,13 +154,11 @@ print_color(const stpi_dither_t *d, stpi_dither_channel_t *dc, int x, int y,
    * desired to use some function of overall density, rather than just
    * this color's input, for this purpose.
    */
-  for (i = levels; i >= 0; i--)
+  i = dc->segment_lut[density];
+  if (i != STPI_NO_SEGMENT)
     {
       stpi_dither_segment_t *dd = &(dc->ranges[i]);
 
-      if (density <= dd->lower->range)
-	continue;
-
       /*
        * If we're using an adaptive dithering method, decide whether
        * to use the Floyd-Steinberg or the ordered method based on the
@@ -198,9 +196,7 @@ print_color(const stpi_dither_t *d, stpi_dither_channel_t *dc, int x, int y,
        */
       if (stpi_dither_type & D_ORDERED_BASE)
 	{
-	  rangepoint = density - dd->lower->range;
-	  if (dd->range_span < 65535)
-	    rangepoint = rangepoint * 65535 / dd->range_span;
+	  rangepoint = dc->rangepoint_lut[density];
 	  vmatrix = 0;
 	}
       else
@@ -213,9 +209,7 @@ print_color(const stpi_dither_t *d, stpi_dither_channel_t *dc, int x, int y,
 	   */
 
 	  unsigned virtual_value;
-	  rangepoint = density - dd->lower->range;
-	  if (dd->range_span < 65535)
-	    rangepoint = rangepoint * 65535 / dd->range_span;
+	  rangepoint = dc->rangepoint_lut[density];
 	  if (dd->value_span == 0)
 	    virtual_value = upper->value;
 	  else /* if (dd->range_span == 0) */
@@ -324,7 +318,6 @@ print_color(const stpi_dither_t *d, stpi_dither_channel_t *dc, int x, int y,
 	      adjusted -= adj;
 	    }
 	}
-      return adjusted;
     }
   return adjusted;
 }
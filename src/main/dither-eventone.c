@@ -30,6 +30,7 @@
 #include <gutenprint/gutenprint.h>
 #include "gutenprint-internal.h"
 #include <gutenprint/gutenprint-intl-internal.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <limits.h>
@@ -55,6 +56,9 @@ typedef struct
   stpi_dither_channel_t *dummy_channel;
   double transition;		/* Exponential scaling for transition region */
   stp_dither_matrix_impl_t transition_matrix;
+  stpi_thread_pool_t *pool;	/* Workers for column-striped dithering */
+  int nstripes;
+  struct et_stripe *stripes;
 } eventone_t;
 
 typedef struct shade_segment
@@ -72,11 +76,16 @@ typedef struct shade_segment
 #define UNITONE_C1 16384
 #define UNITONE_C2 (UNITONE_C1 * sqrt(3.0) / 2.0)
 
+static int et_stripe_limit(void);
+static void et_stripe_setup(stpi_dither_t *d, eventone_t *et);
+static void et_stripe_free(stpi_dither_t *d, eventone_t *et);
+
 static void
 free_eventone_data(stpi_dither_t *d)
 {
   int i;
   eventone_t *et = (eventone_t *) (d->aux_data);
+  et_stripe_free(d, et);
   for (i = 0; i < CHANNEL_COUNT(d); i++)
     {
       if (CHANNEL(d, i).aux_data)
@@ -181,6 +190,8 @@ et_setup(stpi_dither_t *d)
 
   d->aux_data = et;
   d->aux_freefunc = free_eventone_data;
+  if (stpi_thread_count() > 1 && et_stripe_limit() > 1)
+    et_stripe_setup(d, et);
 }
 
 static int
@@ -321,47 +332,16 @@ unitone_adjust(stpi_dither_channel_t *dc, eventone_t *et,
 }
 
 
-static inline void
-find_segment(stpi_dither_channel_t *dc, unsigned inkval,
-	     stpi_ink_defn_t *lower, stpi_ink_defn_t *upper)
-{
-  lower->range = 0;
-  lower->bits = 0;
-
-  if (dc->nlevels == 1)
-    {
-      upper->bits = dc->ink_list[1].bits;
-      upper->range = dc->ink_list[1].value;
-    }
-  else
-    {
-      int i;
-      stpi_ink_defn_t *ip;
-
-      for (i=0, ip = dc->ink_list; i < dc->nlevels - 1; i++, ip++)
-	{
-	  if (ip->value > inkval)
-	    break;
-	  lower->bits = ip->bits;
-	  lower->range = ip->value;
-	}
-
-      upper->bits = ip->bits;
-      upper->range = ip->value;
-    }
-}
-
 static inline int
 find_segment_and_ditherpoint(stpi_dither_channel_t *dc, unsigned inkval,
 			     stpi_ink_defn_t *lower, stpi_ink_defn_t *upper)
 {
-  find_segment(dc, inkval, lower, upper);
-  if (inkval <= lower->range)
-    return 0;
-  else if (inkval >= upper->range)
-    return 65535;
-  else
-    return (65535u * (inkval - lower->range)) / (upper->range - lower->range);
+  const stpi_ink_defn_t *ip = &(dc->ink_list[dc->segment_lut[inkval]]);
+  lower->bits = ip[0].bits;
+  lower->range = ip[0].value;
+  upper->bits = ip[1].bits;
+  upper->range = ip[1].value;
+  return dc->rangepoint_lut[inkval];
 }
 
 static inline void
@@ -396,55 +376,86 @@ print_ink(stpi_dither_t *d, unsigned char *tptr, const stpi_ink_defn_t *ink,
     }
 }
 
-void
-stpi_dither_et(stp_vars_t *v,
-	       int row,
-	       const unsigned short *raw,
-	       int duplicate_line,
-	       int zero_mask,
-	       const unsigned char *mask)
+/*
+ * Position of the dither within the current row.  ptr_offset, which
+ * print_ink() and the mask test use, lives in the dither itself.
+ */
+typedef struct
 {
-  stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
-  eventone_t *et;
-
-  int		x;
-  int	        length;
-  unsigned char	bit;
-  int		i;
-
-  int		terminate;
-  int		direction;
-  int		xerror, xstep, xmod;
-  int		channel_count = CHANNEL_COUNT(d);
-
-  if (!et_initializer(d, duplicate_line, zero_mask))
-    return;
-
-  et = (eventone_t *) d->aux_data;
-  if (d->stpi_dither_type & D_UNITONE)
-    stp_dither_matrix_set_row(&(et->transition_matrix), row);
-
-  length = (d->dst_width + 7) / 8;
+  const unsigned short *raw;
+  int xerror;
+  unsigned char bit;
+} et_cursor_t;
 
+/*
+ * Set up to dither a row starting from its first column in the
+ * serpentine direction, which is returned.
+ */
+static int
+et_cursor_start(stpi_dither_t *d, int row, const unsigned short *raw,
+		et_cursor_t *cur)
+{
+  int channel_count = CHANNEL_COUNT(d);
+  int xmod = d->src_width % d->dst_width;
+  int x;
   if (row & 1)
     {
-      direction = 1;
       x = 0;
-      terminate = d->dst_width;
       d->ptr_offset = 0;
     }
   else
     {
-      direction = -1;
       x = d->dst_width - 1;
-      terminate = -1;
-      d->ptr_offset = length - 1;
+      d->ptr_offset = (d->dst_width + 7) / 8 - 1;
       raw += channel_count * (d->src_width - 1);
     }
-  bit = 1 << (7 - (x & 7));
-  xstep  = channel_count * (d->src_width / d->dst_width);
-  xmod   = d->src_width % d->dst_width;
-  xerror = (xmod * x) % d->dst_width;
+  cur->raw = raw;
+  cur->bit = 1 << (7 - (x & 7));
+  cur->xerror = (xmod * x) % d->dst_width;
+  return x;
+}
+
+/*
+ * Step the cursor from column x to column to without dithering.  This
+ * goes through exactly the same steps as dithering would, so that the
+ * input position is the same as if the intervening columns had been
+ * dithered.
+ */
+static void
+et_cursor_seek(stpi_dither_t *d, et_cursor_t *cur, int x, int to,
+	       int direction)
+{
+  int channel_count = CHANNEL_COUNT(d);
+  int xstep = channel_count * (d->src_width / d->dst_width);
+  int xmod = d->src_width % d->dst_width;
+  for (; x != to; x += direction)
+    {
+      if (direction == 1)
+	ADVANCE_UNIDIRECTIONAL(d, cur->bit, cur->raw, channel_count,
+			       cur->xerror, xstep, xmod);
+      else
+	ADVANCE_REVERSE(d, cur->bit, cur->raw, channel_count,
+			cur->xerror, xstep, xmod);
+    }
+}
+
+/*
+ * Dither columns x up to (not including) terminate.  If print is zero,
+ * the error state is updated but no dots are printed.
+ */
+static void
+et_dither_span(stpi_dither_t *d, eventone_t *et, et_cursor_t *cur,
+	       int x, int terminate, int direction,
+	       const unsigned char *mask, int print)
+{
+  int		length = (d->dst_width + 7) / 8;
+  const unsigned short *raw = cur->raw;
+  unsigned char	bit = cur->bit;
+  int		xerror = cur->xerror;
+  int		i;
+  int		channel_count = CHANNEL_COUNT(d);
+  int		xstep  = channel_count * (d->src_width / d->dst_width);
+  int		xmod   = d->src_width % d->dst_width;
 
   for (; x != terminate; x += direction)
     {
@@ -494,7 +505,7 @@ stpi_dither_et(stp_vars_t *v,
 		}
 
 	      /* Adjust the error to reflect the dot choice */
-	      if (inkp->bits)
+	      if (inkp->bits && print)
 		{
 		  if (!mask || (*(mask + d->ptr_offset) & bit))
 		    {
@@ -515,65 +526,25 @@ stpi_dither_et(stp_vars_t *v,
       else
 	ADVANCE_REVERSE(d, bit, raw, channel_count, xerror, xstep, xmod);
     }
-  if (direction == -1)
-    stpi_dither_reverse_row_ends(d);
+  cur->raw = raw;
+  cur->bit = bit;
+  cur->xerror = xerror;
 }
 
-void
-stpi_dither_ut(stp_vars_t *v,
-	       int row,
-	       const unsigned short *raw,
-	       int duplicate_line,
-	       int zero_mask,
-	       const unsigned char *mask)
+static void
+ut_dither_span(stpi_dither_t *d, eventone_t *et, et_cursor_t *cur,
+	       int x, int terminate, int direction,
+	       const unsigned char *mask, int print)
 {
-  stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
-  eventone_t *et;
-
-  int		x;
-  int	        length;
-  unsigned char	bit;
+  int		length = (d->dst_width + 7) / 8;
+  const unsigned short *raw = cur->raw;
+  unsigned char	bit = cur->bit;
+  int		xerror = cur->xerror;
   int		i;
-
-  int		terminate;
-  int		direction;
-  int		xerror, xstep, xmod;
   int		channel_count = CHANNEL_COUNT(d);
-  stpi_dither_channel_t *ddc;
-
-  if (channel_count == 1)
-    {
-      stpi_dither_et(v, row, raw, duplicate_line, zero_mask, mask);
-      return;
-    }
-
-  if (!et_initializer(d, duplicate_line, zero_mask))
-    return;
-
-  et = (eventone_t *) d->aux_data;
-  ddc = et->dummy_channel;
-
-  length = (d->dst_width + 7) / 8;
-
-  if (row & 1)
-    {
-      direction = 1;
-      x = 0;
-      terminate = d->dst_width;
-      d->ptr_offset = 0;
-    }
-  else
-    {
-      direction = -1;
-      x = d->dst_width - 1;
-      terminate = -1;
-      d->ptr_offset = length - 1;
-      raw += channel_count * (d->src_width - 1);
-    }
-  bit = 1 << (7 - (x & 7));
-  xstep  = channel_count * (d->src_width / d->dst_width);
-  xmod   = d->src_width % d->dst_width;
-  xerror = (xmod * x) % d->dst_width;
+  int		xstep  = channel_count * (d->src_width / d->dst_width);
+  int		xmod   = d->src_width % d->dst_width;
+  stpi_dither_channel_t *ddc = et->dummy_channel;
 
   for (; x != terminate; x += direction)
     {
@@ -714,7 +685,7 @@ stpi_dither_ut(stp_vars_t *v,
 		  dc->v -= 131070;
 		  sp->dis = et->d_sq;
 		}
-	      if (inkp->bits)
+	      if (inkp->bits && print)
 		{
 		  if (!mask || (*(mask + d->ptr_offset) & bit))
 		    {
@@ -750,6 +721,400 @@ stpi_dither_ut(stp_vars_t *v,
       else
 	ADVANCE_REVERSE(d, bit, raw, channel_count, xerror, xstep, xmod);
     }
-  if (direction == -1)
-    stpi_dither_reverse_row_ends(d);
+  cur->raw = raw;
+  cur->bit = bit;
+  cur->xerror = xerror;
+}
+
+/*
+ * Column-striped parallel dithering.
+ *
+ * Each row is split into stripes of whole bytes, one per job.  A stripe
+ * is dithered on a private copy of the dither and channel state, with
+ * private copies of the parts of the error and distance lines that it
+ * touches, so that stripes never write to shared state while running.
+ * Once all stripes are done, their columns of the error and distance
+ * lines are written back, and the error each stripe diffused across
+ * its leading edge is added to its neighbor's.  The error lines thus
+ * carry exactly the same information from row to row as they do when
+ * dithering serially.
+ *
+ * What cannot be reproduced is the error carried along the row into
+ * the first column of each stripe.  To approximate it, each stripe
+ * starts ET_STRIPE_OVERLAP columns early without printing anything.
+ * Since most of the carried error is diffused within a few columns,
+ * the result differs from serial dithering in only a small fraction
+ * of dots near stripe edges.
+ *
+ * Because the output changes, striping is not enabled by STP_THREADS
+ * alone.  It must be requested separately by setting
+ * STP_EVENTONE_STRIPES to the largest number of stripes to use.
+ */
+
+#define ET_STRIPE_MIN_WIDTH 512	/* Narrowest stripe worth a job */
+#define ET_STRIPE_OVERLAP 64	/* Columns dithered before each stripe */
+
+typedef struct et_stripe
+{
+  stpi_dither_t d;		/* Private copies of dither state */
+  eventone_t et;
+  stpi_dither_channel_t *channels; /* Channels, followed by dummy channel */
+  shade_distance_t *shades;
+  int **errs;			/* Private error line for each channel */
+  distance_t **dis;		/* Private distance line for each channel */
+  int *spill;			/* Error at leading edge after the overlap */
+  int x_lo;			/* First column printed */
+  int x_hi;			/* Column after last column printed */
+} et_stripe_t;
+
+typedef struct
+{
+  stpi_dither_t *d;
+  eventone_t *et;
+  int row;
+  int direction;
+  int nchannels;		/* Channels including any dummy channel */
+  const unsigned short *raw;
+  const unsigned char *mask;
+  void (*span)(stpi_dither_t *, eventone_t *, et_cursor_t *, int, int,
+	       int, const unsigned char *, int);
+} et_parallel_t;
+
+static int
+et_stripe_limit(void)
+{
+  static int stripe_limit = -1;
+  if (stripe_limit < 0)
+    {
+      const char *sval = getenv("STP_EVENTONE_STRIPES");
+      int stripes = 0;
+      if (sval)
+	stripes = atoi(sval);
+      if (stripes < 0)
+	stripes = 0;
+      stripe_limit = stripes;
+    }
+  return stripe_limit;
+}
+
+static void
+et_stripe_setup(stpi_dither_t *d, eventone_t *et)
+{
+  int threads = stpi_thread_count();
+  int nchannels = CHANNEL_COUNT(d) + 1;
+  int size = 2 * MAX_SPREAD + ((d->dst_width + 7) & ~7);
+  int nstripes = d->dst_width / ET_STRIPE_MIN_WIDTH;
+  int i, j;
+
+  if (nstripes > threads)
+    nstripes = threads;
+  if (nstripes > et_stripe_limit())
+    nstripes = et_stripe_limit();
+  if (nstripes < 2)
+    return;
+  et->pool = stpi_thread_pool_create(nstripes);
+  if (!et->pool)
+    return;
+  nstripes = stpi_thread_pool_size(et->pool);
+  et->nstripes = nstripes;
+  et->stripes = stp_zalloc(sizeof(et_stripe_t) * nstripes);
+  for (i = 0; i < nstripes; i++)
+    {
+      et_stripe_t *s = &(et->stripes[i]);
+      s->x_lo = ((i * d->dst_width / nstripes) + 7) & ~7;
+      s->x_hi = (((i + 1) * d->dst_width / nstripes) + 7) & ~7;
+      if (s->x_hi > d->dst_width)
+	s->x_hi = d->dst_width;
+      s->channels = stp_zalloc(sizeof(stpi_dither_channel_t) * nchannels);
+      s->shades = stp_zalloc(sizeof(shade_distance_t) * nchannels);
+      s->errs = stp_zalloc(sizeof(int *) * nchannels);
+      s->dis = stp_zalloc(sizeof(distance_t *) * nchannels);
+      s->spill = stp_zalloc(sizeof(int) * 2 * nchannels);
+      for (j = 0; j < nchannels; j++)
+	{
+	  s->errs[j] = stp_zalloc(size * sizeof(int));
+	  s->dis[j] = stp_zalloc(d->dst_width * sizeof(distance_t));
+	}
+    }
+}
+
+static void
+et_stripe_free(stpi_dither_t *d, eventone_t *et)
+{
+  int i, j;
+  stpi_thread_pool_destroy(et->pool);
+  for (i = 0; i < et->nstripes; i++)
+    {
+      et_stripe_t *s = &(et->stripes[i]);
+      for (j = 0; j < CHANNEL_COUNT(d) + 1; j++)
+	{
+	  STP_SAFE_FREE(s->errs[j]);
+	  STP_SAFE_FREE(s->dis[j]);
+	}
+      STP_SAFE_FREE(s->channels);
+      STP_SAFE_FREE(s->shades);
+      STP_SAFE_FREE(s->errs);
+      STP_SAFE_FREE(s->dis);
+      STP_SAFE_FREE(s->spill);
+    }
+  STP_SAFE_FREE(et->stripes);
+}
+
+static inline stpi_dither_channel_t *
+et_source_channel(const et_parallel_t *p, int i)
+{
+  if (i < CHANNEL_COUNT(p->d))
+    return &CHANNEL(p->d, i);
+  else
+    return p->et->dummy_channel;
+}
+
+static inline int
+et_channel_is_used(const et_parallel_t *p, int i)
+{
+  return i >= CHANNEL_COUNT(p->d) || CHANNEL(p->d, i).ptr;
+}
+
+/*
+ * Columns of the error line that a stripe may diffuse error into,
+ * relative to its first or last printed column.
+ */
+static inline int
+et_spill_column(const et_stripe_t *s, int direction, int k)
+{
+  if (direction == 1)
+    return s->x_lo - 1 - k;
+  else
+    return s->x_hi + k;
+}
+
+static void
+et_stripe_load(void *arg, int job)
+{
+  et_parallel_t *p = (et_parallel_t *) arg;
+  et_stripe_t *s = &(p->et->stripes[job]);
+  int lo = s->x_lo - ET_STRIPE_OVERLAP;
+  int hi = s->x_hi + ET_STRIPE_OVERLAP;
+  int i;
+  if (lo < 0)
+    lo = 0;
+  if (hi > p->d->dst_width)
+    hi = p->d->dst_width;
+
+  s->d = *(p->d);
+  s->d.channel = s->channels;
+  s->et = *(p->et);
+  if (p->nchannels > CHANNEL_COUNT(p->d))
+    s->et.dummy_channel = &(s->channels[CHANNEL_COUNT(p->d)]);
+  for (i = 0; i < p->nchannels; i++)
+    {
+      stpi_dither_channel_t *dc = et_source_channel(p, i);
+      shade_distance_t *sp = (shade_distance_t *) dc->aux_data;
+      if (!et_channel_is_used(p, i))
+	{
+	  s->channels[i].ptr = NULL;
+	  continue;
+	}
+      s->channels[i] = *dc;
+      s->channels[i].errs = &(s->errs[i]);
+      s->channels[i].aux_data = &(s->shades[i]);
+      s->shades[i] = *sp;
+      s->shades[i].et_dis = s->dis[i];
+      memcpy(s->errs[i] + MAX_SPREAD + lo - 2, dc->errs[0] + MAX_SPREAD + lo - 2,
+	     (hi - lo + 4) * sizeof(int));
+      memcpy(s->dis[i] + lo, sp->et_dis + lo, (hi - lo) * sizeof(distance_t));
+    }
+}
+
+static void
+et_stripe_run(void *arg, int job)
+{
+  et_parallel_t *p = (et_parallel_t *) arg;
+  et_stripe_t *s = &(p->et->stripes[job]);
+  stpi_dither_t *d = &(s->d);
+  int direction = p->direction;
+  et_cursor_t cur;
+  int x = et_cursor_start(d, p->row, p->raw, &cur);
+  int start;
+  int i, k;
+
+  if (direction == 1)
+    {
+      start = s->x_lo - ET_STRIPE_OVERLAP;
+      if (start < 0)
+	start = 0;
+      et_cursor_seek(d, &cur, x, start, direction);
+      (p->span)(d, &(s->et), &cur, start, s->x_lo, direction, p->mask, 0);
+    }
+  else
+    {
+      start = s->x_hi + ET_STRIPE_OVERLAP;
+      if (start > d->dst_width)
+	start = d->dst_width;
+      et_cursor_seek(d, &cur, x, start - 1, direction);
+      (p->span)(d, &(s->et), &cur, start - 1, s->x_hi - 1, direction,
+		p->mask, 0);
+    }
+  for (i = 0; i < p->nchannels; i++)
+    if (s->channels[i].ptr || i >= CHANNEL_COUNT(d))
+      for (k = 0; k < 2; k++)
+	s->spill[2 * i + k] =
+	  s->errs[i][et_spill_column(s, direction, k) + MAX_SPREAD];
+
+  if (direction == 1)
+    (p->span)(d, &(s->et), &cur, s->x_lo, s->x_hi, direction, p->mask, 1);
+  else
+    {
+      (p->span)(d, &(s->et), &cur, s->x_hi - 1, s->x_lo - 1, direction,
+		p->mask, 1);
+      for (i = 0; i < CHANNEL_COUNT(d); i++)
+	{
+	  int tmp = s->channels[i].row_ends[0];
+	  s->channels[i].row_ends[0] = s->channels[i].row_ends[1];
+	  s->channels[i].row_ends[1] = tmp;
+	}
+    }
+
+  for (i = 0; i < p->nchannels; i++)
+    {
+      stpi_dither_channel_t *dc = et_source_channel(p, i);
+      shade_distance_t *sp = (shade_distance_t *) dc->aux_data;
+      if (!et_channel_is_used(p, i))
+	continue;
+      memcpy(dc->errs[0] + MAX_SPREAD + s->x_lo,
+	     s->errs[i] + MAX_SPREAD + s->x_lo,
+	     (s->x_hi - s->x_lo) * sizeof(int));
+      memcpy(sp->et_dis + s->x_lo, s->dis[i] + s->x_lo,
+	     (s->x_hi - s->x_lo) * sizeof(distance_t));
+    }
+}
+
+static void
+et_dither_parallel(stpi_dither_t *d, eventone_t *et, int row,
+		   const unsigned short *raw, const unsigned char *mask,
+		   int unitone)
+{
+  et_parallel_t p;
+  et_stripe_t *last;
+  int i, j, k;
+
+  p.d = d;
+  p.et = et;
+  p.row = row;
+  p.direction = (row & 1) ? 1 : -1;
+  p.nchannels = CHANNEL_COUNT(d) + (unitone ? 1 : 0);
+  p.raw = raw;
+  p.mask = mask;
+  p.span = unitone ? ut_dither_span : et_dither_span;
+
+  stpi_thread_pool_run(et->pool, et_stripe_load, &p, et->nstripes);
+  stpi_thread_pool_run(et->pool, et_stripe_run, &p, et->nstripes);
+
+  /*
+   * Add in the error diffused across stripe edges, and carry the
+   * state at the end of the row over to the next row.
+   */
+  last = &(et->stripes[p.direction == 1 ? et->nstripes - 1 : 0]);
+  for (i = 0; i < p.nchannels; i++)
+    {
+      stpi_dither_channel_t *dc = et_source_channel(&p, i);
+      if (!et_channel_is_used(&p, i))
+	continue;
+      for (j = 0; j < et->nstripes; j++)
+	{
+	  et_stripe_t *s = &(et->stripes[j]);
+	  for (k = 0; k < 2; k++)
+	    {
+	      int col = et_spill_column(s, p.direction, k) + MAX_SPREAD;
+	      dc->errs[0][col] += s->errs[i][col] - s->spill[2 * i + k];
+	    }
+	  if (i < CHANNEL_COUNT(d))
+	    {
+	      int *ends = s->channels[i].row_ends;
+	      if (ends[0] != -1 &&
+		  (dc->row_ends[0] == -1 || ends[0] < dc->row_ends[0]))
+		dc->row_ends[0] = ends[0];
+	      if (ends[1] > dc->row_ends[1])
+		dc->row_ends[1] = ends[1];
+	    }
+	}
+      dc->v = last->channels[i].v;
+      ((shade_distance_t *) dc->aux_data)->dis = last->shades[i].dis;
+    }
+}
+
+void
+stpi_dither_et(stp_vars_t *v,
+	       int row,
+	       const unsigned short *raw,
+	       int duplicate_line,
+	       int zero_mask,
+	       const unsigned char *mask)
+{
+  stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
+  eventone_t *et;
+  et_cursor_t cur;
+  int x;
+
+  if (!et_initializer(d, duplicate_line, zero_mask))
+    return;
+
+  et = (eventone_t *) d->aux_data;
+  if (d->stpi_dither_type & D_UNITONE)
+    stp_dither_matrix_set_row(&(et->transition_matrix), row);
+
+  if (et->pool)
+    {
+      et_dither_parallel(d, et, row, raw, mask, 0);
+      return;
+    }
+
+  x = et_cursor_start(d, row, raw, &cur);
+  if (row & 1)
+    et_dither_span(d, et, &cur, x, d->dst_width, 1, mask, 1);
+  else
+    {
+      et_dither_span(d, et, &cur, x, -1, -1, mask, 1);
+      stpi_dither_reverse_row_ends(d);
+    }
+}
+
+void
+stpi_dither_ut(stp_vars_t *v,
+	       int row,
+	       const unsigned short *raw,
+	       int duplicate_line,
+	       int zero_mask,
+	       const unsigned char *mask)
+{
+  stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
+  eventone_t *et;
+  et_cursor_t cur;
+  int x;
+
+  if (CHANNEL_COUNT(d) == 1)
+    {
+      stpi_dither_et(v, row, raw, duplicate_line, zero_mask, mask);
+      return;
+    }
+
+  if (!et_initializer(d, duplicate_line, zero_mask))
+    return;
+
+  et = (eventone_t *) d->aux_data;
+
+  if (et->pool)
+    {
+      et_dither_parallel(d, et, row, raw, mask, 1);
+      return;
+    }
+
+  x = et_cursor_start(d, row, raw, &cur);
+  if (row & 1)
+    ut_dither_span(d, et, &cur, x, d->dst_width, 1, mask, 1);
+  else
+    {
+      ut_dither_span(d, et, &cur, x, -1, -1, mask, 1);
+      stpi_dither_reverse_row_ends(d);
+    }
 }
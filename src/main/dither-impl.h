@@ -78,6 +78,15 @@ typedef struct
 typedef void stpi_ditherfunc_t(stp_vars_t *, int, const unsigned short *, int,
 			       int, const unsigned char *);
 
+/*
+ * Dither one row using only the dither state passed to it, for dithers
+ * whose rows don't depend on each other.
+ */
+struct dither;
+typedef void stpi_dither_rowfunc_t(struct dither *, int,
+				   const unsigned short *, int,
+				   const unsigned char *);
+
 /*
  * An end of a dither segment, describing one ink
  */
@@ -123,6 +132,11 @@ typedef struct dither_channel
   int nlevels;
   stpi_dither_segment_t *ranges;
 
+  unsigned *rangepoint_lut;	/* Where each input value falls within */
+				/* its segment */
+  unsigned char *segment_lut;	/* Segment for each input value, or */
+				/* STPI_NO_SEGMENT */
+
   int error_rows;
   int **errs;
 
@@ -171,10 +185,18 @@ typedef struct dither
   unsigned *subchannel_count;
 
   stpi_ditherfunc_t *ditherfunc;
+  stpi_dither_rowfunc_t *rowfunc; /* NULL if rows depend on each other */
   void *aux_data;
   void (*aux_freefunc)(struct dither *);
+
+  int band_ready;		/* A row has been dithered serially */
+  stpi_thread_pool_t *band_pool; /* Workers for dithering bands of rows */
+  struct dither *band_copies;	/* Private dither state for each row */
+  int band_size;
 } stpi_dither_t;
 
+#define STPI_NO_SEGMENT 255
+
 #define CHANNEL(d, c) ((d)->channel[(c)])
 #define CHANNEL_COUNT(d) ((d)->total_channel_count)
 
@@ -188,12 +210,45 @@ extern stpi_ditherfunc_t stpi_dither_ed;
 extern stpi_ditherfunc_t stpi_dither_et;
 extern stpi_ditherfunc_t stpi_dither_ut;
 
+extern stpi_dither_rowfunc_t stpi_dither_very_fast_row;
+extern stpi_dither_rowfunc_t stpi_dither_ordered_row;
+
 extern void stpi_dither_reverse_row_ends(stpi_dither_t *d);
 extern int stpi_dither_translate_channel(stp_vars_t *v, unsigned channel,
 					 unsigned subchannel);
 extern void stpi_dither_channel_destroy(stpi_dither_channel_t *channel);
 extern void stpi_dither_finalize(stp_vars_t *v);
 extern int *stpi_dither_get_errline(stpi_dither_t *d, int row, int color);
+extern int stpi_dither_set_standard_matrix(stp_vars_t *v, int x_aspect,
+					   int y_aspect, int transpose);
+
+/*
+ * Row-at-a-time helpers for the ordered dithers (dither-simd.c).
+ * Packed rows are (dst_width + 7) / 8 bytes per bit plane.
+ */
+extern unsigned short stpi_dither_gather_channel(const stpi_dither_t *d,
+						 const unsigned short *raw,
+						 int channel,
+						 unsigned short *vals);
+extern void stpi_dither_matrix_row(stp_dither_matrix_impl_t *mat,
+				   const unsigned short *vals, unsigned floor,
+				   const unsigned char *mask, int width,
+				   unsigned *dp);
+extern void stpi_dither_pack_threshold(const unsigned short *vals,
+				       const unsigned *dp, int width,
+				       unsigned char *out);
+extern void stpi_dither_pack_select(const unsigned *rp, const unsigned *dp,
+				    const unsigned char *hi,
+				    const unsigned char *lo, int width,
+				    int planes, int length,
+				    unsigned char *out);
+extern void stpi_dither_store_packed(stpi_dither_channel_t *dc,
+				     unsigned char *packed,
+				     const unsigned char *mask,
+				     unsigned bits, int length);
+extern void stpi_dither_store_planes(stpi_dither_channel_t *dc,
+				     unsigned char *packed,
+				     int planes, int length);
 
 
 #define ADVANCE_UNIDIRECTIONAL(d, bit, input, width, xerror, xstep, xmod) \
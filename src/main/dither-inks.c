@@ -96,6 +96,8 @@ stpi_dither_channel_destroy(stpi_dither_channel_t *channel)
       STP_SAFE_FREE(channel->errs);
     }
   STP_SAFE_FREE(channel->ranges);
+  STP_SAFE_FREE(channel->rangepoint_lut);
+  channel->segment_lut = NULL;
   stp_dither_matrix_destroy(&(channel->pick));
   stp_dither_matrix_destroy(&(channel->dithermat));
 }
@@ -158,6 +160,114 @@ insert_subchannel(stp_vars_t *v, stpi_dither_t *d, int channel, int subchannel)
     initialize_channel(v, channel, i);
 }
 
+#define LUT_BY_RANGE 1
+#define LUT_BY_VALUE 2
+#define LUT_BY_INK 3
+
+/*
+ * Precompute the segment that each input value falls into, and where
+ * it falls within it, so that the dithers don't have to search
+ * dc->ranges for every pixel.  Each dither looks things up slightly
+ * differently: error diffusion by ink range, the ordered dither by ink
+ * value, and EvenTone/UniTone by adjacent entries of the ink list (for
+ * which the "segment" is the index of the lower ink).
+ */
+static void
+build_segment_lut(stpi_dither_channel_t *dc, int kind)
+{
+  unsigned val;
+  int i;
+
+  STP_SAFE_FREE(dc->rangepoint_lut);
+  dc->segment_lut = NULL;
+  if (dc->nlevels <= 0)
+    return;
+  STPI_ASSERT(dc->nlevels < STPI_NO_SEGMENT, NULL);
+
+  dc->rangepoint_lut = stp_malloc(65536 * (sizeof(unsigned) + 1));
+  dc->segment_lut = (unsigned char *) (dc->rangepoint_lut + 65536);
+  for (val = 0; val < 65536; val++)
+    {
+      unsigned char segment = STPI_NO_SEGMENT;
+      unsigned rangepoint = 0;
+      if (kind == LUT_BY_INK)
+	{
+	  const stpi_ink_defn_t *lower = &(dc->ink_list[0]);
+	  for (i = 1; i < dc->nlevels - 1; i++)
+	    {
+	      if (dc->ink_list[i].value > val)
+		break;
+	      lower = &(dc->ink_list[i]);
+	    }
+	  segment = lower - dc->ink_list;
+	  if (val <= lower->value)
+	    rangepoint = 0;
+	  else if (val >= lower[1].value)
+	    rangepoint = 65535;
+	  else
+	    rangepoint = (65535u * (val - lower->value)) /
+	      (lower[1].value - lower->value);
+	}
+      else
+	{
+	  for (i = dc->nlevels - 1; i >= 0; i--)
+	    {
+	      const stpi_dither_segment_t *dd = &(dc->ranges[i]);
+	      unsigned bottom, span;
+	      if (kind == LUT_BY_RANGE)
+		{
+		  bottom = dd->lower->range;
+		  span = dd->range_span;
+		}
+	      else
+		{
+		  bottom = dd->lower->value;
+		  span = dd->value_span;
+		}
+	      if (val > bottom)
+		{
+		  segment = i;
+		  rangepoint = val - bottom;
+		  /* A span of 0 is only possible above the top ink */
+		  if (span < 65535 && span > 0)
+		    rangepoint = rangepoint * 65535 / span;
+		  break;
+		}
+	    }
+	}
+      dc->segment_lut[val] = segment;
+      dc->rangepoint_lut[val] = rangepoint;
+    }
+}
+
+/*
+ * Build the tables for the dither in use.  This waits until all of the
+ * inks are known, since adaptive error diffusion hands the whole row to
+ * the ordered dither if any channel has more than one drop size.
+ */
+static void
+build_segment_luts(stpi_dither_t *d)
+{
+  int kind;
+  int i;
+  if (d->ditherfunc == stpi_dither_ordered)
+    kind = LUT_BY_VALUE;
+  else if (d->ditherfunc == stpi_dither_et || d->ditherfunc == stpi_dither_ut)
+    kind = LUT_BY_INK;
+  else if (d->ditherfunc == stpi_dither_ed)
+    {
+      kind = LUT_BY_RANGE;
+      if (d->stpi_dither_type & D_ADAPTIVE_BASE)
+	for (i = 0; i < CHANNEL_COUNT(d); i++)
+	  if (CHANNEL(d, i).nlevels > 1)
+	    kind = LUT_BY_VALUE;
+    }
+  else
+    return;
+  for (i = 0; i < CHANNEL_COUNT(d); i++)
+    build_segment_lut(&(CHANNEL(d, i)), kind);
+}
+
 void
 stpi_dither_finalize(stp_vars_t *v)
 {
@@ -176,6 +286,7 @@ stpi_dither_finalize(stp_vars_t *v)
 	  stp_dither_matrix_clone(&(d->dither_matrix), &(dc->pick),
 				   x_n * (i % rc), y_n * (i / rc));
 	}
+      build_segment_luts(d);
       d->finalized = 1;
     }
 }
@@ -195,6 +306,15 @@ stp_dither_add_channel(stp_vars_t *v, unsigned char *data,
   d->channel[idx].ptr = data;
 }
 
+void
+stpi_dither_set_channel_buffers(stp_vars_t *v, unsigned char *const *data)
+{
+  stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
+  int i;
+  for (i = 0; i < CHANNEL_COUNT(d); i++)
+    CHANNEL(d, i).ptr = data[i];
+}
+
 static void
 stpi_dither_finalize_ranges(stp_vars_t *v, stpi_dither_channel_t *dc)
 {
@@ -248,6 +368,8 @@ stpi_dither_finalize_ranges(stp_vars_t *v, stpi_dither_channel_t *dc)
     dc->very_fast = 1;
   else
     dc->very_fast = 0;
+  if (d->finalized)
+    build_segment_luts(d);
 
   stp_dprintf(STP_DBG_INK, v,
 	      "  bit_max %d signif_bits %d\n", dc->bit_max, dc->signif_bits);
@@ -171,6 +171,7 @@ stpi_set_dither_function(stp_vars_t *v)
   stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
   int i;
   d->stpi_dither_type = -1;
+  d->rowfunc = NULL;
   if (stp_check_string_parameter(v, "Quality", STP_PARAMETER_ACTIVE))
     quality = stpi_get_quality_by_name(stp_get_string_parameter(v, "Quality"));
 
@@ -259,12 +260,14 @@ stpi_set_dither_function(stp_vars_t *v)
     case D_PREDITHERED:
       RETURN_DITHERFUNC(stpi_dither_predithered, v);
     case D_VERY_FAST:
+      d->rowfunc = stpi_dither_very_fast_row;
       RETURN_DITHERFUNC(stpi_dither_very_fast, v);
     case D_ORDERED:
     case D_ORDERED_SEGMENTED:
     case D_ORDERED_NEW:
     case D_ORDERED_SEGMENTED_NEW:
     case D_FAST:
+      d->rowfunc = stpi_dither_ordered_row;
       RETURN_DITHERFUNC(stpi_dither_ordered, v);
     case D_HYBRID_EVENTONE:
     case D_EVENTONE:
@@ -325,6 +328,11 @@ stpi_dither_free(void *vd)
 {
   stpi_dither_t *d = (stpi_dither_t *) vd;
   int j;
+  if (d->band_pool)
+    stpi_thread_pool_destroy(d->band_pool);
+  for (j = 0; j < d->band_size; j++)
+    stp_free(d->band_copies[j].channel);
+  STP_SAFE_FREE(d->band_copies);
   if (d->aux_freefunc)
     (d->aux_freefunc)(d);
   for (j = 0; j < CHANNEL_COUNT(d); j++)
@@ -391,12 +399,10 @@ stp_dither_init(stp_vars_t *v, stp_image_t *image, int out_width,
     }
   else
     {
-      stp_array_t *array =
-	stp_find_standard_dither_array(d->y_aspect, d->x_aspect);
       int transposed = d->y_aspect < d->x_aspect ? 1 : 0;
-      STPI_ASSERT(array, v);
-      stp_dither_set_matrix_from_dither_array(v, array, transposed);
-      stp_array_destroy(array);
+      int found = stpi_dither_set_standard_matrix(v, d->y_aspect, d->x_aspect,
+						  transposed);
+      STPI_ASSERT(found, v);
     }
 
   d->src_width = in_width;
@@ -456,18 +462,13 @@ stpi_dither_get_errline(stpi_dither_t *d, int row, int color)
   return dc->errs[row % dc->error_rows] + MAX_SPREAD;
 }
 
-void
-stp_dither_internal(stp_vars_t *v, int row, const unsigned short *input,
-		    int duplicate_line, int zero_mask,
-		    const unsigned char *mask)
+static void
+start_row(stpi_dither_t *d, int row)
 {
   int i;
-  stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
-  stpi_dither_finalize(v);
   stp_dither_matrix_set_row(&(d->dither_matrix), row);
   for (i = 0; i < CHANNEL_COUNT(d); i++)
     {
-      CHANNEL(d, i).ptr = CHANNEL(d, i).ptr;
       if (CHANNEL(d, i).ptr)
 	  memset(CHANNEL(d, i).ptr, 0,
 		 (d->dst_width + 7) / 8 * CHANNEL(d, i).signif_bits);
@@ -478,7 +479,141 @@ stp_dither_internal(stp_vars_t *v, int row, const unsigned short *input,
       stp_dither_matrix_set_row(&(CHANNEL(d, i).pick), row);
     }
   d->ptr_offset = 0;
+}
+
+void
+stp_dither_internal(stp_vars_t *v, int row, const unsigned short *input,
+		    int duplicate_line, int zero_mask,
+		    const unsigned char *mask)
+{
+  stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
+  stpi_dither_finalize(v);
+  start_row(d, row);
   (d->ditherfunc)(v, row, input, duplicate_line, zero_mask, mask);
+  d->band_ready = 1;
+}
+
+/*
+ * Dithering bands of rows in parallel.
+ *
+ * The ordered and very fast dithers don't carry anything from one row
+ * to the next, except for the position ditherpoint() caches in each
+ * channel's matrix.  That only makes a difference while the cached
+ * position disagrees with the matrix's x offset, which can only be the
+ * case before the first row that moves it by more than one pixel; such
+ * rows are dithered serially.  Every other row of a band is dithered
+ * by rowfunc on a private copy of the dither state (so nothing shared,
+ * such as ptr_offset or the row ends, is written), into that row's own
+ * buffers.
+ */
+
+typedef struct
+{
+  stpi_dither_t *d;
+  const stpi_dither_row_t *band;
+} band_job_t;
+
+static int
+matrix_is_settled(const stp_dither_matrix_impl_t *mat)
+{
+  int x_mod;
+  if (mat->fast_mask)
+    return 1;
+  x_mod = (mat->last_x + mat->x_offset) % mat->x_size;
+  if (x_mod < 0)
+    x_mod += mat->x_size;
+  return mat->last_x_mod == x_mod;
+}
+
+static int
+rows_are_independent(const stpi_dither_t *d)
+{
+  int i;
+  if (!d->rowfunc || !d->band_ready)
+    return 0;
+  for (i = 0; i < CHANNEL_COUNT(d); i++)
+    if (!matrix_is_settled(&(CHANNEL(d, i).dithermat)))
+      return 0;
+  return 1;
+}
+
+static void
+band_setup(stpi_dither_t *d, int rows)
+{
+  int i;
+  if (!d->band_pool)
+    d->band_pool = stpi_thread_pool_create(stpi_thread_count());
+  if (rows > d->band_size)
+    {
+      d->band_copies =
+	stp_realloc(d->band_copies, sizeof(stpi_dither_t) * rows);
+      for (i = d->band_size; i < rows; i++)
+	d->band_copies[i].channel =
+	  stp_malloc(sizeof(stpi_dither_channel_t) * CHANNEL_COUNT(d));
+      d->band_size = rows;
+    }
+}
+
+static void
+band_dither_row(void *arg, int job)
+{
+  band_job_t *bj = (band_job_t *) arg;
+  const stpi_dither_t *d = bj->d;
+  const stpi_dither_row_t *r = &(bj->band[job]);
+  stpi_dither_t *dr = &(d->band_copies[job]);
+  stpi_dither_channel_t *channels = dr->channel;
+  int i;
+
+  memcpy(dr, d, sizeof(stpi_dither_t));
+  dr->channel = channels;
+  memcpy(channels, d->channel,
+	 sizeof(stpi_dither_channel_t) * CHANNEL_COUNT(d));
+  for (i = 0; i < CHANNEL_COUNT(d); i++)
+    channels[i].ptr = r->buffers[i];
+  start_row(dr, r->y);
+  (d->rowfunc)(dr, r->y, r->input, r->zero_mask, r->mask);
+}
+
+void
+stpi_dither_band(stp_vars_t *v, int rows, const stpi_dither_row_t *band)
+{
+  stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
+  const stpi_dither_t *last;
+  band_job_t bj;
+  int i;
+
+  while (rows > 0 && (rows == 1 || stpi_thread_count() < 2 ||
+		      !rows_are_independent(d)))
+    {
+      stpi_dither_set_channel_buffers(v, band->buffers);
+      stp_dither_internal(v, band->y, band->input, band->duplicate_line,
+			  band->zero_mask, band->mask);
+      band++;
+      rows--;
+    }
+  if (rows == 0)
+    return;
+
+  band_setup(d, rows);
+  bj.d = d;
+  bj.band = band;
+  stpi_thread_pool_run(d->band_pool, band_dither_row, &bj, rows);
+
+  /*
+   * Leave the dither as the last row left it.  The matrices are
+   * settled, so where their cached positions are doesn't matter.
+   */
+  last = &(d->band_copies[rows - 1]);
+  for (i = 0; i < CHANNEL_COUNT(d); i++)
+    {
+      CHANNEL(d, i).ptr = last->channel[i].ptr;
+      CHANNEL(d, i).row_ends[0] = last->channel[i].row_ends[0];
+      CHANNEL(d, i).row_ends[1] = last->channel[i].row_ends[1];
+      stp_dither_matrix_set_row(&(CHANNEL(d, i).dithermat),
+				band[rows - 1].y);
+      stp_dither_matrix_set_row(&(CHANNEL(d, i).pick), band[rows - 1].y);
+    }
+  stp_dither_matrix_set_row(&(d->dither_matrix), band[rows - 1].y);
 }
 
 void
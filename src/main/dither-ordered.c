@@ -46,6 +46,18 @@ typedef struct {
   stpi_new_ordered_t *ord_new;
 } stpi_ordered_t;
 
+/*
+ * Scratch space for dithering a row a channel at a time.
+ */
+typedef struct {
+  unsigned short *vals;
+  unsigned *ditherpoint;
+  unsigned *rangepoint;
+  unsigned char *upper;
+  unsigned char *lower;
+  unsigned char *packed;
+} stpi_ordered_row_t;
+
 static int
 compare_channels(const stpi_dither_channel_t *dc1,
 		 const stpi_dither_channel_t *dc2)
@@ -208,51 +220,79 @@ static inline void
 print_color_ordered(const stpi_dither_t *d, stpi_dither_channel_t *dc, int val,
 		    int x, int y, unsigned char bit, int length)
 {
-  int i;
+  int i = dc->segment_lut[val];
   int j;
   unsigned bits;
-  int levels = dc->nlevels - 1;
+  const stpi_dither_segment_t *dd;
 
   /*
-   * Look for the appropriate range into which the input value falls.
+   * Look up the range into which the input value falls, and where we
+   * are within it.
    */
-  for (i = levels; i >= 0; i--)
+  if (i == STPI_NO_SEGMENT)
+    return;
+  dd = &(dc->ranges[i]);
+  if (dc->rangepoint_lut[val] >= ditherpoint(d, &(dc->dithermat), x))
+    bits = dd->upper->bits;
+  else
+    bits = dd->lower->bits;
+
+  if (bits)
     {
-      stpi_dither_segment_t *dd = &(dc->ranges[i]);
+      unsigned char *tptr = dc->ptr + d->ptr_offset;
 
-      if (val > dd->lower->value)
+      /*
+       * Lay down all of the bits in the pixel.
+       */
+      set_row_ends(dc, x);
+      for (j = 1; j <= bits; j += j, tptr += length)
 	{
-	  /*
-	   * Where are we within the range.
-	   */
-
-	  unsigned rangepoint = val - dd->lower->value;
-	  if (dd->value_span < 65535)
-	    rangepoint = rangepoint * 65535 / dd->value_span;
-
-	  if (rangepoint >= ditherpoint(d, &(dc->dithermat), x))
-	    bits = dd->upper->bits;
-	  else
-	    bits = dd->lower->bits;
-
-	  if (bits)
-	    {
-	      unsigned char *tptr = dc->ptr + d->ptr_offset;
+	  if (j & bits)
+	    tptr[0] |= bit;
+	}
+    }
+}
 
-	      /*
-	       * Lay down all of the bits in the pixel.
-	       */
-	      set_row_ends(dc, x);
-	      for (j = 1; j <= bits; j += j, tptr += length)
-		{
-		  if (j & bits)
-		    tptr[0] |= bit;
-		}
+/*
+ * print_color_ordered() for a whole row of one channel.  The drop sizes
+ * are picked a pixel at a time; comparing against the dither matrix and
+ * laying down the bits is done sixteen pixels at a time.
+ */
+static void
+print_color_ordered_row(const stpi_dither_t *d, stpi_dither_channel_t *dc,
+			const unsigned short *vals, const unsigned char *mask,
+			int planes, stpi_ordered_row_t *r)
+{
+  int levels = dc->nlevels - 1;
+  int width = d->dst_width;
+  int length = (width + 7) / 8;
+  unsigned floor = dc->ranges[0].lower->value;
+  int x, i;
 
-	    }
-	  return;
-	}
+  for (i = 1; i <= levels; i++)
+    if (dc->ranges[i].lower->value < floor)
+      floor = dc->ranges[i].lower->value;
+  for (x = 0; x < width; x++)
+    {
+      unsigned val = vals[x];
+      int segment = dc->segment_lut[val];
+      r->rangepoint[x] = 0;
+      r->upper[x] = 0;
+      r->lower[x] = 0;
+      if (segment == STPI_NO_SEGMENT ||
+	  (mask && !(mask[x >> 3] & (128 >> (x & 7)))))
+	continue;
+      r->rangepoint[x] = dc->rangepoint_lut[val];
+      r->upper[x] = dc->ranges[segment].upper->bits;
+      r->lower[x] = dc->ranges[segment].lower->bits;
     }
+  stpi_dither_matrix_row(&(dc->dithermat), vals, floor, mask, width,
+			 r->ditherpoint);
+  if (planes == 0)
+    return;
+  stpi_dither_pack_select(r->rangepoint, r->ditherpoint, r->upper, r->lower,
+			  width, planes, length, r->packed);
+  stpi_dither_store_planes(dc, r->packed, planes, length);
 }
 
 static void
@@ -327,20 +367,20 @@ init_dither_ordered(stpi_dither_t *d, stp_vars_t *v)
 }
 
 void
-stpi_dither_ordered(stp_vars_t *v,
-		    int row,
-		    const unsigned short *raw,
-		    int duplicate_line,
-		    int zero_mask,
-		    const unsigned char *mask)
+stpi_dither_ordered_row(stpi_dither_t *d,
+			int row,
+			const unsigned short *raw,
+			int zero_mask,
+			const unsigned char *mask)
 {
-  stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
   int		x,
 		length;
   unsigned char	bit;
   int i;
   int one_bit_only = 1;
   int one_level_only = 1;
+  int *planes;
+  int max_planes = 0;
 
   int xerror, xstep, xmod;
 
@@ -355,37 +395,43 @@ stpi_dither_ordered(stp_vars_t *v,
   xmod   = d->src_width % d->dst_width;
   xerror = 0;
 
+  planes = stp_zalloc(sizeof(int) * CHANNEL_COUNT(d));
   for (i = 0; i < CHANNEL_COUNT(d); i++)
     {
       stpi_dither_channel_t *dc = &(CHANNEL(d, i));
+      unsigned all_bits = 0;
+      int j;
       if (dc->nlevels != 1)
 	one_level_only = 0;
       if (dc->nlevels != 1 || dc->ranges[0].upper->bits != 1)
 	one_bit_only = 0;
+      for (j = 0; j < dc->nlevels; j++)
+	all_bits |= dc->ranges[j].upper->bits | dc->ranges[j].lower->bits;
+      while (all_bits >> planes[i])
+	planes[i]++;
+      if (planes[i] > max_planes)
+	max_planes = planes[i];
     }
-  if (! one_bit_only && ! d->aux_data &&
-      (d->stpi_dither_type & (D_ORDERED_SEGMENTED | D_ORDERED_NEW)))
-    init_dither_ordered(d, v);
-
   if (one_bit_only)
     {
-      for (x = 0; x < d->dst_width; x ++)
+      stpi_ordered_row_t r;
+      r.vals = stp_malloc(sizeof(unsigned short) * d->dst_width);
+      r.ditherpoint = stp_malloc(sizeof(unsigned) * d->dst_width);
+      r.packed = stp_malloc(length);
+      for (i = 0; i < CHANNEL_COUNT(d); i++)
 	{
-	  if (!mask || (*(mask + d->ptr_offset) & bit))
-	    {
-	      for (i = 0; i < CHANNEL_COUNT(d); i++)
-		{
-		  if (raw[i] &&
-		      raw[i] >= ditherpoint(d, &(CHANNEL(d, i).dithermat), x))
-		    {
-		      set_row_ends(&(CHANNEL(d, i)), x);
-		      CHANNEL(d, i).ptr[d->ptr_offset] |= bit;
-		    }
-		}
-	    }
-	  ADVANCE_UNIDIRECTIONAL(d, bit, raw, CHANNEL_COUNT(d),
-				 xerror, xstep, xmod);
+	  stpi_dither_channel_t *dc = &(CHANNEL(d, i));
+	  if (!dc->ptr || !stpi_dither_gather_channel(d, raw, i, r.vals))
+	    continue;
+	  stpi_dither_matrix_row(&(dc->dithermat), r.vals, 0, mask,
+				 d->dst_width, r.ditherpoint);
+	  stpi_dither_pack_threshold(r.vals, r.ditherpoint, d->dst_width,
+				     r.packed);
+	  stpi_dither_store_packed(dc, r.packed, mask, 1, length);
 	}
+      stp_free(r.vals);
+      stp_free(r.ditherpoint);
+      stp_free(r.packed);
     }
   else if (d->stpi_dither_type & D_ORDERED_SEGMENTED)
     {
@@ -431,6 +477,29 @@ stpi_dither_ordered(stp_vars_t *v,
 				 xerror, xstep, xmod);
 	}
     }
+  else if ((one_level_only || !(d->stpi_dither_type == D_ORDERED_NEW)) &&
+	   max_planes <= 8)
+    {
+      stpi_ordered_row_t r;
+      r.vals = stp_malloc(sizeof(unsigned short) * d->dst_width);
+      r.ditherpoint = stp_malloc(sizeof(unsigned) * d->dst_width);
+      r.rangepoint = stp_malloc(sizeof(unsigned) * d->dst_width);
+      r.upper = stp_malloc(d->dst_width);
+      r.lower = stp_malloc(d->dst_width);
+      r.packed = stp_malloc(length * max_planes);
+      for (i = 0; i < CHANNEL_COUNT(d); i++)
+	{
+	  stpi_dither_channel_t *dc = &(CHANNEL(d, i));
+	  if (dc->ptr && stpi_dither_gather_channel(d, raw, i, r.vals))
+	    print_color_ordered_row(d, dc, r.vals, mask, planes[i], &r);
+	}
+      stp_free(r.vals);
+      stp_free(r.ditherpoint);
+      stp_free(r.rangepoint);
+      stp_free(r.upper);
+      stp_free(r.lower);
+      stp_free(r.packed);
+    }
   else if (one_level_only || !(d->stpi_dither_type == D_ORDERED_NEW))
     {
       for (x = 0; x != d->dst_width; x ++)
@@ -465,4 +534,36 @@ stpi_dither_ordered(stp_vars_t *v,
 				 xstep, xmod);
 	}
     }
+  stp_free(planes);
+}
+
+void
+stpi_dither_ordered(stp_vars_t *v,
+		    int row,
+		    const unsigned short *raw,
+		    int duplicate_line,
+		    int zero_mask,
+		    const unsigned char *mask)
+{
+  stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
+  int i;
+
+  /*
+   * Set up the segmented and new dithers on the first row, so that
+   * stpi_dither_ordered_row() needs nothing but the dither state.
+   */
+  if (! d->aux_data &&
+      (d->stpi_dither_type & (D_ORDERED_SEGMENTED | D_ORDERED_NEW)))
+    {
+      for (i = 0; i < CHANNEL_COUNT(d); i++)
+	{
+	  stpi_dither_channel_t *dc = &(CHANNEL(d, i));
+	  if (dc->nlevels != 1 || dc->ranges[0].upper->bits != 1)
+	    {
+	      init_dither_ordered(d, v);
+	      break;
+	    }
+	}
+    }
+  stpi_dither_ordered_row(d, row, raw, zero_mask, mask);
 }
@@ -0,0 +1,518 @@
+/*
+ *
+ *   Gutenprint dither module - vectorized threshold kernels.
+ *
+ *   Copyright 2026 the Gutenprint project
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Row-at-a-time support for the ordered and very fast dithers.  Instead
+ * of walking the row a pixel and a channel at a time, each channel's
+ * input is gathered into a row of its own, the matching row of dither
+ * points is copied out of the matrix, and the two are compared sixteen
+ * or thirty-two pixels at a time.  The comparison results are packed
+ * straight into output bytes (most significant bit first, as the
+ * printer drivers expect) with a movemask or its equivalent.
+ *
+ * Everything here produces exactly the same bits as the per-pixel code
+ * did, including the bookkeeping in the dither matrix and the row ends.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <gutenprint/gutenprint.h>
+#include "gutenprint-internal.h"
+#include <gutenprint/gutenprint-intl-internal.h>
+#include <string.h>
+#include "dither-impl.h"
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+unsigned short
+stpi_dither_gather_channel(const stpi_dither_t *d, const unsigned short *raw,
+			   int channel, unsigned short *vals)
+{
+  int xstep = CHANNEL_COUNT(d) * (d->src_width / d->dst_width);
+  int xmod = d->src_width % d->dst_width;
+  int xerror = 0;
+  unsigned short nz = 0;
+  int x;
+
+  raw += channel;
+  for (x = 0; x < d->dst_width; x++)
+    {
+      vals[x] = *raw;
+      nz |= *raw;
+      raw += xstep;
+      if (xmod)
+	{
+	  xerror += xmod;
+	  if (xerror >= d->dst_width)
+	    {
+	      xerror -= d->dst_width;
+	      raw += CHANNEL_COUNT(d);
+	    }
+	}
+    }
+  return nz;
+}
+
+/*
+ * Copy count dither points starting at column phase of the current row
+ * of mat, wrapping around at the end of the row.
+ */
+static void
+copy_matrix_row(const stp_dither_matrix_impl_t *mat, int phase, int count,
+		unsigned *dp)
+{
+  const unsigned *row = mat->matrix + mat->last_y_mod;
+  phase %= mat->x_size;
+  if (phase < 0)
+    phase += mat->x_size;
+  while (count > 0)
+    {
+      int n = mat->x_size - phase;
+      if (n > count)
+	n = count;
+      memcpy(dp, row + phase, n * sizeof(unsigned));
+      dp += n;
+      count -= n;
+      phase = 0;
+    }
+}
+
+#define ENABLED(x)							\
+  (vals[x] > floor && (!mask || (mask[(x) >> 3] & (128 >> ((x) & 7)))))
+
+void
+stpi_dither_matrix_row(stp_dither_matrix_impl_t *mat,
+		       const unsigned short *vals, unsigned floor,
+		       const unsigned char *mask, int width, unsigned *dp)
+{
+  int first, last, run_end, phase;
+
+  copy_matrix_row(mat, mat->x_offset, width, dp);
+  if (mat->fast_mask)
+    return;
+
+  /*
+   * ditherpoint() carries its position in the matrix over from the last
+   * pixel it was asked about.  If the first pixel in this row that it
+   * would have been asked about is next to that one, it steps from the
+   * old position, which need not agree with x_offset, and it keeps doing
+   * so until it skips a pixel.  Reproduce that, and leave the matrix as
+   * ditherpoint() would have.
+   */
+  for (first = 0; first < width; first++)
+    if (ENABLED(first))
+      break;
+  if (first == width)
+    return;
+  for (last = width - 1; last > first; last--)
+    if (ENABLED(last))
+      break;
+
+  phase = mat->x_offset;
+  if (first >= mat->last_x - 1 && first <= mat->last_x + 1)
+    {
+      for (run_end = first + 1; run_end < width; run_end++)
+	if (!ENABLED(run_end))
+	  break;
+      phase = mat->last_x_mod - mat->last_x;
+      copy_matrix_row(mat, phase + first, run_end - first, dp + first);
+      if (last >= run_end)
+	phase = mat->x_offset;
+    }
+  mat->last_x = last;
+  mat->last_x_mod = (last + phase) % mat->x_size;
+  if (mat->last_x_mod < 0)
+    mat->last_x_mod += mat->x_size;
+  mat->index = mat->last_x_mod + mat->last_y_mod;
+}
+
+#undef ENABLED
+
+/*
+ * Bit reversal of a byte, for the pixels left over at the end of a row.
+ */
+static inline unsigned char
+msb_first(unsigned bits)
+{
+  bits = ((bits & 0x0f) << 4) | ((bits & 0xf0) >> 4);
+  bits = ((bits & 0x33) << 2) | ((bits & 0xcc) >> 2);
+  bits = ((bits & 0x55) << 1) | ((bits & 0xaa) >> 1);
+  return bits;
+}
+
+static void
+scalar_threshold(const unsigned short *vals, const unsigned *dp, int start,
+		 int width, unsigned char *out)
+{
+  int x;
+  for (x = start; x < width; x += 8)
+    {
+      unsigned bits = 0;
+      int i;
+      for (i = 0; i < 8 && x + i < width; i++)
+	if (vals[x + i] && vals[x + i] >= dp[x + i])
+	  bits |= 1 << i;
+      out[x >> 3] = msb_first(bits);
+    }
+}
+
+static void
+scalar_select(const unsigned *rp, const unsigned *dp,
+	      const unsigned char *hi, const unsigned char *lo, int start,
+	      int width, int planes, int length, unsigned char *out)
+{
+  int x;
+  for (x = start; x < width; x += 8)
+    {
+      unsigned bits[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+      int i, j;
+      for (i = 0; i < 8 && x + i < width; i++)
+	{
+	  unsigned sel = rp[x + i] >= dp[x + i] ? hi[x + i] : lo[x + i];
+	  for (j = 0; j < planes; j++)
+	    if (sel & (1 << j))
+	      bits[j] |= 1 << i;
+	}
+      for (j = 0; j < planes; j++)
+	out[j * length + (x >> 3)] = msb_first(bits[j]);
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+#define SSE41 __attribute__((target("sse4.1")))
+#define AVX2 __attribute__((target("avx2")))
+
+/*
+ * Unsigned a >= b for four 32-bit lanes.
+ */
+static inline SSE41 __m128i
+sse41_ge_epu32(__m128i a, __m128i b)
+{
+  return _mm_cmpeq_epi32(_mm_max_epu32(a, b), a);
+}
+
+/*
+ * Compare sixteen rangepoints against sixteen dither points, leaving
+ * 0xff in each byte where the rangepoint is at least the dither point.
+ */
+static inline SSE41 __m128i
+sse41_ge_16(const unsigned *rp, const unsigned *dp)
+{
+  __m128i ge0 = sse41_ge_epu32(_mm_loadu_si128((const __m128i *) rp),
+			       _mm_loadu_si128((const __m128i *) dp));
+  __m128i ge1 = sse41_ge_epu32(_mm_loadu_si128((const __m128i *) (rp + 4)),
+			       _mm_loadu_si128((const __m128i *) (dp + 4)));
+  __m128i ge2 = sse41_ge_epu32(_mm_loadu_si128((const __m128i *) (rp + 8)),
+			       _mm_loadu_si128((const __m128i *) (dp + 8)));
+  __m128i ge3 = sse41_ge_epu32(_mm_loadu_si128((const __m128i *) (rp + 12)),
+			       _mm_loadu_si128((const __m128i *) (dp + 12)));
+  return _mm_packs_epi16(_mm_packs_epi32(ge0, ge1), _mm_packs_epi32(ge2, ge3));
+}
+
+/*
+ * Pack the top bit of sixteen bytes into two output bytes, the first
+ * byte in the most significant bit.
+ */
+static inline SSE41 void
+sse41_movemask_msb(__m128i v, unsigned char *out)
+{
+  const __m128i reverse =
+    _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  unsigned bits = _mm_movemask_epi8(_mm_shuffle_epi8(v, reverse));
+  out[0] = bits & 0xff;
+  out[1] = bits >> 8;
+}
+
+static SSE41 int
+sse41_threshold(const unsigned short *vals, const unsigned *dp, int width,
+		unsigned char *out)
+{
+  const __m128i zero = _mm_setzero_si128();
+  int x;
+  for (x = 0; x + 16 <= width; x += 16)
+    {
+      __m128i v0 = _mm_loadu_si128((const __m128i *) (vals + x));
+      __m128i v1 = _mm_loadu_si128((const __m128i *) (vals + x + 8));
+      __m128i ge0 =
+	_mm_packs_epi32(sse41_ge_epu32(_mm_cvtepu16_epi32(v0),
+				       _mm_loadu_si128((const __m128i *)
+						       (dp + x))),
+			sse41_ge_epu32(_mm_cvtepu16_epi32(_mm_srli_si128(v0, 8)),
+				       _mm_loadu_si128((const __m128i *)
+						       (dp + x + 4))));
+      __m128i ge1 =
+	_mm_packs_epi32(sse41_ge_epu32(_mm_cvtepu16_epi32(v1),
+				       _mm_loadu_si128((const __m128i *)
+						       (dp + x + 8))),
+			sse41_ge_epu32(_mm_cvtepu16_epi32(_mm_srli_si128(v1, 8)),
+				       _mm_loadu_si128((const __m128i *)
+						       (dp + x + 12))));
+      ge0 = _mm_andnot_si128(_mm_cmpeq_epi16(v0, zero), ge0);
+      ge1 = _mm_andnot_si128(_mm_cmpeq_epi16(v1, zero), ge1);
+      sse41_movemask_msb(_mm_packs_epi16(ge0, ge1), out + (x >> 3));
+    }
+  return x;
+}
+
+static SSE41 int
+sse41_select(const unsigned *rp, const unsigned *dp,
+	     const unsigned char *hi, const unsigned char *lo, int width,
+	     int planes, int length, unsigned char *out)
+{
+  int x, j;
+  for (x = 0; x + 16 <= width; x += 16)
+    {
+      __m128i sel =
+	_mm_blendv_epi8(_mm_loadu_si128((const __m128i *) (lo + x)),
+			_mm_loadu_si128((const __m128i *) (hi + x)),
+			sse41_ge_16(rp + x, dp + x));
+      for (j = 0; j < planes; j++)
+	{
+	  __m128i plane = _mm_set1_epi8(1 << j);
+	  sse41_movemask_msb(_mm_cmpeq_epi8(_mm_and_si128(sel, plane), plane),
+			     out + j * length + (x >> 3));
+	}
+    }
+  return x;
+}
+
+/*
+ * Unsigned a >= b for eight 32-bit lanes.
+ */
+static inline AVX2 __m256i
+avx2_ge_epu32(__m256i a, __m256i b)
+{
+  return _mm256_cmpeq_epi32(_mm256_max_epu32(a, b), a);
+}
+
+static AVX2 int
+avx2_threshold(const unsigned short *vals, const unsigned *dp, int width,
+	       unsigned char *out)
+{
+  const __m256i reverse =
+    _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+		     7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  const __m256i zero = _mm256_setzero_si256();
+  int x;
+  for (x = 0; x + 32 <= width; x += 32)
+    {
+      __m256i v0 = _mm256_loadu_si256((const __m256i *) (vals + x));
+      __m256i v1 = _mm256_loadu_si256((const __m256i *) (vals + x + 16));
+      __m256i ge[4];
+      __m256i ge0, ge1;
+      unsigned bits;
+      int i;
+      for (i = 0; i < 4; i++)
+	{
+	  __m128i v = _mm_loadu_si128((const __m128i *) (vals + x + i * 8));
+	  ge[i] = avx2_ge_epu32(_mm256_cvtepu16_epi32(v),
+				_mm256_loadu_si256((const __m256i *)
+						   (dp + x + i * 8)));
+	}
+      /* The packs work within each 128-bit lane; put the pixels back in order */
+      ge0 = _mm256_permute4x64_epi64(_mm256_packs_epi32(ge[0], ge[1]), 0xd8);
+      ge1 = _mm256_permute4x64_epi64(_mm256_packs_epi32(ge[2], ge[3]), 0xd8);
+      ge0 = _mm256_andnot_si256(_mm256_cmpeq_epi16(v0, zero), ge0);
+      ge1 = _mm256_andnot_si256(_mm256_cmpeq_epi16(v1, zero), ge1);
+      ge0 = _mm256_permute4x64_epi64(_mm256_packs_epi16(ge0, ge1), 0xd8);
+      bits = _mm256_movemask_epi8(_mm256_shuffle_epi8(ge0, reverse));
+      out[(x >> 3)] = bits & 0xff;
+      out[(x >> 3) + 1] = (bits >> 8) & 0xff;
+      out[(x >> 3) + 2] = (bits >> 16) & 0xff;
+      out[(x >> 3) + 3] = bits >> 24;
+    }
+  return x;
+}
+
+#endif /* HAVE_X86_SIMD */
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+
+/*
+ * Pack the top bit of sixteen bytes into two output bytes, the first
+ * byte in the most significant bit.
+ */
+static inline void
+neon_movemask_msb(uint8x16_t v, unsigned char *out)
+{
+  static const unsigned char weights[16] =
+    { 128, 64, 32, 16, 8, 4, 2, 1, 128, 64, 32, 16, 8, 4, 2, 1 };
+  uint8x16_t w = vandq_u8(v, vld1q_u8(weights));
+  out[0] = vaddv_u8(vget_low_u8(w));
+  out[1] = vaddv_u8(vget_high_u8(w));
+}
+
+static inline uint8x16_t
+neon_ge_16(const unsigned *rp, const unsigned *dp)
+{
+  uint16x8_t ge0 =
+    vcombine_u16(vmovn_u32(vcgeq_u32(vld1q_u32(rp), vld1q_u32(dp))),
+		 vmovn_u32(vcgeq_u32(vld1q_u32(rp + 4), vld1q_u32(dp + 4))));
+  uint16x8_t ge1 =
+    vcombine_u16(vmovn_u32(vcgeq_u32(vld1q_u32(rp + 8), vld1q_u32(dp + 8))),
+		 vmovn_u32(vcgeq_u32(vld1q_u32(rp + 12),
+				     vld1q_u32(dp + 12))));
+  return vcombine_u8(vmovn_u16(ge0), vmovn_u16(ge1));
+}
+
+static int
+neon_threshold(const unsigned short *vals, const unsigned *dp, int width,
+	       unsigned char *out)
+{
+  int x;
+  for (x = 0; x + 16 <= width; x += 16)
+    {
+      uint16x8_t v0 = vld1q_u16(vals + x);
+      uint16x8_t v1 = vld1q_u16(vals + x + 8);
+      uint16x8_t ge0 =
+	vcombine_u16(vmovn_u32(vcgeq_u32(vmovl_u16(vget_low_u16(v0)),
+					 vld1q_u32(dp + x))),
+		     vmovn_u32(vcgeq_u32(vmovl_u16(vget_high_u16(v0)),
+					 vld1q_u32(dp + x + 4))));
+      uint16x8_t ge1 =
+	vcombine_u16(vmovn_u32(vcgeq_u32(vmovl_u16(vget_low_u16(v1)),
+					 vld1q_u32(dp + x + 8))),
+		     vmovn_u32(vcgeq_u32(vmovl_u16(vget_high_u16(v1)),
+					 vld1q_u32(dp + x + 12))));
+      ge0 = vandq_u16(ge0, vtstq_u16(v0, v0));
+      ge1 = vandq_u16(ge1, vtstq_u16(v1, v1));
+      neon_movemask_msb(vcombine_u8(vmovn_u16(ge0), vmovn_u16(ge1)),
+			out + (x >> 3));
+    }
+  return x;
+}
+
+static int
+neon_select(const unsigned *rp, const unsigned *dp,
+	    const unsigned char *hi, const unsigned char *lo, int width,
+	    int planes, int length, unsigned char *out)
+{
+  int x, j;
+  for (x = 0; x + 16 <= width; x += 16)
+    {
+      uint8x16_t sel = vbslq_u8(neon_ge_16(rp + x, dp + x),
+				vld1q_u8(hi + x), vld1q_u8(lo + x));
+      for (j = 0; j < planes; j++)
+	neon_movemask_msb(vtstq_u8(sel, vdupq_n_u8(1 << j)),
+			  out + j * length + (x >> 3));
+    }
+  return x;
+}
+
+#endif /* __ARM_NEON && __aarch64__ */
+
+void
+stpi_dither_pack_threshold(const unsigned short *vals, const unsigned *dp,
+			   int width, unsigned char *out)
+{
+  int x = 0;
+#ifdef HAVE_X86_SIMD
+  if (stpi_cpu_features() & STPI_CPU_AVX2)
+    x = avx2_threshold(vals, dp, width, out);
+  if (stpi_cpu_features() & STPI_CPU_SSE41)
+    x += sse41_threshold(vals + x, dp + x, width - x, out + (x >> 3));
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+  if (stpi_cpu_features() & STPI_CPU_NEON)
+    x = neon_threshold(vals, dp, width, out);
+#endif
+  scalar_threshold(vals, dp, x, width, out);
+}
+
+void
+stpi_dither_pack_select(const unsigned *rp, const unsigned *dp,
+			const unsigned char *hi, const unsigned char *lo,
+			int width, int planes, int length, unsigned char *out)
+{
+  int x = 0;
+#ifdef HAVE_X86_SIMD
+  if (stpi_cpu_features() & STPI_CPU_SSE41)
+    x = sse41_select(rp, dp, hi, lo, width, planes, length, out);
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+  if (stpi_cpu_features() & STPI_CPU_NEON)
+    x = neon_select(rp, dp, hi, lo, width, planes, length, out);
+#endif
+  scalar_select(rp, dp, hi, lo, x, width, planes, length, out);
+}
+
+/*
+ * Record the first and last pixels set in a packed row, as set_row_ends()
+ * would have.
+ */
+static void
+packed_row_ends(stpi_dither_channel_t *dc, const unsigned char *any,
+		int length)
+{
+  int first, last, b;
+  for (first = 0; first < length; first++)
+    if (any[first])
+      break;
+  if (first == length)
+    return;
+  for (last = length - 1; last > first; last--)
+    if (any[last])
+      break;
+  if (dc->row_ends[0] == -1)
+    {
+      for (b = 0; !(any[first] & (128 >> b)); b++)
+	;
+      dc->row_ends[0] = first * 8 + b;
+    }
+  for (b = 7; !(any[last] & (128 >> b)); b--)
+    ;
+  dc->row_ends[1] = last * 8 + b;
+}
+
+void
+stpi_dither_store_packed(stpi_dither_channel_t *dc, unsigned char *packed,
+			 const unsigned char *mask, unsigned bits, int length)
+{
+  unsigned char *tptr = dc->ptr;
+  int i, j;
+  if (mask)
+    for (i = 0; i < length; i++)
+      packed[i] &= mask[i];
+  for (j = 1; j <= bits; j += j, tptr += length)
+    if (j & bits)
+      for (i = 0; i < length; i++)
+	tptr[i] |= packed[i];
+  packed_row_ends(dc, packed, length);
+}
+
+void
+stpi_dither_store_planes(stpi_dither_channel_t *dc, unsigned char *packed,
+			 int planes, int length)
+{
+  int i, j;
+  for (j = 0; j < planes; j++)
+    for (i = 0; i < length; i++)
+      dc->ptr[j * length + i] |= packed[j * length + i];
+  for (j = 1; j < planes; j++)
+    for (i = 0; i < length; i++)
+      packed[i] |= packed[j * length + i];
+  packed_row_ends(dc, packed, length);
+}
@@ -111,6 +111,12 @@ typedef struct stp_family
 extern int stpi_family_register(stp_list_t *family);
 extern int stpi_family_unregister(stp_list_t *family);
 
+/**
+ * Register the printers in a family module's printer file.
+ * @param name the name of the file, relative to the data path.
+ */
+extern void stpi_printer_file_register(const char *name);
+
 
 /*
  * Paper size functions
@@ -248,6 +254,275 @@ extern void stpi_find_duplicate_printers(void);
 
 extern time_t stpi_time(time_t *t);
 
+/**
+ * Replace the output buffers of all dither channels at once, e. g. to
+ * dither successive rows into different buffers.
+ * @param v the Gutenprint vars object
+ * @param data the new buffers, one per subchannel, in the order of
+ * channels and then subchannels as passed to stp_dither_add_channel().
+ */
+extern void stpi_dither_set_channel_buffers(stp_vars_t *v,
+					    unsigned char *const *data);
+
+/**
+ * One row of a band passed to stpi_dither_band().
+ */
+typedef struct
+{
+  int y;			/* Row number, as for stp_dither_internal() */
+  const unsigned short *input;
+  int duplicate_line;
+  int zero_mask;
+  const unsigned char *mask;
+  unsigned char *const *buffers; /* As for stpi_dither_set_channel_buffers() */
+} stpi_dither_row_t;
+
+/**
+ * Dither a band of consecutive rows, each into its own buffers.  The
+ * result is the same as calling stpi_dither_set_channel_buffers() and
+ * stp_dither_internal() for each row in turn, and the dither is left
+ * in the same state; but dithers whose rows don't depend on each other
+ * are run on several threads if STP_THREADS allows.
+ * @param v the Gutenprint vars object
+ * @param rows the number of rows
+ * @param band the rows, in order
+ */
+extern void stpi_dither_band(stp_vars_t *v, int rows,
+			     const stpi_dither_row_t *band);
+
+/**
+ * Thread support (internal).
+ *
+ * @defgroup thread_internal thread-internal
+ * @{
+ */
+
+/**
+ * Get the number of threads rendering code may use.  This is taken
+ * from the STP_THREADS environment variable, and is always 1 if
+ * Gutenprint was built without thread support.
+ * @returns the number of threads (at least 1).
+ */
+extern int stpi_thread_count(void);
+
+/**
+ * Take the lock protecting global state that may change while other
+ * threads are running (interned parameter names, cached XML data).
+ * The lock is not recursive, and does nothing if Gutenprint was built
+ * without thread support.
+ */
+extern void stpi_global_lock(void);
+
+/**
+ * Release the lock taken by stpi_global_lock().
+ */
+extern void stpi_global_unlock(void);
+
+/*
+ * Publish a value to, and read it from, other threads without taking
+ * a lock: everything written before STPI_STORE_RELEASE() is visible to
+ * a thread once STPI_LOAD_ACQUIRE() has returned the stored value.
+ */
+#ifdef __GNUC__
+#define STPI_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STPI_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define STPI_LOAD_ACQUIRE(p) (*(p))
+#define STPI_STORE_RELEASE(p, v) (*(p) = (v))
+#endif
+
+typedef struct stpi_thread stpi_thread_t;
+
+/**
+ * Start a new thread.
+ * @param func the function to run.
+ * @param arg the argument to pass to func.
+ * @returns the new thread, or NULL on failure.
+ */
+extern stpi_thread_t *stpi_thread_create(void *(*func)(void *), void *arg);
+
+/**
+ * Wait for a thread to finish and release it.
+ * @param thread the thread to wait for.
+ * @returns the value returned by the thread function.
+ */
+extern void *stpi_thread_join(stpi_thread_t *thread);
+
+/**
+ * A bounded, ordered queue of row slots between one producing and one
+ * consuming thread.  Slots are handed out in order as indices from 0
+ * to depth - 1; the caller owns the storage they refer to.
+ */
+typedef struct stpi_row_queue stpi_row_queue_t;
+
+extern stpi_row_queue_t *stpi_row_queue_create(int depth);
+extern void stpi_row_queue_destroy(stpi_row_queue_t *q);
+
+/**
+ * Wait for a free slot for the producer to fill.
+ * @returns the slot, or -1 if the consumer has cancelled the queue.
+ */
+extern int stpi_row_queue_reserve(stpi_row_queue_t *q);
+
+/** Hand the most recently reserved slot to the consumer. */
+extern void stpi_row_queue_commit(stpi_row_queue_t *q);
+
+/**
+ * Wait for the next filled slot.
+ * @returns the slot, or -1 if the queue has been closed and drained,
+ * or cancelled.
+ */
+extern int stpi_row_queue_take(stpi_row_queue_t *q);
+
+/** Return the most recently taken slot to the producer. */
+extern void stpi_row_queue_release(stpi_row_queue_t *q);
+
+/**
+ * Wait for free slots, as stpi_row_queue_reserve(), but take up to max
+ * of them at once.  The slots follow each other from *slot, wrapping
+ * around at the depth of the queue.
+ * @returns the number of slots, or 0 if the consumer has cancelled the
+ * queue.
+ */
+extern int stpi_row_queue_reserve_rows(stpi_row_queue_t *q, int max,
+				       int *slot);
+
+/** Hand the count oldest reserved slots to the consumer. */
+extern void stpi_row_queue_commit_rows(stpi_row_queue_t *q, int count);
+
+/**
+ * Wait for filled slots, as stpi_row_queue_take(), but take up to max
+ * of them at once, in the same way as stpi_row_queue_reserve_rows().
+ * @returns the number of slots, or 0 if the queue has been closed and
+ * drained, or cancelled.
+ */
+extern int stpi_row_queue_take_rows(stpi_row_queue_t *q, int max, int *slot);
+
+/** Return the count oldest taken slots to the producer. */
+extern void stpi_row_queue_release_rows(stpi_row_queue_t *q, int count);
+
+/** Indicate that the producer will commit no more rows. */
+extern void stpi_row_queue_close(stpi_row_queue_t *q);
+
+/** Indicate that the consumer will take no more rows. */
+extern void stpi_row_queue_cancel(stpi_row_queue_t *q);
+
+/**
+ * A fixed set of worker threads that run batches of independent jobs.
+ * The thread submitting a batch takes part in running it.
+ */
+typedef struct stpi_thread_pool stpi_thread_pool_t;
+
+/**
+ * Create a thread pool.
+ * @param threads the number of threads, including the caller, that
+ * will run jobs.
+ * @returns the pool, or NULL if no worker thread could be started.
+ */
+extern stpi_thread_pool_t *stpi_thread_pool_create(int threads);
+extern void stpi_thread_pool_destroy(stpi_thread_pool_t *pool);
+
+/**
+ * Get the number of threads, including the caller, that run jobs.
+ */
+extern int stpi_thread_pool_size(const stpi_thread_pool_t *pool);
+
+/**
+ * Run func(arg, job) for each job from 0 to jobs - 1, and wait for
+ * all of them to finish.  Jobs may run in any order.
+ */
+extern void stpi_thread_pool_run(stpi_thread_pool_t *pool,
+				 void (*func)(void *arg, int job),
+				 void *arg, int jobs);
+
+/** @} */
+
+/**
+ * CPU feature detection (internal).
+ *
+ * @defgroup cpu_internal cpu-internal
+ * @{
+ */
+
+#define STPI_CPU_SSE41	(1 << 0)
+#define STPI_CPU_AVX2	(1 << 1)
+#define STPI_CPU_NEON	(1 << 2)
+
+/**
+ * Get the vector instruction sets that both this build of Gutenprint
+ * and the CPU support.  This is always 0 if the STP_SIMD environment
+ * variable is set to 0.
+ * @returns a mask of STPI_CPU_* flags.
+ */
+extern unsigned stpi_cpu_features(void);
+
+/** @} */
+
+/**
+ * Binary cache of parsed XML files (internal).  The cache is used only
+ * if the STP_XML_CACHE_DIR environment variable names its directory.
+ *
+ * @defgroup xml_cache_internal xml-cache-internal
+ * @{
+ */
+
+/**
+ * Load an XML file, from its binary cache if that is up to date.
+ * This is equivalent to stp_mxmlLoadFromFile(NULL, file,
+ * STP_MXML_NO_CALLBACK), except that the tree returned must not be
+ * modified.  It is freed with stp_mxmlDelete() as usual.
+ * @param file the name of the file to load.
+ * @returns the root of the tree, or NULL if the file can't be read.
+ */
+extern stp_mxml_node_t *stpi_xml_cache_load(const char *file);
+
+/**
+ * Check whether a node belongs to a tree loaded from the cache.
+ * @param node the node to check.
+ * @returns nonzero if the node is in a cached tree.
+ */
+extern int stpi_xml_cache_owns(const stp_mxml_node_t *node);
+
+/**
+ * Release a node belonging to a tree loaded from the cache.  Releasing
+ * the root of the tree frees the whole tree; other nodes are freed
+ * along with it.
+ * @param node the node to release.
+ * @returns nonzero if the node is in a cached tree (and so must not be
+ * freed by the caller), zero otherwise.
+ */
+extern int stpi_xml_cache_release(stp_mxml_node_t *node);
+
+/**
+ * Compute data from an XML file.
+ * @param file the name of the source file.
+ * @param closure the closure passed to stpi_xml_cache_load_data().
+ * @param size where to store the size of the data.
+ * @returns the data, allocated with stp_malloc(), or NULL on failure.
+ */
+typedef void *stpi_xml_cache_fill_t(const char *file, void *closure,
+				    size_t *size);
+
+/**
+ * Load data computed from an XML file, from the cache if that is up to
+ * date.  Otherwise the data is computed with fill() and the cache, if
+ * enabled, is written.  Cached data is mapped read-only and shared between
+ * processes.
+ * @param file the name of the source file.
+ * @param variant distinguishes different data computed from one file.
+ * @param fill computes the data.
+ * @param closure passed to fill().
+ * @param size where to store the size of the data.
+ * @returns the data, which must not be modified and remains valid for
+ * the life of the process, or NULL if it can't be computed.
+ */
+extern const void *stpi_xml_cache_load_data(const char *file,
+					    const char *variant,
+					    stpi_xml_cache_fill_t *fill,
+					    void *closure, size_t *size);
+
+/** @} */
+
 #define CAST_IS_SAFE GCC_DIAG_OFF(cast-qual)
 #define CAST_IS_UNSAFE GCC_DIAG_ON(cast-qual)
 
@@ -324,7 +324,7 @@ static int stp_module_register(stp_module_t *module /* Module to register */)
       char buf[MAXPATHLEN+1];
       (void) snprintf(buf, MAXPATHLEN, "printers/%s.xml", module->name);
       stp_deprintf(STP_DBG_MODULE, "stp-module: attempting to load: %s\n", buf);
-      stp_xml_parse_file_named(buf);
+      stpi_printer_file_register(buf);
     }
   stp_deprintf(STP_DBG_MODULE, "stp-module: register: %s\n", module->name);
   return 0;
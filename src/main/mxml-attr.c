@@ -27,6 +27,8 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+#include <gutenprint/gutenprint.h>
+#include "gutenprint-internal.h"
 
 
 /*
@@ -94,6 +96,16 @@ stp_mxmlElementSetAttr(stp_mxml_node_t *node,	/* I - Element node */
   if (!node || node->type != STP_MXML_ELEMENT || !name || !value)
     return;
 
+ /*
+  * Trees loaded from the binary cache are read-only...
+  */
+
+  if (stpi_xml_cache_owns(node))
+  {
+    stp_erprintf("stp_mxmlElementSetAttr: %s is in a cached tree\n", name);
+    return;
+  }
+
  /*
   * Look for the attribute...
   */
@@ -35,6 +35,8 @@
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+#include <gutenprint/gutenprint.h>
+#include "gutenprint-internal.h"
 
 
 /*
@@ -186,6 +188,13 @@ stp_mxmlDelete(stp_mxml_node_t *node)		/* I - Node to delete */
 
   stp_mxmlRemove(node);
 
+ /*
+  * Trees loaded from the binary cache are freed all at once...
+  */
+
+  if (stpi_xml_cache_release(node))
+    return;
+
  /*
   * Delete children...
   */
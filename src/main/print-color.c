@@ -757,16 +757,22 @@ stpi_color_traditional_get_row(stp_vars_t *v,
 			       int row,
 			       unsigned *zero_mask)
 {
-  const lut_t *lut = (const lut_t *)(stp_get_component_data(v, "Color"));
+  lut_t *lut = (lut_t *)(stp_get_component_data(v, "Color"));
   unsigned zero;
+  if (!lut->convert)
+    {
+      /* A copy of the lut doesn't inherit the original's plan */
+      lut->convert = (lut->output_color_description->select_conversion)(v);
+      if (!lut->convert)
+	return 2;
+    }
   if (stp_image_get_row(image, lut->in_data,
 			lut->image_width * lut->in_channels * lut->channel_depth / 8, row)
       != STP_IMAGE_STATUS_OK)
     return 2;
   if (!lut->channels_are_initialized)
     initialize_channels(v, image);
-  zero = (lut->output_color_description->conversion_function)
-    (v, lut->in_data, stp_channel_get_input(v));
+  zero = (lut->convert)(v, lut->in_data, stp_channel_get_input(v));
   if (zero_mask)
     *zero_mask = zero;
   stp_channel_convert(v, zero_mask);
@@ -842,6 +848,7 @@ copy_lut(void *vlut)
   stp_curve_cache_copy(&(dest->sat_map), &(src->sat_map));
   /* Don't copy gray_tmp */
   /* Don't copy cmy_tmp */
+  /* Don't copy the conversion plan; it points into src's curve caches */
   if (src->in_data)
     {
       dest->in_data = stp_malloc(src->image_width * src->in_channels);
@@ -864,6 +871,7 @@ free_lut(void *vlut)
   STP_SAFE_FREE(lut->gray_tmp);
   STP_SAFE_FREE(lut->cmy_tmp);
   STP_SAFE_FREE(lut->in_data);
+  STP_SAFE_FREE(lut->simd_tables);
   memset(lut, 0, sizeof(lut_t));
   stp_free(lut);
 }
@@ -1580,6 +1588,14 @@ stpi_color_traditional_init(stp_vars_t *v,
   total_channel_bits = lut->in_channels * lut->channel_depth;
   lut->in_data = stp_malloc(((lut->image_width * total_channel_bits) + 7)/8);
   memset(lut->in_data, 0, ((lut->image_width * total_channel_bits) + 7) / 8);
+  lut->convert = (lut->output_color_description->select_conversion)(v);
+  if (!lut->convert)
+    {
+      stp_eprintf(v, "stpi_color_traditional_init: no conversion from %s to %s\n",
+		  lut->input_color_description->name,
+		  lut->output_color_description->name);
+      return -1;
+    }
   return lut->out_channels;
 }
 
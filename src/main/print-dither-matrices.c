@@ -452,6 +452,7 @@ typedef struct
   int y;
   const char *filename;
   const stp_array_t *dither_array;
+  const unsigned *matrix[2];	/* Final matrices, by transposition */
 } stp_xml_dither_cache_t;
 
 static stp_xml_dither_cache_t *
@@ -507,6 +508,8 @@ stp_xml_dither_cache_set(int x, int y, const char *filename)
   cacheval->y = y;
   cacheval->filename = stp_strdup(filename);
   cacheval->dither_array = NULL;
+  cacheval->matrix[0] = NULL;
+  cacheval->matrix[1] = NULL;
 
   stp_list_item_create(dither_matrix_cache, NULL, (void *) cacheval);
 
@@ -630,7 +633,7 @@ stpi_dither_array_create_from_file(const char* file, int x, int y)
   stp_deprintf(STP_DBG_XML,
 	       "stpi_dither_array_create_from_file: reading `%s'...\n", file);
 
-  doc = stp_mxmlLoadFromFile(NULL, file, STP_MXML_NO_CALLBACK);
+  doc = stpi_xml_cache_load(file);
 
   if (doc)
     {
@@ -647,33 +650,133 @@ stpi_dither_array_create_from_file(const char* file, int x, int y)
   return ret;
 }
 
+static stp_xml_dither_cache_t *
+stp_xml_dither_cache_find(int x, int y)
+{
+  stp_xml_dither_cache_t *cachedval = stp_xml_dither_cache_get(x, y);
+
+  if (!cachedval)
+    {
+      char buf[MAXPATHLEN+1];
+      (void) snprintf(buf, MAXPATHLEN, "dither/matrix-%dx%d.xml", x, y);
+      stp_xml_parse_file_named(buf);
+      cachedval = stp_xml_dither_cache_get(x, y);
+      if (cachedval == NULL || cachedval->filename == NULL)
+	return NULL;
+    }
+  return cachedval;
+}
+
+static const stp_array_t *
+stp_xml_dither_cache_get_array(stp_xml_dither_cache_t *cachedval)
+{
+  if (!cachedval->dither_array)
+    cachedval->dither_array =
+      stpi_dither_array_create_from_file(cachedval->filename,
+					 cachedval->x, cachedval->y);
+  return cachedval->dither_array;
+}
+
 static stp_array_t *
 stp_xml_get_dither_array(int x, int y)
 {
-  stp_xml_dither_cache_t *cachedval;
-  stp_array_t *ret;
+  stp_xml_dither_cache_t *cachedval = stp_xml_dither_cache_find(x, y);
+  const stp_array_t *array;
 
-  cachedval = stp_xml_dither_cache_get(x, y);
+  if (!cachedval || !(array = stp_xml_dither_cache_get_array(cachedval)))
+    return NULL;
+  return stp_array_create_copy(array);
+}
 
-  if (cachedval && cachedval->dither_array)
-    return stp_array_create_copy(cachedval->dither_array);
+/*
+ * The final integer matrices are cached as
+ * { base, x_size, y_size, matrix[x_size * y_size] }
+ * alongside the XML file they come from (see xml-cache.c).  Normally
+ * they are simply mapped, and shared by every process using them,
+ * without reading the XML at all.
+ */
+#define MATRIX_HEADER 3
 
-  if (!cachedval)
+typedef struct
+{
+  int x;
+  int y;
+  int transpose;
+} dither_matrix_fill_t;
+
+static void *
+dither_matrix_fill(const char *file, void *closure, size_t *size)
+{
+  const dither_matrix_fill_t *f = (const dither_matrix_fill_t *) closure;
+  stp_xml_dither_cache_t *cachedval = stp_xml_dither_cache_find(f->x, f->y);
+  const stp_array_t *array;
+  stp_dither_matrix_impl_t mat;
+  unsigned *answer;
+
+  if (!cachedval || !(array = stp_xml_dither_cache_get_array(cachedval)))
+    return NULL;
+  memset(&mat, 0, sizeof(mat));
+  stp_dither_matrix_init_from_dither_array(&mat, array, f->transpose);
+  *size = sizeof(unsigned) * (MATRIX_HEADER + mat.total_size);
+  answer = stp_malloc(*size);
+  answer[0] = mat.base;
+  answer[1] = mat.x_size;
+  answer[2] = mat.y_size;
+  memcpy(answer + MATRIX_HEADER, mat.matrix, sizeof(unsigned) * mat.total_size);
+  stp_dither_matrix_destroy(&mat);
+  return answer;
+}
+
+static const unsigned *
+stp_xml_get_dither_matrix(int x, int y, int transpose)
+{
+  stp_xml_dither_cache_t *cachedval = stp_xml_dither_cache_get(x, y);
+  dither_matrix_fill_t f;
+  const unsigned *answer;
+  char *filename;
+  size_t size = 0;
+
+  if (cachedval && cachedval->matrix[transpose])
+    return cachedval->matrix[transpose];
+  if (cachedval)
+    filename = stp_strdup(cachedval->filename);
+  else
     {
       char buf[MAXPATHLEN+1];
       (void) snprintf(buf, MAXPATHLEN, "dither/matrix-%dx%d.xml", x, y);
-      stp_xml_parse_file_named(buf);
+      filename = stp_path_find_file(NULL, buf);
+      if (!filename)
+	return NULL;
+    }
+  f.x = x;
+  f.y = y;
+  f.transpose = transpose;
+  answer = stpi_xml_cache_load_data(filename,
+				    transpose ? "transposed" : "matrix",
+				    dither_matrix_fill, &f, &size);
+  if (answer &&
+      (size < sizeof(unsigned) * MATRIX_HEADER ||
+       size != (sizeof(unsigned) *
+		(MATRIX_HEADER + (size_t) answer[1] * answer[2])) ||
+       answer[1] == 0 || answer[2] == 0))
+    {
+      stp_erprintf("stp_xml_get_dither_matrix: bad matrix for %s\n",
+		   filename);
+      answer = NULL;
+    }
+  if (answer)
+    {
+      /* If it came from the cache, we haven't seen the file itself */
       cachedval = stp_xml_dither_cache_get(x, y);
-      if (cachedval == NULL || cachedval->filename == NULL)
+      if (!cachedval)
 	{
-	  return NULL;
+	  stp_xml_dither_cache_set(x, y, filename);
+	  cachedval = stp_xml_dither_cache_get(x, y);
 	}
+      cachedval->matrix[transpose] = answer;
     }
-
-  ret = stpi_dither_array_create_from_file(cachedval->filename, x, y);
-
-  cachedval->dither_array = ret;
-  return stp_array_create_copy(ret);
+  stp_free(filename);
+  return answer;
 }
 
 void
@@ -682,23 +785,30 @@ stpi_init_dither(void)
   stp_register_xml_parser("dither-matrix", stp_xml_process_dither_matrix);
 }
 
+static void
+standard_dither_aspect(int *x_aspect, int *y_aspect)
+{
+  int divisor = gcd(*x_aspect, *y_aspect);
+
+  *x_aspect /= divisor;
+  *y_aspect /= divisor;
+
+  if (*x_aspect == 3)		/* We don't have x3 matrices */
+    *x_aspect += 1;		/* so cheat */
+  if (*y_aspect == 3)
+    *y_aspect += 1;
+
+  divisor = gcd(*x_aspect, *y_aspect);
+  *x_aspect /= divisor;
+  *y_aspect /= divisor;
+}
+
 stp_array_t *
 stp_find_standard_dither_array(int x_aspect, int y_aspect)
 {
   stp_array_t *answer;
-  int divisor = gcd(x_aspect, y_aspect);
-
-  x_aspect /= divisor;
-  y_aspect /= divisor;
 
-  if (x_aspect == 3)		/* We don't have x3 matrices */
-    x_aspect += 1;		/* so cheat */
-  if (y_aspect == 3)
-    y_aspect += 1;
-
-  divisor = gcd(x_aspect, y_aspect);
-  x_aspect /= divisor;
-  y_aspect /= divisor;
+  standard_dither_aspect(&x_aspect, &y_aspect);
 
   answer = stp_xml_get_dither_array(x_aspect, y_aspect);
   if (answer)
@@ -708,3 +818,44 @@ stp_find_standard_dither_array(int x_aspect, int y_aspect)
     return answer;
   return NULL;
 }
+
+/*
+ * Use the standard matrix for the aspect ratio, as
+ * stp_dither_set_matrix_from_dither_array(v,
+ *   stp_find_standard_dither_array(x_aspect, y_aspect), transpose)
+ * would, but sharing the cached matrix rather than building a copy.
+ */
+int
+stpi_dither_set_standard_matrix(stp_vars_t *v, int x_aspect, int y_aspect,
+				int transpose)
+{
+  stpi_dither_t *d = (stpi_dither_t *) stp_get_component_data(v, "Dither");
+  stp_dither_matrix_impl_t *mat = &(d->dither_matrix);
+  const unsigned *matrix;
+
+  standard_dither_aspect(&x_aspect, &y_aspect);
+  matrix = stp_xml_get_dither_matrix(x_aspect, y_aspect, transpose);
+  if (!matrix)
+    matrix = stp_xml_get_dither_matrix(y_aspect, x_aspect, transpose);
+  if (!matrix)
+    return 0;
+
+  preinit_matrix(v);
+  mat->base = matrix[0];
+  mat->exp = 1;
+  mat->x_size = matrix[1];
+  mat->y_size = matrix[2];
+  mat->total_size = mat->x_size * mat->y_size;
+  /* Never written to, since we don't own it */
+  mat->matrix = (unsigned *) (matrix + MATRIX_HEADER);
+  mat->last_x = mat->last_x_mod = 0;
+  mat->last_y = mat->last_y_mod = 0;
+  mat->index = 0;
+  mat->i_own = 0;
+  if (is_po2(mat->x_size))
+    mat->fast_mask = mat->x_size - 1;
+  else
+    mat->fast_mask = 0;
+  postinit_matrix(v, 0, 0);
+  return 1;
+}
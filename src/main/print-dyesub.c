@@ -40,6 +40,11 @@
 #include <stdio.h>
 #include <limits.h>
 #include <time.h>  /* For strftime() and localtime_r() */
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #ifdef __GNUC__
 #define inline __inline__
 #endif
@@ -345,12 +350,18 @@ typedef struct {
   int plane_interlacing;
   int row_interlacing;
   unsigned char empty_byte[MAX_INK_CHANNELS];  /* one for each color plane */
-  unsigned short **image_data;
+  unsigned short **image_data;	/* NULL if streaming */
+  unsigned short *image_slab;	/* Storage for image_data */
+  int *colmap;			/* Offset in input row of each output pixel */
+  int contiguous;		/* colmap is the identity */
+  int ink_identity;		/* ink_order is the identity */
+  stp_image_t *image;
+  int next_row;		/* Next row to convert if streaming */
+  int read_error;
   int outh_px, outw_px, outt_px, outb_px, outl_px, outr_px;
   int imgh_px, imgw_px;
   int prnh_px, prnw_px, prnt_px, prnb_px, prnl_px, prnr_px;
   int print_mode;	/* portrait or landscape */
-  int image_rows;
   int plane_lefttoright;
 } dyesub_print_vars_t;
 
@@ -13367,17 +13378,24 @@ dyesub_interpolate(int point, int olddim, int newdim)
 static void
 dyesub_free_image(dyesub_print_vars_t *pv, stp_image_t *image)
 {
-  unsigned short** image_data = pv->image_data;
-  int image_px_height = pv->image_rows;
-  int i;
-
-  for (i = 0; i< image_px_height; i++)
-    if (image_data[i])
-      stp_free(image_data[i]);
-  if (image_data)
-    stp_free(image_data);
+  STP_SAFE_FREE(pv->image_data);
+  STP_SAFE_FREE(pv->image_slab);
+  STP_SAFE_FREE(pv->colmap);
 }
 
+#define DYESUB_ROTATE_BLOCK (32)
+
+/*
+ * Convert the whole image, for landscape mode and for printers that
+ * want one color plane at a time, which need to go back over it.
+ *
+ * Only the rows that will be printed are kept, and they're stored
+ * already scaled to the output width, so each row can be rendered
+ * straight through.  In landscape mode the image is rotated at the same
+ * time; input rows are collected a block at a time so that the reads
+ * across them stay in cache.  This is called with the dimensions in pv
+ * already swapped for landscape mode, and the column map set up.
+ */
 static unsigned short **
 dyesub_read_image(stp_vars_t *v,
 		dyesub_print_vars_t *pv,
@@ -13385,117 +13403,244 @@ dyesub_read_image(stp_vars_t *v,
 {
   int image_px_width  = stp_image_width(image);
   int image_px_height = stp_image_height(image);
-  int row_size = image_px_width * pv->ink_channels * sizeof(short);
+  int channels = pv->out_channels;
+  int rotate = pv->print_mode == DYESUB_LANDSCAPE;
+  size_t row_size = image_px_width * channels;
+  size_t out_row_size = pv->outw_px * channels;
+  int rows = pv->imgh_px;	/* Rows to print from, after rotation */
+  int needed_rows = 0;
+  int last_row = -1;
+  int slab_row = 0;
   unsigned short **image_data;
+  unsigned short *block = NULL;
+  int *src_rows = NULL;
   unsigned int zero_mask;
-  int i;
+  int i, j, w, c;
 
-  image_data = stp_zalloc(image_px_height * sizeof(unsigned short *));
-  pv->image_rows = 0;
+  image_data = stp_zalloc(rows * sizeof(unsigned short *));
+  pv->image_data = image_data;
   if (!image_data)
-    return NULL;	/* ? out of memory ? */
+    return NULL;
+  /* Work out which rows will be printed; they only ever move forward */
+  for (i = 0; i < pv->outh_px; i++)
+    {
+      j = dyesub_interpolate(i, pv->outh_px, pv->imgh_px);
+      if (j != last_row)
+	needed_rows++;
+      last_row = j;
+    }
+  pv->image_slab = stp_malloc(needed_rows * out_row_size * sizeof(short));
+  if (rotate)
+    {
+      block = stp_malloc(DYESUB_ROTATE_BLOCK * row_size * sizeof(short));
+      /* The input row each output column comes from */
+      src_rows = stp_malloc(pv->outw_px * sizeof(int));
+    }
+  if (!pv->image_slab || (rotate && (!block || !src_rows)))
+    {
+      stp_dprintf(STP_DBG_DYESUB, v,
+		  "dyesub_read_image: unable to allocate image buffer\n");
+      STP_SAFE_FREE(block);
+      STP_SAFE_FREE(src_rows);
+      dyesub_free_image(pv, image);
+      return NULL;	/* ? out of memory ? */
+    }
+  for (i = 0, last_row = -1; i < pv->outh_px; i++)
+    {
+      j = dyesub_interpolate(i, pv->outh_px, pv->imgh_px);
+      if (j != last_row)
+	image_data[j] = pv->image_slab + slab_row++ * out_row_size;
+      last_row = j;
+    }
+  if (rotate)
+    for (w = 0; w < pv->outw_px; w++)
+      src_rows[w] = image_px_height - 1 - pv->colmap[w] / channels;
 
   for (i = 0; i < image_px_height; i++)
     {
+      const unsigned short *in;
       if (stp_color_get_row(v, image, i, &zero_mask))
         {
 	  stp_dprintf(STP_DBG_DYESUB, v,
 	  	"dyesub_read_image: "
 		"stp_color_get_row(..., %d, ...) == 0\n", i);
+	  STP_SAFE_FREE(block);
+	  STP_SAFE_FREE(src_rows);
 	  dyesub_free_image(pv, image);
 	  return NULL;
 	}
-      image_data[i] = stp_malloc(row_size);
-      pv->image_rows = i+1;
-      if (!image_data[i])
-        {
+      in = stp_channel_get_output(v);
+      if (!rotate)
+	{
+	  unsigned short *out = image_data[i];
+	  if (out)
+	    for (w = 0; w < pv->outw_px; w++, out += channels)
+	      for (c = 0; c < channels; c++)
+		out[c] = in[pv->colmap[w] + c];
+	  continue;
+	}
+      memcpy(block + (i % DYESUB_ROTATE_BLOCK) * row_size, in,
+	     row_size * sizeof(short));
+      if (i % DYESUB_ROTATE_BLOCK == DYESUB_ROTATE_BLOCK - 1 ||
+	  i == image_px_height - 1)
+	{
+	  /*
+	   * Input pixel (x, y) goes to row x; the output columns taken
+	   * from this block of input rows are a contiguous run.
+	   */
+	  int first = i - (i % DYESUB_ROTATE_BLOCK);
+	  int wmin = pv->outw_px, wmax = 0;
+	  for (w = 0; w < pv->outw_px; w++)
+	    if (src_rows[w] >= first && src_rows[w] <= i)
+	      {
+		wmin = MIN(wmin, w);
+		wmax = MAX(wmax, w + 1);
+	      }
+	  for (j = 0; j < rows; j++)
+	    {
+	      unsigned short *out = image_data[j];
+	      if (!out)
+		continue;
+	      in = block + j * channels;
+	      for (w = wmin, out += wmin * channels; w < wmax;
+		   w++, out += channels)
+		for (c = 0; c < channels; c++)
+		  out[c] = in[(src_rows[w] - first) * row_size + c];
+	    }
+	}
+    }
+  STP_SAFE_FREE(block);
+  STP_SAFE_FREE(src_rows);
+
+  /* The image is now stored at the output width */
+  for (w = 0; w < pv->outw_px; w++)
+    pv->colmap[w] = w * channels;
+  pv->contiguous = 1;
+  return image_data;
+}
+
+/*
+ * Get one row of the image.  When streaming, rows are converted as
+ * they're needed, which works because in portrait mode each output row
+ * comes from a single input row, and those only ever move forward.
+ * The row returned is valid until the next call.
+ */
+static const unsigned short *
+dyesub_image_row(stp_vars_t *v, dyesub_print_vars_t *pv, int row)
+{
+  unsigned int zero_mask;
+  if (pv->image_data)
+    return pv->image_data[row];
+  if (pv->read_error)
+    return NULL;
+  while (pv->next_row <= row)
+    {
+      if (stp_color_get_row(v, pv->image, pv->next_row, &zero_mask))
+	{
 	  stp_dprintf(STP_DBG_DYESUB, v,
-	  	"dyesub_read_image: "
-		"(image_data[%d] = stp_malloc()) == NULL\n", i);
-	  dyesub_free_image(pv, image);
+		      "dyesub_image_row: "
+		      "stp_color_get_row(..., %d, ...) == 0\n", pv->next_row);
+	  pv->read_error = 1;
 	  return NULL;
 	}
-      memcpy(image_data[i], stp_channel_get_output(v), row_size);
+      pv->next_row++;
     }
-  return image_data;
+  return stp_channel_get_output(v);
 }
 
-static void
-dyesub_render_pixel_u8(unsigned short *src, char *dest,
-		       dyesub_print_vars_t *pv,
-		       int plane)
+/*
+ * Work out where in its input row each output pixel comes from, once
+ * per job rather than once per pixel.
+ */
+static int
+dyesub_init_colmap(dyesub_print_vars_t *pv)
 {
-  /* Scale down to output bit depth */
-  *dest = src[plane] / 257;
+  int w, i;
+  pv->colmap = stp_malloc(pv->outw_px * sizeof(int));
+  if (!pv->colmap)
+    return 0;
+  pv->contiguous = (pv->outw_px == pv->imgw_px && !pv->plane_lefttoright);
+  for (w = 0; w < pv->outw_px; w++)
+    {
+      int col = dyesub_interpolate(w, pv->outw_px, pv->imgw_px);
+      if (pv->plane_lefttoright)
+	col = pv->imgw_px - col - 1;
+      pv->colmap[w] = col * pv->out_channels;
+    }
+  pv->ink_identity = 1;
+  for (i = 0; i < pv->ink_channels; i++)
+    if (pv->ink_order[i] != i + 1)
+      pv->ink_identity = 0;
+  return 1;
 }
 
+/*
+ * Scale down to output bit depth.  (x - (x >> 8)) >> 8 is exactly
+ * x / 257 for all 16-bit x.
+ */
 static void
-dyesub_render_pixel_packed_u8(unsigned short *src, char *dest,
-			      dyesub_print_vars_t *pv)
+dyesub_narrow_u8(const unsigned short *src, unsigned char *dest, int count)
 {
-  int i;
-
-  /* copy out_channel (image) to equiv ink_channel (printer) */
-  for (i = 0; i < pv->ink_channels; i++)
+  int i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= count; i += 16)
+    {
+      __m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+      __m128i b = _mm_loadu_si128((const __m128i *) (src + i + 8));
+      a = _mm_srli_epi16(_mm_sub_epi16(a, _mm_srli_epi16(a, 8)), 8);
+      b = _mm_srli_epi16(_mm_sub_epi16(b, _mm_srli_epi16(b, 8)), 8);
+      _mm_storeu_si128((__m128i *) (dest + i), _mm_packus_epi16(a, b));
+    }
+#elif defined(__ARM_NEON)
+  for (; i + 8 <= count; i += 8)
     {
-      dyesub_render_pixel_u8(src, dest + i, pv, pv->ink_order[i]-1);
+      uint16x8_t a = vld1q_u16(src + i);
+      vst1_u8(dest + i, vshrn_n_u16(vsubq_u16(a, vshrq_n_u16(a, 8)), 8));
     }
+#endif
+  for (; i < count; i++)
+    dest[i] = src[i] / 257;
 }
 
 static void
-dyesub_render_row_packed_u8(stp_vars_t *v,
-			    dyesub_print_vars_t *pv,
-			    const dyesub_cap_t *caps,
-			    int in_row,
-			    char *dest,
-			    int bytes_per_pixel)
+dyesub_render_row_packed_u8(dyesub_print_vars_t *pv,
+			    const unsigned short *in_data,
+			    unsigned char *dest)
 {
-  int w;
-  unsigned short *src;
+  int w, i;
+  int channels = pv->ink_channels;
 
+  if (pv->contiguous && pv->ink_identity)
+    {
+      dyesub_narrow_u8(in_data, dest, pv->outw_px * channels);
+      return;
+    }
+  /* copy out_channel (image) to equiv ink_channel (printer) */
   for (w = 0; w < pv->outw_px; w++)
     {
-      int row = in_row;
-      int col = dyesub_interpolate(w, pv->outw_px, pv->imgw_px);
-      if (pv->plane_lefttoright)
-	col = pv->imgw_px - col - 1;
-      if (pv->print_mode == DYESUB_LANDSCAPE)
-        { /* "rotate" image */
-          dyesub_swap_ints(&col, &row);
-          row = (pv->imgw_px - 1) - row;
-        }
-      src = &(pv->image_data[row][col * pv->out_channels]);
-
-      dyesub_render_pixel_packed_u8(src, dest + w*bytes_per_pixel, pv);
+      const unsigned short *src = in_data + pv->colmap[w];
+      for (i = 0; i < channels; i++)
+	dest[i] = src[pv->ink_order[i] - 1] / 257;
+      dest += channels;
     }
 }
 
 static void
-dyesub_render_row_interlaced_u8(stp_vars_t *v,
-				dyesub_print_vars_t *pv,
-				const dyesub_cap_t *caps,
-				int in_row,
-				char *dest,
+dyesub_render_row_interlaced_u8(dyesub_print_vars_t *pv,
+				const unsigned short *in_data,
+				unsigned char *dest,
 				int plane)
 {
   int w;
-  unsigned short *src;
 
-  for (w = 0; w < pv->outw_px; w++)
+  if (pv->contiguous && pv->out_channels == 1)
     {
-      int row = in_row;
-      int col = dyesub_interpolate(w, pv->outw_px, pv->imgw_px);
-      if (pv->plane_lefttoright)
-	col = pv->imgw_px - col - 1;
-      if (pv->print_mode == DYESUB_LANDSCAPE)
-        { /* "rotate" image */
-          dyesub_swap_ints(&col, &row);
-          row = (pv->imgw_px - 1) - row;
-        }
-      src = &(pv->image_data[row][col * pv->out_channels]);
-
-      dyesub_render_pixel_u8(src, dest + w, pv, plane);
+      dyesub_narrow_u8(in_data, dest, pv->outw_px);
+      return;
     }
+  in_data += plane;
+  for (w = 0; w < pv->outw_px; w++)
+    dest[w] = in_data[pv->colmap[w]] / 257;
 }
 
 static int
@@ -13556,18 +13701,20 @@ dyesub_print_plane(stp_vars_t *v,
         {
 	  int srcrow = dyesub_interpolate(h + pv->prnt_px - pv->outt_px,
 					  pv->outh_px, pv->imgh_px);
+	  const unsigned short *srcdata;
+	  unsigned char *dest = (unsigned char *) destrow + bpp * pv->outl_px;
 
 	  stp_dprintf(STP_DBG_DYESUB, v,
 		       "dyesub_print_plane: h = %d, row = %d\n", h, srcrow);
 
-	  if (pv->plane_interlacing || pv->row_interlacing)
-	    {
-	      dyesub_render_row_interlaced_u8(v, pv, caps, srcrow,
-						destrow + bpp * pv->outl_px, p);
-	    }
+	  srcdata = dyesub_image_row(v, pv, srcrow);
+	  if (!srcdata)
+	    /* Keep the printer in step even if we can't read the image */
+	    memset(dest, pv->empty_byte[plane], bpp * pv->outw_px);
+	  else if (pv->plane_interlacing || pv->row_interlacing)
+	    dyesub_render_row_interlaced_u8(pv, srcdata, dest, p);
 	  else
-            dyesub_render_row_packed_u8(v, pv, caps, srcrow,
-					destrow + bpp * pv->outl_px, bpp);
+            dyesub_render_row_packed_u8(pv, srcdata, dest);
 	}
       /* And send it out */
       stp_zfwrite(destrow, rowlen, 1, v);
@@ -13748,7 +13895,6 @@ dyesub_do_print(stp_vars_t *v, stp_image_t *image, int print_op)
     }
 
 
-  pv.image_data = dyesub_read_image(v, &pv, image);
   if (ink_type)
     {
       if (strcmp(ink_type, "RGB") == 0 ||
@@ -13777,12 +13923,8 @@ dyesub_do_print(stp_vars_t *v, stp_image_t *image, int print_op)
   pv.row_interlacing = dyesub_feature(caps, DYESUB_FEATURE_ROW_INTERLACE);
   pv.plane_lefttoright = dyesub_feature(caps, DYESUB_FEATURE_PLANE_LEFTTORIGHT);
   pv.print_mode = page_mode;
-  if (!pv.image_data)
-    {
-      stp_image_conclude(image);
-      stp_free(pd);
-      return 2;
-    }
+  pv.image = image;
+
 
   if (dyesub_feature(caps, DYESUB_FEATURE_FULL_HEIGHT))
     {
@@ -13836,6 +13978,20 @@ dyesub_do_print(stp_vars_t *v, stp_image_t *image, int print_op)
   if (pv.outr_px > pv.prnw_px)
     pv.outr_px = pv.prnw_px;
 
+  /*
+   * Portrait mode, one pass over the image: convert rows as they're
+   * printed.  Otherwise the whole image is needed up front.
+   */
+  if (!dyesub_init_colmap(&pv) ||
+      ((pv.print_mode == DYESUB_LANDSCAPE || pv.plane_interlacing) &&
+       !dyesub_read_image(v, &pv, image)))
+    {
+      dyesub_free_image(&pv, image);
+      stp_image_conclude(image);
+      stp_free(pd);
+      return 2;
+    }
+
   /* By this point, we're finally DONE mangling the pv structure,
      and can start calling into the bulk of the driver code. */
 
@@ -13874,9 +14030,9 @@ dyesub_do_print(stp_vars_t *v, stp_image_t *image, int print_op)
   if (print_op & OP_JOB_END)
     dyesub_exec(v, caps->job_end_func, "caps->job_end");
 
-  if (pv.image_data) {
-    dyesub_free_image(&pv, image);
-  }
+  dyesub_free_image(&pv, image);
+  if (pv.read_error)
+    status = 2;
 
   stp_image_conclude(image);
   stp_free(pd);
@@ -4366,8 +4366,37 @@ set_mask(unsigned char *cd_mask, int x_center, int scaled_x_where,
     }
 }
 
+static void
+fill_cd_mask(const escp2_privdata_t *pd, int y, unsigned char *cd_mask)
+{
+  stp_dimension_t outer_r_sq = pd->cd_outer_radius * pd->cd_outer_radius;
+  stp_dimension_t inner_r_sq = pd->cd_inner_radius * pd->cd_inner_radius;
+  int x_center = pd->cd_x_offset * pd->res->printed_hres / pd->micro_units;
+  stp_dimension_t y_distance_from_center =
+    pd->cd_outer_radius -
+    ((y + pd->cd_y_offset) * pd->micro_units / pd->res->printed_vres);
+  if (y_distance_from_center < 0)
+    y_distance_from_center = -y_distance_from_center;
+  memset(cd_mask, 0, (pd->image_printed_width + 7) / 8);
+  if (y_distance_from_center < pd->cd_outer_radius)
+    {
+      stp_dimension_t y_sq = y_distance_from_center * y_distance_from_center;
+      stp_dimension_t x_where = sqrt(outer_r_sq - y_sq);
+      int scaled_x_where = x_where * pd->res->printed_hres / pd->micro_units;
+      set_mask(cd_mask, x_center, scaled_x_where,
+	       pd->image_printed_width, 1, 0);
+      if (y_distance_from_center < pd->cd_inner_radius)
+	{
+	  x_where = sqrt(inner_r_sq - y_sq);
+	  scaled_x_where = x_where * pd->res->printed_hres / pd->micro_units;
+	  set_mask(cd_mask, x_center, scaled_x_where,
+		   pd->image_printed_width, 1, 1);
+	}
+    }
+}
+
 static int
-escp2_print_data(stp_vars_t *v, stp_image_t *image)
+escp2_print_data_serial(stp_vars_t *v, stp_image_t *image)
 {
   escp2_privdata_t *pd = get_privdata(v);
   int errdiv  = stp_image_height(image) / pd->image_printed_height;
@@ -4376,16 +4405,9 @@ escp2_print_data(stp_vars_t *v, stp_image_t *image)
   int errlast = -1;
   int errline  = 0;
   int y;
-  stp_dimension_t outer_r_sq = 0;
-  stp_dimension_t inner_r_sq = 0;
-  int x_center = pd->cd_x_offset * pd->res->printed_hres / pd->micro_units;
   unsigned char *cd_mask = NULL;
   if (pd->cd_outer_radius > 0)
-    {
-      cd_mask = stp_malloc(1 + (pd->image_printed_width + 7) / 8);
-      outer_r_sq = pd->cd_outer_radius * pd->cd_outer_radius;
-      inner_r_sq = pd->cd_inner_radius * pd->cd_inner_radius;
-    }
+    cd_mask = stp_malloc(1 + (pd->image_printed_width + 7) / 8);
 
   for (y = 0; y < pd->image_printed_height; y ++)
     {
@@ -4401,29 +4423,7 @@ escp2_print_data(stp_vars_t *v, stp_image_t *image)
 	}
 
       if (cd_mask)
-	{
-	  stp_dimension_t y_distance_from_center =
-	    pd->cd_outer_radius -
-	    ((y + pd->cd_y_offset) * pd->micro_units / pd->res->printed_vres);
-	  if (y_distance_from_center < 0)
-	    y_distance_from_center = -y_distance_from_center;
-	  memset(cd_mask, 0, (pd->image_printed_width + 7) / 8);
-	  if (y_distance_from_center < pd->cd_outer_radius)
-	    {
-	      stp_dimension_t y_sq = y_distance_from_center * y_distance_from_center;
-	      stp_dimension_t x_where = sqrt(outer_r_sq - y_sq);
-	      int scaled_x_where = x_where * pd->res->printed_hres / pd->micro_units;
-	      set_mask(cd_mask, x_center, scaled_x_where,
-		       pd->image_printed_width, 1, 0);
-	      if (y_distance_from_center < pd->cd_inner_radius)
-		{
-		  x_where = sqrt(inner_r_sq - y_sq);
-		  scaled_x_where = x_where * pd->res->printed_hres / pd->micro_units;
-		  set_mask(cd_mask, x_center, scaled_x_where,
-			   pd->image_printed_width, 1, 1);
-		}
-	    }
-	}
+	fill_cd_mask(pd, y, cd_mask);
 
       stp_dither(v, y, duplicate_line, zero_mask, cd_mask);
 
@@ -4441,6 +4441,230 @@ escp2_print_data(stp_vars_t *v, stp_image_t *image)
   return 1;
 }
 
+/*
+ * Pipelined rendering, used when more than one thread is allowed
+ * (STP_THREADS).  Color conversion and dithering each run in their own
+ * thread, and weaving and output remain with the caller:
+ *
+ *   color thread:  stp_color_get_row() -> color queue
+ *   dither thread: color queue -> stpi_dither_band() -> dither queue
+ *   caller:        dither queue -> stp_write_weave()
+ *
+ * Each stage only modifies its own component data, and rows pass
+ * through the queues strictly in order, so the output is identical to
+ * that of the serial loop.  The dither thread takes whatever rows are
+ * waiting, up to a band; draft dithers spread a band over more threads.
+ */
+
+#define ESCP2_PIPELINE_DEPTH 16
+#define ESCP2_DITHER_BAND 8	/* Most rows dithered at once */
+
+typedef struct
+{
+  int y;
+  int duplicate_line;
+  unsigned zero_mask;
+  unsigned short *input;	/* Copy of the channel output */
+  unsigned char *cd_mask;
+} escp2_color_row_t;
+
+typedef struct
+{
+  stp_vars_t *v;
+  stp_image_t *image;
+  stpi_row_queue_t *color_queue;
+  stpi_row_queue_t *dither_queue;
+  escp2_color_row_t color_rows[ESCP2_PIPELINE_DEPTH];
+  unsigned char **dither_rows[ESCP2_PIPELINE_DEPTH];
+  size_t input_size;
+  int status;
+} escp2_pipeline_t;
+
+static void *
+escp2_color_thread(void *arg)
+{
+  escp2_pipeline_t *pl = (escp2_pipeline_t *) arg;
+  stp_vars_t *v = pl->v;
+  stp_image_t *image = pl->image;
+  escp2_privdata_t *pd = get_privdata(v);
+  int errdiv  = stp_image_height(image) / pd->image_printed_height;
+  int errmod  = stp_image_height(image) % pd->image_printed_height;
+  int errval  = 0;
+  int errlast = -1;
+  int errline  = 0;
+  int y;
+
+  for (y = 0; y < pd->image_printed_height; y ++)
+    {
+      escp2_color_row_t *row;
+      int slot = stpi_row_queue_reserve(pl->color_queue);
+      if (slot < 0)
+	break;
+      row = &(pl->color_rows[slot]);
+      row->y = y;
+      row->duplicate_line = 1;
+      row->zero_mask = 0;
+
+      if (errline != errlast)
+	{
+	  errlast = errline;
+	  row->duplicate_line = 0;
+	  if (stp_color_get_row(v, image, errline, &(row->zero_mask)))
+	    {
+	      pl->status = 2;
+	      break;
+	    }
+	}
+      memcpy(row->input, stp_channel_get_output(v), pl->input_size);
+
+      if (row->cd_mask)
+	fill_cd_mask(pd, y, row->cd_mask);
+
+      stpi_row_queue_commit(pl->color_queue);
+      errval += errmod;
+      errline += errdiv;
+      if (errval >= pd->image_printed_height)
+	{
+	  errval -= pd->image_printed_height;
+	  errline ++;
+	}
+    }
+  stpi_row_queue_close(pl->color_queue);
+  return NULL;
+}
+
+static void *
+escp2_dither_thread(void *arg)
+{
+  escp2_pipeline_t *pl = (escp2_pipeline_t *) arg;
+  stp_vars_t *v = pl->v;
+  stpi_dither_row_t band[ESCP2_DITHER_BAND];
+  int in_slot, out_slot, rows, i;
+
+  while ((rows = stpi_row_queue_take_rows(pl->color_queue, ESCP2_DITHER_BAND,
+					  &in_slot)) > 0)
+    {
+      rows = stpi_row_queue_reserve_rows(pl->dither_queue, rows, &out_slot);
+      if (rows == 0)
+	{
+	  stpi_row_queue_cancel(pl->color_queue);
+	  break;
+	}
+      for (i = 0; i < rows; i++)
+	{
+	  const escp2_color_row_t *row =
+	    &(pl->color_rows[(in_slot + i) % ESCP2_PIPELINE_DEPTH]);
+	  band[i].y = row->y;
+	  band[i].input = row->input;
+	  band[i].duplicate_line = row->duplicate_line;
+	  band[i].zero_mask = row->zero_mask;
+	  band[i].mask = row->cd_mask;
+	  band[i].buffers =
+	    pl->dither_rows[(out_slot + i) % ESCP2_PIPELINE_DEPTH];
+	}
+      stpi_dither_band(v, rows, band);
+      stpi_row_queue_release_rows(pl->color_queue, rows);
+      stpi_row_queue_commit_rows(pl->dither_queue, rows);
+    }
+  stpi_row_queue_close(pl->dither_queue);
+  return NULL;
+}
+
+static void
+free_pipeline(escp2_pipeline_t *pl, int channels)
+{
+  int i, j;
+  for (i = 0; i < ESCP2_PIPELINE_DEPTH; i++)
+    {
+      STP_SAFE_FREE(pl->color_rows[i].input);
+      STP_SAFE_FREE(pl->color_rows[i].cd_mask);
+      if (pl->dither_rows[i])
+	{
+	  for (j = 0; j < channels; j++)
+	    STP_SAFE_FREE(pl->dither_rows[i][j]);
+	  stp_free(pl->dither_rows[i]);
+	}
+    }
+  stpi_row_queue_destroy(pl->color_queue);
+  stpi_row_queue_destroy(pl->dither_queue);
+}
+
+/*
+ * Returns -1 if the pipeline could not be started, in which case
+ * nothing has been printed and the caller should fall back to the
+ * serial loop.
+ */
+static int
+escp2_print_data_pipelined(stp_vars_t *v, stp_image_t *image)
+{
+  escp2_privdata_t *pd = get_privdata(v);
+  int line_width = (pd->image_printed_width + 7) / 8 * pd->bitwidth;
+  escp2_pipeline_t pl;
+  stpi_thread_t *color_thread;
+  stpi_thread_t *dither_thread;
+  int i, j, slot;
+
+  memset(&pl, 0, sizeof(pl));
+  pl.v = v;
+  pl.image = image;
+  pl.status = 1;
+  pl.input_size = (sizeof(unsigned short) * stp_image_width(image) *
+		   pd->channels_in_use);
+  pl.color_queue = stpi_row_queue_create(ESCP2_PIPELINE_DEPTH);
+  pl.dither_queue = stpi_row_queue_create(ESCP2_PIPELINE_DEPTH);
+  for (i = 0; i < ESCP2_PIPELINE_DEPTH; i++)
+    {
+      pl.color_rows[i].input = stp_malloc(pl.input_size);
+      if (pd->cd_outer_radius > 0)
+	pl.color_rows[i].cd_mask =
+	  stp_malloc(1 + (pd->image_printed_width + 7) / 8);
+      pl.dither_rows[i] =
+	stp_zalloc(sizeof(unsigned char *) * pd->channels_in_use);
+      for (j = 0; j < pd->channels_in_use; j++)
+	pl.dither_rows[i][j] = stp_zalloc(line_width);
+    }
+
+  dither_thread = stpi_thread_create(escp2_dither_thread, &pl);
+  if (!dither_thread)
+    {
+      free_pipeline(&pl, pd->channels_in_use);
+      return -1;
+    }
+  color_thread = stpi_thread_create(escp2_color_thread, &pl);
+  if (!color_thread)
+    {
+      stpi_row_queue_close(pl.color_queue);
+      stpi_thread_join(dither_thread);
+      stpi_dither_set_channel_buffers(v, pd->cols);
+      free_pipeline(&pl, pd->channels_in_use);
+      return -1;
+    }
+
+  while ((slot = stpi_row_queue_take(pl.dither_queue)) >= 0)
+    {
+      stp_write_weave(v, pl.dither_rows[slot]);
+      stpi_row_queue_release(pl.dither_queue);
+    }
+
+  stpi_thread_join(color_thread);
+  stpi_thread_join(dither_thread);
+  stpi_dither_set_channel_buffers(v, pd->cols);
+  free_pipeline(&pl, pd->channels_in_use);
+  return pl.status;
+}
+
+static int
+escp2_print_data(stp_vars_t *v, stp_image_t *image)
+{
+  if (stpi_thread_count() > 1)
+    {
+      int status = escp2_print_data_pipelined(v, image);
+      if (status >= 0)
+	return status;
+    }
+  return escp2_print_data_serial(v, image);
+}
+
 static int
 escp2_print_page(stp_vars_t *v, stp_image_t *image)
 {
@@ -42,6 +42,19 @@ struct stp_list_item
   void *data;			/*!< Data		*/
   struct stp_list_item *prev;	/*!< Previous node	*/
   struct stp_list_item *next;	/*!< Next node		*/
+  struct stp_list *list;	/*!< Owning list	*/
+  struct stp_list_item *hash_next[2]; /*!< Next node in hash bucket */
+  unsigned hash[2];		/*!< Hash of name and long name */
+};
+
+/**
+ * A hash index of list nodes by name (or long name).  Nodes with the
+ * same hash are chained through stp_list_item::hash_next.
+ */
+struct list_index
+{
+  struct stp_list_item **buckets;	/*!< Bucket heads, or NULL if unused	*/
+  unsigned size;			/*!< Number of buckets (a power of 2)	*/
 };
 
 /** The internal representation of an stp_list_t list. */
@@ -50,55 +63,149 @@ struct stp_list
   struct stp_list_item *start;			/*!< Start node				*/
   struct stp_list_item *end;			/*!< End node				*/
   struct stp_list_item *index_cache_node;	/*!< Cached node (for index)		*/
-  char *name_cache;				/*!< Cached name			*/
-  struct stp_list_item *name_cache_node;	/*!< Cached node (for name)		*/
-  char *long_name_cache;			/*!< Cached long name			*/
-  struct stp_list_item *long_name_cache_node;	/*!< Cached node (for long name)	*/
   stp_node_freefunc freefunc;			/*!< Callback to free node data		*/
   stp_node_copyfunc copyfunc;			/*!< Callback to copy node		*/
   stp_node_namefunc namefunc;			/*!< Callback to get node name		*/
   stp_node_namefunc long_namefunc;		/*!< Callback to get node long name	*/
   stp_node_sortfunc sortfunc;			/*!< Callback to compare (sort) nodes	*/
+  struct list_index index[2];			/*!< Name and long name indices		*/
   int index_cache;				/*!< Cached node index			*/
   int length;					/*!< Number of nodes			*/
 };
 
-/**
- * Cache a list node by its short name.
- * @param list the list to use.
- * @param name the short name.
- * @param cache the node to cache.
+/*
+ * Lists with a name (or long name) function and more than a handful of
+ * nodes are indexed by hash, so that lookups by name don't need to
+ * walk the list.  The index is maintained when nodes are added or
+ * removed, so a node's name must not change while it is in a list
+ * other than through stp_list_item_set_data().
+ *
+ * Lookups by name modify nothing (shorter lists are simply walked), so
+ * several threads may look up names in a list that isn't changing.
+ * Lookups by index update the index cache, so they may not.
  */
+
+#define LIST_INDEX_MIN_LENGTH 8
+#define LIST_INDEX_NAME 0
+#define LIST_INDEX_LONG_NAME 1
+
+static inline stp_node_namefunc
+index_namefunc(const stp_list_t *list, int which)
+{
+  return which == LIST_INDEX_NAME ? list->namefunc : list->long_namefunc;
+}
+
+/* FNV-1a */
+static unsigned
+hash_name(const char *name)
+{
+  unsigned hash = 2166136261u;
+  while (*name)
+    {
+      hash ^= (unsigned char) *name++;
+      hash *= 16777619u;
+    }
+  return hash;
+}
+
 static void
-set_name_cache(stp_list_t *list,
-	       const char *name,
-	       stp_list_item_t *cache)
+index_add(stp_list_t *list, int which, stp_list_item_t *item)
 {
-  if (list->name_cache)
-    stp_free(list->name_cache);
-  list->name_cache = NULL;
-  if (name)
-    list->name_cache = stp_strdup(name);
-  list->name_cache_node = cache;
+  struct list_index *idx = &(list->index[which]);
+  const char *name = index_namefunc(list, which)(item->data);
+  unsigned bucket;
+  item->hash_next[which] = NULL;
+  item->hash[which] = 0;
+  if (!name)			/* Unnamed nodes can't be found by name */
+    return;
+  item->hash[which] = hash_name(name);
+  bucket = item->hash[which] & (idx->size - 1);
+  item->hash_next[which] = idx->buckets[bucket];
+  idx->buckets[bucket] = item;
+}
+
+static void
+index_remove(stp_list_t *list, int which, stp_list_item_t *item)
+{
+  struct list_index *idx = &(list->index[which]);
+  stp_list_item_t **node = &(idx->buckets[item->hash[which] & (idx->size - 1)]);
+  while (*node)
+    {
+      if (*node == item)
+	{
+	  *node = item->hash_next[which];
+	  break;
+	}
+      node = &((*node)->hash_next[which]);
+    }
+  item->hash_next[which] = NULL;
 }
 
 /**
- * Cache a list node by its long name.
+ * (Re)build a hash index, or discard it if the list doesn't need one.
  * @param list the list to use.
- * @param long_name the long name.
- * @param cache the node to cache.
+ * @param which the index to build.
+ * @param size the minimum number of buckets to use.
  */
 static void
-set_long_name_cache(stp_list_t *list,
-		    const char *long_name,
-		    stp_list_item_t *cache)
+index_build(stp_list_t *list, int which, unsigned size)
+{
+  struct list_index *idx = &(list->index[which]);
+  stp_list_item_t *item;
+  STP_SAFE_FREE(idx->buckets);
+  idx->size = 0;
+  if (!index_namefunc(list, which) ||
+      (list->length < LIST_INDEX_MIN_LENGTH && size == 0))
+    return;
+  idx->size = 16;
+  while (idx->size < size || idx->size < (unsigned) list->length)
+    idx->size *= 2;
+  idx->buckets = stp_zalloc(idx->size * sizeof(stp_list_item_t *));
+  for (item = list->start; item; item = item->next)
+    index_add(list, which, item);
+}
+
+static void
+index_insert(stp_list_t *list, int which, stp_list_item_t *item)
 {
-  if (list->long_name_cache)
-    stp_free(list->long_name_cache);
-  list->long_name_cache = NULL;
-  if (long_name)
-    list->long_name_cache = stp_strdup(long_name);
-  list->long_name_cache_node = cache;
+  struct list_index *idx = &(list->index[which]);
+  if (idx->buckets && (unsigned) list->length <= idx->size)
+    index_add(list, which, item);
+  else if (idx->buckets || list->length >= LIST_INDEX_MIN_LENGTH)
+    index_build(list, which, idx->size * 2);
+}
+
+/**
+ * Find an item in a list through a hash index.
+ * @param list the list to use.
+ * @param which the index to use.
+ * @param name the name to find.
+ * @param dup set if more than one item has this name.
+ * @returns a pointer to the list item, or NULL if there is none.
+ */
+static stp_list_item_t *
+index_find(const stp_list_t *list, int which, const char *name, int *dup)
+{
+  const struct list_index *idx = &(list->index[which]);
+  stp_node_namefunc namefunc = index_namefunc(list, which);
+  unsigned hash = hash_name(name);
+  stp_list_item_t *node = idx->buckets[hash & (idx->size - 1)];
+  stp_list_item_t *found = NULL;
+  *dup = 0;
+  while (node)
+    {
+      if (node->hash[which] == hash && strcmp(name, namefunc(node->data)) == 0)
+	{
+	  if (found)
+	    {
+	      *dup = 1;
+	      return NULL;
+	    }
+	  found = node;
+	}
+      node = node->hash_next[which];
+    }
+  return found;
 }
 
 /**
@@ -110,8 +217,6 @@ clear_cache(stp_list_t *list)
 {
   list->index_cache = 0;
   list->index_cache_node = NULL;
-  set_name_cache(list, NULL, NULL);
-  set_long_name_cache(list, NULL, NULL);
 }
 
 void
@@ -146,10 +251,10 @@ stp_list_create(void)
   list->long_namefunc = NULL;
   list->sortfunc = NULL;
   list->copyfunc = NULL;
-  list->name_cache = NULL;
-  list->name_cache_node = NULL;
-  list->long_name_cache = NULL;
-  list->long_name_cache_node = NULL;
+  list->index[LIST_INDEX_NAME].buckets = NULL;
+  list->index[LIST_INDEX_NAME].size = 0;
+  list->index[LIST_INDEX_LONG_NAME].buckets = NULL;
+  list->index[LIST_INDEX_LONG_NAME].size = 0;
 
   stp_deprintf(STP_DBG_LIST, "stp_list_head constructor\n");
   return list;
@@ -172,6 +277,10 @@ stp_list_copy(const stp_list_t *list)
   stp_list_set_namefunc(ret, stp_list_get_namefunc(list));
   stp_list_set_long_namefunc(ret, stp_list_get_long_namefunc(list));
   stp_list_set_sortfunc(ret, stp_list_get_sortfunc(list));
+  /* Size the indices up front rather than growing them as we go */
+  index_build(ret, LIST_INDEX_NAME, list->index[LIST_INDEX_NAME].size);
+  index_build(ret, LIST_INDEX_LONG_NAME,
+	      list->index[LIST_INDEX_LONG_NAME].size);
   while (item)
     {
       void *data = item->data;
@@ -193,6 +302,9 @@ stp_list_destroy(stp_list_t *list)
 
   check_list(list);
   clear_cache(list);
+  /* No point in maintaining the indices while we tear the list down */
+  STP_SAFE_FREE(list->index[LIST_INDEX_NAME].buckets);
+  STP_SAFE_FREE(list->index[LIST_INDEX_LONG_NAME].buckets);
   cur = list->start;
   while(cur)
     {
@@ -367,52 +479,21 @@ stp_list_get_item_by_name_internal(const stp_list_t *list, const char *name)
 stp_list_item_t *
 stp_list_get_item_by_name(const stp_list_t *list, const char *name)
 {
-  stp_list_item_t *node = NULL;
-  stp_list_t *ulist = deconst_list(list);
   check_list(list);
 
   if (!list->namefunc || !name)
     return NULL;
 
-  if (list->name_cache && list->name_cache_node)
+  if (list->index[LIST_INDEX_NAME].buckets)
     {
-      const char *new_name;
-      node = list->name_cache_node;
-      /* Is this the item we've cached? */
-      if (strcmp(name, list->name_cache) == 0 &&
-	  strcmp(name, list->namefunc(node->data)) == 0)
+      int dup;
+      stp_list_item_t *node = index_find(list, LIST_INDEX_NAME, name, &dup);
+      if (!dup)
 	return node;
-
-      /* If not, check the next item in case we're searching the list */
-      node = node->next;
-      if (node)
-	{
-	  new_name = list->namefunc(node->data);
-	  if (strcmp(name, new_name) == 0)
-	    {
-	      set_name_cache(ulist, new_name, node);
-	      return node;
-	    }
-	}
-      /* If not, check the index cache */
-      node = list->index_cache_node;
-      if (node)
-	{
-	  new_name = list->namefunc(node->data);
-	  if (strcmp(name, new_name) == 0)
-	    {
-	      set_name_cache(ulist, new_name, node);
-	      return node;
-	    }
-	}
+      /* Several items share this name; we want the first in the list */
     }
 
-  node = stp_list_get_item_by_name_internal(list, name);
-
-  if (node)
-    set_name_cache(ulist, name, node);
-
-  return node;
+  return stp_list_get_item_by_name_internal(list, name);
 }
 
 
@@ -441,52 +522,20 @@ stp_list_get_item_by_long_name_internal(const stp_list_t *list,
 stp_list_item_t *
 stp_list_get_item_by_long_name(const stp_list_t *list, const char *long_name)
 {
-  stp_list_item_t *node = NULL;
-  stp_list_t *ulist = deconst_list(list);
   check_list(list);
 
   if (!list->long_namefunc || !long_name)
     return NULL;
 
-  if (list->long_name_cache && list->long_name_cache_node)
+  if (list->index[LIST_INDEX_LONG_NAME].buckets)
     {
-      const char *new_long_name;
-      node = list->long_name_cache_node;
-      /* Is this the item we've cached? */
-      if (strcmp(long_name, list->long_name_cache) == 0 &&
-	  strcmp(long_name, list->long_namefunc(node->data)) == 0)
+      int dup;
+      stp_list_item_t *node = index_find(list, LIST_INDEX_LONG_NAME, long_name, &dup);
+      if (!dup)
 	return node;
-
-      /* If not, check the next item in case we're searching the list */
-      node = node->next;
-      if (node)
-	{
-	  new_long_name = list->long_namefunc(node->data);
-	  if (strcmp(long_name, new_long_name) == 0)
-	    {
-	      set_long_name_cache(ulist, new_long_name, node);
-	      return node;
-	    }
-	}
-      /* If not, check the index cache */
-      node = list->index_cache_node;
-      if (node)
-	{
-	  new_long_name = list->long_namefunc(node->data);
-	  if (strcmp(long_name, new_long_name) == 0)
-	    {
-	      set_long_name_cache(ulist, new_long_name, node);
-	      return node;
-	    }
-	}
     }
 
-  node = stp_list_get_item_by_long_name_internal(list, long_name);
-
-  if (node)
-    set_long_name_cache(ulist, long_name, node);
-
-  return node;
+  return stp_list_get_item_by_long_name_internal(list, long_name);
 }
 
 
@@ -526,6 +575,7 @@ stp_list_set_namefunc(stp_list_t *list, stp_node_namefunc namefunc)
 {
   check_list(list);
   list->namefunc = namefunc;
+  index_build(list, LIST_INDEX_NAME, 0);
 }
 
 stp_node_namefunc
@@ -541,6 +591,7 @@ stp_list_set_long_namefunc(stp_list_t *list, stp_node_namefunc long_namefunc)
 {
   check_list(list);
   list->long_namefunc = long_namefunc;
+  index_build(list, LIST_INDEX_LONG_NAME, 0);
 }
 
 stp_node_namefunc
@@ -591,6 +642,7 @@ stp_list_item_create(stp_list_t *list,
 
   ln = stp_malloc(sizeof(stp_list_item_t));
   ln->prev = ln->next = NULL;
+  ln->list = list;
 
   if (data)
     ln->data = stpi_cast_safe(data);
@@ -649,6 +701,11 @@ stp_list_item_create(stp_list_t *list,
   /* increment reference count */
   list->length++;
 
+  if (list->namefunc)
+    index_insert(list, LIST_INDEX_NAME, ln);
+  if (list->long_namefunc)
+    index_insert(list, LIST_INDEX_LONG_NAME, ln);
+
   stp_deprintf(STP_DBG_LIST, "stp_list_node constructor\n");
   return 0;
 }
@@ -663,6 +720,11 @@ stp_list_item_destroy(stp_list_t *list, stp_list_item_t *item)
   /* decrement reference count */
   list->length--;
 
+  if (list->index[LIST_INDEX_NAME].buckets)
+    index_remove(list, LIST_INDEX_NAME, item);
+  if (list->index[LIST_INDEX_LONG_NAME].buckets)
+    index_remove(list, LIST_INDEX_LONG_NAME, item);
+
   if (list->freefunc)
     list->freefunc((void *) item->data);
   if (item->prev)
@@ -706,7 +768,16 @@ stp_list_item_set_data(stp_list_item_t *item, void *data)
 {
   if (data)
     {
+      stp_list_t *list = item->list;
+      int which;
+      /* The new data may have a different name */
+      for (which = LIST_INDEX_NAME; which <= LIST_INDEX_LONG_NAME; which++)
+	if (list->index[which].buckets)
+	  index_remove(list, which, item);
       item->data = data;
+      for (which = LIST_INDEX_NAME; which <= LIST_INDEX_LONG_NAME; which++)
+	if (list->index[which].buckets)
+	  index_add(list, which, item);
       return 0;
     }
   return 1; /* return error if data was NULL */
@@ -33,6 +33,7 @@
 #include "gutenprint-internal.h"
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 
 /* #define DEBUG */
 /* #define PCL_DEBUG_DISABLE_BLANKLINE_REMOVAL */
@@ -48,10 +49,34 @@
  */
 static void	pcl_mode0(stp_vars_t *, unsigned char *, int, int);
 static void	pcl_mode2(stp_vars_t *, unsigned char *, int, int);
+static void	pcl_mode_delta(stp_vars_t *, unsigned char *, int, int);
 
 #ifndef MAX
 #  define MAX(a, b) ((a) > (b) ? (a) : (b))
 #endif /* !MAX */
+#ifndef MIN
+#  define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif /* !MIN */
+
+#define PCL_MAX_PLANES	16	/* Most planes sent for one row */
+#define PCL_MODE_SWITCH	5	/* Length of "\033*b#M" */
+
+/*
+ * Delta row compression works against the previous row of each plane,
+ * so the planes of a row are encoded in every mode first and sent once
+ * the last one arrives, using whichever modes come out shortest.
+ */
+
+#define PCL_NMODES	4	/* Modes 0, 2, 3 and 9 */
+
+static const int pcl_modes[PCL_NMODES] = { 0, 2, 3, 9 };
+
+typedef struct pcl_plane
+{
+  unsigned char *seed;		/* Previous row of this plane */
+  unsigned char *data[PCL_NMODES];
+  int length[PCL_NMODES];	/* -1 if the mode can't be used */
+} pcl_plane_t;
 
 typedef struct
 {
@@ -60,6 +85,10 @@ typedef struct
   unsigned char *row_buf;	/* For color laser */
   unsigned char *comp_buf;
   void (*writefunc)(stp_vars_t *, unsigned char *, int, int);	/* PCL output function */
+  pcl_plane_t *planes;		/* For mode 3 and mode 9 compression */
+  int plane;			/* Plane being sent in the current row */
+  int compression;		/* Current compression mode */
+  int do_crdr;			/* Try mode 9 as well as mode 3 */
   int do_cret;
   int do_cretb;
   int do_6color;
@@ -346,6 +375,9 @@ typedef struct {
 #define PCL_PRINTER_LABEL       256     /* Datamax-O'Neil PCL Label Printer */
 #define PCL_PRINTER_LJ_COLOR	512	/* Color laser printers */
 #define PCL_PRINTER_COPIES     1024     /* Supports PCL5/HPGL2/HP-RTL copies */
+#define PCL_PRINTER_DELTAROW	2048	/* Delta row compression (mode 3) */
+#define PCL_PRINTER_CRDR	4096	/* Compressed replacement delta row
+					   compression (mode 9) */
 
 /*
  * FIXME - the 520 shouldn't be lumped in with the 500 as it supports
@@ -1290,7 +1322,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 10, 10},	/* Check/Fix */
     PCL_COLOR_NONE,
-    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE | PCL_PRINTER_COPIES,
+    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_BLANKLINE | PCL_PRINTER_COPIES,
     ljsmall_papersizes,
     emptylist,
     laserjet_papersources,
@@ -1303,7 +1335,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 10, 10},	/* Check/Fix */
     PCL_COLOR_NONE,
-    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE | PCL_PRINTER_COPIES,
+    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_BLANKLINE | PCL_PRINTER_COPIES,
     ljbig_papersizes,
     emptylist,
     laserjet_papersources,
@@ -1316,7 +1348,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 10, 10},	/* Check/Fix */
     PCL_COLOR_NONE,
-    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljbig_papersizes,
     emptylist,
@@ -1330,7 +1362,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 10, 10},	/* Check/Fix */
     PCL_COLOR_NONE,
-    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljsmall_papersizes,
     emptylist,
@@ -1344,7 +1376,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 10, 10},	/* Check/Fix */
     PCL_COLOR_NONE,
-    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljbig_papersizes,
     emptylist,
@@ -1358,7 +1390,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 18, 18},	/* Check/Fix */
     PCL_COLOR_NONE,
-    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljsmall_papersizes,
     emptylist,
@@ -1372,7 +1404,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 18, 18},	/* Check/Fix */
     PCL_COLOR_NONE,
-    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljbig_papersizes,
     emptylist,
@@ -1386,7 +1418,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 18, 18},	/* Check/Fix */
     PCL_COLOR_NONE,
-    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljtabloid_papersizes,
     emptylist,
@@ -1400,7 +1432,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 10, 10},	/* Check/Fix */
     PCL_COLOR_NONE,
-    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljbig_papersizes,
     emptylist,
@@ -1414,7 +1446,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 10, 10},	/* Check/Fix */
     PCL_COLOR_RGB,
-    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_CRDR | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljsmall_papersizes,
     emptylist,
@@ -1428,7 +1460,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 10, 10},	/* Check/Fix */
     PCL_COLOR_RGB,
-    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_CRDR | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljbig_papersizes,
     emptylist,
@@ -1442,7 +1474,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 18, 18},	/* Check/Fix */
     PCL_COLOR_RGB,
-    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_CRDR | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljsmall_papersizes,
     emptylist,
@@ -1456,7 +1488,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 18, 18},	/* Check/Fix */
     PCL_COLOR_RGB,
-    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_CRDR | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljbig_papersizes,
     emptylist,
@@ -1470,7 +1502,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 18, 18},	/* Check/Fix */
     PCL_COLOR_RGB,
-    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_NEW_ERG | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_CRDR | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljtabloid_papersizes,
     emptylist,
@@ -1484,7 +1516,7 @@ static const pcl_cap_t pcl_model_capabilities[] =
     {12, 12, 18, 18},
     {12, 12, 18, 18},	/* Check/Fix */
     PCL_COLOR_RGB,
-    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_TIFF | PCL_PRINTER_BLANKLINE |
+    PCL_PRINTER_LJ_COLOR | PCL_PRINTER_TIFF | PCL_PRINTER_DELTAROW | PCL_PRINTER_CRDR | PCL_PRINTER_BLANKLINE |
       PCL_PRINTER_DUPLEX | PCL_PRINTER_COPIES,
     ljsmall_papersizes,
     emptylist,
@@ -2589,6 +2621,13 @@ pcl_printfunc(stp_vars_t *v)
 	      stp_dprintf(STP_DBG_PCL, v, "Blank Lines = %d\n", pd->blank_lines);
 	      stp_zprintf(v, "\033*b%dY", pd->blank_lines);
 	      pd->blank_lines=0;
+	      if (pd->planes)		/* Vertical movement clears the seed rows */
+		{
+		  int i;
+		  for (i = 0; i < PCL_MAX_PLANES; i++)
+		    if (pd->planes[i].seed)
+		      memset(pd->planes[i].seed, 0, pd->height);
+		}
 	    }
 	  else;
 	}
@@ -2736,6 +2775,7 @@ pcl_do_print(stp_vars_t *v, stp_image_t *image)
   int		top = (int) stp_get_top(v) + .5;
   int		left = (int) stp_get_left(v) + .5;
   int		y;		/* Looping vars */
+  int		plane, mode;
   stp_resolution_t	xdpi, ydpi;	/* Resolution */
   unsigned char *black,		/* Black bitmap data */
 		*cyan,		/* Cyan bitmap data */
@@ -3339,15 +3379,26 @@ pcl_do_print(stp_vars_t *v, stp_image_t *image)
 
 /* Allocate buffer for pcl_mode2 tiff compression */
 
+  privdata.planes = NULL;
   if ((caps->stp_printer_type & PCL_PRINTER_TIFF) == PCL_PRINTER_TIFF &&
       !(stp_get_debug_level() & STP_DBG_NO_COMPRESSION))
   {
     privdata.comp_buf = stp_malloc((privdata.height + 128 + 7) * 129 / 128);
-    privdata.writefunc = pcl_mode2;
+    privdata.compression = 2;
+    if (caps->stp_printer_type & PCL_PRINTER_DELTAROW)
+      {
+	privdata.planes = stp_zalloc(PCL_MAX_PLANES * sizeof(pcl_plane_t));
+	privdata.plane = 0;
+	privdata.do_crdr = (caps->stp_printer_type & PCL_PRINTER_CRDR) != 0;
+	privdata.writefunc = pcl_mode_delta;
+      }
+    else
+      privdata.writefunc = pcl_mode2;
   }
   else
   {
     privdata.comp_buf = NULL;
+    privdata.compression = 0;
     privdata.writefunc = pcl_mode0;
   }
 
@@ -3624,6 +3675,18 @@ pcl_do_print(stp_vars_t *v, stp_image_t *image)
 
   if (privdata.comp_buf != NULL)
     stp_free(privdata.comp_buf);
+  if (privdata.planes != NULL)
+  {
+    for (plane = 0; plane < PCL_MAX_PLANES; plane++)
+    {
+      if (privdata.planes[plane].seed)
+	stp_free(privdata.planes[plane].seed);
+      for (mode = 1; mode < PCL_NMODES; mode++)
+	if (privdata.planes[plane].data[mode])
+	  stp_free(privdata.planes[plane].data[mode]);
+    }
+    stp_free(privdata.planes);
+  }
   if (privdata.row_buf != NULL)
     stp_free(privdata.row_buf);
 
@@ -3714,6 +3777,269 @@ pcl_mode2(stp_vars_t *v,		/* I - Print file or command */
 }
 
 
+/*
+ * 'pcl_put_offset()' - Append the remainder of a delta row offset or
+ *                      count that didn't fit in the command byte.
+ */
+
+static unsigned char *
+pcl_put_offset(unsigned char *out,	/* I - Output buffer */
+	       int	     value)	/* I - Amount beyond the command field */
+{
+  while (value >= 255)
+    {
+      *out++ = 255;
+      value -= 255;
+    }
+  *out++ = value;
+  return out;
+}
+
+
+/*
+ * 'pcl_pack_delta()' - Encode a plane against its seed row using mode 3
+ *                      (delta row) compression.  Returns the encoded
+ *                      length, or -1 if it would not fit in outlen bytes.
+ */
+
+static int
+pcl_pack_delta(const unsigned char *line,	/* I - Plane data */
+	       const unsigned char *seed,	/* I - Previous row of plane */
+	       int		   length,	/* I - Length of plane */
+	       unsigned char	   *out,	/* O - Encoded data */
+	       int		   outlen)	/* I - Size of out */
+{
+  unsigned char *start = out;
+  unsigned char *end = out + outlen;
+  int last = 0;				/* Byte after the last replacement */
+  int i = 0;
+
+  while (i < length)
+    {
+      int first, count, offset;
+
+      while (i < length && line[i] == seed[i])
+	i++;
+      if (i == length)
+	break;
+      first = i;
+      while (i < length && i - first < 8 && line[i] != seed[i])
+	i++;
+      count = i - first;
+      offset = first - last;
+      if (end - out < 2 + offset / 255 + count)
+	return -1;
+      if (offset < 31)
+	*out++ = ((count - 1) << 5) | offset;
+      else
+	{
+	  *out++ = ((count - 1) << 5) | 31;
+	  out = pcl_put_offset(out, offset - 31);
+	}
+      memcpy(out, line + first, count);
+      out += count;
+      last = i;
+    }
+  return out - start;
+}
+
+
+/*
+ * 'pcl_pack_crdr()' - Encode a plane against its seed row using mode 9
+ *                     (compressed replacement delta row) compression.
+ *                     Returns the encoded length, or -1 if it would not
+ *                     fit in outlen bytes.
+ */
+
+static int
+pcl_pack_crdr(const unsigned char *line,	/* I - Plane data */
+	      const unsigned char *seed,	/* I - Previous row of plane */
+	      int		  length,	/* I - Length of plane */
+	      unsigned char	  *out,		/* O - Encoded data */
+	      int		  outlen)	/* I - Size of out */
+{
+  unsigned char *start = out;
+  unsigned char *end = out + outlen;
+  int last = 0;				/* Byte after the last replacement */
+  int i = 0;
+
+  while (i < length)
+    {
+      int stop, offset;
+
+      while (i < length && line[i] == seed[i])
+	i++;
+      if (i == length)
+	break;
+      stop = i;
+      while (stop < length && line[stop] != seed[stop])
+	stop++;
+      offset = i - last;
+      while (i < stop)
+	{
+	  int run = 1;
+	  while (i + run < stop && line[i + run] == line[i])
+	    run++;
+	  if (end - out < 4 + offset / 255 + run / 255)
+	    return -1;
+	  if (run >= 3)
+	    {
+	      /* Repeated byte: 1oocccccc, count is stored minus 2 */
+	      *out++ = 0x80 | (MIN(offset, 3) << 5) | MIN(run - 2, 31);
+	      if (offset >= 3)
+		out = pcl_put_offset(out, offset - 3);
+	      if (run - 2 >= 31)
+		out = pcl_put_offset(out, run - 2 - 31);
+	      *out++ = line[i];
+	      i += run;
+	    }
+	  else
+	    {
+	      /* Literal bytes: 0oooocc, count is stored minus 1 */
+	      int count = run;
+	      while (i + count < stop &&
+		     !(i + count + 2 < stop &&
+		       line[i + count] == line[i + count + 1] &&
+		       line[i + count] == line[i + count + 2]))
+		count++;
+	      if (end - out < 3 + offset / 255 + count / 255 + count)
+		return -1;
+	      *out++ = (MIN(offset, 15) << 3) | MIN(count - 1, 7);
+	      if (offset >= 15)
+		out = pcl_put_offset(out, offset - 15);
+	      if (count - 1 >= 7)
+		out = pcl_put_offset(out, count - 1 - 7);
+	      memcpy(out, line + i, count);
+	      out += count;
+	      i += count;
+	    }
+	  offset = 0;
+	}
+      last = stop;
+    }
+  return out - start;
+}
+
+
+/*
+ * 'pcl_mode_delta()' - Send PCL graphics using mode 0, 2, 3 or (if the
+ *                      printer supports it) 9 compression, choosing the
+ *                      modes that give the shortest output for each row.
+ */
+
+static void
+pcl_mode_delta(stp_vars_t *v,		/* I - Print file or command */
+	       unsigned char *line,	/* I - Output bitmap data */
+	       int           height,	/* I - Height of bitmap data */
+	       int           last_plane) /* I - True if this is the last plane */
+{
+  pcl_privdata_t *privdata =
+    (pcl_privdata_t *) stp_get_component_data(v, "Driver");
+  pcl_plane_t *plane = privdata->planes + privdata->plane;
+  int buf_size = (privdata->height + 128 + 7) * 129 / 128;
+  int cost[PCL_MAX_PLANES][PCL_NMODES];
+  int from[PCL_MAX_PLANES][PCL_NMODES];
+  int chosen[PCL_MAX_PLANES];
+  int nplanes, limit, i, m, n;
+  unsigned char	*comp_ptr;		/* Current slot in buffer */
+
+  STPI_ASSERT(privdata->plane < PCL_MAX_PLANES, v);
+  if (!plane->seed)
+    {
+      plane->seed = stp_zalloc(privdata->height);
+      for (m = 1; m < PCL_NMODES; m++)
+	plane->data[m] = stp_malloc(buf_size);
+    }
+
+ /*
+  * Encode the plane every way we can.  A delta encoding longer than the
+  * best of mode 0 and 2 plus two mode changes will never be chosen, so
+  * the delta encoders can give up at that point.
+  */
+
+  stp_pack_tiff(v, line, height, plane->data[1], &comp_ptr, NULL, NULL);
+  plane->length[1] = comp_ptr - plane->data[1];
+  plane->length[0] = height;
+  limit = MIN(plane->length[0], plane->length[1]) + 2 * PCL_MODE_SWITCH;
+  plane->length[2] = pcl_pack_delta(line, plane->seed, height,
+				    plane->data[2], MIN(limit, buf_size));
+  plane->length[3] = -1;
+  if (privdata->do_crdr)
+    plane->length[3] = pcl_pack_crdr(line, plane->seed, height,
+				     plane->data[3], MIN(limit, buf_size));
+
+ /*
+  * Whatever mode is used, this row becomes the seed for the plane; it
+  * is also what we send in mode 0.
+  */
+
+  memcpy(plane->seed, line, height);
+  plane->data[0] = plane->seed;
+
+  if (!last_plane)
+    {
+      privdata->plane++;
+      return;
+    }
+
+ /*
+  * Choose the mode for each plane of the row, counting the cost of the
+  * "\033*b#M" needed each time the mode changes.
+  */
+
+  nplanes = privdata->plane + 1;
+  for (i = 0; i < nplanes; i++)
+    {
+      pcl_plane_t *p = privdata->planes + i;
+      for (m = 0; m < PCL_NMODES; m++)
+	{
+	  cost[i][m] = INT_MAX;
+	  if (p->length[m] < 0)
+	    continue;
+	  for (n = 0; n < PCL_NMODES; n++)
+	    {
+	      int c;
+	      if (i == 0)
+		c = pcl_modes[n] == privdata->compression ? 0 : INT_MAX;
+	      else
+		c = cost[i - 1][n];
+	      if (c == INT_MAX)
+		continue;
+	      c += p->length[m] + (m == n ? 0 : PCL_MODE_SWITCH);
+	      if (c < cost[i][m])
+		{
+		  cost[i][m] = c;
+		  from[i][m] = n;
+		}
+	    }
+	}
+    }
+  m = 0;
+  for (n = 1; n < PCL_NMODES; n++)
+    if (cost[nplanes - 1][n] < cost[nplanes - 1][m])
+      m = n;
+  for (i = nplanes - 1; i >= 0; i--)
+    {
+      chosen[i] = m;
+      m = from[i][m];
+    }
+
+  for (i = 0; i < nplanes; i++)
+    {
+      pcl_plane_t *p = privdata->planes + i;
+      m = chosen[i];
+      if (pcl_modes[m] != privdata->compression)
+	{
+	  stp_zprintf(v, "\033*b%dM", pcl_modes[m]);
+	  privdata->compression = pcl_modes[m];
+	}
+      stp_zprintf(v, "\033*b%d%c", p->length[m], i == nplanes - 1 ? 'W' : 'V');
+      stp_zfwrite((const char *) p->data[m], p->length[m], 1, v);
+    }
+  privdata->plane = 0;
+}
+
+
 static stp_family_t print_pcl_module_data =
   {
     &print_pcl_printfuncs,
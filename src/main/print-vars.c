@@ -37,11 +37,13 @@
 #include <gutenprint/gutenprint-intl-internal.h>
 #include "generic-options.h"
 
-typedef struct
+typedef struct value
 {
-  char *name;
+  const char *name;		/* Interned; owned by the key table */
+  stp_parameter_key_t key;
   stp_parameter_type_t typ;
   stp_parameter_activity_t active;
+  struct value *next;		/* Next value with the same key */
   union
   {
     int ival;
@@ -73,6 +75,8 @@ struct stp_vars			/* Plug-in variables */
   stp_dimension_t	page_width;	/* Width of page in points */
   stp_dimension_t	page_height;	/* Height of page in points */
   stp_list_t *params[STP_PARAMETER_TYPE_INVALID];
+  value_t **values;		/* Parameter values indexed by key */
+  int nvalues;			/* Number of slots in values */
   stp_list_t *internal_data;
   void (*outfunc)(void *data, const char *buffer, size_t bytes);
   void *outdata;
@@ -114,6 +118,220 @@ static stp_vars_t default_vars;
 
 #define CHECK_VARS(v) STPI_ASSERT(v, NULL)
 
+/*
+ * Parameter names are interned: the first time a name is set, it is
+ * assigned a small integer key, and each vars object keeps its values
+ * in an array indexed by key.  Values of different types that happen
+ * to share a name are chained together.  The per-type lists are kept
+ * so that parameters can still be listed in the order they were set.
+ *
+ * Looking up a parameter never interns its name (a name that has never
+ * been interned can't have a value), so getting parameters modifies
+ * nothing, and callers that want to avoid even the name lookup can
+ * intern the name once and use the _k accessors.
+ *
+ * The key table is shared by every vars object and by all threads.
+ * Entries are only ever added, never changed or removed, so looking up
+ * keys and names takes no lock: a new entry is filled in completely
+ * before the count of keys, and then the hash chain that leads to it,
+ * are published.  Only adding an entry takes the global lock.
+ */
+
+#define PARAM_KEY_BUCKETS 512
+#define PARAM_KEY_CHUNK 256	/* Names per block of the name table */
+#define PARAM_KEY_CHUNKS 256	/* So at most 65536 keys */
+
+typedef struct param_key
+{
+  const char *name;
+  stp_parameter_key_t key;
+  struct param_key *next;
+} param_key_t;
+
+static param_key_t *param_key_buckets[PARAM_KEY_BUCKETS];
+static const char **param_key_names[PARAM_KEY_CHUNKS];
+static int param_key_count = 0;
+
+static inline unsigned
+param_key_hash(const char *name)
+{
+  unsigned hash = 2166136261u;
+  while (*name)
+    {
+      hash ^= (unsigned char) *name++;
+      hash *= 16777619u;
+    }
+  return hash % PARAM_KEY_BUCKETS;
+}
+
+static stp_parameter_key_t
+lookup_parameter_key(const char *name, unsigned bucket)
+{
+  const param_key_t *pk;
+  for (pk = STPI_LOAD_ACQUIRE(&(param_key_buckets[bucket])); pk;
+       pk = pk->next)
+    if (strcmp(pk->name, name) == 0)
+      return pk->key;
+  return STP_PARAMETER_KEY_INVALID;
+}
+
+stp_parameter_key_t
+stp_parameter_intern(const char *name)
+{
+  stp_parameter_key_t key;
+  unsigned bucket;
+  if (!name)
+    return STP_PARAMETER_KEY_INVALID;
+  bucket = param_key_hash(name);
+  key = lookup_parameter_key(name, bucket);
+  if (key != STP_PARAMETER_KEY_INVALID)
+    return key;
+  stpi_global_lock();
+  /* Another thread may have added it in the meantime */
+  key = lookup_parameter_key(name, bucket);
+  if (key == STP_PARAMETER_KEY_INVALID)
+    {
+      if (param_key_count < PARAM_KEY_CHUNK * PARAM_KEY_CHUNKS)
+	{
+	  param_key_t *pk = stp_malloc(sizeof(param_key_t));
+	  const char **names;
+	  key = param_key_count;
+	  names = param_key_names[key / PARAM_KEY_CHUNK];
+	  if (!names)
+	    {
+	      names = stp_malloc(PARAM_KEY_CHUNK * sizeof(const char *));
+	      param_key_names[key / PARAM_KEY_CHUNK] = names;
+	    }
+	  pk->name = stp_strdup(name);
+	  pk->key = key;
+	  pk->next = param_key_buckets[bucket];
+	  names[key % PARAM_KEY_CHUNK] = pk->name;
+	  STPI_STORE_RELEASE(&param_key_count, key + 1);
+	  STPI_STORE_RELEASE(&(param_key_buckets[bucket]), pk);
+	}
+      else
+	stp_erprintf("Gutenprint: too many parameter names, can't add %s\n",
+		     name);
+    }
+  stpi_global_unlock();
+  return key;
+}
+
+const char *
+stp_parameter_key_name(stp_parameter_key_t key)
+{
+  if (key < 0 || key >= STPI_LOAD_ACQUIRE(&param_key_count))
+    return NULL;
+  return param_key_names[key / PARAM_KEY_CHUNK][key % PARAM_KEY_CHUNK];
+}
+
+static stp_parameter_key_t
+find_parameter_key(const char *name)
+{
+  if (!name)
+    return STP_PARAMETER_KEY_INVALID;
+  return lookup_parameter_key(name, param_key_hash(name));
+}
+
+static inline int
+param_key_limit(void)
+{
+  return STPI_LOAD_ACQUIRE(&param_key_count);
+}
+
+static inline int
+valid_key(stp_parameter_key_t key)
+{
+  return key >= 0 && key < param_key_limit();
+}
+
+static value_t *
+find_value(const stp_vars_t *v, stp_parameter_key_t key,
+	   stp_parameter_type_t typ)
+{
+  value_t *val;
+  if (key < 0 || key >= v->nvalues)
+    return NULL;
+  for (val = v->values[key]; val; val = val->next)
+    if (val->typ == typ)
+      return val;
+  return NULL;
+}
+
+static void
+link_value(stp_vars_t *v, value_t *val)
+{
+  if (val->key >= v->nvalues)
+    {
+      int nvalues = param_key_limit();
+      v->values = stp_realloc(v->values, nvalues * sizeof(value_t *));
+      memset(v->values + v->nvalues, 0,
+	     (nvalues - v->nvalues) * sizeof(value_t *));
+      v->nvalues = nvalues;
+    }
+  val->next = v->values[val->key];
+  v->values[val->key] = val;
+}
+
+static void
+unlink_value(stp_vars_t *v, const value_t *val)
+{
+  value_t **vp = &(v->values[val->key]);
+  while (*vp)
+    {
+      if (*vp == val)
+	{
+	  *vp = val->next;
+	  break;
+	}
+      vp = &((*vp)->next);
+    }
+}
+
+/*
+ * Create a value and add it to the vars.  The caller must fill in the
+ * value itself.
+ */
+static value_t *
+create_value(stp_vars_t *v, stp_parameter_key_t key,
+	     stp_parameter_type_t typ, stp_parameter_activity_t active)
+{
+  value_t *val = stp_malloc(sizeof(value_t));
+  val->name = stp_parameter_key_name(key);
+  val->key = key;
+  val->typ = typ;
+  val->active = active;
+  link_value(v, val);
+  stp_list_item_create(v->params[typ], NULL, val);
+  return val;
+}
+
+static void
+destroy_value(stp_vars_t *v, value_t *val)
+{
+  stp_list_t *list = v->params[val->typ];
+  unlink_value(v, val);
+  stp_list_item_destroy(list, stp_list_get_item_by_name(list, val->name));
+}
+
+/* Rebuild the index after the value lists have been replaced */
+static void
+index_values(stp_vars_t *v)
+{
+  int i;
+  STP_SAFE_FREE(v->values);
+  v->nvalues = 0;
+  for (i = 0; i < STP_PARAMETER_TYPE_INVALID; i++)
+    {
+      stp_list_item_t *item = stp_list_get_start(v->params[i]);
+      while (item)
+	{
+	  link_value(v, (value_t *) stp_list_item_get_data(item));
+	  item = stp_list_item_next(item);
+	}
+    }
+}
+
 static const char *
 value_namefunc(const void *item)
 {
@@ -142,7 +360,6 @@ value_freefunc(void *item)
     default:
       break;
     }
-  stp_free(v->name);
   stp_free(v);
 }
 
@@ -176,7 +393,9 @@ value_copy(const void *item)
 {
   value_t *ret = stp_malloc(sizeof(value_t));
   const value_t *v = (const value_t *) (item);
-  ret->name = stp_strdup(v->name);
+  ret->name = v->name;
+  ret->key = v->key;
+  ret->next = NULL;
   ret->typ = v->typ;
   ret->active = v->active;
   switch (v->typ)
@@ -355,6 +574,7 @@ stp_vars_destroy(stp_vars_t *v)
   CHECK_VARS(v);
   for (i = 0; i < STP_PARAMETER_TYPE_INVALID; i++)
     stp_list_destroy(v->params[i]);
+  STP_SAFE_FREE(v->values);
   stp_list_destroy(v->internal_data);
   STP_SAFE_FREE(v->driver);
   STP_SAFE_FREE(v->color_conversion);
@@ -443,87 +663,89 @@ stp_get_verified(const stp_vars_t *v)
 }
 
 static void
-set_default_raw_parameter(stp_list_t *list, const char *parameter,
+set_default_raw_parameter(stp_vars_t *v, stp_parameter_key_t key,
 			  const char *value, size_t bytes, int typ)
 {
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  if (value && !item)
+  if (value && valid_key(key) && !find_value(v, key, typ))
     {
-      value_t *val = stp_malloc(sizeof(value_t));
-      val->name = stp_strdup(parameter);
-      val->typ = typ;
-      val->active = STP_PARAMETER_DEFAULTED;
-      stp_list_item_create(list, NULL, val);
+      value_t *val = create_value(v, key, typ, STP_PARAMETER_DEFAULTED);
       copy_to_raw(&(val->value.rval), value, bytes);
     }
 }
 
 static void
-set_raw_parameter(stp_list_t *list, const char *parameter, const char *value,
+set_raw_parameter(stp_vars_t *v, stp_parameter_key_t key, const char *value,
 		  size_t bytes, int typ)
 {
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  if (value)
+  value_t *val = find_value(v, key, typ);
+  if (value && valid_key(key))
     {
-      value_t *val;
-      if (item)
+      if (val)
 	{
-	  val = (value_t *) stp_list_item_get_data(item);
 	  if (val->active == STP_PARAMETER_DEFAULTED)
 	    val->active = STP_PARAMETER_ACTIVE;
 	  stp_free(stpi_cast_safe(val->value.rval.data));
 	}
       else
-	{
-	  val = stp_malloc(sizeof(value_t));
-	  val->name = stp_strdup(parameter);
-	  val->typ = typ;
-	  val->active = STP_PARAMETER_ACTIVE;
-	  stp_list_item_create(list, NULL, val);
-	}
+	val = create_value(v, key, typ, STP_PARAMETER_ACTIVE);
       copy_to_raw(&(val->value.rval), value, bytes);
     }
-  else if (item)
-    stp_list_item_destroy(list, item);
+  else if (val)
+    destroy_value(v, val);
+}
+
+static void
+clear_parameter(stp_vars_t *v, stp_parameter_key_t key,
+		stp_parameter_type_t typ)
+{
+  value_t *val = find_value(v, key, typ);
+  if (val)
+    destroy_value(v, val);
 }
 
 void
 stp_set_string_parameter_n(stp_vars_t *v, const char *parameter,
 			   const char *value, size_t bytes)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_STRING_LIST];
   if (value)
     stp_dprintf(STP_DBG_VARS, v, "stp_set_string_parameter(0x%p, %s, %s)\n",
 		 (const void *) v, parameter, value);
   else
     stp_dprintf(STP_DBG_VARS, v, "stp_set_string_parameter(0x%p, %s)\n",
 		 (const void *) v, parameter);
-  set_raw_parameter(list, parameter, value, bytes,
+  set_raw_parameter(v, stp_parameter_intern(parameter), value, bytes,
 		    STP_PARAMETER_TYPE_STRING_LIST);
   stp_set_verified(v, 0);
 }
 
 void
-stp_set_string_parameter(stp_vars_t *v, const char *parameter,
-			 const char *value)
+stp_set_string_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+			   const char *value)
 {
-  int byte_count = 0;
+  size_t byte_count = 0;
   if (value)
-      byte_count = strlen(value);
+    byte_count = strlen(value);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_string_parameter(0x%p, %s, %s)\n",
-	       (const void *) v, parameter, value ? value : "NULL");
-  stp_set_string_parameter_n(v, parameter, value, byte_count);
+	       (const void *) v, stp_parameter_key_name(key),
+	       value ? value : "NULL");
+  set_raw_parameter(v, key, value, byte_count, STP_PARAMETER_TYPE_STRING_LIST);
   stp_set_verified(v, 0);
 }
 
+void
+stp_set_string_parameter(stp_vars_t *v, const char *parameter,
+			 const char *value)
+{
+  stp_set_string_parameter_k(v, stp_parameter_intern(parameter), value);
+}
+
 void
 stp_set_default_string_parameter_n(stp_vars_t *v, const char *parameter,
 				   const char *value, size_t bytes)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_STRING_LIST];
   stp_dprintf(STP_DBG_VARS, v, "stp_set_default_string_parameter(0x%p, %s, %s)\n",
 	       (const void *) v, parameter, value ? value : "NULL");
-  set_default_raw_parameter(list, parameter, value, bytes,
+  set_default_raw_parameter(v, stp_parameter_intern(parameter), value, bytes,
 			    STP_PARAMETER_TYPE_STRING_LIST);
   stp_set_verified(v, 0);
 }
@@ -539,6 +761,12 @@ stp_set_default_string_parameter(stp_vars_t *v, const char *parameter,
   stp_set_verified(v, 0);
 }
 
+void
+stp_clear_string_parameter_k(stp_vars_t *v, stp_parameter_key_t key)
+{
+  stp_set_string_parameter_k(v, key, NULL);
+}
+
 void
 stp_clear_string_parameter(stp_vars_t *v, const char *parameter)
 {
@@ -546,39 +774,51 @@ stp_clear_string_parameter(stp_vars_t *v, const char *parameter)
 }
 
 const char *
-stp_get_string_parameter(const stp_vars_t *v, const char *parameter)
+stp_get_string_parameter_k(const stp_vars_t *v, stp_parameter_key_t key)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_STRING_LIST];
-  value_t *val;
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  if (item)
-    {
-      val = (value_t *) stp_list_item_get_data(item);
-      return val->value.rval.data;
-    }
+  const value_t *val = find_value(v, key, STP_PARAMETER_TYPE_STRING_LIST);
+  if (val)
+    return val->value.rval.data;
   else
     return NULL;
 }
 
+const char *
+stp_get_string_parameter(const stp_vars_t *v, const char *parameter)
+{
+  return stp_get_string_parameter_k(v, find_parameter_key(parameter));
+}
+
+void
+stp_set_raw_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+			const void *value, size_t bytes)
+{
+  set_raw_parameter(v, key, value, bytes, STP_PARAMETER_TYPE_RAW);
+  stp_set_verified(v, 0);
+}
+
 void
 stp_set_raw_parameter(stp_vars_t *v, const char *parameter,
 		      const void *value, size_t bytes)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_RAW];
-  set_raw_parameter(list, parameter, value, bytes, STP_PARAMETER_TYPE_RAW);
-  stp_set_verified(v, 0);
+  stp_set_raw_parameter_k(v, stp_parameter_intern(parameter), value, bytes);
 }
 
 void
 stp_set_default_raw_parameter(stp_vars_t *v, const char *parameter,
 			      const void *value, size_t bytes)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_RAW];
-  set_default_raw_parameter(list, parameter, value, bytes,
+  set_default_raw_parameter(v, stp_parameter_intern(parameter), value, bytes,
 			    STP_PARAMETER_TYPE_RAW);
   stp_set_verified(v, 0);
 }
 
+void
+stp_clear_raw_parameter_k(stp_vars_t *v, stp_parameter_key_t key)
+{
+  stp_set_raw_parameter_k(v, key, NULL, 0);
+}
+
 void
 stp_clear_raw_parameter(stp_vars_t *v, const char *parameter)
 {
@@ -586,43 +826,49 @@ stp_clear_raw_parameter(stp_vars_t *v, const char *parameter)
 }
 
 const stp_raw_t *
-stp_get_raw_parameter(const stp_vars_t *v, const char *parameter)
+stp_get_raw_parameter_k(const stp_vars_t *v, stp_parameter_key_t key)
 {
-  const stp_list_t *list = v->params[STP_PARAMETER_TYPE_RAW];
-  const value_t *val;
-  const stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  if (item)
-    {
-      val = (const value_t *) stp_list_item_get_data(item);
-      return &(val->value.rval);
-    }
+  const value_t *val = find_value(v, key, STP_PARAMETER_TYPE_RAW);
+  if (val)
+    return &(val->value.rval);
   else
     return NULL;
 }
 
+const stp_raw_t *
+stp_get_raw_parameter(const stp_vars_t *v, const char *parameter)
+{
+  return stp_get_raw_parameter_k(v, find_parameter_key(parameter));
+}
+
 void
-stp_set_file_parameter(stp_vars_t *v, const char *parameter,
-		       const char *value)
+stp_set_file_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+			 const char *value)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_FILE];
   size_t byte_count = 0;
   if (value)
     byte_count = strlen(value);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_file_parameter(0x%p, %s, %s)\n",
-	       (const void *) v, parameter, value ? value : "NULL");
-  set_raw_parameter(list, parameter, value, byte_count,
-		    STP_PARAMETER_TYPE_FILE);
+	       (const void *) v, stp_parameter_key_name(key),
+	       value ? value : "NULL");
+  set_raw_parameter(v, key, value, byte_count, STP_PARAMETER_TYPE_FILE);
   stp_set_verified(v, 0);
 }
 
+void
+stp_set_file_parameter(stp_vars_t *v, const char *parameter,
+		       const char *value)
+{
+  stp_set_file_parameter_k(v, stp_parameter_intern(parameter), value);
+}
+
 void
 stp_set_file_parameter_n(stp_vars_t *v, const char *parameter,
 			 const char *value, size_t byte_count)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_FILE];
   stp_dprintf(STP_DBG_VARS, v, "stp_set_file_parameter(0x%p, %s, %s)\n",
 	       (const void *) v, parameter, value ? value : "NULL");
-  set_raw_parameter(list, parameter, value, byte_count,
+  set_raw_parameter(v, stp_parameter_intern(parameter), value, byte_count,
 		    STP_PARAMETER_TYPE_FILE);
   stp_set_verified(v, 0);
 }
@@ -631,14 +877,13 @@ void
 stp_set_default_file_parameter(stp_vars_t *v, const char *parameter,
 			       const char *value)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_FILE];
   size_t byte_count = 0;
   if (value)
     byte_count = strlen(value);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_default_file_parameter(0x%p, %s, %s)\n",
 	       (const void *) v, parameter, value ? value : "NULL");
-  set_default_raw_parameter(list, parameter, value, byte_count,
-			    STP_PARAMETER_TYPE_FILE);
+  set_default_raw_parameter(v, stp_parameter_intern(parameter), value,
+			    byte_count, STP_PARAMETER_TYPE_FILE);
   stp_set_verified(v, 0);
 }
 
@@ -646,14 +891,19 @@ void
 stp_set_default_file_parameter_n(stp_vars_t *v, const char *parameter,
 				 const char *value, size_t byte_count)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_FILE];
   stp_dprintf(STP_DBG_VARS, v, "stp_set_default_file_parameter(0x%p, %s, %s)\n",
 	       (const void *) v, parameter, value ? value : "NULL");
-  set_default_raw_parameter(list, parameter, value, byte_count,
-			    STP_PARAMETER_TYPE_FILE);
+  set_default_raw_parameter(v, stp_parameter_intern(parameter), value,
+			    byte_count, STP_PARAMETER_TYPE_FILE);
   stp_set_verified(v, 0);
 }
 
+void
+stp_clear_file_parameter_k(stp_vars_t *v, stp_parameter_key_t key)
+{
+  stp_set_file_parameter_k(v, key, NULL);
+}
+
 void
 stp_clear_file_parameter(stp_vars_t *v, const char *parameter)
 {
@@ -661,78 +911,76 @@ stp_clear_file_parameter(stp_vars_t *v, const char *parameter)
 }
 
 const char *
-stp_get_file_parameter(const stp_vars_t *v, const char *parameter)
+stp_get_file_parameter_k(const stp_vars_t *v, stp_parameter_key_t key)
 {
-  const stp_list_t *list = v->params[STP_PARAMETER_TYPE_FILE];
-  const value_t *val;
-  const stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  if (item)
-    {
-      val = (const value_t *) stp_list_item_get_data(item);
-      return val->value.rval.data;
-    }
+  const value_t *val = find_value(v, key, STP_PARAMETER_TYPE_FILE);
+  if (val)
+    return val->value.rval.data;
   else
     return NULL;
 }
 
+const char *
+stp_get_file_parameter(const stp_vars_t *v, const char *parameter)
+{
+  return stp_get_file_parameter_k(v, find_parameter_key(parameter));
+}
+
 void
-stp_set_curve_parameter(stp_vars_t *v, const char *parameter,
-			const stp_curve_t *curve)
+stp_set_curve_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+			  const stp_curve_t *curve)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_CURVE];
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
+  value_t *val = find_value(v, key, STP_PARAMETER_TYPE_CURVE);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_curve_parameter(0x%p, %s)\n",
-	       (const void *) v, parameter);
-  if (curve)
+	       (const void *) v, stp_parameter_key_name(key));
+  if (curve && valid_key(key))
     {
-      value_t *val;
-      if (item)
+      if (val)
 	{
-	  val = (value_t *) stp_list_item_get_data(item);
 	  if (val->active == STP_PARAMETER_DEFAULTED)
 	    val->active = STP_PARAMETER_ACTIVE;
 	  if (val->value.cval)
 	    stp_curve_destroy(val->value.cval);
 	}
       else
-	{
-	  val = stp_malloc(sizeof(value_t));
-	  val->name = stp_strdup(parameter);
-	  val->typ = STP_PARAMETER_TYPE_CURVE;
-	  val->active = STP_PARAMETER_ACTIVE;
-	  stp_list_item_create(list, NULL, val);
-	}
+	val = create_value(v, key, STP_PARAMETER_TYPE_CURVE,
+			   STP_PARAMETER_ACTIVE);
       val->value.cval = stp_curve_create_copy(curve);
     }
-  else if (item)
-    stp_list_item_destroy(list, item);
+  else if (val)
+    destroy_value(v, val);
   stp_set_verified(v, 0);
 }
 
+void
+stp_set_curve_parameter(stp_vars_t *v, const char *parameter,
+			const stp_curve_t *curve)
+{
+  stp_set_curve_parameter_k(v, stp_parameter_intern(parameter), curve);
+}
+
 void
 stp_set_default_curve_parameter(stp_vars_t *v, const char *parameter,
 				const stp_curve_t *curve)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_CURVE];
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
+  stp_parameter_key_t key = stp_parameter_intern(parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_default_curve_parameter(0x%p, %s)\n",
 	       (const void *) v, parameter);
-  if (!item)
+  if (curve && valid_key(key) && !find_value(v, key, STP_PARAMETER_TYPE_CURVE))
     {
-      if (curve)
-	{
-	  value_t *val;
-	  val = stp_malloc(sizeof(value_t));
-	  val->name = stp_strdup(parameter);
-	  val->typ = STP_PARAMETER_TYPE_CURVE;
-	  val->active = STP_PARAMETER_DEFAULTED;
-	  stp_list_item_create(list, NULL, val);
-	  val->value.cval = stp_curve_create_copy(curve);
-	}
+      value_t *val = create_value(v, key, STP_PARAMETER_TYPE_CURVE,
+				  STP_PARAMETER_DEFAULTED);
+      val->value.cval = stp_curve_create_copy(curve);
     }
   stp_set_verified(v, 0);
 }
 
+void
+stp_clear_curve_parameter_k(stp_vars_t *v, stp_parameter_key_t key)
+{
+  stp_set_curve_parameter_k(v, key, NULL);
+}
+
 void
 stp_clear_curve_parameter(stp_vars_t *v, const char *parameter)
 {
@@ -740,77 +988,75 @@ stp_clear_curve_parameter(stp_vars_t *v, const char *parameter)
 }
 
 const stp_curve_t *
-stp_get_curve_parameter(const stp_vars_t *v, const char *parameter)
+stp_get_curve_parameter_k(const stp_vars_t *v, stp_parameter_key_t key)
 {
-  const stp_list_t *list = v->params[STP_PARAMETER_TYPE_CURVE];
-  const value_t *val;
-  const stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  if (item)
-    {
-      val = (value_t *) stp_list_item_get_data(item);
-      return val->value.cval;
-    }
+  const value_t *val = find_value(v, key, STP_PARAMETER_TYPE_CURVE);
+  if (val)
+    return val->value.cval;
   else
     return NULL;
 }
 
+const stp_curve_t *
+stp_get_curve_parameter(const stp_vars_t *v, const char *parameter)
+{
+  return stp_get_curve_parameter_k(v, find_parameter_key(parameter));
+}
+
 void
-stp_set_array_parameter(stp_vars_t *v, const char *parameter,
-			const stp_array_t *array)
+stp_set_array_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+			  const stp_array_t *array)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_ARRAY];
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
+  value_t *val = find_value(v, key, STP_PARAMETER_TYPE_ARRAY);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_array_parameter(0x%p, %s)\n",
-	       (const void *) v, parameter);
-  if (array)
+	       (const void *) v, stp_parameter_key_name(key));
+  if (array && valid_key(key))
     {
-      value_t *val;
-      if (item)
+      if (val)
 	{
-	  val = (value_t *) stp_list_item_get_data(item);
 	  if (val->active == STP_PARAMETER_DEFAULTED)
 	    val->active = STP_PARAMETER_ACTIVE;
 	  stp_array_destroy(val->value.aval);
 	}
       else
-	{
-	  val = stp_malloc(sizeof(value_t));
-	  val->name = stp_strdup(parameter);
-	  val->typ = STP_PARAMETER_TYPE_ARRAY;
-	  val->active = STP_PARAMETER_ACTIVE;
-	  stp_list_item_create(list, NULL, val);
-	}
+	val = create_value(v, key, STP_PARAMETER_TYPE_ARRAY,
+			   STP_PARAMETER_ACTIVE);
       val->value.aval = stp_array_create_copy(array);
     }
-  else if (item)
-    stp_list_item_destroy(list, item);
+  else if (val)
+    destroy_value(v, val);
   stp_set_verified(v, 0);
 }
 
+void
+stp_set_array_parameter(stp_vars_t *v, const char *parameter,
+			const stp_array_t *array)
+{
+  stp_set_array_parameter_k(v, stp_parameter_intern(parameter), array);
+}
+
 void
 stp_set_default_array_parameter(stp_vars_t *v, const char *parameter,
 				const stp_array_t *array)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_ARRAY];
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
+  stp_parameter_key_t key = stp_parameter_intern(parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_default_array_parameter(0x%p, %s)\n",
 	       (const void *) v, parameter);
-  if (!item)
+  if (array && valid_key(key) && !find_value(v, key, STP_PARAMETER_TYPE_ARRAY))
     {
-      if (array)
-	{
-	  value_t *val;
-	  val = stp_malloc(sizeof(value_t));
-	  val->name = stp_strdup(parameter);
-	  val->typ = STP_PARAMETER_TYPE_ARRAY;
-	  val->active = STP_PARAMETER_DEFAULTED;
-	  stp_list_item_create(list, NULL, val);
-	  val->value.aval = stp_array_create_copy(array);
-	}
+      value_t *val = create_value(v, key, STP_PARAMETER_TYPE_ARRAY,
+				  STP_PARAMETER_DEFAULTED);
+      val->value.aval = stp_array_create_copy(array);
     }
   stp_set_verified(v, 0);
 }
 
+void
+stp_clear_array_parameter_k(stp_vars_t *v, stp_parameter_key_t key)
+{
+  stp_set_array_parameter_k(v, key, NULL);
+}
+
 void
 stp_clear_array_parameter(stp_vars_t *v, const char *parameter)
 {
@@ -818,91 +1064,115 @@ stp_clear_array_parameter(stp_vars_t *v, const char *parameter)
 }
 
 const stp_array_t *
-stp_get_array_parameter(const stp_vars_t *v, const char *parameter)
+stp_get_array_parameter_k(const stp_vars_t *v, stp_parameter_key_t key)
 {
-  const stp_list_t *list = v->params[STP_PARAMETER_TYPE_ARRAY];
-  const value_t *val;
-  const stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  if (item)
-    {
-      val = (const value_t *) stp_list_item_get_data(item);
-      return val->value.aval;
-    }
+  const value_t *val = find_value(v, key, STP_PARAMETER_TYPE_ARRAY);
+  if (val)
+    return val->value.aval;
   else
     return NULL;
 }
 
-void
-stp_set_int_parameter(stp_vars_t *v, const char *parameter, int ival)
+const stp_array_t *
+stp_get_array_parameter(const stp_vars_t *v, const char *parameter)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_INT];
-  value_t *val;
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  stp_dprintf(STP_DBG_VARS, v, "stp_set_int_parameter(0x%p, %s, %d)\n",
-	       (const void *) v, parameter, ival);
-  if (item)
+  return stp_get_array_parameter_k(v, find_parameter_key(parameter));
+}
+
+/*
+ * Find or create a value for a scalar parameter.  Setting a parameter
+ * that was only defaulted makes it active.
+ */
+static value_t *
+set_scalar_parameter(stp_vars_t *v, stp_parameter_key_t key,
+		     stp_parameter_type_t typ)
+{
+  value_t *val = find_value(v, key, typ);
+  if (val)
     {
-      val = (value_t *) stp_list_item_get_data(item);
       if (val->active == STP_PARAMETER_DEFAULTED)
 	val->active = STP_PARAMETER_ACTIVE;
     }
-  else
-    {
-      val = stp_malloc(sizeof(value_t));
-      val->name = stp_strdup(parameter);
-      val->typ = STP_PARAMETER_TYPE_INT;
-      val->active = STP_PARAMETER_ACTIVE;
-      stp_list_item_create(list, NULL, val);
-    }
-  val->value.ival = ival;
+  else if (valid_key(key))
+    val = create_value(v, key, typ, STP_PARAMETER_ACTIVE);
   stp_set_verified(v, 0);
+  return val;
+}
+
+static value_t *
+set_default_scalar_parameter(stp_vars_t *v, stp_parameter_key_t key,
+			     stp_parameter_type_t typ)
+{
+  value_t *val = NULL;
+  if (valid_key(key) && !find_value(v, key, typ))
+    val = create_value(v, key, typ, STP_PARAMETER_DEFAULTED);
+  stp_set_verified(v, 0);
+  return val;
+}
+
+void
+stp_set_int_parameter_k(stp_vars_t *v, stp_parameter_key_t key, int ival)
+{
+  value_t *val;
+  stp_dprintf(STP_DBG_VARS, v, "stp_set_int_parameter(0x%p, %s, %d)\n",
+	       (const void *) v, stp_parameter_key_name(key), ival);
+  val = set_scalar_parameter(v, key, STP_PARAMETER_TYPE_INT);
+  if (val)
+    val->value.ival = ival;
+}
+
+void
+stp_set_int_parameter(stp_vars_t *v, const char *parameter, int ival)
+{
+  stp_set_int_parameter_k(v, stp_parameter_intern(parameter), ival);
 }
 
 void
 stp_set_default_int_parameter(stp_vars_t *v, const char *parameter, int ival)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_INT];
   value_t *val;
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_default_int_parameter(0x%p, %s, %d)\n",
 	       (const void *) v, parameter, ival);
-  if (!item)
-    {
-      val = stp_malloc(sizeof(value_t));
-      val->name = stp_strdup(parameter);
-      val->typ = STP_PARAMETER_TYPE_INT;
-      val->active = STP_PARAMETER_DEFAULTED;
-      stp_list_item_create(list, NULL, val);
-      val->value.ival = ival;
-    }
+  val = set_default_scalar_parameter(v, stp_parameter_intern(parameter),
+				     STP_PARAMETER_TYPE_INT);
+  if (val)
+    val->value.ival = ival;
+}
+
+void
+stp_clear_int_parameter_k(stp_vars_t *v, stp_parameter_key_t key)
+{
+  stp_dprintf(STP_DBG_VARS, v, "stp_clear_int_parameter(0x%p, %s)\n",
+	       (const void *) v, stp_parameter_key_name(key));
+  clear_parameter(v, key, STP_PARAMETER_TYPE_INT);
   stp_set_verified(v, 0);
 }
 
 void
 stp_clear_int_parameter(stp_vars_t *v, const char *parameter)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_INT];
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_clear_int_parameter(0x%p, %s)\n",
 	       (const void *) v, parameter);
-  if (item)
-    stp_list_item_destroy(list, item);
+  clear_parameter(v, find_parameter_key(parameter), STP_PARAMETER_TYPE_INT);
   stp_set_verified(v, 0);
 }
 
-int
-stp_get_int_parameter(const stp_vars_t *v, const char *parameter)
+/*
+ * The name is needed only if the parameter isn't set; if the caller
+ * passes NULL, it is looked up from the key then.
+ */
+static int
+get_int_parameter(const stp_vars_t *v, stp_parameter_key_t key,
+		  const char *parameter)
 {
-  const stp_list_t *list = v->params[STP_PARAMETER_TYPE_INT];
-  const stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  if (item)
-    {
-      const value_t *val = (const value_t *) stp_list_item_get_data(item);
-      return val->value.ival;
-    }
+  const value_t *val = find_value(v, key, STP_PARAMETER_TYPE_INT);
+  if (val)
+    return val->value.ival;
   else
     {
       stp_parameter_t desc;
+      if (!parameter)
+	parameter = stp_parameter_key_name(key);
       stp_describe_parameter(v, parameter, &desc);
       if (desc.p_type == STP_PARAMETER_TYPE_INT)
 	{
@@ -921,84 +1191,79 @@ stp_get_int_parameter(const stp_vars_t *v, const char *parameter)
     }
 }
 
+int
+stp_get_int_parameter_k(const stp_vars_t *v, stp_parameter_key_t key)
+{
+  return get_int_parameter(v, key, NULL);
+}
+
+int
+stp_get_int_parameter(const stp_vars_t *v, const char *parameter)
+{
+  return get_int_parameter(v, find_parameter_key(parameter), parameter);
+}
+
 void
-stp_set_boolean_parameter(stp_vars_t *v, const char *parameter, int ival)
+stp_set_boolean_parameter_k(stp_vars_t *v, stp_parameter_key_t key, int ival)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_BOOLEAN];
   value_t *val;
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_boolean_parameter(0x%p, %s, %d)\n",
-	       (const void *) v, parameter, ival);
-  if (item)
-    {
-      val = (value_t *) stp_list_item_get_data(item);
-      if (val->active == STP_PARAMETER_DEFAULTED)
-	val->active = STP_PARAMETER_ACTIVE;
-    }
-  else
-    {
-      val = stp_malloc(sizeof(value_t));
-      val->name = stp_strdup(parameter);
-      val->typ = STP_PARAMETER_TYPE_BOOLEAN;
-      val->active = STP_PARAMETER_ACTIVE;
-      stp_list_item_create(list, NULL, val);
-    }
-  if (ival)
-    val->value.ival = 1;
-  else
-    val->value.ival = 0;
-  stp_set_verified(v, 0);
+	       (const void *) v, stp_parameter_key_name(key), ival);
+  val = set_scalar_parameter(v, key, STP_PARAMETER_TYPE_BOOLEAN);
+  if (val)
+    val->value.ival = ival ? 1 : 0;
+}
+
+void
+stp_set_boolean_parameter(stp_vars_t *v, const char *parameter, int ival)
+{
+  stp_set_boolean_parameter_k(v, stp_parameter_intern(parameter), ival);
 }
 
 void
 stp_set_default_boolean_parameter(stp_vars_t *v, const char *parameter,
 				  int ival)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_BOOLEAN];
   value_t *val;
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_default_boolean_parameter(0x%p, %s, %d)\n",
 	       (const void *) v, parameter, ival);
-  if (!item)
-    {
-      val = stp_malloc(sizeof(value_t));
-      val->name = stp_strdup(parameter);
-      val->typ = STP_PARAMETER_TYPE_BOOLEAN;
-      val->active = STP_PARAMETER_DEFAULTED;
-      stp_list_item_create(list, NULL, val);
-      if (ival)
-	val->value.ival = 1;
-      else
-	val->value.ival = 0;
-    }
+  val = set_default_scalar_parameter(v, stp_parameter_intern(parameter),
+				     STP_PARAMETER_TYPE_BOOLEAN);
+  if (val)
+    val->value.ival = ival ? 1 : 0;
+}
+
+void
+stp_clear_boolean_parameter_k(stp_vars_t *v, stp_parameter_key_t key)
+{
+  stp_dprintf(STP_DBG_VARS, v, "stp_clear_boolean_parameter(0x%p, %s)\n",
+	       (const void *) v, stp_parameter_key_name(key));
+  clear_parameter(v, key, STP_PARAMETER_TYPE_BOOLEAN);
   stp_set_verified(v, 0);
 }
 
 void
 stp_clear_boolean_parameter(stp_vars_t *v, const char *parameter)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_BOOLEAN];
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_clear_boolean_parameter(0x%p, %s)\n",
 	       (const void *) v, parameter);
-  if (item)
-    stp_list_item_destroy(list, item);
+  clear_parameter(v, find_parameter_key(parameter),
+		  STP_PARAMETER_TYPE_BOOLEAN);
   stp_set_verified(v, 0);
 }
 
-int
-stp_get_boolean_parameter(const stp_vars_t *v, const char *parameter)
+static int
+get_boolean_parameter(const stp_vars_t *v, stp_parameter_key_t key,
+		      const char *parameter)
 {
-  const stp_list_t *list = v->params[STP_PARAMETER_TYPE_BOOLEAN];
-  const stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  if (item)
-    {
-      const value_t *val = (const value_t *) stp_list_item_get_data(item);
-      return val->value.ival;
-    }
+  const value_t *val = find_value(v, key, STP_PARAMETER_TYPE_BOOLEAN);
+  if (val)
+    return val->value.ival;
   else
     {
       stp_parameter_t desc;
+      if (!parameter)
+	parameter = stp_parameter_key_name(key);
       stp_describe_parameter(v, parameter, &desc);
       if (desc.p_type == STP_PARAMETER_TYPE_BOOLEAN)
 	{
@@ -1017,78 +1282,80 @@ stp_get_boolean_parameter(const stp_vars_t *v, const char *parameter)
     }
 }
 
+int
+stp_get_boolean_parameter_k(const stp_vars_t *v, stp_parameter_key_t key)
+{
+  return get_boolean_parameter(v, key, NULL);
+}
+
+int
+stp_get_boolean_parameter(const stp_vars_t *v, const char *parameter)
+{
+  return get_boolean_parameter(v, find_parameter_key(parameter), parameter);
+}
+
 void
-stp_set_dimension_parameter(stp_vars_t *v, const char *parameter, stp_dimension_t sval)
+stp_set_dimension_parameter_k(stp_vars_t *v, stp_parameter_key_t key,
+			      stp_dimension_t sval)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_DIMENSION];
   value_t *val;
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_dimension_parameter(0x%p, %s, %f)\n",
-	       (const void *) v, parameter, sval);
-  if (item)
-    {
-      val = (value_t *) stp_list_item_get_data(item);
-      if (val->active == STP_PARAMETER_DEFAULTED)
-	val->active = STP_PARAMETER_ACTIVE;
-    }
-  else
-    {
-      val = stp_malloc(sizeof(value_t));
-      val->name = stp_strdup(parameter);
-      val->typ = STP_PARAMETER_TYPE_DIMENSION;
-      val->active = STP_PARAMETER_ACTIVE;
-      stp_list_item_create(list, NULL, val);
-    }
-  val->value.sval = sval;
-  stp_set_verified(v, 0);
+	       (const void *) v, stp_parameter_key_name(key), sval);
+  val = set_scalar_parameter(v, key, STP_PARAMETER_TYPE_DIMENSION);
+  if (val)
+    val->value.sval = sval;
+}
+
+void
+stp_set_dimension_parameter(stp_vars_t *v, const char *parameter, stp_dimension_t sval)
+{
+  stp_set_dimension_parameter_k(v, stp_parameter_intern(parameter), sval);
 }
 
 void
 stp_set_default_dimension_parameter(stp_vars_t *v, const char *parameter,
 				    stp_dimension_t sval)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_DIMENSION];
   value_t *val;
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_default_dimension_parameter(0x%p, %s, %f)\n",
 	       (const void *) v, parameter, sval);
-  if (!item)
-    {
-      val = stp_malloc(sizeof(value_t));
-      val->name = stp_strdup(parameter);
-      val->typ = STP_PARAMETER_TYPE_DIMENSION;
-      val->active = STP_PARAMETER_DEFAULTED;
-      stp_list_item_create(list, NULL, val);
-      val->value.sval = sval;
-    }
+  val = set_default_scalar_parameter(v, stp_parameter_intern(parameter),
+				     STP_PARAMETER_TYPE_DIMENSION);
+  if (val)
+    val->value.sval = sval;
+}
+
+void
+stp_clear_dimension_parameter_k(stp_vars_t *v, stp_parameter_key_t key)
+{
+  stp_dprintf(STP_DBG_VARS, v, "stp_clear_dimension_parameter(0x%p, %s)\n",
+	       (const void *) v, stp_parameter_key_name(key));
+  clear_parameter(v, key, STP_PARAMETER_TYPE_DIMENSION);
   stp_set_verified(v, 0);
 }
 
 void
 stp_clear_dimension_parameter(stp_vars_t *v, const char *parameter)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_DIMENSION];
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_clear_dimension_parameter(0x%p, %s)\n",
 	       (const void *) v, parameter);
-  if (item)
-    stp_list_item_destroy(list, item);
+  clear_parameter(v, find_parameter_key(parameter),
+		  STP_PARAMETER_TYPE_DIMENSION);
   stp_set_verified(v, 0);
 }
 
-stp_dimension_t
-stp_get_dimension_parameter(const stp_vars_t *v, const char *parameter)
+static stp_dimension_t
+get_dimension_parameter(const stp_vars_t *v, stp_parameter_key_t key,
+			const char *parameter)
 {
-  const stp_list_t *list = v->params[STP_PARAMETER_TYPE_DIMENSION];
-  const stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  if (item)
-    {
-      const value_t *val = (const value_t *) stp_list_item_get_data(item);
-      return val->value.sval;
-    }
+  const value_t *val = find_value(v, key, STP_PARAMETER_TYPE_DIMENSION);
+  if (val)
+    return val->value.sval;
   else
     {
       stp_parameter_t desc;
+      if (!parameter)
+	parameter = stp_parameter_key_name(key);
       stp_describe_parameter(v, parameter, &desc);
       if (desc.p_type == STP_PARAMETER_TYPE_DIMENSION)
 	{
@@ -1107,78 +1374,78 @@ stp_get_dimension_parameter(const stp_vars_t *v, const char *parameter)
     }
 }
 
+stp_dimension_t
+stp_get_dimension_parameter_k(const stp_vars_t *v, stp_parameter_key_t key)
+{
+  return get_dimension_parameter(v, key, NULL);
+}
+
+stp_dimension_t
+stp_get_dimension_parameter(const stp_vars_t *v, const char *parameter)
+{
+  return get_dimension_parameter(v, find_parameter_key(parameter), parameter);
+}
+
 void
-stp_set_float_parameter(stp_vars_t *v, const char *parameter, double dval)
+stp_set_float_parameter_k(stp_vars_t *v, stp_parameter_key_t key, double dval)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_DOUBLE];
   value_t *val;
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_float_parameter(0x%p, %s, %f)\n",
-	       (const void *) v, parameter, dval);
-  if (item)
-    {
-      val = (value_t *) stp_list_item_get_data(item);
-      if (val->active == STP_PARAMETER_DEFAULTED)
-	val->active = STP_PARAMETER_ACTIVE;
-    }
-  else
-    {
-      val = stp_malloc(sizeof(value_t));
-      val->name = stp_strdup(parameter);
-      val->typ = STP_PARAMETER_TYPE_DOUBLE;
-      val->active = STP_PARAMETER_ACTIVE;
-      stp_list_item_create(list, NULL, val);
-    }
-  val->value.dval = dval;
-  stp_set_verified(v, 0);
+	       (const void *) v, stp_parameter_key_name(key), dval);
+  val = set_scalar_parameter(v, key, STP_PARAMETER_TYPE_DOUBLE);
+  if (val)
+    val->value.dval = dval;
+}
+
+void
+stp_set_float_parameter(stp_vars_t *v, const char *parameter, double dval)
+{
+  stp_set_float_parameter_k(v, stp_parameter_intern(parameter), dval);
 }
 
 void
 stp_set_default_float_parameter(stp_vars_t *v, const char *parameter,
 				double dval)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_DOUBLE];
   value_t *val;
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_set_default_float_parameter(0x%p, %s, %f)\n",
 	       (const void *) v, parameter, dval);
-  if (!item)
-    {
-      val = stp_malloc(sizeof(value_t));
-      val->name = stp_strdup(parameter);
-      val->typ = STP_PARAMETER_TYPE_DOUBLE;
-      val->active = STP_PARAMETER_DEFAULTED;
-      stp_list_item_create(list, NULL, val);
-      val->value.dval = dval;
-    }
+  val = set_default_scalar_parameter(v, stp_parameter_intern(parameter),
+				     STP_PARAMETER_TYPE_DOUBLE);
+  if (val)
+    val->value.dval = dval;
+}
+
+void
+stp_clear_float_parameter_k(stp_vars_t *v, stp_parameter_key_t key)
+{
+  stp_dprintf(STP_DBG_VARS, v, "stp_clear_float_parameter(0x%p, %s)\n",
+	       (const void *) v, stp_parameter_key_name(key));
+  clear_parameter(v, key, STP_PARAMETER_TYPE_DOUBLE);
   stp_set_verified(v, 0);
 }
 
 void
 stp_clear_float_parameter(stp_vars_t *v, const char *parameter)
 {
-  stp_list_t *list = v->params[STP_PARAMETER_TYPE_DOUBLE];
-  stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
   stp_dprintf(STP_DBG_VARS, v, "stp_clear_float_parameter(0x%p, %s)\n",
 	       (const void *) v, parameter);
-  if (item)
-    stp_list_item_destroy(list, item);
+  clear_parameter(v, find_parameter_key(parameter), STP_PARAMETER_TYPE_DOUBLE);
   stp_set_verified(v, 0);
 }
 
-double
-stp_get_float_parameter(const stp_vars_t *v, const char *parameter)
+static double
+get_float_parameter(const stp_vars_t *v, stp_parameter_key_t key,
+		    const char *parameter)
 {
-  const stp_list_t *list = v->params[STP_PARAMETER_TYPE_DOUBLE];
-  const stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-  if (item)
-    {
-      const value_t *val = (value_t *) stp_list_item_get_data(item);
-      return val->value.dval;
-    }
+  const value_t *val = find_value(v, key, STP_PARAMETER_TYPE_DOUBLE);
+  if (val)
+    return val->value.dval;
   else
     {
       stp_parameter_t desc;
+      if (!parameter)
+	parameter = stp_parameter_key_name(key);
       stp_describe_parameter(v, parameter, &desc);
       if (desc.p_type == STP_PARAMETER_TYPE_DOUBLE)
 	{
@@ -1197,6 +1464,18 @@ stp_get_float_parameter(const stp_vars_t *v, const char *parameter)
     }
 }
 
+double
+stp_get_float_parameter_k(const stp_vars_t *v, stp_parameter_key_t key)
+{
+  return get_float_parameter(v, key, NULL);
+}
+
+double
+stp_get_float_parameter(const stp_vars_t *v, const char *parameter)
+{
+  return get_float_parameter(v, find_parameter_key(parameter), parameter);
+}
+
 void
 stp_scale_float_parameter(stp_vars_t *v, const char *parameter,
 			  double scale)
@@ -1259,24 +1538,27 @@ stp_clear_parameter(stp_vars_t *v, const char *parameter, stp_parameter_type_t t
 }
 
 
+int
+stp_check_parameter_k(const stp_vars_t *v,
+		      stp_parameter_key_t key,
+		      stp_parameter_activity_t active,
+		      stp_parameter_type_t p_type)
+{
+  const value_t *val = find_value(v, key, p_type);
+  if (val && active <= val->active)
+    return 1;
+  else
+    return 0;
+}
+
 int
 stp_check_parameter(const stp_vars_t *v,
 		    const char *parameter,
 		    stp_parameter_activity_t active,
 		    stp_parameter_type_t p_type)
 {
-  if (p_type >= STP_PARAMETER_TYPE_STRING_LIST &&
-      p_type < STP_PARAMETER_TYPE_INVALID)
-    {
-      const stp_list_t *list = v->params[p_type];
-      const stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-      if (item &&
-	  active <= ((const value_t *) stp_list_item_get_data(item))->active)
-	return 1;
-      else
-	return 0;
-    }
-  return 0;
+  return stp_check_parameter_k(v, find_parameter_key(parameter), active,
+			       p_type);
 }
 
 #define CHECK_FUNCTION(type, index)					\
@@ -1285,6 +1567,14 @@ stp_check_##type##_parameter(const stp_vars_t *v, const char *parameter, \
 			     stp_parameter_activity_t active)		\
 {									\
   return stp_check_parameter(v, parameter, active, index);		\
+}									\
+									\
+int									\
+stp_check_##type##_parameter_k(const stp_vars_t *v,			\
+			       stp_parameter_key_t key,			\
+			       stp_parameter_activity_t active)		\
+{									\
+  return stp_check_parameter_k(v, key, active, index);			\
 }
 
 CHECK_FUNCTION(string, STP_PARAMETER_TYPE_STRING_LIST)
@@ -1338,17 +1628,11 @@ stp_parameter_activity_t
 stp_get_parameter_active(const stp_vars_t *v, const char *parameter,
 			 stp_parameter_type_t p_type)
 {
-  if (p_type >= STP_PARAMETER_TYPE_STRING_LIST &&
-      p_type < STP_PARAMETER_TYPE_INVALID)
-    {
-      const stp_list_t *list = v->params[p_type];
-      const stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-      if (item)
-	return ((const value_t *) stp_list_item_get_data(item))->active;
-      else
-	return 0;
-    }
-  return 0;
+  const value_t *val = find_value(v, find_parameter_key(parameter), p_type);
+  if (val)
+    return val->active;
+  else
+    return 0;
 }
 
 #define GET_PARAMETER_ACTIVE_FUNCTION(type, index)			\
@@ -1374,15 +1658,10 @@ stp_set_parameter_active(stp_vars_t *v,
 			 stp_parameter_activity_t active,
 			 stp_parameter_type_t p_type)
 {
-  if (p_type >= STP_PARAMETER_TYPE_STRING_LIST &&
-      p_type < STP_PARAMETER_TYPE_INVALID)
-    {
-      const stp_list_t *list = v->params[p_type];
-      const stp_list_item_t *item = stp_list_get_item_by_name(list, parameter);
-      if (item && (active == STP_PARAMETER_ACTIVE ||
-		   active == STP_PARAMETER_INACTIVE))
-	((value_t *) stp_list_item_get_data(item))->active = active;
-    }
+  value_t *val = find_value(v, find_parameter_key(parameter), p_type);
+  if (val && (active == STP_PARAMETER_ACTIVE ||
+	      active == STP_PARAMETER_INACTIVE))
+    val->active = active;
 }
 
 #define SET_PARAMETER_ACTIVE_FUNCTION(type, index)			\
@@ -1456,6 +1735,7 @@ stp_vars_copy(stp_vars_t *vd, const stp_vars_t *vs)
       stp_list_destroy(vd->params[i]);
       vd->params[i] = copy_value_list(vs->params[i]);
     }
+  index_values(vd);
   stp_list_destroy(vd->internal_data);
   vd->internal_data = copy_compdata_list(vs->internal_data);
   stp_set_verified(vd, stp_get_verified(vs));
@@ -1564,7 +1844,10 @@ stp_prune_inactive_options(stp_vars_t *v)
 	  value_t *var = (value_t *)stp_list_item_get_data(item);
 	  if (var->active < STP_PARAMETER_DEFAULTED ||
 	      !(stp_parameter_find(params, var->name)))
-	    stp_list_item_destroy(list, item);
+	    {
+	      unlink_value(v, var);
+	      stp_list_item_destroy(list, item);
+	    }
 	  item = next;
 	}
     }
@@ -27,6 +27,7 @@
 #include <config.h>
 #endif
 #include <string.h>
+#include <stdlib.h>
 #include <gutenprint/gutenprint.h>
 #include "gutenprint-internal.h"
 #include <gutenprint/gutenprint-intl-internal.h>
@@ -331,6 +332,21 @@ calculate_raw_row_parameters(raw_t *w,		/* I - weave parameters */
 
 /* COOKED WEAVE */
 
+/*
+ * The raw weave repeats every separation * jets rows: advancing a row
+ * by that much advances its raw pass by oversampling * separation and
+ * leaves its jet unchanged.  One period of (row, subpass) -> (pass, jet)
+ * is computed up front, so that looking up a row doesn't need to search
+ * for the pass that prints it.  Setting STP_WEAVE_TABLE=0 computes every
+ * row directly instead.
+ */
+typedef struct row_entry {
+	int pass;		/* Raw pass, relative to the period */
+	int jet;
+} row_entry_t;
+
+#define WEAVE_TABLE_MAX_ENTRIES (1 << 20)
+
 typedef struct cooked {
 	raw_t rw;
 	int first_row_printed;
@@ -345,6 +361,9 @@ typedef struct cooked {
 	int *stagger_premap;
 	int *pass_postmap;
 	int *stagger_postmap;
+
+	int period;			/* Rows per period of the raw weave */
+	row_entry_t *row_table;		/* period * oversampling entries */
 } cooked_t;
 
 typedef struct startmap {
@@ -578,6 +597,53 @@ calculate_pass_map(stp_vars_t *v,
 	}
 }
 
+static void
+initialize_row_table(cooked_t *w)
+{
+	int subpass, row;
+	const char *sval = getenv("STP_WEAVE_TABLE");
+
+	w->period = w->rw.separation * w->rw.jets;
+	w->row_table = NULL;
+	if (sval && atoi(sval) == 0)
+		return;
+	if (w->period > WEAVE_TABLE_MAX_ENTRIES / w->rw.oversampling)
+		return;
+	w->row_table = stp_malloc(sizeof(row_entry_t) * w->period *
+				  w->rw.oversampling);
+	for (subpass = 0; subpass < w->rw.oversampling; subpass++) {
+		row_entry_t *entry = w->row_table + subpass * w->period;
+		for (row = 0; row < w->period; row++) {
+			int startrow;
+			calculate_raw_row_parameters(&w->rw, row, subpass,
+						     &entry[row].pass,
+						     &entry[row].jet, &startrow);
+		}
+	}
+}
+
+static void
+lookup_raw_row_parameters(cooked_t *w,		/* I - weave parameters */
+			  int row,		/* I - row number */
+			  int subpass,		/* I - subpass number */
+			  int *pass,		/* O - pass number */
+			  int *jet,		/* O - jet number in pass */
+			  int *startrow)	/* O - starting row of pass */
+{
+	if (w->row_table && row >= 0 &&
+	    subpass >= 0 && subpass < w->rw.oversampling) {
+		int band = row / w->period;
+		const row_entry_t *entry =
+		  w->row_table + subpass * w->period + row - band * w->period;
+		*pass = entry->pass +
+		  band * w->rw.oversampling * w->rw.separation;
+		*jet = entry->jet;
+		*startrow = row - entry->jet * w->rw.separation;
+	} else
+		calculate_raw_row_parameters(&w->rw, row, subpass,
+					     pass, jet, startrow);
+}
+
 static void *				/* O - weave parameter block */
 initialize_weave_params(int separation,		/* I - jet separation */
                         int jets,		/* I - number of jets */
@@ -594,6 +660,7 @@ initialize_weave_params(int separation,		/* I - jet separation */
 	if (w) {
 		initialize_raw_weave(&w->rw, separation, jets, oversample, strategy, v);
 		calculate_pass_map(v, w, pageheight, firstrow, lastrow);
+		initialize_row_table(w);
 	}
 	return w;
 }
@@ -607,6 +674,7 @@ stpi_destroy_weave_params(void *vw)
 	if (w->stagger_premap) stp_free(w->stagger_premap);
 	if (w->pass_postmap) stp_free(w->pass_postmap);
 	if (w->stagger_postmap) stp_free(w->stagger_postmap);
+	if (w->row_table) stp_free(w->row_table);
 	stp_free(w);
 }
 
@@ -627,9 +695,8 @@ stpi_calculate_row_parameters(void *vw,		/* I - weave parameters */
 
 	STPI_ASSERT(row >= w->first_row_printed, w->rw.v);
 	STPI_ASSERT(row <= w->last_row_printed, w->rw.v);
-	calculate_raw_row_parameters(&w->rw,
-	                             row + w->rw.separation * w->rw.jets,
-	                             subpass, &raw_pass, &jet, &startrow);
+	lookup_raw_row_parameters(w, row + w->rw.separation * w->rw.jets,
+	                          subpass, &raw_pass, &jet, &startrow);
 	startrow -= w->rw.separation * w->rw.jets;
 	jetsused = w->rw.jets;
 	phantomrows = 0;
@@ -67,9 +67,59 @@ static const char* stpi_printer_long_namefunc(const void *item);
 
 static stp_list_t *printer_list = NULL;
 
+/*
+ * Unless STP_LAZY_PRINTERS is set to 0, the printer files of the
+ * family modules aren't parsed at startup.  Each one is summed up
+ * instead in a small index: for each printer, its identity (driver,
+ * names, model...), the name of the parameter set it uses, and
+ * whether it has any settings of its own.  That is all the printer
+ * list and the lookup functions need, and the printers point into
+ * the index for their strings.  If the XML cache is in use, the index
+ * is kept there, and the file isn't read at all.
+ *
+ * The first time a printer's default settings are needed, the
+ * parameter sets of its file are read.  They are small and shared by
+ * the whole family, so they are kept.  The few printers that have
+ * settings of their own also need their own node, which is read from
+ * the file each time.  Either way, the parsed file is freed as soon as
+ * the settings have been read from it.
+ */
+typedef struct
+{
+  char *name;
+  int params_loaded;
+} stpi_printer_file_t;
+
+/*
+ * One printer in an index.  The strings are offsets from the start of
+ * the index, or 0 if absent.
+ */
+typedef struct
+{
+  unsigned family;
+  unsigned driver;
+  unsigned long_name;
+  unsigned manufacturer;
+  unsigned device_id;
+  unsigned comment;
+  unsigned parameters;
+  int model;
+  int has_settings;
+} stpi_printer_index_t;
+
+/*
+ * An index is a count, followed by that many entries and then by the
+ * strings.
+ */
+#define PRINTER_INDEX_ENTRIES(index) \
+  ((const stpi_printer_index_t *) ((const unsigned *) (index) + 1))
+
+static stp_list_t *printer_file_list = NULL;
+static int lazy_printers = -1;
+
 struct stp_printer
 {
-  const char *driver;
+  char       *driver;
   char       *long_name;        /* Long name for UI */
   char       *family;           /* Printer family */
   char	     *manufacturer;	/* Printer manufacturer */
@@ -78,7 +128,11 @@ struct stp_printer
   int        model;             /* Model number */
   int	     vars_initialized;
   const stp_printfuncs_t *printfuncs;
-  stp_vars_t *printvars;
+  stp_vars_t *printvars;	/* NULL until loaded */
+  stpi_printer_file_t *file;	/* File to load printvars from */
+  const char *parameters;	/* Parameter set, if loaded from a file */
+  int        has_settings;	/* Has settings of its own in the file */
+  int        indexed;		/* Strings belong to the file's index */
 };
 
 static void
@@ -138,11 +192,17 @@ static void
 stpi_printer_freefunc(void *item)
 {
   stp_printer_t *printer = (stp_printer_t *) item;
+  if (printer->indexed)
+    {
+      stp_free(printer);
+      return;
+    }
   if (printer->comment)
     {
       stp_free(printer->comment);
       printer->comment = NULL;
     }
+  stp_free(printer->driver);
   stp_free(printer->long_name);
   stp_free(printer->family);
   stp_free(printer);
@@ -433,12 +493,16 @@ stp_initialize_printer_defaults(void)
     }
 }
 
+static void stpi_printer_load_printvars(stp_printer_t *printer);
+
 const stp_vars_t *
 stp_printer_get_defaults(const stp_printer_t *printer)
 {
   if (! printer->vars_initialized)
     {
       stp_printer_t *nc_printer = (stp_printer_t *) stpi_cast_safe(printer);
+      if (! nc_printer->printvars)
+	stpi_printer_load_printvars(nc_printer);
       stp_deprintf(STP_DBG_PRINTERS, "  ==>init %s\n", printer->driver);
       set_printer_defaults (nc_printer->printvars, 1, 0);
       nc_printer->vars_initialized = 1;
@@ -1130,121 +1194,250 @@ stp_printvars_create_from_xmltree(stp_mxml_node_t *printer,
 
 
 /*
- * Parse the printer node, and return the generated printer.  Returns
- * NULL on failure.
+ * Fill in the default settings of a printer, from its parameter set
+ * and from its node (if it has one).
  */
-static stp_printer_t*
-stp_printer_create_from_xmltree(stp_mxml_node_t *printer, /* The printer node */
-				const char *family,       /* Family name */
-				const stp_printfuncs_t *printfuncs)
-                                                       /* Family printfuncs */
+static void
+stp_printer_vars_from_xmltree(stp_printer_t *outprinter,
+			      const char *parameters,
+			      stp_mxml_node_t *printer) /* The printer node */
 {
-  stp_mxml_node_t *prop;	/* Temporary node pointer */
-  stp_mxml_node_t *child;
-  const char *stmp;		/* Temporary string */
-  stp_printer_t *outprinter;	/* Generated printer */
-  size_t slen = 0;
-  int
-    driver = 0,			/* Check driver */
-    long_name = 0;
+  const stp_vars_t *params;
 
-  outprinter = stp_zalloc(sizeof(stp_printer_t));
-  if (!outprinter)
-    return NULL;
-  stmp = stp_mxmlElementGetAttr(printer, "parameters");
-  if (stmp && !stp_find_params(stmp, family))
+  params = parameters ? stp_find_params(parameters, outprinter->family) : NULL;
+  if (parameters && !params)
     stp_erprintf("stp_printer_create_from_xmltree: cannot find parameters %s::%s\n",
-		 family, stmp);
-  if (stmp && stp_find_params(stmp, family))
-    outprinter->printvars = stp_vars_create_copy(stp_find_params(stmp, family));
+		 outprinter->family, parameters);
+  if (params)
+    outprinter->printvars = stp_vars_create_copy(params);
   else
     outprinter->printvars = stp_vars_create();
-  if (outprinter->printvars == NULL)
+  stp_set_driver(outprinter->printvars, outprinter->driver);
+  if (printer)
+    stp_vars_fill_from_xmltree(printer->child, outprinter->printvars);
+}
+
+static stp_mxml_node_t *
+stpi_find_printer_node(stp_mxml_node_t *doc, const char *family_name,
+		       const char *driver)
+{
+  stp_mxml_node_t *printdef = stp_xml_get_node(doc, "gutenprint", "printdef",
+					       NULL);
+  stp_mxml_node_t *family;
+  stp_mxml_node_t *printer;
+  for (family = printdef ? printdef->child : NULL; family;
+       family = family->next)
     {
-      stp_free(outprinter);
-      return NULL;
+      const char *stmp;
+      if (family->type != STP_MXML_ELEMENT ||
+	  strcmp(family->value.element.name, "family") != 0 ||
+	  !(stmp = stp_mxmlElementGetAttr(family, "name")) ||
+	  strcmp(stmp, family_name) != 0)
+	continue;
+      for (printer = family->child; printer; printer = printer->next)
+	if (printer->type == STP_MXML_ELEMENT &&
+	    !strcmp(printer->value.element.name, "printer") &&
+	    (stmp = stp_mxmlElementGetAttr(printer, "driver")) != NULL &&
+	    !strcmp(stmp, driver))
+	  return printer;
     }
+  return NULL;
+}
 
-  stmp = stp_mxmlElementGetAttr(printer, "driver");
-  stp_set_driver(outprinter->printvars, (const char *) stmp);
+static void
+stpi_add_printvars(stp_mxml_node_t *node, const char *family_name)
+{
+  stp_printvars_t *printvars =
+    stp_printvars_create_from_xmltree(node, family_name);
+  if (printvars)
+    {
+      stpi_init_printvars_list();
+      stp_list_item_create(printvars_list, NULL, printvars);
+    }
+}
 
-  outprinter->long_name = stp_strdup(stp_mxmlElementGetAttr(printer, "name"));
-  outprinter->manufacturer = stp_strdup(stp_mxmlElementGetAttr(printer, "manufacturer"));
-  outprinter->model = stp_xmlstrtol(stp_mxmlElementGetAttr(printer, "model"));
-  outprinter->family = stp_strdup((const char *) family);
-  stmp = stp_mxmlElementGetAttr(printer, "deviceid");
-  if (stmp)
-    outprinter->device_id = stp_strdup(stmp);
+/*
+ * Read the parameter sets of every family in a file.
+ */
+static void
+stpi_load_parameter_sets(stp_mxml_node_t *doc)
+{
+  stp_mxml_node_t *printdef = stp_xml_get_node(doc, "gutenprint", "printdef",
+					       NULL);
+  stp_mxml_node_t *family;
+  stp_mxml_node_t *node;
+  for (family = printdef ? printdef->child : NULL; family;
+       family = family->next)
+    {
+      const char *family_name;
+      if (family->type != STP_MXML_ELEMENT ||
+	  strcmp(family->value.element.name, "family") != 0 ||
+	  !(family_name = stp_mxmlElementGetAttr(family, "name")))
+	continue;
+      for (node = family->child; node; node = node->next)
+	if (node->type == STP_MXML_ELEMENT &&
+	    !strcmp(node->value.element.name, "parameters"))
+	  stpi_add_printvars(node, family_name);
+    }
+}
+
+static void
+stpi_printer_load_printvars(stp_printer_t *printer)
+{
+  stpi_printer_file_t *file = printer->file;
+  stp_mxml_node_t *doc = NULL;
+  stp_mxml_node_t *node = NULL;
+
+  stp_xml_init();
+  if (!file->params_loaded || printer->has_settings)
+    {
+      stp_deprintf(STP_DBG_XML, "stpi_printer_load_printvars: reading `%s'...\n",
+		   file->name);
+      doc = stpi_xml_cache_load(file->name);
+      if (doc && !file->params_loaded)
+	stpi_load_parameter_sets(doc);
+      file->params_loaded = 1;
+      if (doc && printer->has_settings)
+	node = stpi_find_printer_node(doc, printer->family, printer->driver);
+      if (printer->has_settings && !node)
+	stp_erprintf("stp_printer_get_defaults: cannot find printer %s in %s\n",
+		     printer->driver, file->name);
+    }
+  stp_printer_vars_from_xmltree(printer, printer->parameters, node);
+  if (doc)
+    stp_mxmlDelete(doc);
+  stp_xml_exit();
+}
+
+static void
+stpi_printer_file_freefunc(void *item)
+{
+  stpi_printer_file_t *file = (stpi_printer_file_t *) item;
+  stp_free(file->name);
+  stp_free(file);
+}
+
+static const char *
+stpi_printer_file_namefunc(const void *item)
+{
+  const stpi_printer_file_t *file = (const stpi_printer_file_t *) item;
+  return file->name;
+}
+
+static stpi_printer_file_t *
+stpi_get_printer_file(const char *name)
+{
+  stp_list_item_t *item;
+  stpi_printer_file_t *file;
+  if (!printer_file_list)
+    {
+      printer_file_list = stp_list_create();
+      stp_list_set_freefunc(printer_file_list, stpi_printer_file_freefunc);
+      stp_list_set_namefunc(printer_file_list, stpi_printer_file_namefunc);
+    }
+  item = stp_list_get_item_by_name(printer_file_list, name);
+  if (item)
+    return (stpi_printer_file_t *) stp_list_item_get_data(item);
+  file = stp_zalloc(sizeof(stpi_printer_file_t));
+  file->name = stp_strdup(name);
+  stp_list_item_create(printer_file_list, NULL, file);
+  return file;
+}
+
+/*
+ * The comment of a printer is the text of its node.
+ */
+static char *
+stpi_printer_comment(stp_mxml_node_t *printer)
+{
+  stp_mxml_node_t *child;
+  char *comment = NULL;
+  size_t slen = 0;
 
   child = printer->child;
   while (child)
     {
       if (child->type == STP_MXML_TEXT)
 	{
-	  if (outprinter->comment)
+	  if (comment)
 	    {
 	      size_t oslen = slen;
 	      slen += strlen(child->value.text.string);
 	      if (child->value.text.whitespace)
 		slen += 1;
-	      outprinter->comment = stp_realloc(outprinter->comment, slen + 1);
-	      (void) memset(outprinter->comment + oslen, 0, slen - oslen);
+	      comment = stp_realloc(comment, slen + 1);
+	      (void) memset(comment + oslen, 0, slen - oslen);
 	      if (child->value.text.whitespace)
-		  outprinter->comment[oslen++] = ' ';
-	      strncat(outprinter->comment + oslen,
-		      child->value.text.string, slen - oslen);
+		  comment[oslen++] = ' ';
+	      strncat(comment + oslen, child->value.text.string, slen - oslen);
 	    }
 	  else
 	    {
-	      outprinter->comment = stp_strdup(child->value.text.string);
-	      slen = strlen(outprinter->comment);
+	      comment = stp_strdup(child->value.text.string);
+	      slen = strlen(comment);
 	    }
 	}
       child = child->next;
     }
+  return comment;
+}
+
+/*
+ * Parse the printer node, and return the generated printer.  Returns
+ * NULL on failure.
+ */
+static stp_printer_t*
+stp_printer_create_from_xmltree(stp_mxml_node_t *printer, /* The printer node */
+				const char *family,       /* Family name */
+				const stp_printfuncs_t *printfuncs)
+{
+  const char *stmp;		/* Temporary string */
+  stp_printer_t *outprinter;	/* Generated printer */
 
-  if (stp_get_driver(outprinter->printvars))
-    driver = 1;
-  if (outprinter->long_name)
-    long_name = 1;
+  stmp = stp_mxmlElementGetAttr(printer, "driver");
+  if (!stmp || !stp_mxmlElementGetAttr(printer, "name") || !printfuncs)
+    return NULL;
+
+  outprinter = stp_zalloc(sizeof(stp_printer_t));
+  if (!outprinter)
+    return NULL;
+
+  outprinter->driver = stp_strdup(stmp);
+  outprinter->long_name = stp_strdup(stp_mxmlElementGetAttr(printer, "name"));
+  outprinter->manufacturer = stp_strdup(stp_mxmlElementGetAttr(printer, "manufacturer"));
+  outprinter->model = stp_xmlstrtol(stp_mxmlElementGetAttr(printer, "model"));
+  outprinter->family = stp_strdup((const char *) family);
+  stmp = stp_mxmlElementGetAttr(printer, "deviceid");
+  if (stmp)
+    outprinter->device_id = stp_strdup(stmp);
+  outprinter->comment = stpi_printer_comment(printer);
 
   outprinter->printfuncs = printfuncs;
 
-  prop = printer->child;
-  stp_vars_fill_from_xmltree(prop, outprinter->printvars);
-  if (driver && long_name && printfuncs)
-    {
-      if (stp_get_debug_level() & STP_DBG_XML)
-	{
-	  stmp = stp_mxmlElementGetAttr(printer, "driver");
-	  stp_erprintf("stp_printer_create_from_xmltree: printer: %s\n", stmp);
-	}
-      outprinter->driver = stp_get_driver(outprinter->printvars);
-      return outprinter;
-    }
-  stp_free(outprinter);
-  return NULL;
+  stp_printer_vars_from_xmltree(outprinter,
+				stp_mxmlElementGetAttr(printer, "parameters"),
+				printer);
+  if (stp_get_debug_level() & STP_DBG_XML)
+    stp_erprintf("stp_printer_create_from_xmltree: printer: %s\n",
+		 outprinter->driver);
+  return outprinter;
 }
 
 /*
- * Parse the <family> node.
+ * Find the family module for a family name.
  */
-static void
-stpi_xml_process_family(stp_mxml_node_t *family)     /* The family node */
+static stp_family_t *
+stpi_find_family(const char *family_name)
 {
   stp_list_t *family_module_list = NULL;      /* List of valid families */
   stp_list_item_t *family_module_item;        /* Current family */
-  const char *family_name;                       /* Name of family */
-  stp_mxml_node_t *printer;                         /* printer child node */
   stp_module_t *family_module_data;           /* Family module data */
   stp_family_t *family_data = NULL;  /* Family data */
-  int family_valid = 0;                       /* Is family valid? */
 
   family_module_list = stp_module_get_class(STP_MODULE_CLASS_FAMILY);
   if (!family_module_list)
-    return;
+    return NULL;
 
-  family_name = stp_mxmlElementGetAttr(family, "name");
   family_module_item = stp_list_get_start(family_module_list);
   while (family_module_item)
     {
@@ -1253,18 +1446,284 @@ stpi_xml_process_family(stp_mxml_node_t *family)     /* The family node */
       if (!strcmp(family_name, family_module_data->name))
 	{
 	  stp_deprintf(STP_DBG_XML,
-		       "stpi_xml_process_family: family module: %s\n",
+		       "stpi_find_family: family module: %s\n",
 		       family_module_data->name);
 	  family_data = family_module_data->syms;
 	  if (family_data->printer_list == NULL)
 	    family_data->printer_list = stp_list_create();
-	  family_valid = 1;
 	}
       family_module_item = stp_list_item_next(family_module_item);
     }
 
+  stp_list_destroy(family_module_list);
+  return family_data;
+}
+
+/*
+ * Growable buffers for building an index.
+ */
+typedef struct
+{
+  char *data;
+  size_t len;
+  size_t size;
+} stpi_index_buf_t;
+
+static size_t
+stpi_index_buf_add(stpi_index_buf_t *buf, const void *data, size_t len)
+{
+  size_t offset = buf->len;
+  if (buf->len + len > buf->size)
+    {
+      buf->size = (buf->len + len) * 2;
+      buf->data = stp_realloc(buf->data, buf->size);
+    }
+  memcpy(buf->data + offset, data, len);
+  buf->len += len;
+  return offset;
+}
+
+static unsigned
+stpi_index_add_string(stpi_index_buf_t *strings, const char *s)
+{
+  if (!s)
+    return 0;
+  return stpi_index_buf_add(strings, s, strlen(s) + 1);
+}
+
+/*
+ * Compute the index of a printer file.
+ */
+static void *
+printer_index_fill(const char *file, void *closure, size_t *size)
+{
+  stp_mxml_node_t *doc = stpi_xml_cache_load(file);
+  stp_mxml_node_t *printdef;
+  stp_mxml_node_t *family;
+  stp_mxml_node_t *printer;
+  stpi_index_buf_t entries = { NULL, 0, 0 };
+  stpi_index_buf_t strings = { NULL, 0, 0 };
+  unsigned count = 0;
+  size_t strings_offset;
+  char *answer;
+  stpi_printer_index_t *entry;
+  unsigned i;
+
+  if (!doc)
+    return NULL;
+  printdef = stp_xml_get_node(doc, "gutenprint", "printdef", NULL);
+  /* Offset 0 means no string, so start with a placeholder */
+  (void) stpi_index_buf_add(&strings, "", 1);
+  for (family = printdef ? printdef->child : NULL; family;
+       family = family->next)
+    {
+      const char *family_name;
+      unsigned family_offset;
+      if (family->type != STP_MXML_ELEMENT ||
+	  strcmp(family->value.element.name, "family") != 0 ||
+	  !(family_name = stp_mxmlElementGetAttr(family, "name")))
+	continue;
+      family_offset = stpi_index_add_string(&strings, family_name);
+      for (printer = family->child; printer; printer = printer->next)
+	{
+	  stpi_printer_index_t e;
+	  stp_mxml_node_t *child;
+	  char *comment;
+	  if (printer->type != STP_MXML_ELEMENT ||
+	      strcmp(printer->value.element.name, "printer") != 0 ||
+	      !stp_mxmlElementGetAttr(printer, "driver") ||
+	      !stp_mxmlElementGetAttr(printer, "name"))
+	    continue;
+	  memset(&e, 0, sizeof(e));
+	  e.family = family_offset;
+	  e.driver = stpi_index_add_string
+	    (&strings, stp_mxmlElementGetAttr(printer, "driver"));
+	  e.long_name = stpi_index_add_string
+	    (&strings, stp_mxmlElementGetAttr(printer, "name"));
+	  e.manufacturer = stpi_index_add_string
+	    (&strings, stp_mxmlElementGetAttr(printer, "manufacturer"));
+	  e.device_id = stpi_index_add_string
+	    (&strings, stp_mxmlElementGetAttr(printer, "deviceid"));
+	  e.parameters = stpi_index_add_string
+	    (&strings, stp_mxmlElementGetAttr(printer, "parameters"));
+	  comment = stpi_printer_comment(printer);
+	  e.comment = stpi_index_add_string(&strings, comment);
+	  STP_SAFE_FREE(comment);
+	  e.model = stp_xmlstrtol(stp_mxmlElementGetAttr(printer, "model"));
+	  for (child = printer->child; child; child = child->next)
+	    if (child->type == STP_MXML_ELEMENT)
+	      e.has_settings = 1;
+	  (void) stpi_index_buf_add(&entries, &e, sizeof(e));
+	  count++;
+	}
+    }
+  stp_mxmlDelete(doc);
+
+  strings_offset = sizeof(unsigned) + entries.len;
+  *size = strings_offset + strings.len;
+  answer = stp_malloc(*size);
+  memcpy(answer, &count, sizeof(unsigned));
+  if (entries.len)
+    memcpy(answer + sizeof(unsigned), entries.data, entries.len);
+  memcpy(answer + strings_offset, strings.data, strings.len);
+  entry = (stpi_printer_index_t *) (answer + sizeof(unsigned));
+  for (i = 0; i < count; i++)
+    {
+#define RELOCATE(field) if (entry[i].field) entry[i].field += strings_offset
+      RELOCATE(family);
+      RELOCATE(driver);
+      RELOCATE(long_name);
+      RELOCATE(manufacturer);
+      RELOCATE(device_id);
+      RELOCATE(comment);
+      RELOCATE(parameters);
+#undef RELOCATE
+    }
+  STP_SAFE_FREE(entries.data);
+  stp_free(strings.data);
+  return answer;
+}
+
+/*
+ * An index from the cache could be damaged; check that every string
+ * lies within it, and that the last one is terminated.
+ */
+static int
+printer_index_valid(const char *index, size_t size)
+{
+  const stpi_printer_index_t *entry = PRINTER_INDEX_ENTRIES(index);
+  unsigned count;
+  size_t strings_offset;
+  unsigned i;
+
+  if (size < sizeof(unsigned) + 1 || index[size - 1] != '\0')
+    return 0;
+  memcpy(&count, index, sizeof(unsigned));
+  if (count > (size - sizeof(unsigned)) / sizeof(stpi_printer_index_t))
+    return 0;
+  strings_offset = sizeof(unsigned) + count * sizeof(stpi_printer_index_t);
+  for (i = 0; i < count; i++)
+    {
+#define CHECK(field) \
+      if (entry[i].field && \
+	  (entry[i].field < strings_offset || entry[i].field >= size)) \
+	return 0
+      CHECK(family);
+      CHECK(driver);
+      CHECK(long_name);
+      CHECK(manufacturer);
+      CHECK(device_id);
+      CHECK(comment);
+      CHECK(parameters);
+#undef CHECK
+      if (!entry[i].family || !entry[i].driver || !entry[i].long_name)
+	return 0;
+    }
+  return 1;
+}
+
+/*
+ * Register the printers of a family module's printer file.
+ */
+void
+stpi_printer_file_register(const char *name)
+{
+  const char *index;
+  const stpi_printer_index_t *entry;
+  stpi_printer_file_t *printer_file;
+  stp_family_t *family_data = NULL;
+  const char *family_name = NULL;
+  char *file_name;
+  size_t size = 0;
+  unsigned count;
+  unsigned i;
+
+  if (lazy_printers < 0)
+    {
+      const char *sval = getenv("STP_LAZY_PRINTERS");
+      lazy_printers = !(sval && atoi(sval) == 0);
+    }
+  if (!lazy_printers)
+    {
+      stp_xml_parse_file_named(name);
+      return;
+    }
+
+  file_name = stp_path_find_file(NULL, name);
+  if (!file_name)
+    return;
+  stp_deprintf(STP_DBG_XML, "stpi_printer_file_register: indexing `%s'...\n",
+	       file_name);
+  stp_xml_init();
+  index = stpi_xml_cache_load_data(file_name, "printers", printer_index_fill,
+				   NULL, &size);
+  stp_xml_exit();
+  if (index && !printer_index_valid(index, size))
+    {
+      stp_erprintf("stpi_printer_file_register: bad index for %s\n",
+		   file_name);
+      index = NULL;
+    }
+  if (!index)
+    {
+      free(file_name);
+      return;
+    }
+
+  printer_file = stpi_get_printer_file(file_name);
+  free(file_name);
+  memcpy(&count, index, sizeof(unsigned));
+  entry = PRINTER_INDEX_ENTRIES(index);
+  for (i = 0; i < count; i++)
+    {
+      stp_printer_t *outprinter;
+      const char *this_family = index + entry[i].family;
+      if (!family_name || strcmp(family_name, this_family) != 0)
+	{
+	  family_name = this_family;
+	  family_data = stpi_find_family(family_name);
+	}
+      if (!family_data || !family_data->printfuncs)
+	continue;
+
+      outprinter = stp_zalloc(sizeof(stp_printer_t));
+#define INDEX_STRING(field) \
+      (entry[i].field ? (char *) stpi_cast_safe(index + entry[i].field) : NULL)
+      outprinter->family = INDEX_STRING(family);
+      outprinter->driver = INDEX_STRING(driver);
+      outprinter->long_name = INDEX_STRING(long_name);
+      outprinter->manufacturer = INDEX_STRING(manufacturer);
+      outprinter->device_id = INDEX_STRING(device_id);
+      outprinter->comment = INDEX_STRING(comment);
+      outprinter->parameters = INDEX_STRING(parameters);
+#undef INDEX_STRING
+      outprinter->model = entry[i].model;
+      outprinter->has_settings = entry[i].has_settings;
+      outprinter->printfuncs = family_data->printfuncs;
+      outprinter->file = printer_file;
+      outprinter->indexed = 1;
+      if (stp_get_debug_level() & STP_DBG_XML)
+	stp_erprintf("stpi_printer_file_register: printer: %s\n",
+		     outprinter->driver);
+      stp_list_item_create(family_data->printer_list, NULL, outprinter);
+    }
+}
+
+/*
+ * Parse the <family> node.
+ */
+static void
+stpi_xml_process_family(stp_mxml_node_t *family)     /* The family node */
+{
+  const char *family_name;                       /* Name of family */
+  stp_mxml_node_t *printer;                         /* printer child node */
+  stp_family_t *family_data;  /* Family data */
+
+  family_name = stp_mxmlElementGetAttr(family, "name");
+  family_data = stpi_find_family(family_name);
+
   printer = family->child;
-  while (family_valid && printer)
+  while (family_data && printer)
     {
       if (printer->type == STP_MXML_ELEMENT)
 	{
@@ -1279,21 +1738,10 @@ stpi_xml_process_family(stp_mxml_node_t *family)     /* The family node */
 				      outprinter);
 	    }
 	  else if (!strcmp(printer_name, "parameters"))
-	    {
-	      stp_printvars_t *printvars =
-		stp_printvars_create_from_xmltree(printer, family_name);
-	      if (printvars)
-		{
-		  stpi_init_printvars_list();
-		  stp_list_item_create(printvars_list, NULL, printvars);
-		}
-	    }
+	    stpi_add_printvars(printer, family_name);
 	}
       printer = printer->next;
     }
-
-  stp_list_destroy(family_module_list);
-  return;
 }
 
 /*
@@ -0,0 +1,506 @@
+/*
+ *   Thread support for Gutenprint
+ *
+ *   Copyright 2026 the Gutenprint project
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file must include only standard C header files.  The core code must
+ * compile on generic platforms that don't support glib, gimp, etc.
+ *
+ * Threading is strictly opt-in: unless STP_THREADS is set to a value
+ * greater than 1 (and POSIX threads are available), stpi_thread_count()
+ * returns 1 and callers are expected to use their serial code paths.
+ * Output must not depend on the number of threads; anything that trades
+ * exact output for speed needs its own switch.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <gutenprint/gutenprint.h>
+#include "gutenprint-internal.h"
+#include <stdlib.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#define STPI_MAX_THREADS 64
+
+static int stpi_threads = 0;
+
+int
+stpi_thread_count(void)
+{
+  if (stpi_threads == 0)
+    {
+      int threads = 1;
+#ifdef HAVE_PTHREAD
+      const char *tval = getenv("STP_THREADS");
+      if (tval)
+	threads = atoi(tval);
+      if (threads < 1)
+	threads = 1;
+      else if (threads > STPI_MAX_THREADS)
+	threads = STPI_MAX_THREADS;
+#endif
+      stpi_threads = threads;
+    }
+  return stpi_threads;
+}
+
+#ifdef HAVE_PTHREAD
+
+/*
+ * One lock for the library's few pieces of global state that can be
+ * modified after initialization.  Nothing may be called with it held
+ * that might itself take it.
+ */
+static pthread_mutex_t stpi_global_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void
+stpi_global_lock(void)
+{
+  pthread_mutex_lock(&stpi_global_mutex);
+}
+
+void
+stpi_global_unlock(void)
+{
+  pthread_mutex_unlock(&stpi_global_mutex);
+}
+
+struct stpi_thread
+{
+  pthread_t thread;
+};
+
+stpi_thread_t *
+stpi_thread_create(void *(*func)(void *), void *arg)
+{
+  stpi_thread_t *ret = stp_malloc(sizeof(stpi_thread_t));
+  if (pthread_create(&(ret->thread), NULL, func, arg) != 0)
+    {
+      stp_free(ret);
+      return NULL;
+    }
+  return ret;
+}
+
+void *
+stpi_thread_join(stpi_thread_t *thread)
+{
+  void *retval = NULL;
+  if (thread)
+    {
+      pthread_join(thread->thread, &retval);
+      stp_free(thread);
+    }
+  return retval;
+}
+
+/*
+ * A bounded FIFO of row slots connecting one producer and one consumer.
+ * The queue only hands out slot numbers (0 .. depth - 1, in order);
+ * the caller owns whatever storage the slots refer to.
+ */
+struct stpi_row_queue
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int depth;
+  unsigned long produced;	/* Rows committed by the producer */
+  unsigned long consumed;	/* Rows released by the consumer */
+  int closed;			/* Producer will commit no more rows */
+  int cancelled;		/* Consumer wants no more rows */
+};
+
+stpi_row_queue_t *
+stpi_row_queue_create(int depth)
+{
+  stpi_row_queue_t *q = stp_zalloc(sizeof(stpi_row_queue_t));
+  pthread_mutex_init(&(q->lock), NULL);
+  pthread_cond_init(&(q->cond), NULL);
+  q->depth = depth > 0 ? depth : 1;
+  return q;
+}
+
+void
+stpi_row_queue_destroy(stpi_row_queue_t *q)
+{
+  if (q)
+    {
+      pthread_cond_destroy(&(q->cond));
+      pthread_mutex_destroy(&(q->lock));
+      stp_free(q);
+    }
+}
+
+int
+stpi_row_queue_reserve_rows(stpi_row_queue_t *q, int max, int *slot)
+{
+  int count = 0;
+  pthread_mutex_lock(&(q->lock));
+  while (!q->cancelled && q->produced - q->consumed >= (unsigned long) q->depth)
+    pthread_cond_wait(&(q->cond), &(q->lock));
+  if (!q->cancelled)
+    {
+      count = q->depth - (int) (q->produced - q->consumed);
+      if (count > max)
+	count = max;
+      *slot = q->produced % q->depth;
+    }
+  pthread_mutex_unlock(&(q->lock));
+  return count;
+}
+
+int
+stpi_row_queue_reserve(stpi_row_queue_t *q)
+{
+  int slot;
+  return stpi_row_queue_reserve_rows(q, 1, &slot) ? slot : -1;
+}
+
+void
+stpi_row_queue_commit_rows(stpi_row_queue_t *q, int count)
+{
+  pthread_mutex_lock(&(q->lock));
+  q->produced += count;
+  pthread_cond_broadcast(&(q->cond));
+  pthread_mutex_unlock(&(q->lock));
+}
+
+void
+stpi_row_queue_commit(stpi_row_queue_t *q)
+{
+  stpi_row_queue_commit_rows(q, 1);
+}
+
+int
+stpi_row_queue_take_rows(stpi_row_queue_t *q, int max, int *slot)
+{
+  int count = 0;
+  pthread_mutex_lock(&(q->lock));
+  while (!q->cancelled && !q->closed && q->produced == q->consumed)
+    pthread_cond_wait(&(q->cond), &(q->lock));
+  if (!q->cancelled && q->produced != q->consumed)
+    {
+      count = (int) (q->produced - q->consumed);
+      if (count > max)
+	count = max;
+      *slot = q->consumed % q->depth;
+    }
+  pthread_mutex_unlock(&(q->lock));
+  return count;
+}
+
+int
+stpi_row_queue_take(stpi_row_queue_t *q)
+{
+  int slot;
+  return stpi_row_queue_take_rows(q, 1, &slot) ? slot : -1;
+}
+
+void
+stpi_row_queue_release_rows(stpi_row_queue_t *q, int count)
+{
+  pthread_mutex_lock(&(q->lock));
+  q->consumed += count;
+  pthread_cond_broadcast(&(q->cond));
+  pthread_mutex_unlock(&(q->lock));
+}
+
+void
+stpi_row_queue_release(stpi_row_queue_t *q)
+{
+  stpi_row_queue_release_rows(q, 1);
+}
+
+void
+stpi_row_queue_close(stpi_row_queue_t *q)
+{
+  pthread_mutex_lock(&(q->lock));
+  q->closed = 1;
+  pthread_cond_broadcast(&(q->cond));
+  pthread_mutex_unlock(&(q->lock));
+}
+
+void
+stpi_row_queue_cancel(stpi_row_queue_t *q)
+{
+  pthread_mutex_lock(&(q->lock));
+  q->cancelled = 1;
+  pthread_cond_broadcast(&(q->cond));
+  pthread_mutex_unlock(&(q->lock));
+}
+
+/*
+ * Each call to stpi_thread_pool_run starts a new batch.  Jobs are
+ * handed out one at a time under the lock; they are expected to be
+ * coarse enough that this costs nothing measurable.
+ */
+struct stpi_thread_pool
+{
+  pthread_mutex_t lock;
+  pthread_cond_t work;		/* Signalled when a batch starts */
+  pthread_cond_t done;		/* Signalled when a batch completes */
+  int nworkers;
+  pthread_t *workers;
+  unsigned long batch;		/* Number of the current batch */
+  void (*func)(void *, int);
+  void *arg;
+  int jobs;
+  int next_job;
+  int jobs_done;
+  int shutdown;
+};
+
+static void
+pool_run_jobs(stpi_thread_pool_t *pool)
+{
+  /* Called and returns with the lock held */
+  while (pool->next_job < pool->jobs)
+    {
+      int job = pool->next_job++;
+      pthread_mutex_unlock(&(pool->lock));
+      (pool->func)(pool->arg, job);
+      pthread_mutex_lock(&(pool->lock));
+      if (++pool->jobs_done == pool->jobs)
+	pthread_cond_broadcast(&(pool->done));
+    }
+}
+
+static void *
+pool_worker(void *arg)
+{
+  stpi_thread_pool_t *pool = (stpi_thread_pool_t *) arg;
+  unsigned long batch = 0;
+  pthread_mutex_lock(&(pool->lock));
+  while (1)
+    {
+      while (!pool->shutdown && pool->batch == batch)
+	pthread_cond_wait(&(pool->work), &(pool->lock));
+      if (pool->shutdown)
+	break;
+      batch = pool->batch;
+      pool_run_jobs(pool);
+    }
+  pthread_mutex_unlock(&(pool->lock));
+  return NULL;
+}
+
+stpi_thread_pool_t *
+stpi_thread_pool_create(int threads)
+{
+  stpi_thread_pool_t *pool;
+  int i;
+  if (threads < 2)
+    return NULL;
+  pool = stp_zalloc(sizeof(stpi_thread_pool_t));
+  pthread_mutex_init(&(pool->lock), NULL);
+  pthread_cond_init(&(pool->work), NULL);
+  pthread_cond_init(&(pool->done), NULL);
+  pool->workers = stp_zalloc(sizeof(pthread_t) * (threads - 1));
+  for (i = 0; i < threads - 1; i++)
+    {
+      if (pthread_create(&(pool->workers[i]), NULL, pool_worker, pool) != 0)
+	break;
+      pool->nworkers++;
+    }
+  if (pool->nworkers == 0)
+    {
+      stpi_thread_pool_destroy(pool);
+      return NULL;
+    }
+  return pool;
+}
+
+void
+stpi_thread_pool_destroy(stpi_thread_pool_t *pool)
+{
+  int i;
+  if (!pool)
+    return;
+  pthread_mutex_lock(&(pool->lock));
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&(pool->work));
+  pthread_mutex_unlock(&(pool->lock));
+  for (i = 0; i < pool->nworkers; i++)
+    pthread_join(pool->workers[i], NULL);
+  pthread_cond_destroy(&(pool->done));
+  pthread_cond_destroy(&(pool->work));
+  pthread_mutex_destroy(&(pool->lock));
+  stp_free(pool->workers);
+  stp_free(pool);
+}
+
+int
+stpi_thread_pool_size(const stpi_thread_pool_t *pool)
+{
+  return pool ? pool->nworkers + 1 : 1;
+}
+
+void
+stpi_thread_pool_run(stpi_thread_pool_t *pool,
+		     void (*func)(void *arg, int job), void *arg, int jobs)
+{
+  if (!pool || jobs <= 1)
+    {
+      int i;
+      for (i = 0; i < jobs; i++)
+	func(arg, i);
+      return;
+    }
+  pthread_mutex_lock(&(pool->lock));
+  pool->func = func;
+  pool->arg = arg;
+  pool->jobs = jobs;
+  pool->next_job = 0;
+  pool->jobs_done = 0;
+  pool->batch++;
+  pthread_cond_broadcast(&(pool->work));
+  pool_run_jobs(pool);
+  while (pool->jobs_done < pool->jobs)
+    pthread_cond_wait(&(pool->done), &(pool->lock));
+  pthread_mutex_unlock(&(pool->lock));
+}
+
+#else /* !HAVE_PTHREAD */
+
+/*
+ * With only one thread there is nothing to lock.
+ */
+
+void
+stpi_global_lock(void)
+{
+}
+
+void
+stpi_global_unlock(void)
+{
+}
+
+/*
+ * Without thread support stpi_thread_count() always returns 1, so none
+ * of these should ever be reached; they exist so that callers need not
+ * be conditionally compiled.
+ */
+
+stpi_thread_t *
+stpi_thread_create(void *(*func)(void *), void *arg)
+{
+  return NULL;
+}
+
+void *
+stpi_thread_join(stpi_thread_t *thread)
+{
+  return NULL;
+}
+
+stpi_row_queue_t *
+stpi_row_queue_create(int depth)
+{
+  return NULL;
+}
+
+void
+stpi_row_queue_destroy(stpi_row_queue_t *q)
+{
+}
+
+int
+stpi_row_queue_reserve(stpi_row_queue_t *q)
+{
+  return -1;
+}
+
+int
+stpi_row_queue_reserve_rows(stpi_row_queue_t *q, int max, int *slot)
+{
+  return 0;
+}
+
+void
+stpi_row_queue_commit(stpi_row_queue_t *q)
+{
+}
+
+void
+stpi_row_queue_commit_rows(stpi_row_queue_t *q, int count)
+{
+}
+
+int
+stpi_row_queue_take(stpi_row_queue_t *q)
+{
+  return -1;
+}
+
+int
+stpi_row_queue_take_rows(stpi_row_queue_t *q, int max, int *slot)
+{
+  return 0;
+}
+
+void
+stpi_row_queue_release(stpi_row_queue_t *q)
+{
+}
+
+void
+stpi_row_queue_release_rows(stpi_row_queue_t *q, int count)
+{
+}
+
+void
+stpi_row_queue_close(stpi_row_queue_t *q)
+{
+}
+
+void
+stpi_row_queue_cancel(stpi_row_queue_t *q)
+{
+}
+
+stpi_thread_pool_t *
+stpi_thread_pool_create(int threads)
+{
+  return NULL;
+}
+
+void
+stpi_thread_pool_destroy(stpi_thread_pool_t *pool)
+{
+}
+
+int
+stpi_thread_pool_size(const stpi_thread_pool_t *pool)
+{
+  return 1;
+}
+
+void
+stpi_thread_pool_run(stpi_thread_pool_t *pool,
+		     void (*func)(void *arg, int job), void *arg, int jobs)
+{
+  int i;
+  for (i = 0; i < jobs; i++)
+    func(arg, i);
+}
+
+#endif /* HAVE_PTHREAD */
@@ -0,0 +1,761 @@
+/*
+ *   Binary cache of parsed XML files for Gutenprint
+ *
+ *   Copyright 2026 the Gutenprint project
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Parsing the XML data files is a large part of the cost of starting up
+ * a program using Gutenprint, and filters are started afresh for every
+ * job.  So the first time a file is parsed, its tree is written out as
+ * an image of the mxml nodes themselves, with pointers replaced by
+ * offsets.  Later loads map the image, turn the offsets back into
+ * pointers, and use the nodes in place without parsing anything.
+ *
+ * The cache is used only if STP_XML_CACHE_DIR names the directory to
+ * keep it in; the directory is created if need be.  Nothing is written
+ * anywhere unless it is asked for.  A cache file is used only if its
+ * source file has the same size and modification time as when the
+ * cache was written, and if it was written by a build with the same
+ * node layout; otherwise it is simply rewritten.
+ *
+ * Trees loaded from the cache must be treated as read-only (as all
+ * trees loaded from the data files are), and are freed as usual with
+ * stp_mxmlDelete().  The list of loaded images is shared by all
+ * threads, so it is only touched with the global lock held.  Every
+ * node deleted has to be checked against it, so the range of addresses
+ * covered by all images ever loaded is also kept; it can be checked
+ * without the lock, and rules out ordinary nodes (and every node, if
+ * the cache isn't in use) without taking it.
+ *
+ * Data computed from a file (the integer dither matrices, for example)
+ * can be cached in the same way with stpi_xml_cache_load_data().  That
+ * needs no relocation, so it is mapped read-only and shared, and every
+ * process using it shares one copy.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <gutenprint/gutenprint.h>
+#include "gutenprint-internal.h"
+#include <gutenprint/gutenprint-intl-internal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#include <stdint.h>
+
+#define XML_CACHE_MAGIC "GPXMLC\r\n"
+#define XML_CACHE_VERSION 1
+#define XML_CACHE_BYTE_ORDER 0x01020304u
+#define XML_CACHE_ALIGN(x) (((x) + 15) & ~((size_t) 15))
+#define XML_DATA_MAGIC "GPXMLD\r\n"
+#define XML_DATA_VERSION 1
+
+typedef struct
+{
+  char magic[8];
+  unsigned version;
+  unsigned byte_order;
+  unsigned pointer_size;
+  unsigned node_size;
+  unsigned attr_size;
+  unsigned path_length;		/* Source file name, including the NUL */
+  unsigned long long source_mtime;
+  unsigned long long source_size;
+  unsigned long long nodes;
+  unsigned long long nodes_offset;
+  unsigned long long attrs_offset;
+  unsigned long long strings_offset;
+  unsigned long long size;	/* Of the whole file */
+} xml_cache_header_t;
+
+typedef struct
+{
+  char magic[8];
+  unsigned version;
+  unsigned byte_order;
+  unsigned path_length;		/* Source file name, including the NUL */
+  unsigned pad;
+  unsigned long long source_mtime;
+  unsigned long long source_size;
+  unsigned long long data_offset;
+  unsigned long long size;	/* Of the whole file */
+} xml_data_header_t;
+
+/*
+ * A loaded cache image.  The root node is the first node in the image.
+ */
+typedef struct xml_cache_image
+{
+  char *base;
+  size_t size;
+  int mapped;			/* Else allocated */
+  struct xml_cache_image *next;
+} xml_cache_image_t;
+
+static xml_cache_image_t *xml_cache_images = NULL;
+static uintptr_t xml_cache_lo = 0;
+static uintptr_t xml_cache_hi = 0;
+
+static inline stp_mxml_node_t *
+image_root(const xml_cache_image_t *image)
+{
+  const xml_cache_header_t *h = (const xml_cache_header_t *) image->base;
+  return (stp_mxml_node_t *) (image->base + h->nodes_offset);
+}
+
+static inline int
+maybe_cached(const stp_mxml_node_t *node)
+{
+  uintptr_t addr = (uintptr_t) node;
+  return (addr < STPI_LOAD_ACQUIRE(&xml_cache_hi) &&
+	  addr >= STPI_LOAD_ACQUIRE(&xml_cache_lo));
+}
+
+/*
+ * Must be called with the global lock held.
+ */
+static xml_cache_image_t *
+find_image(const stp_mxml_node_t *node)
+{
+  xml_cache_image_t *image;
+  for (image = xml_cache_images; image; image = image->next)
+    if ((const char *) node >= image->base &&
+	(const char *) node < image->base + image->size)
+      return image;
+  return NULL;
+}
+
+int
+stpi_xml_cache_owns(const stp_mxml_node_t *node)
+{
+  int answer;
+  if (!maybe_cached(node))
+    return 0;
+  stpi_global_lock();
+  answer = find_image(node) != NULL;
+  stpi_global_unlock();
+  return answer;
+}
+
+int
+stpi_xml_cache_release(stp_mxml_node_t *node)
+{
+  xml_cache_image_t *image;
+  xml_cache_image_t **prev;
+  if (!maybe_cached(node))
+    return 0;
+  stpi_global_lock();
+  if (!(image = find_image(node)))
+    {
+      stpi_global_unlock();
+      return 0;
+    }
+  /* Nodes within the image are freed along with the whole image */
+  if (node != image_root(image))
+    {
+      stpi_global_unlock();
+      return 1;
+    }
+  for (prev = &xml_cache_images; *prev != image; prev = &((*prev)->next))
+    ;
+  *prev = image->next;
+  stpi_global_unlock();
+#ifdef HAVE_SYS_MMAN_H
+  if (image->mapped)
+    munmap(image->base, image->size);
+  else
+#endif
+    stp_free(image->base);
+  stp_free(image);
+  return 1;
+}
+
+static char *
+xml_cache_dir(void)
+{
+  const char *dir = getenv("STP_XML_CACHE_DIR");
+  if (dir && dir[0])
+    return stp_strdup(dir);
+  return NULL;
+}
+
+/*
+ * The name of the cache for a file is derived from the file's full
+ * name, and the variant of any data computed from it; the full name is
+ * also stored in the cache, in case two names hash alike.
+ */
+static char *
+xml_cache_name(const char *dir, const char *file, const char *variant,
+	       char **full_name)
+{
+  const char *base = strrchr(file, '/');
+  unsigned long long hash = 14695981039346656037ull;
+  const char *s;
+  char *answer;
+  if (file[0] == '/')
+    *full_name = stp_strdup(file);
+  else
+    {
+      char cwd[4096];
+      if (!getcwd(cwd, sizeof(cwd)))
+	return NULL;
+      stp_asprintf(full_name, "%s/%s", cwd, file);
+    }
+  for (s = *full_name; *s; s++)
+    {
+      hash ^= (unsigned char) *s;
+      hash *= 1099511628211ull;
+    }
+  stp_asprintf(&answer, "%s/%s-%016llx%s%s.bin", dir, base ? base + 1 : file,
+	       hash, variant ? "-" : "", variant ? variant : "");
+  return answer;
+}
+
+static void
+make_cache_dir(const char *dir)
+{
+  if (mkdir(dir, 0755) != 0 && errno == ENOENT)
+    {
+      /* Create the parent too, but no further */
+      char *parent = stp_strdup(dir);
+      char *slash = strrchr(parent, '/');
+      if (slash && slash != parent)
+	{
+	  *slash = '\0';
+	  (void) mkdir(parent, 0700);
+	  (void) mkdir(dir, 0755);
+	}
+      stp_free(parent);
+    }
+}
+
+/* Write to a temporary file and rename it, so readers never see half */
+static void
+write_cache_file(const char *cache_name, const char *full_name,
+		 const char *buf, size_t size)
+{
+  char *tmp_name;
+  FILE *fp;
+  int fd;
+  stp_asprintf(&tmp_name, "%s.%ld.tmp", cache_name, (long) getpid());
+  fd = open(tmp_name, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (fd >= 0 && (fp = fdopen(fd, "wb")) != NULL)
+    {
+      int ok = fwrite(buf, size, 1, fp) == 1;
+      if (fclose(fp) == 0 && ok && rename(tmp_name, cache_name) == 0)
+	stp_deprintf(STP_DBG_XML, "xml_cache_write: wrote %s for %s\n",
+		     cache_name, full_name);
+      else
+	unlink(tmp_name);
+    }
+  else if (fd >= 0)
+    close(fd);
+  stp_free(tmp_name);
+}
+
+/*
+ * Writing the cache
+ */
+
+typedef struct
+{
+  char *buf;
+  size_t nodes;			/* Nodes written so far */
+  size_t attrs;			/* Attributes written so far */
+  size_t strings;		/* Bytes of strings written so far */
+  size_t nodes_offset;
+  size_t attrs_offset;
+  size_t strings_offset;
+} xml_cache_writer_t;
+
+static void
+count_tree(const stp_mxml_node_t *node, size_t *nodes, size_t *attrs,
+	   size_t *strings)
+{
+  const stp_mxml_node_t *child;
+  int i;
+  (*nodes)++;
+  switch (node->type)
+    {
+    case STP_MXML_ELEMENT:
+      *strings += strlen(node->value.element.name) + 1;
+      *attrs += node->value.element.num_attrs;
+      for (i = 0; i < node->value.element.num_attrs; i++)
+	{
+	  *strings += strlen(node->value.element.attrs[i].name) + 1;
+	  *strings += strlen(node->value.element.attrs[i].value) + 1;
+	}
+      break;
+    case STP_MXML_OPAQUE:
+      *strings += strlen(node->value.opaque) + 1;
+      break;
+    case STP_MXML_TEXT:
+      *strings += strlen(node->value.text.string) + 1;
+      break;
+    default:
+      break;
+    }
+  for (child = node->child; child; child = child->next)
+    count_tree(child, nodes, attrs, strings);
+}
+
+/* Offsets are stored in place of pointers; 0 stands for NULL */
+#define OFFSET_PTR(type, offset) ((type *) (uintptr_t) (offset))
+
+static char *
+write_string(xml_cache_writer_t *w, const char *s)
+{
+  size_t offset = w->strings_offset + w->strings;
+  size_t len = strlen(s) + 1;
+  memcpy(w->buf + offset, s, len);
+  w->strings += len;
+  return OFFSET_PTR(char, offset);
+}
+
+static size_t
+node_offset(const xml_cache_writer_t *w, size_t idx)
+{
+  return w->nodes_offset + idx * sizeof(stp_mxml_node_t);
+}
+
+static size_t
+write_tree(xml_cache_writer_t *w, const stp_mxml_node_t *node, size_t parent)
+{
+  size_t idx = w->nodes++;
+  stp_mxml_node_t *out = (stp_mxml_node_t *) (w->buf + node_offset(w, idx));
+  const stp_mxml_node_t *child;
+  size_t prev = 0;
+  int i;
+  out->type = node->type;
+  if (idx > 0)
+    out->parent = OFFSET_PTR(stp_mxml_node_t, node_offset(w, parent));
+  switch (node->type)
+    {
+    case STP_MXML_ELEMENT:
+      out->value.element.name = write_string(w, node->value.element.name);
+      out->value.element.num_attrs = node->value.element.num_attrs;
+      if (node->value.element.num_attrs)
+	{
+	  size_t offset = w->attrs_offset + w->attrs * sizeof(stp_mxml_attr_t);
+	  stp_mxml_attr_t *attrs = (stp_mxml_attr_t *) (w->buf + offset);
+	  out->value.element.attrs = OFFSET_PTR(stp_mxml_attr_t, offset);
+	  w->attrs += node->value.element.num_attrs;
+	  for (i = 0; i < node->value.element.num_attrs; i++)
+	    {
+	      attrs[i].name = write_string(w, node->value.element.attrs[i].name);
+	      attrs[i].value =
+		write_string(w, node->value.element.attrs[i].value);
+	    }
+	}
+      break;
+    case STP_MXML_OPAQUE:
+      out->value.opaque = write_string(w, node->value.opaque);
+      break;
+    case STP_MXML_TEXT:
+      out->value.text.whitespace = node->value.text.whitespace;
+      out->value.text.string = write_string(w, node->value.text.string);
+      break;
+    default:
+      out->value = node->value;
+      break;
+    }
+  for (child = node->child; child; child = child->next)
+    {
+      size_t c = write_tree(w, child, idx);
+      stp_mxml_node_t *cnode =
+	(stp_mxml_node_t *) (w->buf + node_offset(w, c));
+      if (prev)
+	{
+	  ((stp_mxml_node_t *) (w->buf + node_offset(w, prev)))->next =
+	    OFFSET_PTR(stp_mxml_node_t, node_offset(w, c));
+	  cnode->prev = OFFSET_PTR(stp_mxml_node_t, node_offset(w, prev));
+	}
+      else
+	out->child = OFFSET_PTR(stp_mxml_node_t, node_offset(w, c));
+      prev = c;
+    }
+  if (prev)
+    out->last_child = OFFSET_PTR(stp_mxml_node_t, node_offset(w, prev));
+  return idx;
+}
+
+static void
+xml_cache_write(const char *cache_name, const char *full_name,
+		const struct stat *sbuf, const stp_mxml_node_t *root)
+{
+  xml_cache_writer_t w;
+  xml_cache_header_t *h;
+  size_t nodes = 0, attrs = 0, strings = 0;
+  size_t path_length = strlen(full_name) + 1;
+  size_t size;
+
+  if (root->next || root->prev)
+    return;			/* Not a single tree */
+  count_tree(root, &nodes, &attrs, &strings);
+  memset(&w, 0, sizeof(w));
+  w.nodes_offset = XML_CACHE_ALIGN(sizeof(xml_cache_header_t) + path_length);
+  w.attrs_offset =
+    XML_CACHE_ALIGN(w.nodes_offset + nodes * sizeof(stp_mxml_node_t));
+  w.strings_offset =
+    XML_CACHE_ALIGN(w.attrs_offset + attrs * sizeof(stp_mxml_attr_t));
+  size = w.strings_offset + strings;
+  w.buf = stp_zalloc(size);
+
+  h = (xml_cache_header_t *) w.buf;
+  memcpy(h->magic, XML_CACHE_MAGIC, sizeof(h->magic));
+  h->version = XML_CACHE_VERSION;
+  h->byte_order = XML_CACHE_BYTE_ORDER;
+  h->pointer_size = sizeof(void *);
+  h->node_size = sizeof(stp_mxml_node_t);
+  h->attr_size = sizeof(stp_mxml_attr_t);
+  h->path_length = path_length;
+  h->source_mtime = sbuf->st_mtime;
+  h->source_size = sbuf->st_size;
+  h->nodes = nodes;
+  h->nodes_offset = w.nodes_offset;
+  h->attrs_offset = w.attrs_offset;
+  h->strings_offset = w.strings_offset;
+  h->size = size;
+  memcpy(w.buf + sizeof(xml_cache_header_t), full_name, path_length);
+  (void) write_tree(&w, root, 0);
+  write_cache_file(cache_name, full_name, w.buf, size);
+  stp_free(w.buf);
+}
+
+/*
+ * Reading the cache
+ */
+
+#define RELOCATE(type, ptr)						\
+do {									\
+  if (ptr)								\
+    {									\
+      uintptr_t offset_ = (uintptr_t) (ptr);				\
+      if (offset_ >= size)						\
+	return 0;							\
+      (ptr) = (type *) (base + offset_);				\
+    }									\
+} while (0)
+
+/*
+ * Turn the offsets in an image back into pointers.  Offsets are
+ * checked against the size of the image, so a damaged cache can't
+ * send us off into the weeds.
+ */
+static int
+relocate_image(char *base, const xml_cache_header_t *h)
+{
+  stp_mxml_node_t *node = (stp_mxml_node_t *) (base + h->nodes_offset);
+  size_t size = h->size;
+  unsigned long long i;
+  int j;
+  for (i = 0; i < h->nodes; i++, node++)
+    {
+      RELOCATE(stp_mxml_node_t, node->next);
+      RELOCATE(stp_mxml_node_t, node->prev);
+      RELOCATE(stp_mxml_node_t, node->parent);
+      RELOCATE(stp_mxml_node_t, node->child);
+      RELOCATE(stp_mxml_node_t, node->last_child);
+      switch (node->type)
+	{
+	case STP_MXML_ELEMENT:
+	  RELOCATE(char, node->value.element.name);
+	  if (node->value.element.num_attrs < 0 ||
+	      (h->attrs_offset + node->value.element.num_attrs *
+	       sizeof(stp_mxml_attr_t)) > h->strings_offset)
+	    return 0;
+	  RELOCATE(stp_mxml_attr_t, node->value.element.attrs);
+	  for (j = 0; j < node->value.element.num_attrs; j++)
+	    {
+	      RELOCATE(char, node->value.element.attrs[j].name);
+	      RELOCATE(char, node->value.element.attrs[j].value);
+	    }
+	  break;
+	case STP_MXML_OPAQUE:
+	  RELOCATE(char, node->value.opaque);
+	  break;
+	case STP_MXML_TEXT:
+	  RELOCATE(char, node->value.text.string);
+	  break;
+	default:
+	  break;
+	}
+    }
+  return 1;
+}
+
+static int
+header_is_valid(const xml_cache_header_t *h, size_t size,
+		const struct stat *sbuf, const char *full_name)
+{
+  return (size >= sizeof(xml_cache_header_t) &&
+	  memcmp(h->magic, XML_CACHE_MAGIC, sizeof(h->magic)) == 0 &&
+	  h->version == XML_CACHE_VERSION &&
+	  h->byte_order == XML_CACHE_BYTE_ORDER &&
+	  h->pointer_size == sizeof(void *) &&
+	  h->node_size == sizeof(stp_mxml_node_t) &&
+	  h->attr_size == sizeof(stp_mxml_attr_t) &&
+	  h->size == size &&
+	  h->source_mtime == (unsigned long long) sbuf->st_mtime &&
+	  h->source_size == (unsigned long long) sbuf->st_size &&
+	  h->nodes > 0 &&
+	  h->path_length == strlen(full_name) + 1 &&
+	  sizeof(xml_cache_header_t) + h->path_length <= h->nodes_offset &&
+	  h->nodes_offset + h->nodes * sizeof(stp_mxml_node_t) <=
+	  h->attrs_offset &&
+	  h->attrs_offset <= h->strings_offset &&
+	  h->strings_offset <= size &&
+	  memcmp((const char *) h + sizeof(xml_cache_header_t), full_name,
+		 h->path_length) == 0);
+}
+
+static stp_mxml_node_t *
+xml_cache_read(const char *cache_name, const char *full_name,
+	       const struct stat *sbuf)
+{
+  xml_cache_image_t *image;
+  struct stat cbuf;
+  char *base = NULL;
+  int mapped = 0;
+  int fd = open(cache_name, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &cbuf) != 0 || cbuf.st_size < sizeof(xml_cache_header_t))
+    {
+      close(fd);
+      return NULL;
+    }
+#ifdef HAVE_SYS_MMAN_H
+  /* Private, so that relocation doesn't touch the file */
+  base = mmap(NULL, cbuf.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (base == MAP_FAILED)
+    base = NULL;
+  else
+    mapped = 1;
+#endif
+  if (!base)
+    {
+      base = stp_malloc(cbuf.st_size);
+      if (read(fd, base, cbuf.st_size) != cbuf.st_size)
+	{
+	  stp_free(base);
+	  base = NULL;
+	}
+    }
+  close(fd);
+  if (!base)
+    return NULL;
+  if (!header_is_valid((const xml_cache_header_t *) base, cbuf.st_size,
+		       sbuf, full_name) ||
+      !relocate_image(base, (const xml_cache_header_t *) base))
+    {
+      stp_deprintf(STP_DBG_XML, "xml_cache_read: %s is stale\n", cache_name);
+#ifdef HAVE_SYS_MMAN_H
+      if (mapped)
+	munmap(base, cbuf.st_size);
+      else
+#endif
+	stp_free(base);
+      return NULL;
+    }
+  image = stp_malloc(sizeof(xml_cache_image_t));
+  image->base = base;
+  image->size = cbuf.st_size;
+  image->mapped = mapped;
+  stpi_global_lock();
+  image->next = xml_cache_images;
+  xml_cache_images = image;
+  if (xml_cache_hi == 0 || (uintptr_t) base < xml_cache_lo)
+    STPI_STORE_RELEASE(&xml_cache_lo, (uintptr_t) base);
+  if ((uintptr_t) base + image->size > xml_cache_hi)
+    STPI_STORE_RELEASE(&xml_cache_hi, (uintptr_t) base + image->size);
+  stpi_global_unlock();
+  stp_deprintf(STP_DBG_XML, "xml_cache_read: loaded %s from %s\n",
+	       full_name, cache_name);
+  return image_root(image);
+}
+
+stp_mxml_node_t *
+stpi_xml_cache_load(const char *file)
+{
+  struct stat sbuf;
+  stp_mxml_node_t *answer = NULL;
+  char *dir;
+  char *cache_name = NULL;
+  char *full_name = NULL;
+
+  if (stat(file, &sbuf) != 0 || !S_ISREG(sbuf.st_mode))
+    return NULL;
+  dir = xml_cache_dir();
+  if (dir)
+    cache_name = xml_cache_name(dir, file, NULL, &full_name);
+  if (cache_name)
+    answer = xml_cache_read(cache_name, full_name, &sbuf);
+  if (!answer)
+    {
+      answer = stp_mxmlLoadFromFile(NULL, file, STP_MXML_NO_CALLBACK);
+      if (answer && cache_name)
+	{
+	  make_cache_dir(dir);
+	  xml_cache_write(cache_name, full_name, &sbuf, answer);
+	}
+    }
+  STP_SAFE_FREE(cache_name);
+  STP_SAFE_FREE(full_name);
+  STP_SAFE_FREE(dir);
+  return answer;
+}
+
+/*
+ * Data computed from XML files
+ */
+
+static const void *
+xml_data_read(const char *cache_name, const char *full_name,
+	      const struct stat *sbuf, size_t *size)
+{
+  const xml_data_header_t *h;
+  struct stat cbuf;
+  char *base = NULL;
+  int mapped = 0;
+  int fd = open(cache_name, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &cbuf) != 0 || cbuf.st_size < sizeof(xml_data_header_t))
+    {
+      close(fd);
+      return NULL;
+    }
+#ifdef HAVE_SYS_MMAN_H
+  base = mmap(NULL, cbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED)
+    base = NULL;
+  else
+    mapped = 1;
+#endif
+  if (!base)
+    {
+      base = stp_malloc(cbuf.st_size);
+      if (read(fd, base, cbuf.st_size) != cbuf.st_size)
+	{
+	  stp_free(base);
+	  base = NULL;
+	}
+    }
+  close(fd);
+  if (!base)
+    return NULL;
+  h = (const xml_data_header_t *) base;
+  if (memcmp(h->magic, XML_DATA_MAGIC, sizeof(h->magic)) != 0 ||
+      h->version != XML_DATA_VERSION ||
+      h->byte_order != XML_CACHE_BYTE_ORDER ||
+      h->size != cbuf.st_size ||
+      h->source_mtime != (unsigned long long) sbuf->st_mtime ||
+      h->source_size != (unsigned long long) sbuf->st_size ||
+      h->path_length != strlen(full_name) + 1 ||
+      sizeof(xml_data_header_t) + h->path_length > h->data_offset ||
+      h->data_offset > h->size ||
+      memcmp(base + sizeof(xml_data_header_t), full_name,
+	     h->path_length) != 0)
+    {
+      stp_deprintf(STP_DBG_XML, "xml_data_read: %s is stale\n", cache_name);
+#ifdef HAVE_SYS_MMAN_H
+      if (mapped)
+	munmap(base, cbuf.st_size);
+      else
+#endif
+	stp_free(base);
+      return NULL;
+    }
+  stp_deprintf(STP_DBG_XML, "xml_data_read: loaded data for %s from %s\n",
+	       full_name, cache_name);
+  *size = h->size - h->data_offset;
+  return base + h->data_offset;
+}
+
+static void
+xml_data_write(const char *cache_name, const char *full_name,
+	       const struct stat *sbuf, const void *data, size_t size)
+{
+  xml_data_header_t *h;
+  size_t path_length = strlen(full_name) + 1;
+  size_t data_offset =
+    XML_CACHE_ALIGN(sizeof(xml_data_header_t) + path_length);
+  char *buf = stp_zalloc(data_offset + size);
+
+  h = (xml_data_header_t *) buf;
+  memcpy(h->magic, XML_DATA_MAGIC, sizeof(h->magic));
+  h->version = XML_DATA_VERSION;
+  h->byte_order = XML_CACHE_BYTE_ORDER;
+  h->path_length = path_length;
+  h->source_mtime = sbuf->st_mtime;
+  h->source_size = sbuf->st_size;
+  h->data_offset = data_offset;
+  h->size = data_offset + size;
+  memcpy(buf + sizeof(xml_data_header_t), full_name, path_length);
+  memcpy(buf + data_offset, data, size);
+  write_cache_file(cache_name, full_name, buf, data_offset + size);
+  stp_free(buf);
+}
+
+const void *
+stpi_xml_cache_load_data(const char *file, const char *variant,
+			 stpi_xml_cache_fill_t *fill, void *closure,
+			 size_t *size)
+{
+  struct stat sbuf;
+  const void *answer = NULL;
+  void *data;
+  char *dir;
+  char *cache_name = NULL;
+  char *full_name = NULL;
+
+  if (stat(file, &sbuf) != 0 || !S_ISREG(sbuf.st_mode))
+    return NULL;
+  dir = xml_cache_dir();
+  if (dir)
+    cache_name = xml_cache_name(dir, file, variant, &full_name);
+  if (cache_name)
+    answer = xml_data_read(cache_name, full_name, &sbuf, size);
+  if (!answer && (data = (*fill)(file, closure, size)) != NULL)
+    {
+      if (cache_name)
+	{
+	  make_cache_dir(dir);
+	  xml_data_write(cache_name, full_name, &sbuf, data, *size);
+	  /* Share the copy just written with everyone else if we can */
+	  answer = xml_data_read(cache_name, full_name, &sbuf, size);
+	}
+      if (answer)
+	stp_free(data);
+      else
+	answer = data;
+    }
+  STP_SAFE_FREE(cache_name);
+  STP_SAFE_FREE(full_name);
+  STP_SAFE_FREE(dir);
+  return answer;
+}
@@ -269,7 +269,7 @@ stp_xml_parse_file(const char *file) /* File to parse */
 
   stp_xml_init();
 
-  doc = stp_mxmlLoadFromFile(NULL, file, STP_MXML_NO_CALLBACK);
+  doc = stpi_xml_cache_load(file);
 
   if ((cur = stp_xml_get_node(doc, "gutenprint", NULL)) == NULL)
     {
@@ -290,8 +290,7 @@ stp_xml_parse_file(const char *file) /* File to parse */
 static stp_mxml_node_t *
 xml_try_parse_file_1(const char *pathname, const char *topnodename)
 {
-  stp_mxml_node_t *root =
-    stp_mxmlLoadFromFile(NULL, pathname, STP_MXML_NO_CALLBACK);
+  stp_mxml_node_t *root = stpi_xml_cache_load(pathname);
   if (root)
     {
       stp_mxml_node_t *answer =
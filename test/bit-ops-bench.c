@@ -0,0 +1,1454 @@
+/*
+ *   Benchmark for the bit shuffling routines in bit-ops.c.
+ *
+ *   Copyright 2026 the Gutenprint project
+ *
+ *   This program is free software; you can redistribute it and/or modify it
+ *   under the terms of the GNU General Public License as published by the Free
+ *   Software Foundation; either version 2 of the License, or (at your option)
+ *   any later version.
+ *
+ *   This program is distributed in the hope that it will be useful, but
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *   for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Times stp_fold*, stp_split, stp_unpack and stp_pack_tiff against
+ * the code they replaced, which is kept below, and checks that both
+ * give the same output.  Run with STP_SIMD=0 to time the table code
+ * without the vector kernels.
+ *
+ * The PackBits rows are made up to look like testpattern output; a
+ * file of real rows, row bytes wide, can be given as well.
+ *
+ * With -c, nothing is timed: every routine is run once at each row
+ * width up to a few vector blocks, and at a few longer odd widths,
+ * and only mismatches are reported.  PackBits also gets rows of random
+ * runs there.  This is what "make check" runs.
+ *
+ * Usage: bit-ops-bench [row bytes [iterations [raw rows]]]
+ *        bit-ops-bench -c
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <gutenprint/gutenprint.h>
+#include <gutenprint/gutenprint-module.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+/*
+ * The code these replaced.
+ */
+
+static void
+ref_fold(const unsigned char *line,
+	 int single_length,
+	 unsigned char *outbuf)
+{
+  int i;
+  memset(outbuf, 0, single_length * 2);
+  for (i = 0; i < single_length; i++)
+    {
+      unsigned char l0 = line[0];
+      unsigned char l1 = line[single_length];
+      if (l0 || l1)
+	{
+	  outbuf[0] =		/* B7 A7 B6 A6 B5 A5 B4 A4 */
+	    ((l0 & (1 << 7)) >> 1) +
+	    ((l0 & (1 << 6)) >> 2) +
+	    ((l0 & (1 << 5)) >> 3) +
+	    ((l0 & (1 << 4)) >> 4) +
+	    ((l1 & (1 << 7)) >> 0) +
+	    ((l1 & (1 << 6)) >> 1) +
+	    ((l1 & (1 << 5)) >> 2) +
+	    ((l1 & (1 << 4)) >> 3);
+	  outbuf[1] =		/* B3 A3 B2 A2 B1 A1 B0 A0 */
+	    ((l0 & (1 << 3)) << 3) +
+	    ((l0 & (1 << 2)) << 2) +
+	    ((l0 & (1 << 1)) << 1) +
+	    ((l0 & (1 << 0)) << 0) +
+	    ((l1 & (1 << 3)) << 4) +
+	    ((l1 & (1 << 2)) << 3) +
+	    ((l1 & (1 << 1)) << 2) +
+	    ((l1 & (1 << 0)) << 1);
+	}
+      line++;
+      outbuf += 2;
+    }
+}
+
+static void
+ref_fold_3bit(const unsigned char *line,
+                int single_length,
+                unsigned char *outbuf)
+{
+  int i;
+  memset(outbuf, 0, single_length * 3);
+  for (i = 0; i < single_length; i++)
+    {
+      unsigned char l0 = line[0];
+      unsigned char l1 = line[single_length];
+      unsigned char l2 = line[single_length * 2];
+      if (l0 || l1 || l2)
+	{
+	  outbuf[0] =		/* C7 B7 A7 C6 B6 A6 C5 B5  */
+	    ((l0 & (1 << 7)) >> 2) |
+	    ((l0 & (1 << 6)) >> 4) |
+	    ((l1 & (1 << 7)) >> 1) |
+	    ((l1 & (1 << 6)) >> 3) |
+	    ((l1 & (1 << 5)) >> 5) |
+	    ((l2 & (1 << 7)) << 0) |
+	    ((l2 & (1 << 6)) >> 2) |
+	    ((l2 & (1 << 5)) >> 4);
+	  outbuf[1] =		/* A5 C4 B4 A4 C3 B3 A3 C2 */
+	    ((l0 & (1 << 5)) << 2) |
+	    ((l0 & (1 << 4)) << 0) |
+	    ((l0 & (1 << 3)) >> 2) |
+	    ((l1 & (1 << 4)) << 1) |
+	    ((l1 & (1 << 3)) >> 1) |
+	    ((l2 & (1 << 4)) << 2) |
+	    ((l2 & (1 << 3)) << 0) |
+	    ((l2 & (1 << 2)) >> 2);
+	  outbuf[2] =		/* B2 A2 C1 B1 A1 C0 B0 A0 */
+	    ((l0 & (1 << 2)) << 4) |
+	    ((l0 & (1 << 1)) << 2) |
+	    ((l0 & (1 << 0)) << 0) |
+	    ((l1 & (1 << 2)) << 5) |
+	    ((l1 & (1 << 1)) << 3) |
+	    ((l1 & (1 << 0)) << 1) |
+	    ((l2 & (1 << 1)) << 4) |
+	    ((l2 & (1 << 0)) << 2);
+	}
+    line++;
+    outbuf += 3;
+  }
+}
+static void
+ref_fold_4bit(const unsigned char *line,
+                int single_length,
+                unsigned char *outbuf)
+{
+  int i;
+  memset(outbuf, 0, single_length * 4);
+  for (i = 0; i < single_length; i++)
+    {
+      unsigned char l0 = line[0];
+      unsigned char l1 = line[single_length];
+      unsigned char l2 = line[single_length*2];
+      unsigned char l3 = line[single_length*3];
+      if (l0 || l1 || l2 || l3)
+	{
+	  outbuf[0] =		/* D7 C7 B7 A7 D6 C6 B6 A6 */
+            ((l3 & (1 << 7)) >> 0)|
+            ((l2 & (1 << 7)) >> 1)|
+            ((l1 & (1 << 7)) >> 2)|
+            ((l0 & (1 << 7)) >> 3)|
+            ((l3 & (1 << 6)) >> 3)|
+            ((l2 & (1 << 6)) >> 4)|
+            ((l1 & (1 << 6)) >> 5)|
+            ((l0 & (1 << 6)) >> 6);
+
+	  outbuf[1] =		/* D5 C5 B5 A5 D4 C4 B4 A4 */
+            ((l3 & (1 << 5)) << 2)|
+            ((l2 & (1 << 5)) << 1)|
+            ((l1 & (1 << 5)) << 0)|
+            ((l0 & (1 << 5)) >> 1)|
+            ((l3 & (1 << 4)) >> 1)|
+            ((l2 & (1 << 4)) >> 2)|
+            ((l1 & (1 << 4)) >> 3)|
+            ((l0 & (1 << 4)) >> 4);
+
+	  outbuf[2] =		/* D3 C3 B3 A3 D2 C2 B2 A2 */
+            ((l3 & (1 << 3)) << 4)|
+            ((l2 & (1 << 3)) << 3)|
+            ((l1 & (1 << 3)) << 2)|
+            ((l0 & (1 << 3)) << 1)|
+            ((l3 & (1 << 2)) << 1)|
+            ((l2 & (1 << 2)) << 0)|
+            ((l1 & (1 << 2)) >> 1)|
+            ((l0 & (1 << 2)) >> 2);
+
+	  outbuf[3] =		/* D1 C1 B1 A1 D0 C0 B0 A0 */
+            ((l3 & (1 << 1)) << 6)|
+            ((l2 & (1 << 1)) << 5)|
+            ((l1 & (1 << 1)) << 4)|
+            ((l0 & (1 << 1)) << 3)|
+            ((l3 & (1 << 0)) << 3)|
+            ((l2 & (1 << 0)) << 2)|
+            ((l1 & (1 << 0)) << 1)|
+            ((l0 & (1 << 0)) << 0);
+	}
+      line++;
+      outbuf += 4;
+    }
+}
+
+static void
+ref_fold_8bit(const unsigned char *line,
+                int single_length,
+                unsigned char *outbuf)
+{
+  int i;
+  memset(outbuf, 0, single_length * 8);
+  for (i = 0; i < single_length; i++)
+    {
+      unsigned char l0 = line[0];
+      unsigned char l1 = line[single_length];
+      unsigned char l2 = line[single_length*2];
+      unsigned char l3 = line[single_length*3];
+      unsigned char l4 = line[single_length*4];
+      unsigned char l5 = line[single_length*5];
+      unsigned char l6 = line[single_length*6];
+      unsigned char l7 = line[single_length*7];
+      if (l0 || l1 || l2 || l3 || l4 || l5 || l6 || l7)
+	{
+	  outbuf[0] =		/* H7 G7 F7 E7 D7 C7 B7 A7 */
+            ((l7 & (1 << 7)) >> 0)|
+            ((l6 & (1 << 7)) >> 1)|
+            ((l5 & (1 << 7)) >> 2)|
+            ((l4 & (1 << 7)) >> 3)|
+            ((l3 & (1 << 7)) >> 4)|
+            ((l2 & (1 << 7)) >> 5)|
+            ((l1 & (1 << 7)) >> 6)|
+            ((l0 & (1 << 7)) >> 7);
+
+	  outbuf[1] =		/* H6 G6 F6 E6 D6 C6 B6 A6 */
+            ((l7 & (1 << 6)) << 1)|
+            ((l6 & (1 << 6)) >> 0)|
+            ((l5 & (1 << 6)) >> 1)|
+            ((l4 & (1 << 6)) >> 2)|
+            ((l3 & (1 << 6)) >> 3)|
+            ((l2 & (1 << 6)) >> 4)|
+            ((l1 & (1 << 6)) >> 5)|
+            ((l0 & (1 << 6)) >> 6);
+
+	  outbuf[2] =		/* H5 G5 F5 E5 D5 C5 B5 A5 */
+            ((l7 & (1 << 5)) << 2)|
+            ((l6 & (1 << 5)) << 1)|
+            ((l5 & (1 << 5)) >> 0)|
+            ((l4 & (1 << 5)) >> 1)|
+            ((l3 & (1 << 5)) >> 2)|
+            ((l2 & (1 << 5)) >> 3)|
+            ((l1 & (1 << 5)) >> 4)|
+            ((l0 & (1 << 5)) >> 5);
+
+	  outbuf[3] =		/* H4 G4 F4 E4 D4 C4 B4 A4 */
+            ((l7 & (1 << 4)) << 3)|
+            ((l6 & (1 << 4)) << 2)|
+            ((l5 & (1 << 4)) << 1)|
+            ((l4 & (1 << 4)) >> 0)|
+            ((l3 & (1 << 4)) >> 1)|
+            ((l2 & (1 << 4)) >> 2)|
+            ((l1 & (1 << 4)) >> 3)|
+            ((l0 & (1 << 4)) >> 4);
+	  outbuf[4] =		/* H3 G3 F3 E3 D3 C3 B3 A3 */
+            ((l7 & (1 << 3)) << 4)|
+            ((l6 & (1 << 3)) << 3)|
+            ((l5 & (1 << 3)) << 2)|
+            ((l4 & (1 << 3)) << 1)|
+            ((l3 & (1 << 3)) >> 0)|
+            ((l2 & (1 << 3)) >> 1)|
+            ((l1 & (1 << 3)) >> 2)|
+            ((l0 & (1 << 3)) >> 3);
+
+	  outbuf[5] =		/* H2 G2 F2 E2 D2 C2 B2 A2 */
+            ((l7 & (1 << 2)) << 5)|
+            ((l6 & (1 << 2)) << 4)|
+            ((l5 & (1 << 2)) << 3)|
+            ((l4 & (1 << 2)) << 2)|
+            ((l3 & (1 << 2)) << 1)|
+            ((l2 & (1 << 2)) >> 0)|
+            ((l1 & (1 << 2)) >> 1)|
+            ((l0 & (1 << 2)) >> 2);
+
+	  outbuf[6] =		/* H1 G1 F1 E1 D1 C1 B1 A1 */
+            ((l7 & (1 << 1)) << 6)|
+            ((l6 & (1 << 1)) << 5)|
+            ((l5 & (1 << 1)) << 4)|
+            ((l4 & (1 << 1)) << 3)|
+            ((l3 & (1 << 1)) << 2)|
+            ((l2 & (1 << 1)) << 1)|
+            ((l1 & (1 << 1)) >> 0)|
+            ((l0 & (1 << 1)) >> 1);
+
+	  outbuf[7] =		/* H0 G0 F0 E0 D0 C0 B0 A0 */
+            ((l7 & (1 << 0)) << 7)|
+            ((l6 & (1 << 0)) << 6)|
+            ((l5 & (1 << 0)) << 5)|
+            ((l4 & (1 << 0)) << 4)|
+            ((l3 & (1 << 0)) << 3)|
+            ((l2 & (1 << 0)) << 2)|
+            ((l1 & (1 << 0)) << 1)|
+            ((l0 & (1 << 0)) >> 0);
+	}
+      line++;
+      outbuf += 8;
+    }
+}
+
+#define SPLIT_MASK(k, b) (((1 << (b)) - 1) << ((k) * (b)))
+
+#define SPLIT_STEP(k, b, i, o, in, r, inc, rl)	\
+do						\
+  {						\
+    if (in & SPLIT_MASK(k, b))			\
+      {						\
+	o[r][i] |= SPLIT_MASK(k, b) & in;	\
+	r += inc;				\
+	if (r >= rl)				\
+	  r = 0;				\
+      }						\
+  } while (0)
+
+static void
+ref_split(int length,
+	  int bits,
+	  int n,
+	  const unsigned char *in,
+	  int increment,
+	  unsigned char **outs)
+{
+  int row = 0;
+  int limit = length * bits;
+  int rlimit = n * increment;
+  int i;
+  for (i = 1; i < n; i++)
+    memset(outs[i * increment], 0, limit);
+
+  if (bits == 1)
+    {
+      for (i = 0; i < limit; i++)
+	{
+	  unsigned char inbyte = in[i];
+	  outs[0][i] = 0;
+	  if (inbyte == 0)
+	    continue;
+	  /* For some reason gcc isn't unrolling this, even with -funroll-loops */
+	  SPLIT_STEP(0, 1, i, outs, inbyte, row, increment, rlimit);
+	  SPLIT_STEP(1, 1, i, outs, inbyte, row, increment, rlimit);
+	  SPLIT_STEP(2, 1, i, outs, inbyte, row, increment, rlimit);
+	  SPLIT_STEP(3, 1, i, outs, inbyte, row, increment, rlimit);
+	  SPLIT_STEP(4, 1, i, outs, inbyte, row, increment, rlimit);
+	  SPLIT_STEP(5, 1, i, outs, inbyte, row, increment, rlimit);
+	  SPLIT_STEP(6, 1, i, outs, inbyte, row, increment, rlimit);
+	  SPLIT_STEP(7, 1, i, outs, inbyte, row, increment, rlimit);
+	}
+    }
+  else
+    {
+      for (i = 0; i < limit; i++)
+	{
+	  unsigned char inbyte = in[i];
+	  outs[0][i] = 0;
+	  if (inbyte == 0)
+	    continue;
+	  /* For some reason gcc isn't unrolling this, even with -funroll-loops */
+	  SPLIT_STEP(0, 2, i, outs, inbyte, row, increment, rlimit);
+	  SPLIT_STEP(1, 2, i, outs, inbyte, row, increment, rlimit);
+	  SPLIT_STEP(2, 2, i, outs, inbyte, row, increment, rlimit);
+	  SPLIT_STEP(3, 2, i, outs, inbyte, row, increment, rlimit);
+	}
+    }
+}
+
+
+static void
+ref_unpack_2_1(int length,
+		const unsigned char *in,
+		unsigned char **outs)
+{
+  unsigned char	tempin, bit, temp0, temp1;
+
+  if (length <= 0)
+    return;
+  for (bit = 128, temp0 = 0, temp1 = 0;
+       length > 0;
+       length --)
+    {
+      tempin = *in++;
+
+      if (tempin & 128)
+        temp0 |= bit;
+      if (tempin & 64)
+        temp1 |= bit;
+      bit >>= 1;
+      if (tempin & 32)
+        temp0 |= bit;
+      if (tempin & 16)
+        temp1 |= bit;
+      bit >>= 1;
+      if (tempin & 8)
+        temp0 |= bit;
+      if (tempin & 4)
+        temp1 |= bit;
+      bit >>= 1;
+      if (tempin & 2)
+        temp0 |= bit;
+      if (tempin & 1)
+        temp1 |= bit;
+
+      if (bit > 1)
+        bit >>= 1;
+      else
+      {
+        bit     = 128;
+	*outs[0]++ = temp0;
+	*outs[1]++ = temp1;
+
+	temp0   = 0;
+	temp1   = 0;
+      }
+    }
+
+  if (bit < 128)
+    {
+      *outs[0]++ = temp0;
+      *outs[1]++ = temp1;
+    }
+}
+
+static void
+ref_unpack_2_2(int length,
+		const unsigned char *in,
+		unsigned char **outs)
+{
+  if (length <= 0)
+    return;
+
+  for (;length;length --)
+    {
+      unsigned char ti0, ti1;
+      ti0 = in[0];
+      ti1 = in[1];
+
+      *outs[0]++  = (ti0 & 0xc0) << 0
+	| (ti0 & 0x0c) << 2
+	| (ti1 & 0xc0) >> 4
+	| (ti1 & 0x0c) >> 2;
+      *outs[1]++  = (ti0 & 0x30) << 2
+	| (ti0 & 0x03) << 4
+	| (ti1 & 0x30) >> 2
+	| (ti1 & 0x03) >> 0;
+      in += 2;
+    }
+}
+
+static void
+ref_unpack_4_1(int length,
+		 const unsigned char *in,
+		 unsigned char **outs)
+{
+  unsigned char	tempin, bit, temp0, temp1, temp2, temp3;
+
+  if (length <= 0)
+    return;
+  for (bit = 128, temp0 = 0, temp1 = 0, temp2 = 0, temp3 = 0;
+       length > 0;
+       length --)
+    {
+      tempin = *in++;
+
+      if (tempin & 128)
+        temp0 |= bit;
+      if (tempin & 64)
+        temp1 |= bit;
+      if (tempin & 32)
+        temp2 |= bit;
+      if (tempin & 16)
+        temp3 |= bit;
+      bit >>= 1;
+      if (tempin & 8)
+        temp0 |= bit;
+      if (tempin & 4)
+        temp1 |= bit;
+      if (tempin & 2)
+        temp2 |= bit;
+      if (tempin & 1)
+        temp3 |= bit;
+
+      if (bit > 1)
+        bit >>= 1;
+      else
+      {
+        bit     = 128;
+	*outs[0]++ = temp0;
+	*outs[1]++ = temp1;
+	*outs[2]++ = temp2;
+	*outs[3]++ = temp3;
+
+	temp0   = 0;
+	temp1   = 0;
+	temp2   = 0;
+	temp3   = 0;
+      }
+    }
+
+  if (bit < 128)
+    {
+      *outs[0]++ = temp0;
+      *outs[1]++ = temp1;
+      *outs[2]++ = temp2;
+      *outs[3]++ = temp3;
+    }
+}
+
+static void
+ref_unpack_4_2(int length,
+		 const unsigned char *in,
+		 unsigned char **outs)
+{
+  unsigned char	tempin,
+		shift,
+		temp0,
+		temp1,
+		temp2,
+		temp3;
+
+  length *= 2;
+
+  for (shift = 0, temp0 = 0, temp1 = 0, temp2 = 0, temp3 = 0;
+       length > 0;
+       length --)
+    {
+     /*
+      * Note - we can't use (tempin & N) >> (shift - M) since negative
+      * right-shifts are not always implemented.
+      */
+
+      tempin = *in++;
+
+      if (tempin & 192)
+        temp0 |= (tempin & 192) >> shift;
+      if (tempin & 48)
+        temp1 |= ((tempin & 48) << 2) >> shift;
+      if (tempin & 12)
+        temp2 |= ((tempin & 12) << 4) >> shift;
+      if (tempin & 3)
+        temp3 |= ((tempin & 3) << 6) >> shift;
+
+      if (shift < 6)
+        shift += 2;
+      else
+      {
+        shift   = 0;
+	*outs[0]++ = temp0;
+	*outs[1]++ = temp1;
+	*outs[2]++ = temp2;
+	*outs[3]++ = temp3;
+
+	temp0   = 0;
+	temp1   = 0;
+	temp2   = 0;
+	temp3   = 0;
+      }
+    }
+
+  if (shift)
+    {
+      *outs[0]++ = temp0;
+      *outs[1]++ = temp1;
+      *outs[2]++ = temp2;
+      *outs[3]++ = temp3;
+    }
+}
+
+static void
+ref_unpack_8_1(int length,
+		const unsigned char *in,
+		unsigned char **outs)
+{
+  unsigned char	tempin, bit, temp0, temp1, temp2, temp3, temp4, temp5, temp6,
+    temp7;
+
+  if (length <= 0)
+    return;
+
+  for (bit = 128, temp0 = 0, temp1 = 0, temp2 = 0,
+       temp3 = 0, temp4 = 0, temp5 = 0, temp6 = 0, temp7 = 0;
+       length > 0;
+       length --)
+    {
+      tempin = *in++;
+
+      if (tempin & 128)
+        temp0 |= bit;
+      if (tempin & 64)
+        temp1 |= bit;
+      if (tempin & 32)
+        temp2 |= bit;
+      if (tempin & 16)
+        temp3 |= bit;
+      if (tempin & 8)
+        temp4 |= bit;
+      if (tempin & 4)
+        temp5 |= bit;
+      if (tempin & 2)
+        temp6 |= bit;
+      if (tempin & 1)
+        temp7 |= bit;
+
+      if (bit > 1)
+        bit >>= 1;
+      else
+      {
+        bit     = 128;
+	*outs[0]++ = temp0;
+	*outs[1]++ = temp1;
+	*outs[2]++ = temp2;
+	*outs[3]++ = temp3;
+	*outs[4]++ = temp4;
+	*outs[5]++ = temp5;
+	*outs[6]++ = temp6;
+	*outs[7]++ = temp7;
+
+	temp0   = 0;
+	temp1   = 0;
+	temp2   = 0;
+	temp3   = 0;
+	temp4   = 0;
+	temp5   = 0;
+	temp6   = 0;
+	temp7   = 0;
+      }
+    }
+
+  if (bit < 128)
+    {
+      *outs[0]++ = temp0;
+      *outs[1]++ = temp1;
+      *outs[2]++ = temp2;
+      *outs[3]++ = temp3;
+      *outs[4]++ = temp4;
+      *outs[5]++ = temp5;
+      *outs[6]++ = temp6;
+      *outs[7]++ = temp7;
+    }
+}
+
+static void
+ref_unpack_8_2(int length,
+		const unsigned char *in,
+		unsigned char **outs)
+{
+  unsigned char	tempin,
+		shift,
+		temp0,
+		temp1,
+		temp2,
+		temp3,
+		temp4,
+		temp5,
+		temp6,
+		temp7;
+
+
+  for (shift = 0, temp0 = 0, temp1 = 0,
+       temp2 = 0, temp3 = 0, temp4 = 0, temp5 = 0, temp6 = 0, temp7 = 0;
+       length > 0;
+       length --)
+    {
+     /*
+      * Note - we can't use (tempin & N) >> (shift - M) since negative
+      * right-shifts are not always implemented.
+      */
+
+      tempin = *in++;
+
+      if (tempin & 192)
+        temp0 |= (tempin & 192) >> shift;
+      if (tempin & 48)
+        temp1 |= ((tempin & 48) << 2) >> shift;
+      if (tempin & 12)
+        temp2 |= ((tempin & 12) << 4) >> shift;
+      if (tempin & 3)
+        temp3 |= ((tempin & 3) << 6) >> shift;
+
+      tempin = *in++;
+
+      if (tempin & 192)
+        temp4 |= (tempin & 192) >> shift;
+      if (tempin & 48)
+        temp5 |= ((tempin & 48) << 2) >> shift;
+      if (tempin & 12)
+        temp6 |= ((tempin & 12) << 4) >> shift;
+      if (tempin & 3)
+        temp7 |= ((tempin & 3) << 6) >> shift;
+
+      if (shift < 6)
+        shift += 2;
+      else
+      {
+        shift   = 0;
+	*outs[0]++ = temp0;
+	*outs[1]++ = temp1;
+	*outs[2]++ = temp2;
+	*outs[3]++ = temp3;
+	*outs[4]++ = temp4;
+	*outs[5]++ = temp5;
+	*outs[6]++ = temp6;
+	*outs[7]++ = temp7;
+
+	temp0   = 0;
+	temp1   = 0;
+	temp2   = 0;
+	temp3   = 0;
+	temp4   = 0;
+	temp5   = 0;
+	temp6   = 0;
+	temp7   = 0;
+      }
+    }
+
+  if (shift)
+    {
+      *outs[0]++ = temp0;
+      *outs[1]++ = temp1;
+      *outs[2]++ = temp2;
+      *outs[3]++ = temp3;
+      *outs[4]++ = temp4;
+      *outs[5]++ = temp5;
+      *outs[6]++ = temp6;
+      *outs[7]++ = temp7;
+    }
+}
+
+static void
+ref_unpack_16_1(int length,
+		 const unsigned char *in,
+		 unsigned char **outs)
+{
+  unsigned char	tempin, bit;
+  unsigned char temp[16];
+  int j;
+
+  if (length <= 0)
+    return;
+
+  memset(temp, 0, 16);
+
+  for (bit = 128; length > 0; length--)
+    {
+      tempin = *in++;
+
+      if (tempin & 128)
+        temp[0] |= bit;
+      if (tempin & 64)
+        temp[1] |= bit;
+      if (tempin & 32)
+        temp[2] |= bit;
+      if (tempin & 16)
+        temp[3] |= bit;
+      if (tempin & 8)
+        temp[4] |= bit;
+      if (tempin & 4)
+        temp[5] |= bit;
+      if (tempin & 2)
+        temp[6] |= bit;
+      if (tempin & 1)
+        temp[7] |= bit;
+
+      tempin = *in++;
+
+      if (tempin & 128)
+	temp[8] |= bit;
+      if (tempin & 64)
+	temp[9] |= bit;
+      if (tempin & 32)
+	temp[10] |= bit;
+      if (tempin & 16)
+	temp[11] |= bit;
+      if (tempin & 8)
+	temp[12] |= bit;
+      if (tempin & 4)
+	temp[13] |= bit;
+      if (tempin & 2)
+	temp[14] |= bit;
+      if (tempin & 1)
+	temp[15] |= bit;
+
+      if (bit > 1)
+        bit >>= 1;
+      else
+	{
+	  bit     = 128;
+	  for (j = 0; j < 16; j++)
+	    *outs[j]++ = temp[j];
+
+	  memset(temp, 0, 16);
+	}
+    }
+
+  if (bit < 128)
+    for (j = 0; j < 16; j++)
+      *outs[j]++ = temp[j];
+}
+
+static void
+ref_unpack_16_2(int length,
+		 const unsigned char *in,
+		 unsigned char **outs)
+{
+  unsigned char	tempin, shift;
+  unsigned char temp[16];
+  int j;
+
+  if (length <= 0)
+    return;
+
+  memset(temp, 0, 16);
+
+  for (shift = 0; length > 0; length--)
+    {
+      /*
+       * Note - we can't use (tempin & N) >> (shift - M) since negative
+       * right-shifts are not always implemented.
+       */
+
+      tempin = *in++;
+
+      if (tempin & 192)
+        temp[0] |= (tempin & 192) >> shift;
+      if (tempin & 48)
+        temp[1] |= ((tempin & 48) << 2) >> shift;
+      if (tempin & 12)
+        temp[2] |= ((tempin & 12) << 4) >> shift;
+      if (tempin & 3)
+        temp[3] |= ((tempin & 3) << 6) >> shift;
+
+      tempin = *in++;
+
+      if (tempin & 192)
+        temp[4] |= (tempin & 192) >> shift;
+      if (tempin & 48)
+        temp[5] |= ((tempin & 48) << 2) >> shift;
+      if (tempin & 12)
+        temp[6] |= ((tempin & 12) << 4) >> shift;
+      if (tempin & 3)
+        temp[7] |= ((tempin & 3) << 6) >> shift;
+
+      if (length-- > 0)
+	{
+	  tempin = *in++;
+
+	  if (tempin & 192)
+	    temp[8] |= (tempin & 192) >> shift;
+	  if (tempin & 48)
+	    temp[9] |= ((tempin & 48) << 2) >> shift;
+	  if (tempin & 12)
+	    temp[10] |= ((tempin & 12) << 4) >> shift;
+	  if (tempin & 3)
+	    temp[11] |= ((tempin & 3) << 6) >> shift;
+
+	  tempin = *in++;
+
+	  if (tempin & 192)
+	    temp[12] |= (tempin & 192) >> shift;
+	  if (tempin & 48)
+	    temp[13] |= ((tempin & 48) << 2) >> shift;
+	  if (tempin & 12)
+	    temp[14] |= ((tempin & 12) << 4) >> shift;
+	  if (tempin & 3)
+	    temp[15] |= ((tempin & 3) << 6) >> shift;
+	}
+
+      if (shift < 6)
+        shift += 2;
+      else
+	{
+	  shift   = 0;
+	  for (j = 0; j < 16; j++)
+	    *outs[j]++ = temp[j];
+
+	  memset(temp, 0, 16);
+	}
+    }
+
+  if (shift)
+    for (j = 0; j < 16; j++)
+      *outs[j]++ = temp[j];
+}
+
+
+static void
+ref_find_first_and_last(const unsigned char *line, int length,
+			int *first, int *last)
+{
+  int found_first = 0;
+  int f = 0;
+  int l = 0;
+  for (f = 0; f < length; f++)
+    {
+      if (line[f])
+	{
+	  found_first = 1;
+	  break;
+	}
+    }
+  *first = f;
+  if (!found_first)
+    {
+      *last = 0;
+      return;
+    }
+  for (l = length - 1; l >= f; l--)
+    if (line[l])
+      break;
+  ;
+  *last = l;
+}
+
+static int
+ref_pack_tiff(const unsigned char *line,
+	      int length,
+	      unsigned char *comp_buf,
+	      unsigned char **comp_ptr,
+	      int *first,
+	      int *last)
+{
+  unsigned char *comp_pti = comp_buf;
+  if (first && last)
+    ref_find_first_and_last(line, length, first, last);
+
+  /*
+   * Compress using TIFF "packbits" run-length encoding...
+   */
+
+  while (length > 0)
+    {
+      const unsigned char *start = line;	/* Start of compressed data */
+      unsigned char repeat;		/* Repeating char */
+      int count;			/* Count of compressed bytes */
+      /*
+       * Get a run of at least 3 non-repeated chars...
+       */
+
+      line   += 2;
+      length -= 2;
+
+      while (length > 0 && (line[-2] != line[-1] || line[-1] != line[0]))
+	{
+	  line ++;
+	  length --;
+	}
+
+      line   -= 2;
+      length += 2;
+
+      /*
+       * Output the non-repeated sequences (max 128 at a time).
+       */
+
+      count = line - start;
+      while (count > 0)
+	{
+	  int tcount = count > 128 ? 128 : count;
+
+	  comp_pti[0] = tcount - 1;
+	  memcpy(comp_pti + 1, start, tcount);
+
+	  comp_pti += tcount + 1;
+	  start    += tcount;
+	  count    -= tcount;
+	}
+
+      if (length <= 0)
+	break;
+
+      /*
+       * Find the repeated sequences...
+       */
+
+      start  = line;
+      repeat = line[0];
+
+      line ++;
+      length --;
+
+      while (length > 0 && *line == repeat)
+	{
+	  line++;
+	  length--;
+	}
+
+      /*
+       * Output the repeated sequences (max 128 at a time).
+       */
+
+      count = line - start;
+      while (count > 0)
+	{
+	  int tcount = count > 128 ? 128 : count;
+
+	  comp_pti[0] = 1 - tcount;
+	  comp_pti[1] = repeat;
+
+	  comp_pti += 2;
+	  count    -= tcount;
+	}
+    }
+  (*comp_ptr) = comp_pti;
+
+  if (first && last && *first > *last)
+    return 0;
+  else
+    return 1;
+}
+
+static void
+ref_unpack(int length, int bits, int n, const unsigned char *in,
+	   unsigned char **outs)
+{
+  unsigned char *touts[16];
+  int i;
+  for (i = 0; i < n; i++)
+    touts[i] = outs[i];
+  if (bits == 1)
+    switch (n)
+      {
+      case 2:
+	ref_unpack_2_1(length, in, touts);
+	break;
+      case 4:
+	ref_unpack_4_1(length, in, touts);
+	break;
+      case 8:
+	ref_unpack_8_1(length, in, touts);
+	break;
+      case 16:
+	ref_unpack_16_1(length, in, touts);
+	break;
+      }
+  else
+    switch (n)
+      {
+      case 2:
+	ref_unpack_2_2(length, in, touts);
+	break;
+      case 4:
+	ref_unpack_4_2(length, in, touts);
+	break;
+      case 8:
+	ref_unpack_8_2(length, in, touts);
+	break;
+      case 16:
+	ref_unpack_16_2(length, in, touts);
+	break;
+      }
+}
+
+typedef void (*fold_func_t)(const unsigned char *, int, unsigned char *);
+
+typedef struct
+{
+  const char *name;
+  int planes;
+  fold_func_t ref;
+  fold_func_t test;
+} fold_case_t;
+
+static const fold_case_t fold_cases[] =
+{
+  { "fold", 2, ref_fold, stp_fold },
+  { "fold_3bit", 3, ref_fold_3bit, stp_fold_3bit },
+  { "fold_4bit", 4, ref_fold_4bit, stp_fold_4bit },
+  { "fold_8bit", 8, ref_fold_8bit, stp_fold_8bit },
+};
+
+/* Percentage of nonzero input bytes to test with */
+static const int densities[] = { 10, 50, 100 };
+
+#define BUFSIZE(len) (16 * (len) + 64)
+
+static int failures = 0;
+static int check_only = 0;
+static int check_len = 0;
+
+static double
+now(void)
+{
+  struct timeval tv;
+  (void) gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+fill(unsigned char *buf, int len, int density)
+{
+  int i;
+  for (i = 0; i < len; i++)
+    buf[i] = (rand() % 100 < density) ? (rand() % 255) + 1 : 0;
+}
+
+static void
+report(const char *name, int density, double ref_time, double test_time,
+       int ok)
+{
+  char set[16] = "";
+  if (!ok)
+    failures++;
+  if (density >= 0)
+    (void) snprintf(set, sizeof(set), "%3d%%", density);
+  if (check_only)
+    {
+      if (!ok)
+	printf("%-14s %4s  MISMATCH at %d bytes\n", name, set, check_len);
+      return;
+    }
+  printf("%-14s %4s  %8.3f ms  %8.3f ms  %5.2fx%s\n", name, set,
+	 ref_time * 1000, test_time * 1000, ref_time / test_time,
+	 ok ? "" : "  MISMATCH");
+}
+
+static void
+bench_fold(const fold_case_t *c, int len, int iterations, int density)
+{
+  unsigned char *in = malloc(len * c->planes);
+  unsigned char *ref_out = malloc(BUFSIZE(len));
+  unsigned char *test_out = malloc(BUFSIZE(len));
+  double start, ref_time, test_time;
+  int i, ok;
+
+  fill(in, len * c->planes, density);
+  memset(ref_out, 0x5a, BUFSIZE(len));
+  memset(test_out, 0x5a, BUFSIZE(len));
+  start = now();
+  for (i = 0; i < iterations; i++)
+    (c->ref)(in, len, ref_out);
+  ref_time = now() - start;
+  start = now();
+  for (i = 0; i < iterations; i++)
+    (c->test)(in, len, test_out);
+  test_time = now() - start;
+  ok = !memcmp(ref_out, test_out, BUFSIZE(len));
+  report(c->name, density, ref_time, test_time, ok);
+  free(in);
+  free(ref_out);
+  free(test_out);
+}
+
+static void
+bench_split(int bits, int n, int increment, int len, int iterations,
+	    int density)
+{
+  unsigned char *in = malloc(len * bits);
+  unsigned char *ref_buf = malloc(BUFSIZE(len) * n * increment);
+  unsigned char *test_buf = malloc(BUFSIZE(len) * n * increment);
+  unsigned char *ref_outs[32];
+  unsigned char *test_outs[32];
+  double start, ref_time, test_time;
+  char name[32];
+  int i, ok;
+
+  for (i = 0; i < n * increment; i++)
+    {
+      ref_outs[i] = ref_buf + i * BUFSIZE(len);
+      test_outs[i] = test_buf + i * BUFSIZE(len);
+    }
+  fill(in, len * bits, density);
+  memset(ref_buf, 0x5a, BUFSIZE(len) * n * increment);
+  memset(test_buf, 0x5a, BUFSIZE(len) * n * increment);
+  start = now();
+  for (i = 0; i < iterations; i++)
+    ref_split(len, bits, n, in, increment, ref_outs);
+  ref_time = now() - start;
+  start = now();
+  for (i = 0; i < iterations; i++)
+    stp_split(len, bits, n, in, increment, test_outs);
+  test_time = now() - start;
+  ok = !memcmp(ref_buf, test_buf, BUFSIZE(len) * n * increment);
+  (void) snprintf(name, sizeof(name), "split_%d_%d/%d", n, bits, increment);
+  report(name, density, ref_time, test_time, ok);
+  free(in);
+  free(ref_buf);
+  free(test_buf);
+}
+
+static void
+bench_unpack(int bits, int n, int len, int iterations, int density)
+{
+  unsigned char *in = malloc(BUFSIZE(len));
+  unsigned char *ref_buf = malloc(BUFSIZE(len) * n);
+  unsigned char *test_buf = malloc(BUFSIZE(len) * n);
+  unsigned char *ref_outs[16];
+  unsigned char *test_outs[16];
+  double start, ref_time, test_time;
+  char name[32];
+  int i, ok;
+
+  for (i = 0; i < n; i++)
+    {
+      ref_outs[i] = ref_buf + i * BUFSIZE(len);
+      test_outs[i] = test_buf + i * BUFSIZE(len);
+    }
+  fill(in, BUFSIZE(len), density);
+  memset(ref_buf, 0x5a, BUFSIZE(len) * n);
+  memset(test_buf, 0x5a, BUFSIZE(len) * n);
+  start = now();
+  for (i = 0; i < iterations; i++)
+    ref_unpack(len, bits, n, in, ref_outs);
+  ref_time = now() - start;
+  start = now();
+  for (i = 0; i < iterations; i++)
+    stp_unpack(len, bits, n, in, test_outs);
+  test_time = now() - start;
+  ok = !memcmp(ref_buf, test_buf, BUFSIZE(len) * n);
+  (void) snprintf(name, sizeof(name), "unpack_%d_%d", n, bits);
+  report(name, density, ref_time, test_time, ok);
+  free(in);
+  free(ref_buf);
+  free(test_buf);
+}
+
+/*
+ * Rows like the ones testpattern's gradients and pages produce once
+ * dithered, from blank ones to solid ones.
+ */
+typedef enum
+{
+  ROW_BLANK,
+  ROW_MARGINS,
+  ROW_CD,
+  ROW_TEXT,
+  ROW_DITHER,
+  ROW_SOLID
+} row_type_t;
+
+static const char *const row_names[] =
+  { "blank", "margins", "cd", "text", "dither", "solid" };
+
+#define PACK_ROWS 64
+
+static void
+fill_row(unsigned char *row, int len, row_type_t type, int y)
+{
+  int i;
+  memset(row, 0, len);
+  switch (type)
+    {
+    case ROW_BLANK:
+      break;
+    case ROW_MARGINS:
+      fill(row + len / 8, len - len / 4, 50);
+      break;
+    case ROW_CD:
+      /* A ring: content on either side of a blank hub */
+      fill(row + len / 8, len / 4, 60);
+      fill(row + len - len / 8 - len / 4, len / 4, 60);
+      break;
+    case ROW_TEXT:
+      for (i = 0; i < len; i += 24 + rand() % 40)
+	memset(row + i, 0xff, (len - i) < 8 ? len - i : rand() % 8);
+      break;
+    case ROW_DITHER:
+      /* Density rises across the row and down the page */
+      for (i = 0; i < len; i++)
+	row[i] = (rand() % len < (i + y * len / PACK_ROWS) / 2) ?
+	  rand() & 0xff : 0;
+      break;
+    case ROW_SOLID:
+      memset(row, 0xff, len);
+      break;
+    }
+}
+
+static void
+bench_pack_rows(const char *name, const unsigned char *rows, int nrows,
+		int len, int iterations)
+{
+  unsigned char *ref_out = malloc(len * 2 + 16);
+  unsigned char *test_out = malloc(len * 2 + 16);
+  unsigned char *ref_ptr, *test_ptr;
+  double start, ref_time, test_time;
+  int ref_first, ref_last, test_first, test_last;
+  int i, y, ok = 1;
+
+  start = now();
+  for (i = 0; i < iterations; i++)
+    for (y = 0; y < nrows; y++)
+      ref_pack_tiff(rows + y * len, len, ref_out, &ref_ptr,
+		    &ref_first, &ref_last);
+  ref_time = now() - start;
+  start = now();
+  for (i = 0; i < iterations; i++)
+    for (y = 0; y < nrows; y++)
+      stp_pack_tiff(NULL, rows + y * len, len, test_out, &test_ptr,
+		    &test_first, &test_last);
+  test_time = now() - start;
+  for (y = 0; y < nrows; y++)
+    {
+      int ref_ret = ref_pack_tiff(rows + y * len, len, ref_out, &ref_ptr,
+				  &ref_first, &ref_last);
+      int test_ret = stp_pack_tiff(NULL, rows + y * len, len, test_out,
+				   &test_ptr, &test_first, &test_last);
+      if (ref_ret != test_ret || ref_first != test_first ||
+	  ref_last != test_last || ref_ptr - ref_out != test_ptr - test_out ||
+	  memcmp(ref_out, test_out, ref_ptr - ref_out))
+	ok = 0;
+    }
+  report(name, -1, ref_time, test_time, ok);
+  free(ref_out);
+  free(test_out);
+}
+
+static void
+bench_pack(row_type_t type, int len, int iterations)
+{
+  unsigned char *rows = malloc(len * PACK_ROWS);
+  char name[32];
+  int y;
+
+  for (y = 0; y < PACK_ROWS; y++)
+    fill_row(rows + y * len, len, type, y);
+  (void) snprintf(name, sizeof(name), "pack_%s", row_names[type]);
+  bench_pack_rows(name, rows, PACK_ROWS, len, iterations / 16 + 1);
+  free(rows);
+}
+
+/*
+ * Rows of random runs and literals, with blank margins of random width,
+ * so that runs and literals start and end at every offset within a
+ * vector block and at the ends of the row.
+ */
+static void
+check_pack_random(int len)
+{
+  unsigned char *rows = malloc(len * PACK_ROWS);
+  int y;
+
+  for (y = 0; y < PACK_ROWS; y++)
+    {
+      unsigned char *row = rows + y * len;
+      int left = rand() % (len + 1);
+      int right = left + rand() % (len - left + 1);
+      int i = left;
+      memset(row, 0, len);
+      while (i < right)
+	{
+	  int run = 1 + rand() % (rand() % 4 ? 4 : 40);
+	  if (run > right - i)
+	    run = right - i;
+	  if (rand() % 2)
+	    memset(row + i, rand() & 0xff, run);
+	  else
+	    fill(row + i, run, 90);
+	  i += run;
+	}
+    }
+  bench_pack_rows("pack_random", rows, PACK_ROWS, len, 1);
+  free(rows);
+}
+
+/*
+ * Pack a file of raw rows, such as the bit planes a driver sends.
+ */
+static void
+bench_pack_file(const char *file, int len, int iterations)
+{
+  FILE *fp = fopen(file, "rb");
+  unsigned char *rows = NULL;
+  size_t size = 0;
+  size_t nread;
+  unsigned char buf[65536];
+
+  if (!fp)
+    {
+      perror(file);
+      failures++;
+      return;
+    }
+  while ((nread = fread(buf, 1, sizeof(buf), fp)) > 0)
+    {
+      rows = realloc(rows, size + nread);
+      memcpy(rows + size, buf, nread);
+      size += nread;
+    }
+  fclose(fp);
+  if (size >= len)
+    bench_pack_rows("pack_file", rows, size / len, len,
+		    iterations / 16 + 1);
+  free(rows);
+}
+
+static void
+run_all(int len, int iterations)
+{
+  int i, j, n, bits;
+
+  for (j = 0; j < sizeof(densities) / sizeof(int); j++)
+    {
+      for (i = 0; i < sizeof(fold_cases) / sizeof(fold_case_t); i++)
+	bench_fold(&fold_cases[i], len, iterations, densities[j]);
+      for (bits = 1; bits <= 2; bits++)
+	for (n = 2; n <= 8; n *= 2)
+	  bench_split(bits, n, n == 2 ? 2 : 1, len, iterations, densities[j]);
+      for (bits = 1; bits <= 2; bits++)
+	for (n = 2; n <= 16; n *= 2)
+	  bench_unpack(bits, n, len, iterations, densities[j]);
+    }
+  for (i = ROW_BLANK; i <= ROW_SOLID; i++)
+    bench_pack(i, len, iterations);
+}
+
+/*
+ * Widths up to four 16-byte blocks catch every tail length of the
+ * vector loops; the longer ones are odd so that they do too.
+ */
+static const int check_widths[] = { 127, 129, 255, 1441, 4097 };
+
+int
+main(int argc, char **argv)
+{
+  int len, iterations;
+  int i;
+
+  if (argc == 2 && !strcmp(argv[1], "-c"))
+    {
+      stp_init();
+      srand(1);
+      check_only = 1;
+      for (check_len = 1; check_len <= 64; check_len++)
+	{
+	  run_all(check_len, 1);
+	  check_pack_random(check_len);
+	}
+      for (i = 0; i < sizeof(check_widths) / sizeof(int); i++)
+	{
+	  check_len = check_widths[i];
+	  run_all(check_len, 1);
+	  check_pack_random(check_len);
+	}
+      printf("%d mismatches\n", failures);
+      return failures ? 1 : 0;
+    }
+  len = argc > 1 ? atoi(argv[1]) : 1441;
+  iterations = argc > 2 ? atoi(argv[2]) : 2000;
+  if (len <= 0 || iterations <= 0)
+    {
+      fprintf(stderr, "Usage: %s [row bytes [iterations [raw rows]]]\n"
+	      "       %s -c\n", argv[0], argv[0]);
+      return 2;
+    }
+  stp_init();
+  srand(1);
+  printf("%d bytes, %d iterations\n", len, iterations);
+  printf("%-14s %4s  %11s  %11s  %6s\n",
+	 "function", "set", "old", "new", "ratio");
+  run_all(len, iterations);
+  if (argc > 3)
+    bench_pack_file(argv[3], len, iterations);
+  if (failures)
+    {
+      printf("%d mismatches\n", failures);
+      return 1;
+    }
+  return 0;
+}
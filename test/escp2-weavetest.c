@@ -53,6 +53,10 @@
  * correctness checks:
  *
  * 1) No pass starts (logically) at a later row than an earlier pass.
+ *
+ * With -b, instead of checking the weave we time the row lookups that
+ * stp_write_weave() does, once with the precomputed weave table and once
+ * computing every row (STP_WEAVE_TABLE=0), and report rows per second.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -63,6 +67,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <limits.h>
+#include <sys/time.h>
 
 #define DEBUG_SIGNAL
 #define MIN(x, y) ((x) <= (y) ? (x) : (y))
@@ -475,6 +480,108 @@ run_weavetest_from_cmdline(int argc, char **argv)
     }
 }
 
+static double
+bench_now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static double
+time_one_weave(int physjets, int physsep, int hpasses, int vpasses,
+	       int subpasses, int nrows, int strategy, int use_table,
+	       unsigned long *checksum)
+{
+  stp_vars_t *v = stp_vars_create();
+  int head_offset[8];
+  int subpass_count = hpasses * vpasses * subpasses;
+  int i, j;
+  double start;
+  stp_weave_t w;
+
+  memset(head_offset, 0, sizeof(head_offset));
+  setenv("STP_WEAVE_TABLE", use_table ? "1" : "0", 1);
+  start = bench_now();
+  stp_initialize_weave(v, physjets, physsep, hpasses, vpasses, subpasses,
+		       7, 1, 128, nrows, 0, nrows, head_offset, strategy,
+		       flush_pass, stp_fill_tiff, stp_pack_tiff,
+		       stp_compute_tiff_linewidth);
+  *checksum = 0;
+  for (i = 0; i < nrows; i++)
+    for (j = 0; j < subpass_count; j++)
+      {
+	stp_weave_parameters_by_row(v, i, j, &w);
+	*checksum = *checksum * 31 + w.pass * 7 + w.jet * 3 +
+	  w.logicalpassstart + w.physpassend + w.missingstartrows;
+      }
+  start = bench_now() - start;
+  stp_vars_destroy(v);
+  return start;
+}
+
+static int
+bench_one_weave(int physjets, int physsep, int hpasses, int vpasses,
+		int subpasses, int nrows, int strategy)
+{
+  unsigned long sum_direct, sum_table;
+  double t_direct, t_table;
+
+  t_direct = time_one_weave(physjets, physsep, hpasses, vpasses, subpasses,
+			    nrows, strategy, 0, &sum_direct);
+  t_table = time_one_weave(physjets, physsep, hpasses, vpasses, subpasses,
+			   nrows, strategy, 1, &sum_table);
+  if (t_direct <= 0)
+    t_direct = 1e-6;
+  if (t_table <= 0)
+    t_table = 1e-6;
+  printf("%4d %4d %2d %2d %2d %2d %12.0f %12.0f %6.2fx%s\n",
+	 physjets, physsep, hpasses, vpasses, subpasses, strategy,
+	 nrows / t_direct, nrows / t_table, t_direct / t_table,
+	 sum_direct == sum_table ? "" : "  MISMATCH");
+  return sum_direct != sum_table;
+}
+
+static int
+run_weave_benchmark(int argc, char **argv)
+{
+  static const int weaves[][6] =
+    {				/* jets sep hpasses vpasses subpasses strategy */
+      {  32, 8, 1, 1, 1, 0 },
+      {  48, 6, 2, 2, 1, 0 },
+      {  96, 2, 2, 4, 1, 1 },
+      { 180, 2, 2, 4, 2, 0 },
+      { 180, 4, 2, 8, 1, 4 },
+      { 360, 2, 1, 4, 1, 0 },
+    };
+  int nrows = 20000;
+  int failures = 0;
+  int i;
+
+  if (argc != 2 && argc != 3 && argc != 9)
+    {
+      fprintf(stderr, "Usage: %s -b [rows [jets separation hpasses vpasses subpasses strategy]]\n",
+	      argv[0]);
+      return 2;
+    }
+  if (argc > 2)
+    nrows = atoi(argv[2]);
+  if (nrows < 1)
+    nrows = 1;
+  printf("%4s %4s %2s %2s %2s %2s %12s %12s %7s\n", "jets", "sep",
+	 "hp", "vp", "sp", "st", "rows/s", "table rows/s", "speedup");
+  if (argc == 9)
+    failures = bench_one_weave(atoi(argv[3]), atoi(argv[4]), atoi(argv[5]),
+			       atoi(argv[6]), atoi(argv[7]), nrows,
+			       atoi(argv[8]));
+  else
+    for (i = 0; i < sizeof(weaves) / sizeof(weaves[0]); i++)
+      failures += bench_one_weave(weaves[i][0], weaves[i][1], weaves[i][2],
+				  weaves[i][3], weaves[i][4], nrows,
+				  weaves[i][5]);
+  return failures ? 1 : 0;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -482,6 +589,8 @@ main(int argc, char **argv)
 
   if (argc == 1)
     return run_weavetest_from_stdin();
+  else if (!strcmp(argv[1], "-b"))
+    return run_weave_benchmark(argc, argv);
   else
     return run_weavetest_from_cmdline(argc, argv);
 }
@@ -271,6 +271,8 @@ int decode_tiff (char *in_buffer, int data_length, char *decode_buf,
                  int maxlen);
 int decode_delta (char *in_buffer, int data_length, char *decode_buf,
 		  int maxlen);
+int decode_crdr (char *in_buffer, int data_length, char *decode_buf,
+		 int maxlen);
 void pcl_reset (image_t *i);
 int depth_to_rows (int depth);
 
@@ -920,6 +922,76 @@ int decode_delta(char *in_buffer,		/* I: Data buffer */
     return(dpos);
 }
 
+/*
+ * decode_crdr() - Uncompress a compressed replacement delta row buffer
+ */
+
+int decode_crdr(char *in_buffer,		/* I: Data buffer */
+		int data_length,		/* I: Length of data */
+		char *decode_buf,		/* I/O: decoded data */
+		int maxlen)			/* I: Max length of decode_buf */
+{
+    unsigned command_byte = 0;
+    unsigned offset_from_last = 0;
+    unsigned replace_count = 0;
+    unsigned next_byte = 0;
+    int repeat;
+
+    int pos = 0;
+    int dpos = 0;
+
+    while(pos < data_length) {
+
+	command_byte = (unsigned char) in_buffer[pos++];
+	repeat = (command_byte & 0x80) != 0;
+	if (repeat) {
+	    offset_from_last = (command_byte >> 5) & 3;
+	    replace_count = command_byte & 31;
+	}
+	else {
+	    offset_from_last = (command_byte >> 3) & 15;
+	    replace_count = command_byte & 7;
+	}
+	if (offset_from_last == (repeat ? 3 : 15)) {
+	    do {
+		next_byte = (unsigned char) in_buffer[pos++];
+		offset_from_last += next_byte;
+	    } while (next_byte == 0xff && pos < data_length);
+	}
+	if (replace_count == (repeat ? 31 : 7)) {
+	    do {
+		next_byte = (unsigned char) in_buffer[pos++];
+		replace_count += next_byte;
+	    } while (next_byte == 0xff && pos < data_length);
+	}
+	replace_count += repeat ? 2 : 1;
+	dpos += offset_from_last;
+	if (dpos + replace_count > maxlen) {
+	    fprintf(stderr, "ERROR: data overrun in CRDR (offset %d, count %d, max %d)\n",
+		    dpos, replace_count, maxlen);
+	    break;
+	}
+	if (repeat) {
+	    if (pos >= data_length) {
+		fprintf(stderr, "ERROR: missing repeated byte in CRDR\n");
+		break;
+	    }
+	    (void) memset(decode_buf + dpos, in_buffer[pos++], replace_count);
+	}
+	else {
+	    if (data_length - pos < replace_count) {
+		fprintf(stderr, "ERROR: data overrun in CRDR (count %d, remaining %d)\n",
+			replace_count, data_length - pos);
+		break;
+	    }
+	    (void) memcpy(decode_buf + dpos, in_buffer + pos, replace_count);
+	    pos += replace_count;
+	}
+	dpos += replace_count;
+    }
+    return(dpos);
+}
+
 /*
  * pcl_reset() - Rest image parameters to default
  */
@@ -1173,9 +1245,10 @@ int main(int argc, char *argv[])
 
 		if (image_data.compression_type != PCL_COMPRESSION_NONE &&
 		    image_data.compression_type != PCL_COMPRESSION_TIFF &&
-		    image_data.compression_type != PCL_COMPRESSION_DELTA) {
+		    image_data.compression_type != PCL_COMPRESSION_DELTA &&
+		    image_data.compression_type != PCL_COMPRESSION_CRDR) {
 		    fprintf(stderr,
-			"Sorry, only 'no compression' or 'tiff compression' handled.\n");
+			"Sorry, only uncompressed, TIFF, delta row or CRDR data handled.\n");
 		    i++;
 		}
 
@@ -2012,6 +2085,9 @@ int main(int argc, char *argv[])
 		    else if (image_data.compression_type == PCL_COMPRESSION_DELTA) {
 			output_data.active_length = decode_delta(data_buffer, numeric_arg, received_rows[current_data_row], output_data.buffer_length * output_data.input_depth * output_data.pixels_depth);
 		    }
+		    else if (image_data.compression_type == PCL_COMPRESSION_CRDR) {
+			output_data.active_length = decode_crdr(data_buffer, numeric_arg, received_rows[current_data_row], output_data.buffer_length * output_data.input_depth * output_data.pixels_depth);
+		    }
 		    /*
 		    fprintf(stderr, "<<<<<Current %d %p %p %p\n",
 			    current_data_row, received_rows,